@@ -0,0 +1,559 @@
+/*
+ * Bench Common - shared plumbing for the native benchmarks (bench_*.c)
+ *
+ * Each benchmark is a stand-alone tool that measures one property of the
+ * host and prints a single JSON object, like the helpers. This header gives
+ * them the same building blocks on Windows and Linux:
+ *
+ *   bench_now_ns()            monotonic clock in nanoseconds
+ *   bench_pin(cpu)            pin the calling thread to one logical CPU
+ *   bench_thread_start/join   plain worker threads
+ *   bench_topology()          logical CPUs with package, core, SMT sibling,
+ *                             L2/L3 group, NUMA node and hybrid core type
+ *   bench_chain(steps)        dependent integer chain of a known cycle count
+ *   bench_fit_budget()        shorten the runs to fit --deadline-ms
+ *   bench_arg*()              command-line parsing
+ *
+ * Latency distributions are kept in hdr_histogram.h histograms and printed
+ * with hdr_json(); --deadline-ms (helper_deadline.h) ends the repetitions
+ * early and the JSON reports the result as truncated.
+ *
+ * Usage:
+ *   BenchCpu cpus[BENCH_MAX_CPUS];
+ *   int n = bench_topology(cpus, BENCH_MAX_CPUS);
+ *   bench_pin(cpus[n - 1].cpu);
+ *   uint64_t start = bench_now_ns();
+ *   bench_chain(1000000);
+ *   double mhz = 1000000.0 * BENCH_CHAIN_CYCLES * 1000.0 / (bench_now_ns() - start);
+ */
+
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+// pthread_setaffinity_np(); include this header before any system header
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "helper_deadline.h"
+
+#define BENCH_MAX_CPUS 1024
+#define BENCH_PATH_MAX 512
+
+// ---------------------------------------------------------------- clocks
+
+static inline uint64_t bench_now_ns(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static inline void bench_sleep_ms(double ms) {
+#ifdef _WIN32
+    Sleep((DWORD)(ms + 0.5));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ms / 1000.0);
+    ts.tv_nsec = (long)((ms - (double)ts.tv_sec * 1000.0) * 1e6);
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+#endif
+}
+
+// ---------------------------------------------------------------- work
+
+// Keeps the compiler from folding a chain of operations on 'x'
+#if defined(_MSC_VER)
+#define BENCH_OPAQUE(x) _ReadWriteBarrier()
+#else
+#define BENCH_OPAQUE(x) __asm__ volatile("" : "+r"(x))
+#endif
+
+// Core clock cycles per bench_chain() step. The chain is a dependent 64-bit
+// multiply (3 cycles on every x86 core since Nehalem and Zen): recent Intel
+// cores eliminate small-immediate adds at rename, so an add chain would
+// report several times the real frequency.
+#define BENCH_CHAIN_CYCLES 3
+
+static volatile uint64_t g_bench_sink;
+
+// Run 'steps' dependent steps (a multiple of 8): steps * BENCH_CHAIN_CYCLES
+// core cycles, whatever the core's frequency
+static inline void bench_chain(uint64_t steps) {
+    uint64_t x = g_bench_sink | 1;
+    for (uint64_t i = 0; i < steps; i += 8) {
+        x *= 0x9E3779B97F4A7C15ull; BENCH_OPAQUE(x); x *= 0x9E3779B97F4A7C15ull; BENCH_OPAQUE(x);
+        x *= 0x9E3779B97F4A7C15ull; BENCH_OPAQUE(x); x *= 0x9E3779B97F4A7C15ull; BENCH_OPAQUE(x);
+        x *= 0x9E3779B97F4A7C15ull; BENCH_OPAQUE(x); x *= 0x9E3779B97F4A7C15ull; BENCH_OPAQUE(x);
+        x *= 0x9E3779B97F4A7C15ull; BENCH_OPAQUE(x); x *= 0x9E3779B97F4A7C15ull; BENCH_OPAQUE(x);
+    }
+    g_bench_sink = x;
+}
+
+// ---------------------------------------------------------------- threads
+
+// Pin the calling thread to logical CPU 'cpu' (numbered across processor
+// groups on Windows). Returns 1 on success.
+static inline int bench_pin(int cpu) {
+#ifdef _WIN32
+    WORD groups = GetActiveProcessorGroupCount();
+    int first = 0;
+    for (WORD group = 0; group < groups; group++) {
+        int count = (int)GetActiveProcessorCount(group);
+        if (cpu < first + count) {
+            GROUP_AFFINITY affinity;
+            memset(&affinity, 0, sizeof(affinity));
+            affinity.Group = group;
+            affinity.Mask = (KAFFINITY)1 << (cpu - first);
+            return SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL) != 0;
+        }
+        first += count;
+    }
+    return 0;
+#else
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return 0;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+}
+
+typedef void (*bench_thread_fn)(void* arg);
+
+typedef struct {
+    bench_thread_fn fn;
+    void* arg;
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t thread;
+#endif
+} BenchThread;
+
+#ifdef _WIN32
+static inline DWORD WINAPI bench_thread_main(LPVOID param) {
+    BenchThread* t = (BenchThread*)param;
+    t->fn(t->arg);
+    return 0;
+}
+#else
+static inline void* bench_thread_main(void* param) {
+    BenchThread* t = (BenchThread*)param;
+    t->fn(t->arg);
+    return NULL;
+}
+#endif
+
+// Start fn(arg) on a new thread; 't' must stay valid until bench_thread_join()
+static inline int bench_thread_start(BenchThread* t, bench_thread_fn fn, void* arg) {
+    t->fn = fn;
+    t->arg = arg;
+#ifdef _WIN32
+    t->handle = CreateThread(NULL, 0, bench_thread_main, t, 0, NULL);
+    return t->handle != NULL;
+#else
+    return pthread_create(&t->thread, NULL, bench_thread_main, t) == 0;
+#endif
+}
+
+static inline void bench_thread_join(BenchThread* t) {
+#ifdef _WIN32
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+#else
+    pthread_join(t->thread, NULL);
+#endif
+}
+
+// Spin-loop hint (PAUSE on x86, YIELD on Arm)
+#if defined(_MSC_VER)
+#define BENCH_PAUSE() YieldProcessor()
+#elif defined(__x86_64__) || defined(__i386__)
+#define BENCH_PAUSE() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define BENCH_PAUSE() __asm__ volatile("yield")
+#else
+#define BENCH_PAUSE() ((void)0)
+#endif
+
+static inline long bench_atomic_add(volatile long* value, long delta) {
+#ifdef _WIN32
+    return InterlockedExchangeAdd(value, delta) + delta;
+#else
+    return __atomic_add_fetch(value, delta, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline long bench_atomic_load(volatile long* value) {
+#ifdef _WIN32
+    return InterlockedCompareExchange(value, 0, 0);
+#else
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// Measuring threads wait here, already pinned, until all 'expected' threads
+// have arrived, so they measure the same interval
+typedef struct {
+    volatile long arrived;
+    long expected;
+} BenchStartLine;
+
+static inline void bench_start_line_wait(BenchStartLine* line) {
+    bench_atomic_add(&line->arrived, 1);
+    while (bench_atomic_load(&line->arrived) < line->expected) BENCH_PAUSE();
+}
+
+// ---------------------------------------------------------------- files
+
+// Read a small text file; returns its length or -1
+static inline int bench_read_text(const char* path, char* buf, size_t size) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return -1;
+    size_t len = fread(buf, 1, size - 1, f);
+    fclose(f);
+    buf[len] = '\0';
+    while (len && (buf[len - 1] == '\n' || buf[len - 1] == ' ')) buf[--len] = '\0';
+    return (int)len;
+}
+
+static inline long bench_read_long(const char* path, long fallback) {
+    char buf[64];
+    if (bench_read_text(path, buf, sizeof(buf)) <= 0) return fallback;
+    return strtol(buf, NULL, 10);
+}
+
+// Write a sysfs/procfs value; returns 0 or the errno of the failed write
+static inline int bench_write_text(const char* path, const char* text) {
+    FILE* f = fopen(path, "w");
+    if (!f) return errno ? errno : 1;
+    int ok = fputs(text, f) >= 0;
+    int err = ok ? 0 : errno;
+    if (fclose(f) != 0 && !err) err = errno ? errno : 1;
+    return err;
+}
+
+// Write a sysfs value through a descriptor opened in advance, for restoring
+// settings from a signal handler: lseek() and write() are async-signal-safe,
+// fopen() and fputs() are not. Errors are ignored (there is no one to tell).
+static inline void bench_write_fd(int fd, const char* text) {
+#ifndef _WIN32
+    if (fd < 0) return;
+    size_t len = 0;
+    while (text[len]) len++;
+    if (lseek(fd, 0, SEEK_SET) == 0) {
+        ssize_t written = write(fd, text, len);
+        (void)written;
+    }
+#else
+    (void)fd;
+    (void)text;
+#endif
+}
+
+// Parse a cpu list ("0-3,8 10") into 'out' (may be NULL); returns the count
+static inline int bench_cpu_list(const char* text, int* out, int max_count) {
+    int count = 0;
+    const char* p = text;
+    while (*p) {
+        while (*p == ',' || *p == ' ' || *p == '\n' || *p == '\t') p++;
+        if (*p < '0' || *p > '9') break;
+        char* end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long cpu = first; cpu <= last && count < max_count; cpu++) {
+            if (out) out[count] = (int)cpu;
+            count++;
+        }
+    }
+    return count;
+}
+
+// ---------------------------------------------------------------- topology
+
+typedef struct {
+    int cpu;                // logical CPU number (bench_pin() numbering)
+    int package;
+    int core;               // lowest logical CPU of the physical core
+    int smt_index;          // 0 for the first thread of a core, 1 for its sibling, ...
+    int l2;                 // lowest logical CPU sharing the L2 (-1 if unknown)
+    int l3;                 // lowest logical CPU sharing the L3 (-1 if unknown)
+    int node;               // NUMA node (-1 if unknown)
+    const char* core_type;  // "P-core", "E-core" or NULL on non-hybrid parts
+} BenchCpu;
+
+static inline int bench_compare_cpus(const void* a, const void* b) {
+    return ((const BenchCpu*)a)->cpu - ((const BenchCpu*)b)->cpu;
+}
+
+#ifdef _WIN32
+// Logical CPUs (bench_pin() numbering) in a group affinity mask; returns the lowest
+static inline int bench_mask_cpus(const GROUP_AFFINITY* mask, int* out, int max_count, int* count) {
+    int first = 0;
+    for (WORD group = 0; group < mask->Group; group++) first += (int)GetActiveProcessorCount(group);
+    int lowest = -1;
+    for (int bit = 0; bit < 64; bit++) {
+        if (!(mask->Mask & ((KAFFINITY)1 << bit))) continue;
+        if (lowest < 0) lowest = first + bit;
+        if (out && *count < max_count) out[(*count)++] = first + bit;
+    }
+    return lowest;
+}
+#endif
+
+// Fill 'out' with the online logical CPUs sorted by number; returns the count
+static inline int bench_topology(BenchCpu* out, int max_count) {
+    int count = 0;
+#ifdef _WIN32
+    DWORD length = 0;
+    GetLogicalProcessorInformationEx(RelationAll, NULL, &length);
+    unsigned char* buf = (unsigned char*)malloc(length ? length : 1);
+    int* classes = (int*)malloc(max_count * sizeof(int));
+    if (!buf || !classes || !GetLogicalProcessorInformationEx(RelationAll, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buf, &length)) {
+        free(buf);
+        free(classes);
+        return 0;
+    }
+    int total = 0;
+    for (WORD group = 0; group < GetActiveProcessorGroupCount(); group++) total += (int)GetActiveProcessorCount(group);
+    if (total > max_count) total = max_count;
+    for (int i = 0; i < total; i++) {
+        out[i].cpu = i;
+        out[i].package = out[i].core = out[i].l2 = out[i].l3 = out[i].node = -1;
+        out[i].smt_index = 0;
+        out[i].core_type = NULL;
+        classes[i] = -1;
+    }
+
+    // EfficiencyClass: higher is faster; all equal on non-hybrid parts
+    int min_class = 255, max_class = 0;
+    int packages = 0;
+    int members[64];
+    for (DWORD offset = 0; offset < length; ) {
+        PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX info = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(buf + offset);
+        int n = 0;
+        if (info->Relationship == RelationProcessorCore) {
+            int lowest = bench_mask_cpus(&info->Processor.GroupMask[0], members, 64, &n);
+            for (int k = 0; k < n; k++) {
+                if (members[k] >= total) continue;
+                out[members[k]].core = lowest;
+                out[members[k]].smt_index = k;
+                classes[members[k]] = info->Processor.EfficiencyClass;
+            }
+            if (info->Processor.EfficiencyClass < min_class) min_class = info->Processor.EfficiencyClass;
+            if (info->Processor.EfficiencyClass > max_class) max_class = info->Processor.EfficiencyClass;
+        } else if (info->Relationship == RelationProcessorPackage) {
+            for (WORD g = 0; g < info->Processor.GroupCount; g++) {
+                n = 0;
+                bench_mask_cpus(&info->Processor.GroupMask[g], members, 64, &n);
+                for (int k = 0; k < n; k++) if (members[k] < total) out[members[k]].package = packages;
+            }
+            packages++;
+        } else if (info->Relationship == RelationCache && (info->Cache.Level == 2 || info->Cache.Level == 3)) {
+            int lowest = bench_mask_cpus(&info->Cache.GroupMask, members, 64, &n);
+            for (int k = 0; k < n; k++) {
+                if (members[k] >= total) continue;
+                if (info->Cache.Level == 2) out[members[k]].l2 = lowest;
+                else out[members[k]].l3 = lowest;
+            }
+        } else if (info->Relationship == RelationNumaNode) {
+            bench_mask_cpus(&info->NumaNode.GroupMask, members, 64, &n);
+            for (int k = 0; k < n; k++) if (members[k] < total) out[members[k]].node = (int)info->NumaNode.NodeNumber;
+        }
+        offset += info->Size;
+    }
+    for (int i = 0; i < total; i++) {
+        if (min_class != max_class && classes[i] >= 0) out[i].core_type = classes[i] == max_class ? "P-core" : "E-core";
+    }
+    free(classes);
+    free(buf);
+    count = total;
+#else
+    char path[BENCH_PATH_MAX];
+    char buf[4096];
+    int* cpus = (int*)malloc(BENCH_MAX_CPUS * sizeof(int));
+    if (!cpus) return 0;
+    int online = 0;
+    if (bench_read_text("/sys/devices/system/cpu/online", buf, sizeof(buf)) > 0) {
+        online = bench_cpu_list(buf, cpus, BENCH_MAX_CPUS);
+    } else {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        for (long i = 0; i < n && i < BENCH_MAX_CPUS; i++) cpus[online++] = (int)i;
+    }
+
+    for (int i = 0; i < online && count < max_count; i++) {
+        BenchCpu* c = &out[count++];
+        c->cpu = cpus[i];
+        c->package = (int)bench_read_long((snprintf(path, sizeof(path),
+            "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", c->cpu), path), 0);
+        c->core = c->cpu;
+        c->smt_index = 0;
+        c->l2 = c->l3 = c->node = -1;
+        c->core_type = NULL;
+
+        int siblings[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", c->cpu);
+        if (bench_read_text(path, buf, sizeof(buf)) > 0) {
+            int n = bench_cpu_list(buf, siblings, 64);
+            for (int k = 0; k < n; k++) {
+                if (k == 0) c->core = siblings[0];
+                if (siblings[k] == c->cpu) c->smt_index = k;
+            }
+        }
+        for (int index = 0; index < 8; index++) {
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", c->cpu, index);
+            long level = bench_read_long(path, -1);
+            if (level < 0) break;
+            if (level != 2 && level != 3) continue;
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", c->cpu, index);
+            if (bench_read_text(path, buf, sizeof(buf)) > 0 && bench_cpu_list(buf, siblings, 1) == 1) {
+                if (level == 2) c->l2 = siblings[0];
+                else c->l3 = siblings[0];
+            }
+        }
+    }
+
+    // NUMA nodes and hybrid core types from their cpu lists
+    for (int node = 0; node < 1024; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        if (bench_read_text(path, buf, sizeof(buf)) < 0) {
+            if (node > 64) break;
+            continue;
+        }
+        int n = bench_cpu_list(buf, cpus, BENCH_MAX_CPUS);
+        for (int k = 0; k < n; k++) {
+            for (int i = 0; i < count; i++) if (out[i].cpu == cpus[k]) out[i].node = node;
+        }
+    }
+    static const struct { const char* path; const char* type; } types[] = {
+        {"/sys/devices/cpu_core/cpus", "P-core"},
+        {"/sys/devices/cpu_atom/cpus", "E-core"},
+    };
+    for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+        if (bench_read_text(types[t].path, buf, sizeof(buf)) <= 0) continue;
+        int n = bench_cpu_list(buf, cpus, BENCH_MAX_CPUS);
+        for (int k = 0; k < n; k++) {
+            for (int i = 0; i < count; i++) if (out[i].cpu == cpus[k]) out[i].core_type = types[t].type;
+        }
+    }
+    free(cpus);
+    qsort(out, count, sizeof(BenchCpu), bench_compare_cpus);
+#endif
+    return count;
+}
+
+static inline const BenchCpu* bench_find_cpu(const BenchCpu* cpus, int count, int cpu) {
+    for (int i = 0; i < count; i++) if (cpus[i].cpu == cpu) return &cpus[i];
+    return NULL;
+}
+
+// Core types are interned strings or NULL; equal if both NULL or the same name
+static inline int bench_same_type(const char* a, const char* b) {
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+// Another thread of primary's core, or NULL without SMT
+static inline const BenchCpu* bench_find_sibling(const BenchCpu* cpus, int count, const BenchCpu* primary) {
+    for (int i = 0; i < count; i++) {
+        if (&cpus[i] != primary && cpus[i].package == primary->package && cpus[i].core == primary->core) return &cpus[i];
+    }
+    return NULL;
+}
+
+// Where a partner core sits relative to the primary CPU
+#define BENCH_SAME_L3 0         // same package, sharing the L3
+#define BENCH_OTHER_L3 1        // same package, another L3
+#define BENCH_OTHER_PACKAGE 2
+
+// Highest-numbered first thread of another core at 'place' relative to
+// primary, of the same core type if 'same_type' is set; NULL if there is none
+static inline const BenchCpu* bench_find_other_core(const BenchCpu* cpus, int count, const BenchCpu* primary,
+                                                    int place, int same_type) {
+    for (int i = count - 1; i >= 0; i--) {
+        const BenchCpu* c = &cpus[i];
+        if (c->smt_index != 0 || c->core == primary->core) continue;
+        if (same_type && !bench_same_type(c->core_type, primary->core_type)) continue;
+        int at = c->package != primary->package ? BENCH_OTHER_PACKAGE : (c->l3 == primary->l3 ? BENCH_SAME_L3 : BENCH_OTHER_L3);
+        if (at == place) return c;
+    }
+    return NULL;
+}
+
+// Print the topology members of one CPU ("cpu", "core", ..., no braces)
+static inline void bench_print_cpu(const BenchCpu* c) {
+    printf("\"cpu\": %d, \"core\": %d, \"package\": %d, \"node\": %d, \"smt_index\": %d, ",
+           c->cpu, c->core, c->package, c->node, c->smt_index);
+    if (c->core_type) printf("\"core_type\": \"%s\"", c->core_type);
+    else printf("\"core_type\": null");
+}
+
+// ---------------------------------------------------------------- deadline
+
+#define BENCH_OUTPUT_RESERVE_MS 250   // left at the deadline for printing the results
+
+// Scale (at most 1) for the planned run times so 'needed_ms' of runs fits the
+// deadline with 'reserve_ms' left; records "full_duration" as skipped when
+// the runs have to be shortened
+static inline double bench_fit_budget(double needed_ms, double reserve_ms) {
+    double budget = deadline_remaining_ms() - reserve_ms;
+    if (needed_ms <= budget) return 1.0;
+    deadline_skip("full_duration", "budget");
+    return budget > 0 && needed_ms > 0 ? budget / needed_ms : 0;
+}
+
+// 'ms' scaled by bench_fit_budget(), but not below the shortest useful run
+static inline double bench_scale_ms(double ms, double scale, double min_ms) {
+    return ms * scale > min_ms ? ms * scale : min_ms;
+}
+
+// ---------------------------------------------------------------- arguments
+
+// Value of "--name VALUE", or NULL
+static inline const char* bench_arg(int argc, char* argv[], const char* name) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], name) == 0) return argv[i + 1];
+    }
+    return NULL;
+}
+
+static inline double bench_arg_double(int argc, char* argv[], const char* name, double fallback) {
+    const char* value = bench_arg(argc, argv, name);
+    return value ? atof(value) : fallback;
+}
+
+static inline int bench_has_flag(int argc, char* argv[], const char* name) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], name) == 0) return 1;
+    }
+    return 0;
+}
+
+#endif // BENCH_COMMON_H
@@ -0,0 +1,297 @@
+/*
+ * False Sharing Benchmark - the effective destructive interference size
+ *
+ * Hot structures are padded to the cache line (64 bytes), but on many Intel
+ * parts the L2 spatial prefetcher pulls lines in 128-byte pairs, so two
+ * threads writing 64 bytes apart can still slow each other down. Two pinned
+ * threads each increment their own counter for --duration-ms, with the
+ * counters
+ *
+ *   same_line           8 bytes apart
+ *   adjacent_line       64 apart, in the same 128-byte pair
+ *   adjacent_line_split 64 apart, straddling a 128-byte pair boundary
+ *   128 / 256           128 and 256 bytes apart
+ *   far                 a page apart (the control)
+ *
+ * and the pair's throughput is reported as a percent of two threads running
+ * alone. Pairs are an SMT sibling, a core sharing the L3, a core on another
+ * L3 and a core on another package, where the host has them.
+ *
+ * The effective destructive interference size of a placement is the
+ * smallest separation from which every larger one runs within 10% of the
+ * far control. It is reported next to the L1D line size (CPUID leaf 4 as in
+ * cpuid_helper's l1d_line, 0x80000005 on AMD, or the OS cache description).
+ *
+ * Usage:
+ *   bench_false_sharing [--duration-ms N] [--deadline-ms N]
+ */
+
+#include "bench_common.h"
+#include "helper_deadline.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SHARING_X86 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define SHARING_X86 1
+#endif
+
+#define MAX_PLACEMENTS 4
+#define WRITE_CHUNK 4096
+#define TOLERANCE_PERCENT 90.0
+
+typedef struct {
+    const char* name;
+    int a_offset, b_offset;
+    int separation;             // bytes between the counters
+} Layout;
+
+static const Layout g_layouts[] = {
+    {"same_line", 0, 8, 8},
+    {"adjacent_line", 0, 64, 64},
+    {"adjacent_line_split", 64, 128, 64},
+    {"128", 0, 128, 128},
+    {"256", 0, 256, 256},
+    {"far", 0, 4096, 4096},
+};
+#define LAYOUT_COUNT (int)(sizeof(g_layouts) / sizeof(g_layouts[0]))
+#define LAYOUT_FAR (LAYOUT_COUNT - 1)
+
+typedef struct {
+    const BenchCpu* cpu;
+    BenchStartLine* start_line;
+    volatile uint64_t* counter;
+    uint64_t duration_ns;
+    int pinned;
+    double rate;                // writes per second
+} WriterThread;
+
+static void writer_thread(void* arg) {
+    WriterThread* t = (WriterThread*)arg;
+    t->pinned = bench_pin(t->cpu->cpu);
+    bench_start_line_wait(t->start_line);
+    if (!t->pinned) return;
+    uint64_t start = bench_now_ns(), now = start;
+    uint64_t end = start + t->duration_ns;
+    uint64_t writes = 0;
+    while (now < end) {
+        for (int i = 0; i < WRITE_CHUNK; i++) *t->counter = *t->counter + 1;
+        writes += WRITE_CHUNK;
+        now = bench_now_ns();
+    }
+    t->rate = now > start ? (double)writes * 1e9 / (double)(now - start) : 0;
+}
+
+// Writers on 'cpu_a' (and 'cpu_b') into 'buffer' at the layout's offsets;
+// returns the combined writes per second, 0 if a thread could not be pinned
+static double run_writers(unsigned char* buffer, const Layout* layout, const BenchCpu* cpu_a, const BenchCpu* cpu_b,
+                          double duration_ms) {
+    WriterThread threads[2];
+    BenchThread handles[2];
+    int count = cpu_b ? 2 : 1;
+    BenchStartLine start_line = {0, count};
+    memset(threads, 0, sizeof(threads));
+    memset(buffer, 0, 8192);
+    threads[0].cpu = cpu_a;
+    threads[0].counter = (volatile uint64_t*)(buffer + layout->a_offset);
+    threads[1].cpu = cpu_b;
+    threads[1].counter = (volatile uint64_t*)(buffer + layout->b_offset);
+    int started = 0;
+    for (int i = 0; i < count; i++) {
+        threads[i].start_line = &start_line;
+        threads[i].duration_ns = (uint64_t)(duration_ms * 1e6);
+        if (!bench_thread_start(&handles[i], writer_thread, &threads[i])) break;
+        started++;
+    }
+    start_line.expected = started;
+    for (int i = 0; i < started; i++) bench_thread_join(&handles[i]);
+    if (started < count) return 0;
+    double total = 0;
+    for (int i = 0; i < count; i++) {
+        if (!threads[i].pinned) return 0;
+        total += threads[i].rate;
+    }
+    return total;
+}
+
+// L1D line size and where it came from
+static int read_l1d_line(const char** source) {
+    *source = NULL;
+#ifdef SHARING_X86
+    unsigned int r[4] = {0, 0, 0, 0};
+    char vendor[13] = {0};
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0);
+    memcpy(r, regs, sizeof(r));
+#else
+    __cpuid(0, r[0], r[1], r[2], r[3]);
+#endif
+    unsigned int max_leaf = r[0];
+    memcpy(vendor, &r[1], 4);
+    memcpy(vendor + 4, &r[3], 4);
+    memcpy(vendor + 8, &r[2], 4);
+    if (strcmp(vendor, "GenuineIntel") == 0 && max_leaf >= 4) {
+        for (int sub = 0; sub < 32; sub++) {
+#ifdef _MSC_VER
+            __cpuidex(regs, 4, sub);
+            memcpy(r, regs, sizeof(r));
+#else
+            __cpuid_count(4, sub, r[0], r[1], r[2], r[3]);
+#endif
+            int type = r[0] & 0x1F, level = (r[0] >> 5) & 0x7;
+            if (type == 0) break;
+            if (type == 1 && level == 1) {
+                *source = "cpuid_0x4";
+                return (int)(r[1] & 0xFFF) + 1;
+            }
+        }
+    } else if (strcmp(vendor, "AuthenticAMD") == 0) {
+#ifdef _MSC_VER
+        __cpuid(regs, 0x80000005);
+        memcpy(r, regs, sizeof(r));
+#else
+        __cpuid(0x80000005, r[0], r[1], r[2], r[3]);
+#endif
+        if (r[2] & 0xFF) {
+            *source = "cpuid_0x80000005";
+            return (int)(r[2] & 0xFF);
+        }
+    }
+#endif
+#ifdef _WIN32
+    DWORD length = 0;
+    GetLogicalProcessorInformationEx(RelationCache, NULL, &length);
+    unsigned char* buf = (unsigned char*)malloc(length ? length : 1);
+    int line = 0;
+    if (buf && GetLogicalProcessorInformationEx(RelationCache, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buf, &length)) {
+        for (DWORD offset = 0; offset < length && !line; ) {
+            PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX info = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(buf + offset);
+            if (info->Cache.Level == 1 && info->Cache.Type != CacheInstruction) line = info->Cache.LineSize;
+            offset += info->Size;
+        }
+    }
+    free(buf);
+    if (line) *source = "os";
+    return line;
+#else
+    char path[BENCH_PATH_MAX];
+    for (int index = 0; index < 8; index++) {
+        char type[32];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+        if (bench_read_text(path, type, sizeof(type)) < 0) break;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+        if (bench_read_long(path, 0) != 1 || strcmp(type, "Instruction") == 0) continue;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/coherency_line_size", index);
+        long line = bench_read_long(path, 0);
+        if (line > 0) {
+            *source = "sysfs";
+            return (int)line;
+        }
+    }
+    return 0;
+#endif
+}
+
+int main(int argc, char* argv[]) {
+    double duration_ms = bench_arg_double(argc, argv, "--duration-ms", 200);
+    if (duration_ms < 20) duration_ms = 20;
+
+    deadline_init(argc, argv);
+
+    static BenchCpu cpus[BENCH_MAX_CPUS];
+    int cpu_count = bench_topology(cpus, BENCH_MAX_CPUS);
+    const BenchCpu* primary = NULL;
+    for (int i = cpu_count - 1; i >= 0 && !primary; i--) {
+        if (cpus[i].smt_index == 0 && bench_find_sibling(cpus, cpu_count, &cpus[i])) primary = &cpus[i];
+    }
+    for (int i = cpu_count - 1; i >= 0 && !primary; i--) {
+        if (cpus[i].smt_index == 0) primary = &cpus[i];
+    }
+    if (!primary) {
+        printf("{\"error\": \"No CPUs selected\"}\n");
+        return 1;
+    }
+    const char* placement_names[MAX_PLACEMENTS] = {"smt_sibling", "same_l3", "other_l3", "other_package"};
+    const BenchCpu* partners[MAX_PLACEMENTS] = {
+        bench_find_sibling(cpus, cpu_count, primary),
+        bench_find_other_core(cpus, cpu_count, primary, BENCH_SAME_L3, 0),
+        bench_find_other_core(cpus, cpu_count, primary, BENCH_OTHER_L3, 0),
+        bench_find_other_core(cpus, cpu_count, primary, BENCH_OTHER_PACKAGE, 0),
+    };
+    const char* line_source;
+    int l1d_line = read_l1d_line(&line_source);
+
+    // Two pages, page-aligned, so every layout's lines start out in the same state
+    unsigned char* raw = (unsigned char*)malloc(3 * 4096);
+    if (!raw) {
+        printf("{\"error\": \"Out of memory\"}\n");
+        return 1;
+    }
+    unsigned char* buffer = (unsigned char*)(((uintptr_t)raw + 4095) & ~(uintptr_t)4095);
+
+    // Every run has to fit the deadline with time left for the output
+    int placements = 0;
+    for (int p = 0; p < MAX_PLACEMENTS; p++) placements += partners[p] != NULL;
+    int runs = 1 + placements * LAYOUT_COUNT;
+    duration_ms = bench_scale_ms(duration_ms, bench_fit_budget(duration_ms * runs, BENCH_OUTPUT_RESERVE_MS), 20);
+
+    double alone = run_writers(buffer, &g_layouts[LAYOUT_FAR], primary, NULL, duration_ms);
+    double rates[MAX_PLACEMENTS][LAYOUT_COUNT];
+    int interference[MAX_PLACEMENTS];
+    int largest = 0;
+    for (int p = 0; p < MAX_PLACEMENTS; p++) {
+        interference[p] = -1;
+        if (!partners[p]) continue;
+        for (int l = 0; l < LAYOUT_COUNT; l++) rates[p][l] = run_writers(buffer, &g_layouts[l], primary, partners[p], duration_ms);
+
+        // Smallest separation from which every larger layout keeps up with the control
+        double far = rates[p][LAYOUT_FAR];
+        if (far <= 0) continue;
+        interference[p] = g_layouts[LAYOUT_FAR].separation;
+        for (int l = LAYOUT_FAR - 1; l >= 0; l--) {
+            if (100.0 * rates[p][l] / far < TOLERANCE_PERCENT) break;
+            // Both 64-byte layouts have to pass before 64 counts
+            if (l > 0 && g_layouts[l - 1].separation == g_layouts[l].separation) continue;
+            interference[p] = g_layouts[l].separation;
+        }
+        if (interference[p] > largest) largest = interference[p];
+    }
+    free(raw);
+
+    printf("{");
+    deadline_print_json();
+    printf("\"method\": \"paired_writers\", \"duration_ms\": %.0f, \"cpu_count\": %d", duration_ms, cpu_count);
+    if (l1d_line) printf(", \"l1d_line\": %d, \"l1d_line_source\": \"%s\"", l1d_line, line_source);
+    else printf(", \"l1d_line\": null, \"l1d_line_source\": null");
+    if (largest) printf(", \"destructive_interference_bytes\": %d", largest);
+    else printf(", \"destructive_interference_bytes\": null");
+    if (largest && l1d_line) printf(", \"exceeds_line\": %s", largest > l1d_line ? "true" : "false");
+    else printf(", \"exceeds_line\": null");
+    printf(", \"alone_writes_per_s\": %.4g,\n \"primary\": {", alone);
+    bench_print_cpu(primary);
+    printf("},\n \"placements\": [");
+    int printed = 0;
+    for (int p = 0; p < MAX_PLACEMENTS; p++) {
+        if (!partners[p]) continue;
+        printf("%s\n  {\"placement\": \"%s\", \"partner\": {", printed++ ? "," : "", placement_names[p]);
+        bench_print_cpu(partners[p]);
+        printf("}");
+        if (interference[p] > 0) printf(", \"destructive_interference_bytes\": %d", interference[p]);
+        else printf(", \"destructive_interference_bytes\": null");
+        printf(", \"layouts\": [");
+        for (int l = 0; l < LAYOUT_COUNT; l++) {
+            double far = rates[p][LAYOUT_FAR];
+            printf("%s\n    {\"layout\": \"%s\", \"separation\": %d, \"writes_per_s\": %.4g", l ? "," : "", g_layouts[l].name,
+                   g_layouts[l].separation, rates[p][l]);
+            if (alone > 0) printf(", \"percent_of_alone\": %.1f", 100.0 * rates[p][l] / (2 * alone));
+            else printf(", \"percent_of_alone\": null");
+            if (far > 0) printf(", \"percent_of_far\": %.1f}", 100.0 * rates[p][l] / far);
+            else printf(", \"percent_of_far\": null}");
+        }
+        printf("]}");
+    }
+    printf("]}\n");
+    return 0;
+}
@@ -0,0 +1,518 @@
+/*
+ * Frequency Ramp Benchmark - how long an idle core takes to reach full speed
+ *
+ * Bursty services pay for every millisecond a core spends ramping up from
+ * idle. For each selected logical CPU this benchmark pins itself there,
+ * sleeps --idle-ms so the core drops to its idle frequency, then runs a
+ * dependent integer chain (bench_chain(), a known number of core cycles per
+ * step) in windows of about --window-us and converts each window's duration
+ * into an effective frequency. The plateau is the median of the last quarter
+ * of --ramp-ms; the ramp-up latency is the time until the frequency first
+ * holds 95% of the plateau (median of five windows). Where /dev/cpu/N/msr is
+ * readable, the plateau is cross-checked with APERF.
+ *
+ * Ramp-up latencies of --runs repetitions go into an HDR histogram per CPU
+ * and per core type (P-core / E-core on hybrid parts).
+ *
+ * With --sweep (Linux, root) every governor in scaling_available_governors
+ * and, for governors that allow it, every energy_performance_preference is
+ * applied to the selected CPUs in turn. Settings the driver refuses are
+ * listed under "unavailable"; the original settings are restored on exit,
+ * including on SIGINT/SIGTERM.
+ *
+ * CPUs: by default the highest-numbered first SMT thread of each core type
+ * (or of the host); --cpus all takes the first thread of every core.
+ *
+ * Usage:
+ *   bench_freq_ramp [--cpus LIST|all] [--runs N] [--idle-ms N] [--ramp-ms N]
+ *                   [--window-us N] [--sweep] [--deadline-ms N]
+ */
+
+#include "bench_common.h"
+#include "hdr_histogram.h"
+#include "helper_deadline.h"
+
+#ifndef _WIN32
+#include <signal.h>
+#include <fcntl.h>
+#endif
+
+#define MAX_WINDOWS 65536
+#define MAX_CONFIGS 64
+#define MAX_SETTINGS 16
+#define SETTING_MAX 48
+#define PLATEAU_FRACTION 0.95
+#define RAMP_HIGHEST_US (60ull * 1000000ull)
+
+typedef struct {
+    char governor[SETTING_MAX];
+    char epp[SETTING_MAX];      // "" = leave unchanged
+} RampConfig;
+
+typedef struct {
+    const BenchCpu* cpu;
+    HdrHistogram ramp_us;
+    double start_mhz_sum;
+    double plateau_mhz_sum;
+    double aperf_mhz_sum;
+    int aperf_runs;
+    int runs;
+} CpuResult;
+
+static const BenchCpu* g_selected[BENCH_MAX_CPUS];
+static int g_selected_count = 0;
+
+static double g_window_mhz[MAX_WINDOWS];
+static double g_window_start_us[MAX_WINDOWS];
+
+// ---------------------------------------------------------------- cpufreq settings (Linux)
+
+static char g_saved_governor[BENCH_MAX_CPUS][SETTING_MAX];
+static char g_saved_epp[BENCH_MAX_CPUS][SETTING_MAX];
+static int g_settings_changed = 0;
+
+// Opened before the sweep changes anything so restore_and_exit() can put the
+// settings back with write() alone; -1 where the file could not be opened
+static int g_restore_governor_fd[BENCH_MAX_CPUS];
+static int g_restore_epp_fd[BENCH_MAX_CPUS];
+
+static void cpufreq_path(char* path, size_t size, int cpu, const char* file) {
+    snprintf(path, size, "/sys/devices/system/cpu/cpu%d/cpufreq/%s", cpu, file);
+}
+
+static void read_setting(int cpu, const char* file, char* out) {
+    char path[BENCH_PATH_MAX];
+    cpufreq_path(path, sizeof(path), cpu, file);
+    if (bench_read_text(path, out, SETTING_MAX) < 0) out[0] = '\0';
+}
+
+// Space-separated list in a cpufreq file; returns the number of entries
+static int read_setting_list(int cpu, const char* file, char out[][SETTING_MAX], int max_count) {
+    char path[BENCH_PATH_MAX];
+    char buf[1024];
+    cpufreq_path(path, sizeof(path), cpu, file);
+    if (bench_read_text(path, buf, sizeof(buf)) <= 0) return 0;
+    int count = 0;
+    for (char* word = strtok(buf, " \n"); word && count < max_count; word = strtok(NULL, " \n")) {
+        snprintf(out[count++], SETTING_MAX, "%s", word);
+    }
+    return count;
+}
+
+#ifndef _WIN32
+static void open_restore_fds(void) {
+    char path[BENCH_PATH_MAX];
+    for (int i = 0; i < g_selected_count; i++) {
+        int cpu = g_selected[i]->cpu;
+        g_restore_governor_fd[i] = g_restore_epp_fd[i] = -1;
+        if (g_saved_governor[i][0]) {
+            cpufreq_path(path, sizeof(path), cpu, "scaling_governor");
+            g_restore_governor_fd[i] = open(path, O_WRONLY | O_CLOEXEC);
+        }
+        if (g_saved_epp[i][0]) {
+            cpufreq_path(path, sizeof(path), cpu, "energy_performance_preference");
+            g_restore_epp_fd[i] = open(path, O_WRONLY | O_CLOEXEC);
+        }
+    }
+}
+#endif
+
+static void restore_settings(void) {
+#ifndef _WIN32
+    if (!g_settings_changed) return;
+    char path[BENCH_PATH_MAX];
+    for (int i = 0; i < g_selected_count; i++) {
+        int cpu = g_selected[i]->cpu;
+        if (g_saved_governor[i][0]) {
+            cpufreq_path(path, sizeof(path), cpu, "scaling_governor");
+            bench_write_text(path, g_saved_governor[i]);
+        }
+        if (g_saved_epp[i][0]) {
+            cpufreq_path(path, sizeof(path), cpu, "energy_performance_preference");
+            bench_write_text(path, g_saved_epp[i]);
+        }
+    }
+    g_settings_changed = 0;
+#endif
+}
+
+#ifndef _WIN32
+// Signal handler: async-signal-safe calls only, so no restore_settings()
+static void restore_and_exit(int sig) {
+    if (g_settings_changed) {
+        for (int i = 0; i < g_selected_count; i++) {
+            bench_write_fd(g_restore_governor_fd[i], g_saved_governor[i]);
+            bench_write_fd(g_restore_epp_fd[i], g_saved_epp[i]);
+        }
+    }
+    _exit(128 + sig);
+}
+#endif
+
+static const char* write_error_reason(int err) {
+    if (err == EACCES || err == EPERM || err == EROFS) return "permission";
+    if (err == EBUSY) return "busy";
+    return "rejected";
+}
+
+// Apply a configuration to every selected CPU; returns NULL or why it failed
+static const char* apply_config(const RampConfig* config) {
+    char path[BENCH_PATH_MAX];
+    g_settings_changed = 1;
+    for (int i = 0; i < g_selected_count; i++) {
+        int cpu = g_selected[i]->cpu;
+        cpufreq_path(path, sizeof(path), cpu, "scaling_governor");
+        int err = bench_write_text(path, config->governor);
+        if (err) return write_error_reason(err);
+        if (config->epp[0]) {
+            cpufreq_path(path, sizeof(path), cpu, "energy_performance_preference");
+            err = bench_write_text(path, config->epp);
+            if (err) return write_error_reason(err);
+        }
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------- measurement
+
+#ifndef _WIN32
+// APERF (IA32_APERF, 0xE8) of 'cpu' through the msr driver; 0 if unreadable
+static uint64_t read_aperf(int fd) {
+    uint64_t value = 0;
+    if (fd < 0 || pread(fd, &value, sizeof(value), 0xE8) != (ssize_t)sizeof(value)) return 0;
+    return value;
+}
+#endif
+
+static double median_of(double* values, int count) {
+    double sorted[8];
+    if (count > 8) count = 8;
+    memcpy(sorted, values, count * sizeof(double));
+    for (int i = 1; i < count; i++) {
+        double v = sorted[i];
+        int j = i;
+        for (; j > 0 && sorted[j - 1] > v; j--) sorted[j] = sorted[j - 1];
+        sorted[j] = v;
+    }
+    return sorted[count / 2];
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Steps of bench_chain() that take about 'window_us' at full speed
+static uint64_t calibrate_chunk(double window_us, double warm_ms) {
+    uint64_t start = bench_now_ns();
+    while ((bench_now_ns() - start) < (uint64_t)(warm_ms * 1e6)) bench_chain(4096);
+    uint64_t steps = 1 << 20;
+    uint64_t t0 = bench_now_ns();
+    bench_chain(steps);
+    double steps_per_us = (double)steps * 1000.0 / (double)(bench_now_ns() - t0);
+    uint64_t chunk = (uint64_t)(steps_per_us * window_us) & ~7ull;
+    return chunk < 64 ? 64 : chunk;
+}
+
+// One idle-then-busy run on the current CPU: fills the window arrays and
+// returns the window count; *aperf_mhz is the APERF plateau (0 if unknown)
+static int run_once(double idle_ms, double ramp_ms, uint64_t chunk, int msr_fd, double* aperf_mhz) {
+    bench_sleep_ms(idle_ms);
+    int windows = 0;
+    uint64_t start = bench_now_ns();
+    uint64_t ramp_ns = (uint64_t)(ramp_ms * 1e6);
+    uint64_t now = start;
+#ifndef _WIN32
+    uint64_t tail_ns = ramp_ns * 3 / 4;
+    uint64_t aperf_start = 0, aperf_start_ns = 0;
+#else
+    (void)msr_fd;
+#endif
+    while (now - start < ramp_ns && windows < MAX_WINDOWS) {
+#ifndef _WIN32
+        if (!aperf_start_ns && now - start >= tail_ns) {
+            aperf_start = read_aperf(msr_fd);
+            aperf_start_ns = bench_now_ns();
+            now = aperf_start_ns;
+        }
+#endif
+        bench_chain(chunk);
+        uint64_t end = bench_now_ns();
+        g_window_start_us[windows] = (double)(now - start) / 1000.0;
+        g_window_mhz[windows] = (double)chunk * BENCH_CHAIN_CYCLES * 1000.0 / (double)(end - now);
+        windows++;
+        now = end;
+    }
+    *aperf_mhz = 0;
+#ifndef _WIN32
+    uint64_t aperf_end = read_aperf(msr_fd);
+    if (aperf_start && aperf_end > aperf_start) {
+        *aperf_mhz = (double)(aperf_end - aperf_start) * 1000.0 / (double)(bench_now_ns() - aperf_start_ns);
+    }
+#endif
+    return windows;
+}
+
+static void measure_cpu(CpuResult* result, int runs, double idle_ms, double ramp_ms, double window_us,
+                        int* budget_skipped) {
+    const BenchCpu* cpu = result->cpu;
+    if (!bench_pin(cpu->cpu)) return;
+    int msr_fd = -1;
+#ifndef _WIN32
+    char path[64];
+    snprintf(path, sizeof(path), "/dev/cpu/%d/msr", cpu->cpu);
+    msr_fd = open(path, O_RDONLY);
+#endif
+    uint64_t chunk = calibrate_chunk(window_us, ramp_ms);
+    double* tail = (double*)malloc(MAX_WINDOWS * sizeof(double));
+
+    for (int run = 0; run < runs && tail; run++) {
+        if (!deadline_allows(idle_ms + ramp_ms + 5)) {
+            if (!*budget_skipped) deadline_skip("ramp_runs", "budget");
+            *budget_skipped = 1;
+            break;
+        }
+        double aperf_mhz;
+        int windows = run_once(idle_ms, ramp_ms, chunk, msr_fd, &aperf_mhz);
+        if (windows < 8) continue;
+
+        // Plateau: median of the last quarter of the run
+        int tail_count = windows / 4;
+        memcpy(tail, g_window_mhz + windows - tail_count, tail_count * sizeof(double));
+        qsort(tail, tail_count, sizeof(double), compare_doubles);
+        double plateau = tail[tail_count / 2];
+
+        // Ramp-up: first window from which the median of five holds the plateau
+        int reached = windows - 1;
+        for (int i = 0; i + 5 <= windows; i++) {
+            if (median_of(g_window_mhz + i, 5) >= PLATEAU_FRACTION * plateau) {
+                reached = i;
+                break;
+            }
+        }
+        hdr_record(&result->ramp_us, (uint64_t)(g_window_start_us[reached] + 0.5));
+        result->start_mhz_sum += g_window_mhz[0];
+        result->plateau_mhz_sum += plateau;
+        if (aperf_mhz > 0) {
+            result->aperf_mhz_sum += aperf_mhz;
+            result->aperf_runs++;
+        }
+        result->runs++;
+    }
+    free(tail);
+#ifndef _WIN32
+    if (msr_fd >= 0) close(msr_fd);
+#endif
+}
+
+// ---------------------------------------------------------------- selection and output
+
+static void select_cpus(const BenchCpu* cpus, int count, const char* spec) {
+    if (spec && strcmp(spec, "all") == 0) {
+        for (int i = 0; i < count; i++) {
+            if (cpus[i].smt_index == 0) g_selected[g_selected_count++] = &cpus[i];
+        }
+        return;
+    }
+    if (spec) {
+        int* list = (int*)malloc(BENCH_MAX_CPUS * sizeof(int));
+        int n = list ? bench_cpu_list(spec, list, BENCH_MAX_CPUS) : 0;
+        for (int k = 0; k < n; k++) {
+            const BenchCpu* c = bench_find_cpu(cpus, count, list[k]);
+            if (c) g_selected[g_selected_count++] = c;
+        }
+        free(list);
+        return;
+    }
+    // Highest-numbered first thread of each core type: CPU 0 takes most housekeeping
+    const char* types[3] = {"P-core", "E-core", NULL};
+    for (int t = 0; t < 3; t++) {
+        for (int i = count - 1; i >= 0; i--) {
+            int same = types[t] ? (cpus[i].core_type && strcmp(cpus[i].core_type, types[t]) == 0)
+                                : cpus[i].core_type == NULL;
+            if (same && cpus[i].smt_index == 0) {
+                g_selected[g_selected_count++] = &cpus[i];
+                break;
+            }
+        }
+    }
+}
+
+static void print_setting(const char* name, const char* value) {
+    if (value && value[0]) printf("\"%s\": \"%s\"", name, value);
+    else printf("\"%s\": null", name);
+}
+
+// One configuration as it is in effect (read back from sysfs, not as requested)
+static void print_config(CpuResult* results, int count) {
+    char driver[SETTING_MAX] = "", governor[SETTING_MAX] = "", epp[SETTING_MAX] = "";
+#ifndef _WIN32
+    read_setting(results[0].cpu->cpu, "scaling_driver", driver);
+    read_setting(results[0].cpu->cpu, "scaling_governor", governor);
+    read_setting(results[0].cpu->cpu, "energy_performance_preference", epp);
+#endif
+    printf("    {");
+    print_setting("driver", driver);
+    printf(", ");
+    print_setting("governor", governor);
+    printf(", ");
+    print_setting("epp", epp);
+
+    // Per core type: the CPUs' histograms merged
+    printf(", \"core_types\": [");
+    int printed = 0;
+    for (int i = 0; i < count; i++) {
+        const char* type = results[i].cpu->core_type;
+        int seen = 0;
+        for (int k = 0; k < i; k++) {
+            const char* other = results[k].cpu->core_type;
+            seen |= (type == other) || (type && other && strcmp(type, other) == 0);
+        }
+        if (seen) continue;
+        HdrHistogram merged;
+        if (hdr_init(&merged, RAMP_HIGHEST_US, 7) != 0) continue;
+        double start = 0, plateau = 0;
+        int runs = 0, cpus = 0;
+        for (int k = i; k < count; k++) {
+            const char* other = results[k].cpu->core_type;
+            if (!((type == other) || (type && other && strcmp(type, other) == 0))) continue;
+            hdr_merge(&merged, &results[k].ramp_us);
+            start += results[k].start_mhz_sum;
+            plateau += results[k].plateau_mhz_sum;
+            runs += results[k].runs;
+            cpus++;
+        }
+        printf("%s\n      {", printed++ ? "," : "");
+        print_setting("core_type", type ? type : "All");
+        printf(", \"cpus\": %d, \"runs\": %d", cpus, runs);
+        if (runs) printf(", \"start_mhz\": %.0f, \"plateau_mhz\": %.0f", start / runs, plateau / runs);
+        else printf(", \"start_mhz\": null, \"plateau_mhz\": null");
+        printf(", \"ramp_us\": ");
+        hdr_json(stdout, &merged, "us");
+        printf("}");
+        hdr_free(&merged);
+    }
+    printf("],\n     \"cpus\": [");
+    for (int i = 0; i < count; i++) {
+        CpuResult* r = &results[i];
+        printf("%s\n      {", i ? "," : "");
+        bench_print_cpu(r->cpu);
+        printf(", \"runs\": %d", r->runs);
+        if (r->runs) printf(", \"start_mhz\": %.0f, \"plateau_mhz\": %.0f", r->start_mhz_sum / r->runs, r->plateau_mhz_sum / r->runs);
+        else printf(", \"start_mhz\": null, \"plateau_mhz\": null");
+        if (r->aperf_runs) printf(", \"plateau_aperf_mhz\": %.0f", r->aperf_mhz_sum / r->aperf_runs);
+        else printf(", \"plateau_aperf_mhz\": null");
+        printf(", \"ramp_us\": ");
+        hdr_json(stdout, &r->ramp_us, "us");
+        printf("}");
+    }
+    printf("]}");
+}
+
+int main(int argc, char* argv[]) {
+    int runs = (int)bench_arg_double(argc, argv, "--runs", 10);
+    double idle_ms = bench_arg_double(argc, argv, "--idle-ms", 100);
+    double ramp_ms = bench_arg_double(argc, argv, "--ramp-ms", 100);
+    double window_us = bench_arg_double(argc, argv, "--window-us", 50);
+    int sweep = bench_has_flag(argc, argv, "--sweep");
+    if (runs < 1) runs = 1;
+    if (ramp_ms < 4) ramp_ms = 4;
+    if (window_us < 5) window_us = 5;
+
+    deadline_init(argc, argv);
+
+    static BenchCpu cpus[BENCH_MAX_CPUS];
+    int cpu_count = bench_topology(cpus, BENCH_MAX_CPUS);
+    select_cpus(cpus, cpu_count, bench_arg(argc, argv, "--cpus"));
+    if (!g_selected_count) {
+        printf("{\"error\": \"No CPUs selected\"}\n");
+        return 1;
+    }
+
+    // Configurations: the current settings, or every governor x EPP
+    static RampConfig configs[MAX_CONFIGS];
+    int config_count = 1;
+    memset(&configs[0], 0, sizeof(configs[0]));
+#ifndef _WIN32
+    for (int i = 0; i < g_selected_count; i++) {
+        read_setting(g_selected[i]->cpu, "scaling_governor", g_saved_governor[i]);
+        read_setting(g_selected[i]->cpu, "energy_performance_preference", g_saved_epp[i]);
+    }
+    if (sweep) {
+        char governors[MAX_SETTINGS][SETTING_MAX];
+        char epps[MAX_SETTINGS][SETTING_MAX];
+        int cpu = g_selected[0]->cpu;
+        int governor_count = read_setting_list(cpu, "scaling_available_governors", governors, MAX_SETTINGS);
+        int epp_count = read_setting_list(cpu, "energy_performance_available_preferences", epps, MAX_SETTINGS);
+        config_count = 0;
+        for (int g = 0; g < governor_count; g++) {
+            // intel_pstate/amd-pstate pin EPP to "performance" under that governor
+            int with_epp = epp_count && strcmp(governors[g], "performance") != 0;
+            for (int e = 0; e < (with_epp ? epp_count : 1) && config_count < MAX_CONFIGS; e++) {
+                RampConfig* config = &configs[config_count++];
+                memcpy(config->governor, governors[g], SETTING_MAX);
+                if (with_epp) memcpy(config->epp, epps[e], SETTING_MAX);
+            }
+        }
+        if (!config_count) {
+            config_count = 1;
+            sweep = 0;
+        }
+        open_restore_fds();
+        signal(SIGINT, restore_and_exit);
+        signal(SIGTERM, restore_and_exit);
+        atexit(restore_settings);
+    }
+#else
+    sweep = 0;
+#endif
+
+    CpuResult* results = (CpuResult*)calloc(g_selected_count, sizeof(CpuResult));
+    if (!results) {
+        printf("{\"error\": \"Out of memory\"}\n");
+        return 1;
+    }
+
+    // Configurations are printed as they finish; the deadline members need
+    // the final elapsed time, so they go at the end
+    printf("{");
+    printf("\"method\": \"dependent_chain\", \"chain_cycles_per_step\": %d, \"runs\": %d, "
+           "\"idle_ms\": %.0f, \"ramp_ms\": %.0f, \"window_us\": %.0f, \"sweep\": %s,\n \"configs\": [\n",
+           BENCH_CHAIN_CYCLES, runs, idle_ms, ramp_ms, window_us, sweep ? "true" : "false");
+
+    int budget_skipped = 0;
+    int printed = 0;
+    char unavailable[MAX_CONFIGS][2 * SETTING_MAX + 64];
+    int unavailable_count = 0;
+    for (int c = 0; c < config_count && !budget_skipped; c++) {
+        if (sweep) {
+            const char* failure = apply_config(&configs[c]);
+            if (failure) {
+                snprintf(unavailable[unavailable_count++], sizeof(unavailable[0]),
+                         "{\"governor\": \"%s\", \"epp\": \"%s\", \"reason\": \"%s\"}",
+                         configs[c].governor, configs[c].epp, failure);
+                continue;
+            }
+            bench_sleep_ms(50);   // let the driver settle on the new policy
+        }
+        for (int i = 0; i < g_selected_count; i++) {
+            memset(&results[i], 0, sizeof(CpuResult));
+            results[i].cpu = g_selected[i];
+            hdr_init(&results[i].ramp_us, RAMP_HIGHEST_US, 7);
+            measure_cpu(&results[i], runs, idle_ms, ramp_ms, window_us, &budget_skipped);
+        }
+        printf("%s", printed++ ? ",\n" : "");
+        print_config(results, g_selected_count);
+        for (int i = 0; i < g_selected_count; i++) hdr_free(&results[i].ramp_us);
+        fflush(stdout);
+    }
+    restore_settings();
+
+    printf("\n ], \"unavailable\": [");
+    for (int i = 0; i < unavailable_count; i++) printf("%s%s", i ? ", " : "", unavailable[i]);
+    printf("], ");
+    deadline_print_json();
+    printf("\"cpu_count\": %d}\n", cpu_count);
+    free(results);
+    return 0;
+}
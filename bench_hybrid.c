@@ -0,0 +1,300 @@
+/*
+ * Hybrid Benchmark - P-core vs E-core performance ratios per workload
+ *
+ * On hybrid parts (Alder Lake, Raptor Lake, Meteor Lake) an E-core is worth
+ * a different fraction of a P-core for every kind of work: close to one for
+ * a memory-latency-bound loop, much less for vector FP. Schedulers and
+ * thread pools that size work per core need those fractions for the SKU at
+ * hand. For each core type and each bench_kernels.h kernel (int, fp, mem,
+ * branch; --kernels selects) this benchmark measures
+ *
+ *   latency      fixed-size tasks back to back on one idle core of the type,
+ *                each task's time in an HDR histogram. A task is sized to
+ *                take --task-us (1 ms) on the reference type.
+ *   loaded       one thread on every core of the type at once: per-core
+ *                throughput with the shared L2 clusters, ring and power
+ *                budget busy, which is what a full thread pool sees
+ *
+ * and reports both against the reference type (P-core, or the only type on
+ * non-hybrid parts): latency_ratio is the median task time over the
+ * reference's (above 1 is slower), throughput_ratio the loaded per-core rate
+ * over the reference's. 'weight' is the geometric mean of a type's
+ * throughput ratios, a single per-core weight for the kernel mix.
+ *
+ * CPUs: the highest-numbered first thread of a core of each type (CPU 0
+ * takes most housekeeping) for the latency runs; the first thread of every
+ * core of the type for the loaded runs.
+ *
+ * Usage:
+ *   bench_hybrid [--kernels int,fp,mem,branch] [--duration-ms N] [--task-us N]
+ *                [--mem-mb N] [--deadline-ms N]
+ */
+
+#include "bench_common.h"
+#include <math.h>
+#include "bench_kernels.h"
+#include "hdr_histogram.h"
+#include "helper_deadline.h"
+
+#ifdef _WIN32
+#pragma comment(lib, "advapi32.lib")
+#endif
+
+#define MAX_TYPES 3                      // P-core, E-core, or one type on non-hybrid parts
+#define TASK_HIGHEST_NS 10000000000ull   // 10 s
+
+typedef struct {
+    const char* name;                    // "P-core", "E-core", or NULL on non-hybrid parts
+    const BenchCpu* latency_cpu;
+    const BenchCpu** cores;              // first thread of every core of the type
+    int core_count;
+    int cpu_count;                       // logical CPUs of the type
+} CoreType;
+
+typedef struct {
+    double single_per_s;                 // ops per second over the latency run
+    double loaded_per_s;                 // per-core ops per second with every core busy
+    int loaded_threads;
+    HdrHistogram task_ns;
+} TypeResult;
+
+typedef struct {
+    const BenchCpu* cpu;
+    BenchStartLine* start_line;
+    BenchKernelState state;              // a shallow copy: the mem buffer is shared, read-only
+    uint64_t duration_ns;
+    int pinned;
+    double rate;
+} LoadThread;
+
+static void load_thread(void* arg) {
+    LoadThread* t = (LoadThread*)arg;
+    t->pinned = bench_pin(t->cpu->cpu);
+    bench_start_line_wait(t->start_line);
+    if (t->pinned) t->rate = bench_kernel_rate(&t->state, t->duration_ns);
+}
+
+// Tasks of 'task_ops' back to back on 'cpu' for 'duration_ms'; returns ops per second
+static double run_tasks(const BenchCpu* cpu, BenchKernelState* state, uint64_t task_ops, double duration_ms,
+                        HdrHistogram* task_ns) {
+    if (!bench_pin(cpu->cpu)) return 0;
+    bench_kernel_rate(state, 20 * 1000000ull);   // wake the core up before timing
+    uint64_t start = bench_now_ns();
+    uint64_t end = start + (uint64_t)(duration_ms * 1e6);
+    uint64_t now = start, tasks = 0;
+    while (now < end) {
+        uint64_t begin = now;
+        bench_kernel_run(state, task_ops);
+        now = bench_now_ns();
+        hdr_record(task_ns, now - begin);
+        tasks++;
+    }
+    return now > start ? (double)(tasks * task_ops) * 1e9 / (double)(now - start) : 0;
+}
+
+// One thread per core of 'type' at once; returns the mean per-core ops per second
+static double run_loaded(const CoreType* type, const BenchKernelState* state, double duration_ms, int* threads_run) {
+    LoadThread* threads = (LoadThread*)calloc(type->core_count, sizeof(LoadThread));
+    BenchThread* handles = (BenchThread*)calloc(type->core_count, sizeof(BenchThread));
+    *threads_run = 0;
+    if (!threads || !handles) {
+        free(threads);
+        free(handles);
+        return 0;
+    }
+    BenchStartLine start_line = {0, type->core_count};
+    int started = 0;
+    for (int i = 0; i < type->core_count; i++) {
+        threads[i].cpu = type->cores[i];
+        threads[i].start_line = &start_line;
+        threads[i].state = *state;
+        // Spread the chase starting points so the threads walk different lines
+        if (state->chase_lines) threads[i].state.chase_pos = (size_t)i * (state->chase_lines / type->core_count);
+        threads[i].duration_ns = (uint64_t)(duration_ms * 1e6);
+        if (!bench_thread_start(&handles[i], load_thread, &threads[i])) break;
+        started++;
+    }
+    start_line.expected = started;
+    for (int i = 0; i < started; i++) bench_thread_join(&handles[i]);
+
+    double total = 0;
+    for (int i = 0; i < started; i++) {
+        if (!threads[i].pinned) continue;
+        total += threads[i].rate;
+        (*threads_run)++;
+    }
+    free(threads);
+    free(handles);
+    return *threads_run ? total / *threads_run : 0;
+}
+
+// Core types present, P-core first; returns the count
+static int find_core_types(const BenchCpu* cpus, int count, CoreType* types) {
+    const char* names[MAX_TYPES] = {"P-core", "E-core", NULL};
+    int type_count = 0;
+    for (int t = 0; t < MAX_TYPES; t++) {
+        CoreType* type = &types[type_count];
+        memset(type, 0, sizeof(*type));
+        type->name = names[t];
+        type->cores = (const BenchCpu**)malloc(count * sizeof(BenchCpu*));
+        if (!type->cores) continue;
+        for (int i = 0; i < count; i++) {
+            if (!bench_same_type(cpus[i].core_type, names[t])) continue;
+            type->cpu_count++;
+            if (cpus[i].smt_index == 0) {
+                type->cores[type->core_count++] = &cpus[i];
+                type->latency_cpu = &cpus[i];
+            }
+        }
+        if (type->core_count) type_count++;
+        else free(type->cores);
+    }
+    return type_count;
+}
+
+// Processor brand string, e.g. "13th Gen Intel(R) Core(TM) i9-13900K"
+static void read_cpu_model(char* out, size_t size) {
+    out[0] = '\0';
+#ifdef _WIN32
+    DWORD length = (DWORD)size;
+    if (RegGetValueA(HKEY_LOCAL_MACHINE, "HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0", "ProcessorNameString",
+                     RRF_RT_REG_SZ, NULL, out, &length) != ERROR_SUCCESS) {
+        out[0] = '\0';
+    }
+#else
+    FILE* f = fopen("/proc/cpuinfo", "r");
+    char line[512];
+    while (f && fgets(line, sizeof(line), f)) {
+        // "model name" on x86, "Model" on Raspberry Pi
+        if (strncmp(line, "model name", 10) != 0 && strncmp(line, "Model", 5) != 0) continue;
+        char* value = strchr(line, ':');
+        if (!value) continue;
+        value++;
+        while (*value == ' ' || *value == '\t') value++;
+        snprintf(out, size, "%s", value);
+        break;
+    }
+    if (f) fclose(f);
+#endif
+    // Trim the newline and padding, and keep the value safe to print as JSON
+    size_t len = strlen(out);
+    while (len && (out[len - 1] == '\n' || out[len - 1] == '\r' || out[len - 1] == ' ')) out[--len] = '\0';
+    for (char* p = out; *p; p++) {
+        if (*p == '"' || *p == '\\' || (unsigned char)*p < 0x20) *p = ' ';
+    }
+}
+
+static void print_ratio(const char* name, double value, double reference) {
+    if (value > 0 && reference > 0) printf(", \"%s\": %.3f", name, value / reference);
+    else printf(", \"%s\": null", name);
+}
+
+int main(int argc, char* argv[]) {
+    double duration_ms = bench_arg_double(argc, argv, "--duration-ms", 500);
+    double task_us = bench_arg_double(argc, argv, "--task-us", 1000);
+    double mem_mb = bench_arg_double(argc, argv, "--mem-mb", 64);
+    if (duration_ms < 20) duration_ms = 20;
+    if (task_us < 10) task_us = 10;
+    if (mem_mb < 1) mem_mb = 1;
+
+    deadline_init(argc, argv);
+
+    int kernels[BENCH_KERNEL_COUNT];
+    int kernel_count = bench_kernel_list(bench_arg(argc, argv, "--kernels"), kernels);
+    static BenchCpu cpus[BENCH_MAX_CPUS];
+    int cpu_count = bench_topology(cpus, BENCH_MAX_CPUS);
+    CoreType types[MAX_TYPES];
+    int type_count = find_core_types(cpus, cpu_count, types);
+    if (!type_count || !kernel_count) {
+        printf("{\"error\": \"%s\"}\n", type_count ? "No kernels selected" : "No CPUs selected");
+        return 1;
+    }
+    char model[256];
+    read_cpu_model(model, sizeof(model));
+
+    // Every run has to fit the deadline with time left for the output
+    int runs = kernel_count * type_count * 2;
+    duration_ms = bench_scale_ms(duration_ms, bench_fit_budget(duration_ms * runs, BENCH_OUTPUT_RESERVE_MS), 20);
+
+    static TypeResult results[BENCH_KERNEL_COUNT][MAX_TYPES];
+    uint64_t task_ops[BENCH_KERNEL_COUNT];
+    size_t mem_bytes = (size_t)(mem_mb * 1024 * 1024);
+    for (int k = 0; k < kernel_count; k++) {
+        BenchKernelState state;
+        if (bench_kernel_init(&state, kernels[k], mem_bytes) != 0) {
+            printf("{\"error\": \"Out of memory\"}\n");
+            return 1;
+        }
+        // Size the task on the reference type so every type runs the same work
+        bench_pin(types[0].latency_cpu->cpu);
+        bench_kernel_rate(&state, 20 * 1000000ull);
+        double reference_rate = bench_kernel_rate(&state, 50 * 1000000ull);
+        uint64_t chunks = (uint64_t)(reference_rate * task_us / 1e6 / BENCH_KERNEL_CHUNK + 0.5);
+        task_ops[k] = (chunks ? chunks : 1) * BENCH_KERNEL_CHUNK;
+
+        for (int t = 0; t < type_count; t++) {
+            TypeResult* r = &results[k][t];
+            if (hdr_init(&r->task_ns, TASK_HIGHEST_NS, 7) != 0) continue;
+            r->single_per_s = run_tasks(types[t].latency_cpu, &state, task_ops[k], duration_ms, &r->task_ns);
+            r->loaded_per_s = run_loaded(&types[t], &state, duration_ms, &r->loaded_threads);
+        }
+        bench_kernel_free(&state);
+    }
+
+    printf("{");
+    deadline_print_json();
+    printf("\"method\": \"kernel_tasks\", \"cpu_model\": ");
+    if (model[0]) printf("\"%s\"", model);
+    else printf("null");
+    printf(", \"hybrid\": %s, \"duration_ms\": %.0f, \"task_us\": %.0f, \"mem_mb\": %.0f, \"cpu_count\": %d",
+           types[0].name ? "true" : "false", duration_ms, task_us, mem_mb, cpu_count);
+    printf(", \"reference\": ");
+    if (types[0].name) printf("\"%s\"", types[0].name);
+    else printf("\"All\"");
+
+    printf(",\n \"core_types\": [");
+    for (int t = 0; t < type_count; t++) {
+        // Geometric mean of the loaded throughput ratios over the kernels
+        double log_sum = 0;
+        int ratios = 0;
+        for (int k = 0; k < kernel_count; k++) {
+            if (results[k][t].loaded_per_s > 0 && results[k][0].loaded_per_s > 0) {
+                log_sum += log(results[k][t].loaded_per_s / results[k][0].loaded_per_s);
+                ratios++;
+            }
+        }
+        printf("%s\n  {\"core_type\": \"%s\", \"cores\": %d, \"cpus\": %d", t ? "," : "",
+               types[t].name ? types[t].name : "All", types[t].core_count, types[t].cpu_count);
+        if (ratios) printf(", \"weight\": %.3f", exp(log_sum / ratios));
+        else printf(", \"weight\": null");
+        printf(", \"latency_cpu\": {");
+        bench_print_cpu(types[t].latency_cpu);
+        printf("}}");
+    }
+
+    printf("],\n \"kernels\": [");
+    for (int k = 0; k < kernel_count; k++) {
+        printf("%s\n  {\"kernel\": \"%s\", \"unit\": \"%s\", \"task_ops\": %llu, \"core_types\": [", k ? "," : "",
+               g_bench_kernel_names[kernels[k]], g_bench_kernel_units[kernels[k]], (unsigned long long)task_ops[k]);
+        TypeResult* reference = &results[k][0];
+        for (int t = 0; t < type_count; t++) {
+            TypeResult* r = &results[k][t];
+            printf("%s\n    {\"core_type\": \"%s\", \"single_per_s\": %.4g, \"loaded_per_s\": %.4g, \"loaded_threads\": %d",
+                   t ? "," : "", types[t].name ? types[t].name : "All", r->single_per_s, r->loaded_per_s, r->loaded_threads);
+            print_ratio("latency_ratio", (double)hdr_value_at(&r->task_ns, 50.0), (double)hdr_value_at(&reference->task_ns, 50.0));
+            print_ratio("single_ratio", r->single_per_s, reference->single_per_s);
+            print_ratio("throughput_ratio", r->loaded_per_s, reference->loaded_per_s);
+            printf(", \"task_ns\": ");
+            hdr_json(stdout, &r->task_ns, "ns");
+            printf("}");
+        }
+        printf("]}");
+    }
+    printf("]}\n");
+
+    for (int k = 0; k < kernel_count; k++) {
+        for (int t = 0; t < type_count; t++) hdr_free(&results[k][t].task_ns);
+    }
+    for (int t = 0; t < type_count; t++) free(types[t].cores);
+    return 0;
+}
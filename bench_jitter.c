@@ -0,0 +1,432 @@
+/*
+ * Jitter Benchmark - per-CPU OS noise from a detour loop
+ *
+ * Picking CPUs to isolate needs to know which ones get interrupted, how
+ * often and for how long. One thread per selected logical CPU (all online
+ * CPUs by default) is pinned there and, once every thread is in place, reads
+ * the clock in a tight loop for --duration-ms. Any gap between consecutive
+ * readings above --threshold-ns is time the CPU spent elsewhere (interrupt,
+ * softirq, timer tick, another task, SMI). Every gap goes into an HDR
+ * histogram; the largest are kept with their time offsets, and the median
+ * interval between gaps exposes periodic noise such as a 250 Hz tick.
+ *
+ * On Linux /proc/interrupts and /proc/softirqs are read before and after the
+ * run, so each CPU's noise is listed next to the interrupts it took: the
+ * local timer (LOC), rescheduling and call-function IPIs, and device IRQs by
+ * name. The noisiest and quietest CPUs are summarised with their core,
+ * package, L3 group and core type, the same topology cpuid_helper shows.
+ *
+ * Usage:
+ *   bench_jitter [--cpus LIST] [--duration-ms N] [--threshold-ns N] [--deadline-ms N]
+ */
+
+#include "bench_common.h"
+#include "hdr_histogram.h"
+#include "helper_deadline.h"
+
+#define WORST_GAPS 8
+#define MAX_GAP_TIMES 4096
+#define TOP_SOURCES 5
+#define SUMMARY_CPUS 5
+#define GAP_HIGHEST_NS (10ull * 1000000000ull)
+
+typedef struct {
+    uint64_t offset_ns;     // since the start of the run
+    uint64_t length_ns;
+} Gap;
+
+typedef struct {
+    const BenchCpu* cpu;
+    BenchStartLine* start_line;
+    uint64_t duration_ns;
+    uint64_t threshold_ns;
+    int pinned;
+    uint64_t loops;
+    uint64_t min_loop_ns;
+    uint64_t gap_count;
+    uint64_t noise_ns;
+    HdrHistogram gaps;
+    Gap worst[WORST_GAPS];
+    int worst_count;
+    uint64_t* gap_times;
+    int gap_time_count;
+} JitterThread;
+
+// ---------------------------------------------------------------- /proc tables
+
+// /proc/interrupts or /proc/softirqs: one row per source, one column per CPU
+typedef struct {
+    int columns;
+    int* column_cpu;        // logical CPU of each column
+    int rows;
+    char (*label)[24];      // "LOC", "34", "TIMER"
+    char (*name)[48];       // "Local timer interrupts", "virtio5-input"
+    uint64_t* counts;       // rows x columns
+} ProcTable;
+
+static char* read_whole_file(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    size_t size = 0, capacity = 65536;
+    char* text = (char*)malloc(capacity + 1);
+    while (text) {
+        size += fread(text + size, 1, capacity - size, f);
+        if (size < capacity) break;
+        capacity *= 2;
+        char* grown = (char*)realloc(text, capacity + 1);
+        if (!grown) free(text);
+        text = grown;
+    }
+    fclose(f);
+    if (text) text[size] = '\0';
+    return text;
+}
+
+static void free_table(ProcTable* t) {
+    free(t->column_cpu);
+    free(t->label);
+    free(t->name);
+    free(t->counts);
+    memset(t, 0, sizeof(*t));
+}
+
+static int read_proc_table(const char* path, ProcTable* t) {
+    memset(t, 0, sizeof(*t));
+    char* text = read_whole_file(path);
+    if (!text) return 0;
+
+    int lines = 0;
+    for (char* p = text; *p; p++) lines += *p == '\n';
+    char* line = text;
+    char* next = strchr(line, '\n');
+    if (next) *next = '\0';
+
+    // Header: "CPU0 CPU1 ..." (online CPUs only)
+    for (char* p = line; (p = strstr(p, "CPU")) != NULL; p += 3) t->columns++;
+    t->column_cpu = (int*)calloc(t->columns ? t->columns : 1, sizeof(int));
+    t->label = (char(*)[24])calloc(lines ? lines : 1, sizeof(*t->label));
+    t->name = (char(*)[48])calloc(lines ? lines : 1, sizeof(*t->name));
+    t->counts = (uint64_t*)calloc((size_t)(lines ? lines : 1) * (t->columns ? t->columns : 1), sizeof(uint64_t));
+    if (!t->column_cpu || !t->label || !t->name || !t->counts || !t->columns) {
+        free(text);
+        free_table(t);
+        return 0;
+    }
+    int column = 0;
+    for (char* p = line; (p = strstr(p, "CPU")) != NULL && column < t->columns; p += 3) {
+        t->column_cpu[column++] = atoi(p + 3);
+    }
+
+    while (next && t->rows < lines) {
+        line = next + 1;
+        next = strchr(line, '\n');
+        if (next) *next = '\0';
+        char* colon = strchr(line, ':');
+        if (!colon) continue;
+        char* start = line;
+        while (*start == ' ') start++;
+        size_t label_len = (size_t)(colon - start);
+        if (label_len >= sizeof(t->label[0])) label_len = sizeof(t->label[0]) - 1;
+        memcpy(t->label[t->rows], start, label_len);
+
+        // Counts, then the description ("IO-APIC 2-edge timer", "Local timer interrupts")
+        char* p = colon + 1;
+        uint64_t* row = t->counts + (size_t)t->rows * t->columns;
+        for (int c = 0; c < t->columns; c++) {
+            char* end;
+            unsigned long long value = strtoull(p, &end, 10);
+            if (end == p) break;
+            row[c] = value;
+            p = end;
+        }
+        while (*p == ' ') p++;
+        // Device IRQs end in the device name; the named rows are a description
+        char* name = p;
+        if (label_len && start[0] >= '0' && start[0] <= '9') {
+            char* last = strrchr(p, ' ');
+            if (last && last[1]) name = last + 1;
+        }
+        snprintf(t->name[t->rows], sizeof(t->name[0]), "%s", name);
+        t->rows++;
+    }
+    free(text);
+    return 1;
+}
+
+static int table_column(const ProcTable* t, int cpu) {
+    for (int c = 0; c < t->columns; c++) if (t->column_cpu[c] == cpu) return c;
+    return -1;
+}
+
+// Change of row 'row' of 'after' for 'cpu' since 'before' (rows matched by label)
+static uint64_t table_delta(const ProcTable* before, const ProcTable* after, int row, int cpu) {
+    int ca = table_column(after, cpu);
+    if (ca < 0) return 0;
+    uint64_t now = after->counts[(size_t)row * after->columns + ca];
+    int cb = table_column(before, cpu);
+    if (cb < 0) return now;
+    int rb = row < before->rows && strcmp(before->label[row], after->label[row]) == 0 ? row : -1;
+    for (int r = 0; rb < 0 && r < before->rows; r++) {
+        if (strcmp(before->label[r], after->label[row]) == 0) rb = r;
+    }
+    uint64_t then = rb >= 0 ? before->counts[(size_t)rb * before->columns + cb] : 0;
+    return now > then ? now - then : 0;
+}
+
+// ---------------------------------------------------------------- measurement
+
+static void keep_worst(JitterThread* t, uint64_t offset, uint64_t length) {
+    int slot = t->worst_count;
+    if (slot == WORST_GAPS) {
+        if (length <= t->worst[WORST_GAPS - 1].length_ns) return;
+        slot = WORST_GAPS - 1;
+    } else {
+        t->worst_count++;
+    }
+    while (slot > 0 && t->worst[slot - 1].length_ns < length) {
+        t->worst[slot] = t->worst[slot - 1];
+        slot--;
+    }
+    t->worst[slot].offset_ns = offset;
+    t->worst[slot].length_ns = length;
+}
+
+static void jitter_thread(void* arg) {
+    JitterThread* t = (JitterThread*)arg;
+    t->pinned = bench_pin(t->cpu->cpu);
+    bench_start_line_wait(t->start_line);
+    if (!t->pinned) return;
+
+    uint64_t start = bench_now_ns();
+    uint64_t end = start + t->duration_ns;
+    uint64_t last = start;
+    uint64_t min_loop = UINT64_MAX;
+    uint64_t loops = 0;
+    while (last < end) {
+        uint64_t now = bench_now_ns();
+        uint64_t delta = now - last;
+        if (delta > t->threshold_ns) {
+            hdr_record(&t->gaps, delta);
+            t->gap_count++;
+            t->noise_ns += delta;
+            keep_worst(t, last - start, delta);
+            if (t->gap_times && t->gap_time_count < MAX_GAP_TIMES) t->gap_times[t->gap_time_count++] = last - start;
+        } else if (delta < min_loop) {
+            min_loop = delta;
+        }
+        last = now;
+        loops++;
+    }
+    t->loops = loops;
+    t->min_loop_ns = min_loop == UINT64_MAX ? 0 : min_loop;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Median spacing of consecutive gaps (us): the period of regular noise
+static double median_gap_interval_us(JitterThread* t) {
+    if (t->gap_time_count < 3) return -1;
+    int n = t->gap_time_count - 1;
+    uint64_t* spacing = (uint64_t*)malloc(n * sizeof(uint64_t));
+    if (!spacing) return -1;
+    for (int i = 0; i < n; i++) spacing[i] = t->gap_times[i + 1] - t->gap_times[i];
+    qsort(spacing, n, sizeof(uint64_t), compare_u64);
+    double median = (double)spacing[n / 2] / 1000.0;
+    free(spacing);
+    return median;
+}
+
+// ---------------------------------------------------------------- output
+
+static ProcTable g_irq_before, g_irq_after, g_softirq_before, g_softirq_after;
+static int g_have_irqs = 0, g_have_softirqs = 0;
+
+static uint64_t print_sources(const ProcTable* before, const ProcTable* after, int cpu, double seconds,
+                              const char* tick_label) {
+    typedef struct { int row; uint64_t count; } Source;
+    Source top[TOP_SOURCES];
+    int top_count = 0;
+    uint64_t total = 0, ticks = 0;
+    for (int r = 0; r < after->rows; r++) {
+        uint64_t d = table_delta(before, after, r, cpu);
+        if (!d) continue;
+        total += d;
+        if (strcmp(after->label[r], tick_label) == 0) ticks = d;
+        if (top_count < TOP_SOURCES) top_count++;
+        else if (top[TOP_SOURCES - 1].count >= d) continue;
+        int slot = top_count - 1;
+        while (slot > 0 && top[slot - 1].count < d) {
+            top[slot] = top[slot - 1];
+            slot--;
+        }
+        top[slot].row = r;
+        top[slot].count = d;
+    }
+    printf("{\"total\": %llu, \"per_second\": %.1f, \"%s\": %llu, \"sources\": [",
+           (unsigned long long)total, total / seconds, tick_label, (unsigned long long)ticks);
+    for (int i = 0; i < top_count; i++) {
+        printf("%s{\"source\": \"%s\", \"name\": \"", i ? ", " : "", after->label[top[i].row]);
+        for (const char* p = after->name[top[i].row]; *p; p++) {
+            if (*p == '"' || *p == '\\') putchar('\\');
+            if ((unsigned char)*p >= 0x20) putchar(*p);
+        }
+        printf("\", \"count\": %llu}", (unsigned long long)top[i].count);
+    }
+    printf("]}");
+    return total;
+}
+
+static int compare_noise(const void* a, const void* b) {
+    const JitterThread* x = *(const JitterThread* const*)a;
+    const JitterThread* y = *(const JitterThread* const*)b;
+    if (x->noise_ns != y->noise_ns) return x->noise_ns < y->noise_ns ? 1 : -1;
+    return x->cpu->cpu - y->cpu->cpu;
+}
+
+static void print_summary_cpu(const JitterThread* t, double duration_ns) {
+    printf("{");
+    bench_print_cpu(t->cpu);
+    printf(", \"l3\": %d, \"noise_percent\": %.4f, \"gaps\": %llu, \"max_gap_ns\": %llu}",
+           t->cpu->l3, 100.0 * (double)t->noise_ns / duration_ns, (unsigned long long)t->gap_count,
+           (unsigned long long)t->gaps.max);
+}
+
+int main(int argc, char* argv[]) {
+    double duration_ms = bench_arg_double(argc, argv, "--duration-ms", 5000);
+    uint64_t threshold_ns = (uint64_t)bench_arg_double(argc, argv, "--threshold-ns", 1000);
+    if (threshold_ns < 50) threshold_ns = 50;
+
+    deadline_init(argc, argv);
+
+    static BenchCpu cpus[BENCH_MAX_CPUS];
+    int cpu_count = bench_topology(cpus, BENCH_MAX_CPUS);
+    const char* spec = bench_arg(argc, argv, "--cpus");
+    const BenchCpu* selected[BENCH_MAX_CPUS];
+    int selected_count = 0;
+    if (spec) {
+        int list[BENCH_MAX_CPUS];
+        int n = bench_cpu_list(spec, list, BENCH_MAX_CPUS);
+        for (int k = 0; k < n; k++) {
+            const BenchCpu* c = bench_find_cpu(cpus, cpu_count, list[k]);
+            if (c) selected[selected_count++] = c;
+        }
+    } else {
+        for (int i = 0; i < cpu_count; i++) selected[selected_count++] = &cpus[i];
+    }
+    if (!selected_count) {
+        printf("{\"error\": \"No CPUs selected\"}\n");
+        return 1;
+    }
+
+    // The run has to fit the deadline with time left for the output
+    duration_ms = bench_scale_ms(duration_ms, bench_fit_budget(duration_ms, BENCH_OUTPUT_RESERVE_MS), 100);
+
+    JitterThread* threads = (JitterThread*)calloc(selected_count, sizeof(JitterThread));
+    BenchThread* handles = (BenchThread*)calloc(selected_count, sizeof(BenchThread));
+    if (!threads || !handles) {
+        printf("{\"error\": \"Out of memory\"}\n");
+        return 1;
+    }
+    BenchStartLine start_line = {0, selected_count + 1};
+    for (int i = 0; i < selected_count; i++) {
+        JitterThread* t = &threads[i];
+        t->cpu = selected[i];
+        t->start_line = &start_line;
+        t->duration_ns = (uint64_t)(duration_ms * 1e6);
+        t->threshold_ns = threshold_ns;
+        // Without it the thread still runs; only median_gap_interval_us is lost
+        t->gap_times = (uint64_t*)malloc(MAX_GAP_TIMES * sizeof(uint64_t));
+        if (!t->gap_times) deadline_skip("gap_times", "out_of_memory");
+        hdr_init(&t->gaps, GAP_HIGHEST_NS, 7);
+    }
+
+    int started = 0;
+    for (int i = 0; i < selected_count; i++) {
+        if (!bench_thread_start(&handles[i], jitter_thread, &threads[i])) break;
+        started++;
+    }
+    start_line.expected = started + 1;
+
+#ifndef _WIN32
+    g_have_irqs = read_proc_table("/proc/interrupts", &g_irq_before);
+    g_have_softirqs = read_proc_table("/proc/softirqs", &g_softirq_before);
+#endif
+    bench_start_line_wait(&start_line);
+    for (int i = 0; i < started; i++) bench_thread_join(&handles[i]);
+#ifndef _WIN32
+    g_have_irqs = g_have_irqs && read_proc_table("/proc/interrupts", &g_irq_after);
+    g_have_softirqs = g_have_softirqs && read_proc_table("/proc/softirqs", &g_softirq_after);
+#endif
+    if (g_have_irqs) deadline_source("interrupts", "proc_interrupts");
+    if (g_have_softirqs) deadline_source("softirqs", "proc_softirqs");
+
+    double duration_ns = duration_ms * 1e6;
+    double seconds = duration_ms / 1000.0;
+    printf("{");
+    deadline_print_json();
+    printf("\"method\": \"detour\", \"duration_ms\": %.0f, \"threshold_ns\": %llu, \"cpu_count\": %d,\n \"cpus\": [",
+           duration_ms, (unsigned long long)threshold_ns, cpu_count);
+    JitterThread** ranked = (JitterThread**)malloc(selected_count * sizeof(JitterThread*));
+    int ranked_count = 0;
+    for (int i = 0; i < selected_count; i++) {
+        JitterThread* t = &threads[i];
+        printf("%s\n  {", i ? "," : "");
+        bench_print_cpu(t->cpu);
+        printf(", \"l2\": %d, \"l3\": %d, \"pinned\": %s", t->cpu->l2, t->cpu->l3, t->pinned ? "true" : "false");
+        if (!t->pinned || i >= started) {
+            printf("}");
+            continue;
+        }
+        if (ranked) ranked[ranked_count++] = t;
+        double interval = median_gap_interval_us(t);
+        printf(", \"loops\": %llu, \"min_loop_ns\": %llu, \"gaps\": %llu, \"noise_ns\": %llu, \"noise_percent\": %.4f",
+               (unsigned long long)t->loops, (unsigned long long)t->min_loop_ns, (unsigned long long)t->gap_count,
+               (unsigned long long)t->noise_ns, 100.0 * (double)t->noise_ns / duration_ns);
+        if (interval >= 0) printf(", \"median_gap_interval_us\": %.1f", interval);
+        else printf(", \"median_gap_interval_us\": null");
+        printf(", \"worst_gaps\": [");
+        for (int k = 0; k < t->worst_count; k++) {
+            printf("%s{\"offset_ms\": %.3f, \"ns\": %llu}", k ? ", " : "",
+                   (double)t->worst[k].offset_ns / 1e6, (unsigned long long)t->worst[k].length_ns);
+        }
+        printf("], \"interrupts\": ");
+        if (g_have_irqs) print_sources(&g_irq_before, &g_irq_after, t->cpu->cpu, seconds, "LOC");
+        else printf("null");
+        printf(", \"softirqs\": ");
+        if (g_have_softirqs) print_sources(&g_softirq_before, &g_softirq_after, t->cpu->cpu, seconds, "TIMER");
+        else printf("null");
+        printf(", \"gap_ns\": ");
+        hdr_json(stdout, &t->gaps, "ns");
+        printf("}");
+    }
+
+    // Noisiest CPUs first; the quietest are the isolation candidates
+    printf("],\n \"noisiest\": [");
+    if (ranked) qsort(ranked, ranked_count, sizeof(JitterThread*), compare_noise);
+    for (int i = 0; i < ranked_count && i < SUMMARY_CPUS; i++) {
+        printf("%s", i ? ", " : "");
+        print_summary_cpu(ranked[i], duration_ns);
+    }
+    printf("],\n \"quietest\": [");
+    for (int i = 0; i < ranked_count && i < SUMMARY_CPUS; i++) {
+        printf("%s", i ? ", " : "");
+        print_summary_cpu(ranked[ranked_count - 1 - i], duration_ns);
+    }
+    printf("]}\n");
+
+    for (int i = 0; i < selected_count; i++) {
+        hdr_free(&threads[i].gaps);
+        free(threads[i].gap_times);
+    }
+    free(ranked);
+    free(threads);
+    free(handles);
+    free_table(&g_irq_before);
+    free_table(&g_irq_after);
+    free_table(&g_softirq_before);
+    free_table(&g_softirq_after);
+    return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * Bench Kernels - representative work loops shared by the comparison benchmarks
+ *
+ * Benchmarks that compare placements (SMT siblings vs separate cores, P-cores
+ * vs E-cores) run the same small set of loops, each bound by a different part
+ * of the core:
+ *
+ *   int      four independent add/rotate/xor chains: integer ALU ports
+ *   fp       sixteen independent multiply-add lanes: FP/SIMD units
+ *            (the compiler vectorizes the lanes)
+ *   mem      dependent loads through a random cyclic permutation of cache
+ *            lines in a buffer larger than the caches: memory latency
+ *   branch   a branch on each bit of a xorshift stream: branch prediction
+ *            misses and front-end refetch
+ *
+ * A kernel counts "ops" in its own unit (ALU instruction, multiply-add,
+ * load, branch); compare rates of the same kernel only. Every loop keeps
+ * its results opaque to the optimizer with BENCH_OPAQUE.
+ *
+ * Usage:
+ *   BenchKernelState state;
+ *   bench_kernel_init(&state, BENCH_KERNEL_MEM, 64u << 20);
+ *   double loads_per_s = bench_kernel_rate(&state, 500 * 1000000ull);
+ *   bench_kernel_free(&state);
+ */
+
+#ifndef BENCH_KERNELS_H
+#define BENCH_KERNELS_H
+
+#include "bench_common.h"
+
+#define BENCH_KERNEL_LINE 64
+#define BENCH_KERNEL_CHUNK 3072     // ops between clock reads (a multiple of 12, 16 and 64)
+
+enum { BENCH_KERNEL_INT, BENCH_KERNEL_FP, BENCH_KERNEL_MEM, BENCH_KERNEL_BRANCH, BENCH_KERNEL_COUNT };
+
+static const char* const g_bench_kernel_names[BENCH_KERNEL_COUNT] = {"int", "fp", "mem", "branch"};
+static const char* const g_bench_kernel_units[BENCH_KERNEL_COUNT] = {"alu_ops", "fmas", "loads", "branches"};
+
+typedef struct {
+    int kernel;
+    uint64_t ints[8];
+    double lanes[16];
+    uint64_t random;
+    unsigned char* chase;           // mem: one next-line index per cache line
+    size_t chase_lines;
+    size_t chase_pos;
+} BenchKernelState;
+
+// Kernel id for a name ("int", "fp", "mem", "branch"), or -1
+static int bench_kernel_parse(const char* name) {
+    for (int k = 0; k < BENCH_KERNEL_COUNT; k++) {
+        if (strcmp(name, g_bench_kernel_names[k]) == 0) return k;
+    }
+    return -1;
+}
+
+// Comma-separated kernel names into 'out'; returns the count (all kernels if 'spec' is NULL)
+static int bench_kernel_list(const char* spec, int* out) {
+    int count = 0;
+    if (!spec) {
+        for (int k = 0; k < BENCH_KERNEL_COUNT; k++) out[count++] = k;
+        return count;
+    }
+    char name[32];
+    for (const char* p = spec; *p && count < BENCH_KERNEL_COUNT; ) {
+        size_t len = strcspn(p, ",");
+        if (len < sizeof(name)) {
+            memcpy(name, p, len);
+            name[len] = '\0';
+            int k = bench_kernel_parse(name);
+            if (k >= 0) out[count++] = k;
+        }
+        p += len;
+        if (*p == ',') p++;
+    }
+    return count;
+}
+
+static uint64_t bench_xorshift(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static size_t* bench_chase_slot(BenchKernelState* s, size_t line) {
+    return (size_t*)(s->chase + line * BENCH_KERNEL_LINE);
+}
+
+// Set up a kernel; 'mem_bytes' sizes the mem kernel's buffer. Returns 0 on success.
+static int bench_kernel_init(BenchKernelState* s, int kernel, size_t mem_bytes) {
+    memset(s, 0, sizeof(*s));
+    s->kernel = kernel;
+    s->random = 0x9E3779B97F4A7C15ull ^ (uint64_t)(size_t)s;
+    for (int i = 0; i < 8; i++) s->ints[i] = bench_xorshift(&s->random);
+    for (int i = 0; i < 16; i++) s->lanes[i] = 1.0 + i;
+    if (kernel != BENCH_KERNEL_MEM) return 0;
+
+    // Sattolo's algorithm: one cycle through every line, in random order,
+    // so neither the prefetchers nor the caches can follow it
+    s->chase_lines = mem_bytes / BENCH_KERNEL_LINE;
+    if (s->chase_lines < 2) s->chase_lines = 2;
+    s->chase = (unsigned char*)malloc(s->chase_lines * BENCH_KERNEL_LINE);
+    size_t* order = (size_t*)malloc(s->chase_lines * sizeof(size_t));
+    if (!s->chase || !order) {
+        free(s->chase);
+        free(order);
+        s->chase = NULL;
+        return -1;
+    }
+    for (size_t i = 0; i < s->chase_lines; i++) order[i] = i;
+    for (size_t i = s->chase_lines - 1; i > 0; i--) {
+        size_t j = (size_t)(bench_xorshift(&s->random) % i);
+        size_t swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+    for (size_t i = 0; i < s->chase_lines; i++) *bench_chase_slot(s, i) = order[i];
+    free(order);
+    return 0;
+}
+
+static void bench_kernel_free(BenchKernelState* s) {
+    free(s->chase);
+    s->chase = NULL;
+}
+
+// Run 'ops' operations, rounded up to whole loop iterations
+static void bench_kernel_run(BenchKernelState* s, uint64_t ops) {
+    switch (s->kernel) {
+    case BENCH_KERNEL_INT: {
+        uint64_t a0 = s->ints[0], b0 = s->ints[1], a1 = s->ints[2], b1 = s->ints[3];
+        uint64_t a2 = s->ints[4], b2 = s->ints[5], a3 = s->ints[6], b3 = s->ints[7];
+        for (uint64_t i = 0; i < ops; i += 12) {
+            a0 += b0; b0 = ((b0 << 13) | (b0 >> 51)) ^ a0;
+            a1 += b1; b1 = ((b1 << 13) | (b1 >> 51)) ^ a1;
+            a2 += b2; b2 = ((b2 << 13) | (b2 >> 51)) ^ a2;
+            a3 += b3; b3 = ((b3 << 13) | (b3 >> 51)) ^ a3;
+            BENCH_OPAQUE(b0); BENCH_OPAQUE(b1); BENCH_OPAQUE(b2); BENCH_OPAQUE(b3);
+        }
+        s->ints[0] = a0; s->ints[1] = b0; s->ints[2] = a1; s->ints[3] = b1;
+        s->ints[4] = a2; s->ints[5] = b2; s->ints[6] = a3; s->ints[7] = b3;
+        break;
+    }
+    case BENCH_KERNEL_FP: {
+        // Converges to c / (1 - m): no overflow and no denormals however long
+        // it runs. Named lanes stay in registers (an array would round-trip
+        // through the stack on every step)
+        double m = 0.9999999, c = 0.001;
+        double l0 = s->lanes[0], l1 = s->lanes[1], l2 = s->lanes[2], l3 = s->lanes[3];
+        double l4 = s->lanes[4], l5 = s->lanes[5], l6 = s->lanes[6], l7 = s->lanes[7];
+        double l8 = s->lanes[8], l9 = s->lanes[9], l10 = s->lanes[10], l11 = s->lanes[11];
+        double l12 = s->lanes[12], l13 = s->lanes[13], l14 = s->lanes[14], l15 = s->lanes[15];
+        for (uint64_t i = 0; i < ops; i += 16) {
+            l0 = l0 * m + c; l1 = l1 * m + c; l2 = l2 * m + c; l3 = l3 * m + c;
+            l4 = l4 * m + c; l5 = l5 * m + c; l6 = l6 * m + c; l7 = l7 * m + c;
+            l8 = l8 * m + c; l9 = l9 * m + c; l10 = l10 * m + c; l11 = l11 * m + c;
+            l12 = l12 * m + c; l13 = l13 * m + c; l14 = l14 * m + c; l15 = l15 * m + c;
+        }
+        s->lanes[0] = l0; s->lanes[1] = l1; s->lanes[2] = l2; s->lanes[3] = l3;
+        s->lanes[4] = l4; s->lanes[5] = l5; s->lanes[6] = l6; s->lanes[7] = l7;
+        s->lanes[8] = l8; s->lanes[9] = l9; s->lanes[10] = l10; s->lanes[11] = l11;
+        s->lanes[12] = l12; s->lanes[13] = l13; s->lanes[14] = l14; s->lanes[15] = l15;
+        break;
+    }
+    case BENCH_KERNEL_MEM: {
+        size_t pos = s->chase_pos;
+        for (uint64_t i = 0; i < ops; i++) pos = *bench_chase_slot(s, pos);
+        s->chase_pos = pos;
+        break;
+    }
+    case BENCH_KERNEL_BRANCH: {
+        uint64_t a = s->ints[0], b = s->ints[1];
+        for (uint64_t i = 0; i < ops; i += 64) {
+            uint64_t bits = bench_xorshift(&s->random);
+            for (int k = 0; k < 64; k++, bits >>= 1) {
+                // The opaque statements keep the compiler from turning the branch into a cmov
+                if (bits & 1) { a += bits; BENCH_OPAQUE(a); }
+                else { b ^= a; BENCH_OPAQUE(b); }
+            }
+        }
+        s->ints[0] = a;
+        s->ints[1] = b;
+        break;
+    }
+    }
+}
+
+// Run the kernel for about 'duration_ns'; returns ops per second
+static double bench_kernel_rate(BenchKernelState* s, uint64_t duration_ns) {
+    uint64_t start = bench_now_ns();
+    uint64_t end = start + duration_ns;
+    uint64_t ops = 0, now = start;
+    while (now < end) {
+        bench_kernel_run(s, BENCH_KERNEL_CHUNK);
+        ops += BENCH_KERNEL_CHUNK;
+        now = bench_now_ns();
+    }
+    return now > start ? (double)ops * 1e9 / (double)(now - start) : 0;
+}
+
+#endif // BENCH_KERNELS_H
@@ -0,0 +1,599 @@
+/*
+ * Memcpy Benchmark - copy and fill strategies by size, and where they cross over
+ *
+ * Custom allocators and serialization buffers pick a copy loop by size:
+ * REP MOVSB is fastest from some size on CPUs with ERMS (and for short
+ * copies too with FSRM), wide vector loops win in between, and past the
+ * last-level cache non-temporal stores stop the copy from evicting
+ * everything else. Where those boundaries lie differs per CPU, so this
+ * benchmark measures, for sizes from 16 bytes to --max-mb (powers of two),
+ *
+ *   memcpy   libc memcpy, REP MOVSB, an AVX2 and an AVX-512 loop, and
+ *            SSE2 non-temporal stores
+ *   memset   the same methods zero-filling (REP STOSB, ...)
+ *
+ * on one thread, and again on --threads threads on cores of the first
+ * package copying their own buffers at the same time (where the memory
+ * bandwidth they share moves the non-temporal crossover down). Each point
+ * is the median of --reps runs of --run-ms; the repetitions go round every
+ * size and method in turn, in a rotating method order, so clock and thermal
+ * drift spread over all methods instead of favouring one (non-temporal
+ * stores from 4 KB).
+ *
+ * For each op and thread count it reports the fastest method per size, the
+ * sizes where the fastest method changes (by more than 3%, holding for the
+ * next size too, so one noisy point is not a crossover), the size from
+ * which REP keeps up with the vector loops and the size from which
+ * non-temporal stores beat every cached method. The CPUID bits that decide
+ * these (ERMS, FSRM, FZRM, FSRS, AVX2, AVX-512 as in cpuid_helper's
+ * features) are reported with them; a vector method runs only when the CPU
+ * has it and the OS saves its register state.
+ *
+ * Usage:
+ *   bench_memcpy [--run-ms N] [--reps N] [--max-mb N] [--threads N] [--deadline-ms N]
+ */
+
+#include "bench_common.h"
+#include "helper_deadline.h"
+
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+#define MEMCPY_X86 1
+#endif
+
+#ifdef MEMCPY_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#include <cpuid.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+#define MAX_THREADS 16
+#define MIN_SIZE 16
+#define MAX_SIZES 32
+#define MAX_REPS 15
+#define BATCH_BYTES 65536       // calls between clock reads: at least this many bytes
+#define TOLERANCE 1.03          // a new fastest method has to win by 3%
+#define NT_MIN_SIZE 4096        // smaller non-temporal copies are all head, tail and SFENCE
+
+enum { OP_MEMCPY, OP_MEMSET, OP_COUNT };
+enum { METHOD_LIBC, METHOD_REP, METHOD_AVX2, METHOD_AVX512, METHOD_NT, METHOD_COUNT };
+
+static const char* g_op_names[OP_COUNT] = {"memcpy", "memset"};
+static const char* g_method_names[OP_COUNT][METHOD_COUNT] = {
+    {"libc", "rep_movsb", "avx2", "avx512", "nt_sse2"},
+    {"libc", "rep_stosb", "avx2", "avx512", "nt_sse2"},
+};
+
+typedef void (*CopyFn)(unsigned char* dst, const unsigned char* src, size_t n);
+
+// ---------------------------------------------------------------- methods
+
+static void copy_libc(unsigned char* dst, const unsigned char* src, size_t n) { memcpy(dst, src, n); }
+static void fill_libc(unsigned char* dst, const unsigned char* src, size_t n) { (void)src; memset(dst, 0, n); }
+
+#ifdef MEMCPY_X86
+static void copy_rep(unsigned char* dst, const unsigned char* src, size_t n) {
+#ifdef _MSC_VER
+    __movsb(dst, src, n);
+#else
+    __asm__ volatile("rep movsb" : "+D"(dst), "+S"(src), "+c"(n) : : "memory");
+#endif
+}
+
+static void fill_rep(unsigned char* dst, const unsigned char* src, size_t n) {
+    (void)src;
+#ifdef _MSC_VER
+    __stosb(dst, 0, n);
+#else
+    __asm__ volatile("rep stosb" : "+D"(dst), "+c"(n) : "a"(0) : "memory");
+#endif
+}
+
+// Under 32 bytes: two overlapping 16-byte moves, as libc memcpy does
+static void copy_small(unsigned char* dst, const unsigned char* src, size_t n) {
+    if (n >= 16) {
+        __m128i head = _mm_loadu_si128((const __m128i*)src);
+        __m128i tail = _mm_loadu_si128((const __m128i*)(src + n - 16));
+        _mm_storeu_si128((__m128i*)dst, head);
+        _mm_storeu_si128((__m128i*)(dst + n - 16), tail);
+    } else {
+        for (size_t i = 0; i < n; i++) dst[i] = src[i];
+    }
+}
+
+static void fill_small(unsigned char* dst, size_t n) {
+    if (n >= 16) {
+        _mm_storeu_si128((__m128i*)dst, _mm_setzero_si128());
+        _mm_storeu_si128((__m128i*)(dst + n - 16), _mm_setzero_si128());
+    } else {
+        for (size_t i = 0; i < n; i++) dst[i] = 0;
+    }
+}
+
+TARGET_AVX2 static void copy_avx2(unsigned char* dst, const unsigned char* src, size_t n) {
+    if (n < 32) {
+        copy_small(dst, src, n);
+        return;
+    }
+    size_t i = 0;
+    for (; i + 128 <= n; i += 128) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(src + i + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(src + i + 96));
+        _mm256_storeu_si256((__m256i*)(dst + i), a);
+        _mm256_storeu_si256((__m256i*)(dst + i + 32), b);
+        _mm256_storeu_si256((__m256i*)(dst + i + 64), c);
+        _mm256_storeu_si256((__m256i*)(dst + i + 96), d);
+    }
+    for (; i + 32 <= n; i += 32) _mm256_storeu_si256((__m256i*)(dst + i), _mm256_loadu_si256((const __m256i*)(src + i)));
+    if (i < n) _mm256_storeu_si256((__m256i*)(dst + n - 32), _mm256_loadu_si256((const __m256i*)(src + n - 32)));
+}
+
+TARGET_AVX2 static void fill_avx2(unsigned char* dst, const unsigned char* src, size_t n) {
+    (void)src;
+    if (n < 32) {
+        fill_small(dst, n);
+        return;
+    }
+    __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 128 <= n; i += 128) {
+        _mm256_storeu_si256((__m256i*)(dst + i), zero);
+        _mm256_storeu_si256((__m256i*)(dst + i + 32), zero);
+        _mm256_storeu_si256((__m256i*)(dst + i + 64), zero);
+        _mm256_storeu_si256((__m256i*)(dst + i + 96), zero);
+    }
+    for (; i + 32 <= n; i += 32) _mm256_storeu_si256((__m256i*)(dst + i), zero);
+    if (i < n) _mm256_storeu_si256((__m256i*)(dst + n - 32), zero);
+}
+
+TARGET_AVX512 static void copy_avx512(unsigned char* dst, const unsigned char* src, size_t n) {
+    if (n < 64) {
+        copy_avx2(dst, src, n);
+        return;
+    }
+    size_t i = 0;
+    for (; i + 256 <= n; i += 256) {
+        __m512i a = _mm512_loadu_si512((const void*)(src + i));
+        __m512i b = _mm512_loadu_si512((const void*)(src + i + 64));
+        __m512i c = _mm512_loadu_si512((const void*)(src + i + 128));
+        __m512i d = _mm512_loadu_si512((const void*)(src + i + 192));
+        _mm512_storeu_si512((void*)(dst + i), a);
+        _mm512_storeu_si512((void*)(dst + i + 64), b);
+        _mm512_storeu_si512((void*)(dst + i + 128), c);
+        _mm512_storeu_si512((void*)(dst + i + 192), d);
+    }
+    for (; i + 64 <= n; i += 64) _mm512_storeu_si512((void*)(dst + i), _mm512_loadu_si512((const void*)(src + i)));
+    if (i < n) _mm512_storeu_si512((void*)(dst + n - 64), _mm512_loadu_si512((const void*)(src + n - 64)));
+}
+
+TARGET_AVX512 static void fill_avx512(unsigned char* dst, const unsigned char* src, size_t n) {
+    if (n < 64) {
+        fill_avx2(dst, src, n);
+        return;
+    }
+    __m512i zero = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 256 <= n; i += 256) {
+        _mm512_storeu_si512((void*)(dst + i), zero);
+        _mm512_storeu_si512((void*)(dst + i + 64), zero);
+        _mm512_storeu_si512((void*)(dst + i + 128), zero);
+        _mm512_storeu_si512((void*)(dst + i + 192), zero);
+    }
+    for (; i + 64 <= n; i += 64) _mm512_storeu_si512((void*)(dst + i), zero);
+    if (i < n) _mm512_storeu_si512((void*)(dst + n - 64), zero);
+}
+
+// Non-temporal stores need a 16-byte aligned destination: cached moves up
+// to the first aligned byte and for the tail, streaming stores in between
+static void copy_nt(unsigned char* dst, const unsigned char* src, size_t n) {
+    if (n < 64) {
+        copy_small(dst, src, n);
+        return;
+    }
+    size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+    copy_small(dst, src, head);
+    size_t i = head;
+    for (; i + 64 <= n; i += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(src + i + 48));
+        _mm_stream_si128((__m128i*)(dst + i), a);
+        _mm_stream_si128((__m128i*)(dst + i + 16), b);
+        _mm_stream_si128((__m128i*)(dst + i + 32), c);
+        _mm_stream_si128((__m128i*)(dst + i + 48), d);
+    }
+    _mm_sfence();
+    if (i < n) copy_small(dst + i, src + i, n - i);
+}
+
+static void fill_nt(unsigned char* dst, const unsigned char* src, size_t n) {
+    (void)src;
+    if (n < 64) {
+        fill_small(dst, n);
+        return;
+    }
+    size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+    fill_small(dst, head);
+    __m128i zero = _mm_setzero_si128();
+    size_t i = head;
+    for (; i + 64 <= n; i += 64) {
+        _mm_stream_si128((__m128i*)(dst + i), zero);
+        _mm_stream_si128((__m128i*)(dst + i + 16), zero);
+        _mm_stream_si128((__m128i*)(dst + i + 32), zero);
+        _mm_stream_si128((__m128i*)(dst + i + 48), zero);
+    }
+    _mm_sfence();
+    if (i < n) fill_small(dst + i, n - i);
+}
+
+static CopyFn g_methods[OP_COUNT][METHOD_COUNT] = {
+    {copy_libc, copy_rep, copy_avx2, copy_avx512, copy_nt},
+    {fill_libc, fill_rep, fill_avx2, fill_avx512, fill_nt},
+};
+#else
+static CopyFn g_methods[OP_COUNT][METHOD_COUNT] = {
+    {copy_libc, NULL, NULL, NULL, NULL},
+    {fill_libc, NULL, NULL, NULL, NULL},
+};
+#endif
+
+// ---------------------------------------------------------------- features
+
+// CPUID bits reported with the results, and which vector methods can run
+typedef struct {
+    int erms, fsrm, fzrm, fsrs, avx2, avx512f;
+    int os_avx, os_avx512;      // XCR0 enables the YMM / ZMM state
+} CopyFeatures;
+
+static void read_features(CopyFeatures* f) {
+    memset(f, 0, sizeof(*f));
+#ifdef MEMCPY_X86
+    unsigned int r1[4] = {0, 0, 0, 0}, r7[4] = {0, 0, 0, 0}, r71[4] = {0, 0, 0, 0};
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0);
+    unsigned int max_leaf = (unsigned int)regs[0];
+    __cpuid(regs, 1);
+    memcpy(r1, regs, sizeof(r1));
+    if (max_leaf >= 7) {
+        __cpuidex(regs, 7, 0);
+        memcpy(r7, regs, sizeof(r7));
+        __cpuidex(regs, 7, 1);
+        memcpy(r71, regs, sizeof(r71));
+    }
+#else
+    unsigned int max_leaf = __get_cpuid_max(0, NULL);
+    __cpuid(1, r1[0], r1[1], r1[2], r1[3]);
+    if (max_leaf >= 7) {
+        __cpuid_count(7, 0, r7[0], r7[1], r7[2], r7[3]);
+        __cpuid_count(7, 1, r71[0], r71[1], r71[2], r71[3]);
+    }
+#endif
+    f->erms = (r7[1] >> 9) & 1;
+    f->fsrm = (r7[3] >> 4) & 1;
+    f->fzrm = (r71[0] >> 10) & 1;
+    f->fsrs = (r71[0] >> 11) & 1;
+    f->avx2 = (r7[1] >> 5) & 1;
+    f->avx512f = (r7[1] >> 16) & 1;
+    if ((r1[2] >> 27) & 1) {
+#ifdef _MSC_VER
+        unsigned long long xcr0 = _xgetbv(0);
+#else
+        unsigned int lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        unsigned long long xcr0 = ((unsigned long long)hi << 32) | lo;
+#endif
+        f->os_avx = (xcr0 & 0x6) == 0x6;            // SSE + AVX state
+        f->os_avx512 = (xcr0 & 0xE6) == 0xE6;       // plus opmask and ZMM state
+    }
+#endif
+}
+
+// ---------------------------------------------------------------- runs
+
+typedef struct {
+    const BenchCpu* cpu;
+    BenchStartLine* start_line;
+    unsigned char* dst;         // allocated by the thread on its first run (node-local)
+    unsigned char* dst_raw;
+    const unsigned char* src;
+    size_t capacity;
+    CopyFn fn;
+    size_t size;
+    uint64_t duration_ns;
+    int pinned;
+    double rate;                // bytes per second
+} CopyThread;
+
+static unsigned char* alloc_aligned(size_t size, unsigned char** raw) {
+    *raw = (unsigned char*)malloc(size + 4096);
+    if (!*raw) return NULL;
+    unsigned char* p = (unsigned char*)(((uintptr_t)*raw + 4095) & ~(uintptr_t)4095);
+    memset(p, 0x5A, size);
+    return p;
+}
+
+static void copy_thread(void* arg) {
+    CopyThread* t = (CopyThread*)arg;
+    t->pinned = bench_pin(t->cpu->cpu);
+    if (t->pinned && !t->dst) t->dst = alloc_aligned(t->capacity, &t->dst_raw);
+    bench_start_line_wait(t->start_line);
+    t->rate = 0;
+    if (!t->pinned || !t->dst) return;
+    size_t batch = t->size >= BATCH_BYTES ? 1 : BATCH_BYTES / t->size;
+    t->fn(t->dst, t->src, t->size);
+    uint64_t start = bench_now_ns(), now = start;
+    uint64_t end = start + t->duration_ns;
+    uint64_t bytes = 0;
+    while (now < end) {
+        for (size_t i = 0; i < batch; i++) t->fn(t->dst, t->src, t->size);
+        bytes += (uint64_t)batch * t->size;
+        now = bench_now_ns();
+    }
+    g_bench_sink += t->dst[t->size - 1];
+    t->rate = now > start ? (double)bytes * 1e9 / (double)(now - start) : 0;
+}
+
+// All 'count' threads run 'fn' on 'size' bytes together; returns their
+// combined bytes per second, 0 if a thread could not be started or pinned
+static double run_threads(CopyThread* threads, int count, CopyFn fn, size_t size, double run_ms) {
+    BenchThread handles[MAX_THREADS];
+    BenchStartLine start_line = {0, count};
+    int started = 0;
+    for (int i = 0; i < count; i++) {
+        threads[i].start_line = &start_line;
+        threads[i].fn = fn;
+        threads[i].size = size;
+        threads[i].duration_ns = (uint64_t)(run_ms * 1e6);
+        if (!bench_thread_start(&handles[i], copy_thread, &threads[i])) break;
+        started++;
+    }
+    start_line.expected = started;
+    for (int i = 0; i < started; i++) bench_thread_join(&handles[i]);
+    if (started < count) return 0;
+    double total = 0;
+    for (int i = 0; i < count; i++) {
+        if (!threads[i].pinned || !threads[i].dst) return 0;
+        total += threads[i].rate;
+    }
+    return total;
+}
+
+// ---------------------------------------------------------------- crossovers
+
+typedef struct {
+    int threads;
+    int op;
+    double rates[METHOD_COUNT][MAX_SIZES];     // median of the repetitions
+} Sweep;
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Median of 'count' rates; 0 if any run failed (a thread could not be pinned)
+static double median_rate(double* rates, int count) {
+    qsort(rates, count, sizeof(double), compare_doubles);
+    if (rates[0] <= 0) return 0;
+    return count % 2 ? rates[count / 2] : (rates[count / 2 - 1] + rates[count / 2]) / 2;
+}
+
+static int is_vector(int method) { return method == METHOD_AVX2 || method == METHOD_AVX512; }
+
+// Fastest method at size index 's' among 'available' (cached methods only if 'cached')
+static int fastest(const Sweep* sweep, const int* available, int s, int cached) {
+    int best = -1;
+    for (int m = 0; m < METHOD_COUNT; m++) {
+        if (!available[m] || (cached && m == METHOD_NT)) continue;
+        if (best < 0 || sweep->rates[m][s] > sweep->rates[best][s]) best = m;
+    }
+    return best;
+}
+
+// Smallest size from which 'method' keeps up with the best of 'rivals' at
+// every larger size (within 'tolerance'); -1 if it never does
+static int threshold(const Sweep* sweep, const int* available, int size_count, int method, int rivals_vector,
+                     double tolerance) {
+    if (!available[method]) return -1;
+    int from = -1;
+    for (int s = size_count - 1; s >= 0; s--) {
+        double rival = 0;
+        for (int m = 0; m < METHOD_COUNT; m++) {
+            if (!available[m] || m == method || m == METHOD_NT) continue;
+            if (rivals_vector && !is_vector(m)) continue;
+            if (sweep->rates[m][s] > rival) rival = sweep->rates[m][s];
+        }
+        if (rival <= 0 || sweep->rates[method][s] * tolerance < rival) break;
+        from = s;
+    }
+    return from;
+}
+
+// True if 'method' beats 'current' at size index 's' by more than the tolerance
+static int overtakes(const Sweep* sweep, int method, int current, int s) {
+    return sweep->rates[method][s] > sweep->rates[current][s] * TOLERANCE;
+}
+
+static void print_sweep(const Sweep* sweep, const int* available, const size_t* sizes, int size_count) {
+    printf("{\"op\": \"%s\", \"threads\": %d", g_op_names[sweep->op], sweep->threads);
+    int rep_from = threshold(sweep, available, size_count, METHOD_REP, 1, TOLERANCE);
+    int nt_from = threshold(sweep, available, size_count, METHOD_NT, 0, 1.0);
+    if (rep_from >= 0) printf(", \"rep_threshold_bytes\": %zu", sizes[rep_from]);
+    else printf(", \"rep_threshold_bytes\": null");
+    if (nt_from >= 0) printf(", \"nt_threshold_bytes\": %zu", sizes[nt_from]);
+    else printf(", \"nt_threshold_bytes\": null");
+
+    printf(",\n   \"methods\": [");
+    int printed = 0;
+    for (int m = 0; m < METHOD_COUNT; m++) {
+        if (!available[m]) continue;
+        printf("%s\n    {\"method\": \"%s\", \"gb_per_s\": [", printed++ ? "," : "", g_method_names[sweep->op][m]);
+        for (int s = 0; s < size_count; s++) {
+            if (sweep->rates[m][s] > 0) printf("%s%.2f", s ? ", " : "", sweep->rates[m][s] / 1e9);
+            else printf("%snull", s ? ", " : "");
+        }
+        printf("]}");
+    }
+    printf("],\n   \"fastest\": [");
+    for (int s = 0; s < size_count; s++) {
+        int best = fastest(sweep, available, s, 0);
+        printf("%s\"%s\"", s ? ", " : "", best >= 0 ? g_method_names[sweep->op][best] : "");
+    }
+
+    // Sizes where the fastest method changes, ignoring changes under 3% and
+    // changes that do not hold for the next size as well
+    printf("],\n   \"crossovers\": [");
+    int current = fastest(sweep, available, 0, 0);
+    printed = 0;
+    for (int s = 1; s + 1 < size_count && current >= 0; s++) {
+        int best = fastest(sweep, available, s, 0);
+        if (best == current || !overtakes(sweep, best, current, s) ||
+            fastest(sweep, available, s + 1, 0) != best || !overtakes(sweep, best, current, s + 1)) {
+            continue;
+        }
+        printf("%s{\"size\": %zu, \"from\": \"%s\", \"to\": \"%s\", \"gain_percent\": %.1f}", printed++ ? ", " : "",
+               sizes[s], g_method_names[sweep->op][current], g_method_names[sweep->op][best],
+               sweep->rates[current][s] > 0 ? 100.0 * (sweep->rates[best][s] / sweep->rates[current][s] - 1) : 0.0);
+        current = best;
+    }
+    printf("]}");
+}
+
+int main(int argc, char* argv[]) {
+    double run_ms = bench_arg_double(argc, argv, "--run-ms", 4);
+    int reps = (int)bench_arg_double(argc, argv, "--reps", 5);
+    double max_mb = bench_arg_double(argc, argv, "--max-mb", 64);
+    int max_threads = (int)bench_arg_double(argc, argv, "--threads", 8);
+    if (run_ms < 1) run_ms = 1;
+    if (reps < 1) reps = 1;
+    if (reps > MAX_REPS) reps = MAX_REPS;
+    if (max_mb < 1) max_mb = 1;
+    if (max_threads < 2) max_threads = 2;
+    if (max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+
+    deadline_init(argc, argv);
+
+    static BenchCpu cpus[BENCH_MAX_CPUS];
+    int cpu_count = bench_topology(cpus, BENCH_MAX_CPUS);
+    if (!cpu_count) {
+        printf("{\"error\": \"No CPUs selected\"}\n");
+        return 1;
+    }
+    char unavailable[8][96];
+    int unavailable_count = 0;
+
+    CopyFeatures features;
+    read_features(&features);
+    int available[METHOD_COUNT] = {1, 0, 0, 0, 0};
+#ifdef MEMCPY_X86
+    available[METHOD_REP] = available[METHOD_NT] = 1;
+    available[METHOD_AVX2] = features.avx2 && features.os_avx;
+    available[METHOD_AVX512] = features.avx512f && features.os_avx512;
+    if (!available[METHOD_AVX2]) snprintf(unavailable[unavailable_count++], sizeof(unavailable[0]),
+                                          "{\"name\": \"avx2\", \"reason\": \"%s\"}",
+                                          features.avx2 ? "os_disabled" : "no_avx2");
+    if (!available[METHOD_AVX512]) snprintf(unavailable[unavailable_count++], sizeof(unavailable[0]),
+                                            "{\"name\": \"avx512\", \"reason\": \"%s\"}",
+                                            features.avx512f ? "os_disabled" : "no_avx512f");
+#else
+    snprintf(unavailable[unavailable_count++], sizeof(unavailable[0]),
+             "{\"name\": \"rep_avx_nt\", \"reason\": \"not_x86\"}");
+#endif
+
+    // Worker threads on the first thread of each core of the first package
+    static CopyThread threads[MAX_THREADS];
+    int thread_count = 0;
+    for (int i = 0; i < cpu_count && thread_count < max_threads; i++) {
+        if (cpus[i].smt_index != 0 || cpus[i].package != cpus[0].package) continue;
+        threads[thread_count++].cpu = &cpus[i];
+    }
+    if (!thread_count) {
+        printf("{\"error\": \"No CPUs selected\"}\n");
+        return 1;
+    }
+    if (thread_count < 2) snprintf(unavailable[unavailable_count++], sizeof(unavailable[0]),
+                                   "{\"name\": \"multi_threaded\", \"reason\": \"no_other_core\"}");
+
+    size_t sizes[MAX_SIZES];
+    int size_count = 0;
+    for (size_t size = MIN_SIZE; size <= (size_t)(max_mb * 1024 * 1024) && size_count < MAX_SIZES; size *= 2)
+        sizes[size_count++] = size;
+    size_t capacity = sizes[size_count - 1];
+
+    // The shared source is read by every thread; place it near them
+    bench_pin(threads[0].cpu->cpu);
+    unsigned char* src_raw;
+    unsigned char* src = alloc_aligned(capacity, &src_raw);
+    if (!src) {
+        printf("{\"error\": \"Out of memory\"}\n");
+        return 1;
+    }
+    for (int i = 0; i < thread_count; i++) {
+        threads[i].src = src;
+        threads[i].capacity = capacity;
+    }
+
+    // Every run has to fit the deadline with time left for the output
+    int methods = 0;
+    for (int m = 0; m < METHOD_COUNT; m++) methods += available[m];
+    int sweeps = thread_count >= 2 ? 2 * OP_COUNT : OP_COUNT;
+    double runs = (double)sweeps * methods * size_count * reps;
+    // The reserve also covers about 1 ms of setup per run
+    run_ms = bench_scale_ms(run_ms, bench_fit_budget(run_ms * runs, BENCH_OUTPUT_RESERVE_MS + runs), 1);
+
+    static Sweep results[2 * OP_COUNT];
+    static double samples[METHOD_COUNT][MAX_SIZES][MAX_REPS];
+    memset(results, 0, sizeof(results));
+    for (int r = 0; r < sweeps; r++) {
+        Sweep* sweep = &results[r];
+        sweep->op = r % OP_COUNT;
+        sweep->threads = r < OP_COUNT ? 1 : thread_count;
+        memset(samples, 0, sizeof(samples));
+        for (int rep = 0; rep < reps; rep++) {
+            for (int s = 0; s < size_count; s++) {
+                for (int k = 0; k < METHOD_COUNT; k++) {
+                    int m = (k + rep) % METHOD_COUNT;
+                    if (!available[m] || (m == METHOD_NT && sizes[s] < NT_MIN_SIZE)) continue;
+                    samples[m][s][rep] = run_threads(threads, sweep->threads, g_methods[sweep->op][m], sizes[s], run_ms);
+                }
+            }
+        }
+        for (int m = 0; m < METHOD_COUNT; m++) {
+            for (int s = 0; s < size_count; s++) sweep->rates[m][s] = median_rate(samples[m][s], reps);
+        }
+    }
+    for (int i = 0; i < thread_count; i++) free(threads[i].dst_raw);
+
+    printf("{");
+    deadline_print_json();
+    printf("\"method\": \"timed_loops_median\", \"run_ms\": %.1f, \"reps\": %d, \"threads\": %d, \"cpu_count\": %d",
+           run_ms, reps, thread_count, cpu_count);
+    const char* names[8] = {"erms", "fsrm", "fzrm", "fsrs", "avx2", "avx512f", "os_avx", "os_avx512"};
+    int bits[8] = {features.erms, features.fsrm, features.fzrm, features.fsrs,
+                   features.avx2, features.avx512f, features.os_avx, features.os_avx512};
+    printf(",\n \"features\": {");
+    for (int i = 0; i < 8; i++) printf("%s\"%s\": %s", i ? ", " : "", names[i], bits[i] ? "true" : "false");
+    printf("}");
+    printf(",\n \"sizes\": [");
+    for (int s = 0; s < size_count; s++) printf("%s%zu", s ? ", " : "", sizes[s]);
+    printf("],\n \"results\": [");
+    for (int r = 0; r < sweeps; r++) {
+        printf("%s\n  ", r ? "," : "");
+        print_sweep(&results[r], available, sizes, size_count);
+    }
+    printf("],\n \"unavailable\": [");
+    for (int i = 0; i < unavailable_count; i++) printf("%s%s", i ? ", " : "", unavailable[i]);
+    printf("]}\n");
+    free(src_raw);
+    return 0;
+}
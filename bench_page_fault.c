@@ -0,0 +1,462 @@
+/*
+ * Page Fault Benchmark - first-touch fault and zeroing cost per NUMA node
+ *
+ * A fresh heap is not memory yet: every page is faulted in (and zeroed by
+ * the kernel) on first touch, so a large allocation stalls the thread that
+ * touches it first. How long depends on the page size, on whether the
+ * pages are pre-faulted, and on the node the memory comes from. For each
+ * NUMA node, threads pinned to the node's cores with their memory bound to
+ * it (MPOL_BIND) map --size-mb in total and fault it in as
+ *
+ *   4k                4 KB pages (MADV_NOHUGEPAGE), one write per page
+ *   4k_populate       MADV_NOHUGEPAGE, then MADV_POPULATE_WRITE (Linux 5.14+)
+ *   thp               MADV_HUGEPAGE, one write per 2 MB
+ *   thp_populate      MADV_HUGEPAGE, then MADV_POPULATE_WRITE (Linux 5.14+)
+ *   hugetlb           MAP_HUGETLB from the node's 2 MB hugetlbfs pool
+ *   hugetlb_populate  MAP_HUGETLB | MAP_POPULATE
+ *
+ * once on one thread and once on the first thread of every core of the node
+ * (up to --threads). Each run reports the fault throughput (mapping plus
+ * faulting, in GB/s and faults/s), the latency of each first-touch fault in
+ * an HDR histogram, the share of the memory that ended up in huge pages
+ * (thp faults/s count a fault per huge page and per 4 KB page of the rest,
+ * null when the share is unknown), and
+ * how fast the threads then memset the faulted memory, which is what
+ * zeroing costs without the faults.
+ *
+ * On Windows the 4k run uses VirtualAllocExNuma, and hugetlb_populate uses
+ * large pages (MEM_LARGE_PAGES, committed at allocation) when the account
+ * holds the lock-pages privilege.
+ *
+ * Usage:
+ *   bench_page_fault [--size-mb N] [--threads N] [--deadline-ms N]
+ */
+
+#include "bench_common.h"
+#include "hdr_histogram.h"
+#include "helper_deadline.h"
+
+#ifdef _WIN32
+#pragma comment(lib, "advapi32.lib")
+#else
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#ifndef _WIN32
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+#define MPOL_BIND_MODE 2        // MPOL_BIND from <linux/mempolicy.h>
+#endif
+
+#define MAX_NODES 64
+#define MAX_THREADS 64
+#define HUGE_PAGE_SIZE (2u << 20)
+#define FAULT_HIGHEST_NS (10ull * 1000000000ull)
+
+enum { PAGE_4K, PAGE_THP, PAGE_HUGETLB };
+
+typedef struct {
+    const char* name;
+    int page;
+    int populate;
+} Variant;
+
+static const Variant g_variants[] = {
+    {"4k", PAGE_4K, 0},
+    {"4k_populate", PAGE_4K, 1},
+    {"thp", PAGE_THP, 0},
+    {"thp_populate", PAGE_THP, 1},
+    {"hugetlb", PAGE_HUGETLB, 0},
+    {"hugetlb_populate", PAGE_HUGETLB, 1},
+};
+#define VARIANT_COUNT (int)(sizeof(g_variants) / sizeof(g_variants[0]))
+
+typedef struct {
+    const BenchCpu* cpu;
+    BenchStartLine* start_line;
+    const Variant* variant;
+    int node;
+    size_t bytes;
+    unsigned char* region;      // mapped by the thread, released by the caller
+    void* mapping;
+    size_t mapping_bytes;
+    const char* error;
+    double fault_rate;          // bytes per second mapped and faulted in
+    double zero_rate;           // bytes per second memset afterwards
+    HdrHistogram fault_ns;
+} FaultThread;
+
+typedef struct {
+    int node;
+    const Variant* variant;
+    int threads;
+    size_t bytes;               // in total
+    double fault_rate, zero_rate;
+    double huge_percent;        // -1 if unknown
+    const char* error;
+    HdrHistogram fault_ns;
+} FaultRun;
+
+static size_t page_bytes(int page) { return page == PAGE_4K ? 4096 : HUGE_PAGE_SIZE; }
+
+// ---------------------------------------------------------------- mapping
+
+#ifdef _WIN32
+// Large pages need SeLockMemoryPrivilege held and enabled in the token
+static int enable_lock_memory(void) {
+    HANDLE token;
+    TOKEN_PRIVILEGES tp;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) return 0;
+    tp.PrivilegeCount = 1;
+    tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    int ok = LookupPrivilegeValueA(NULL, "SeLockMemoryPrivilege", &tp.Privileges[0].Luid) &&
+             AdjustTokenPrivileges(token, FALSE, &tp, 0, NULL, NULL) && GetLastError() == ERROR_SUCCESS;
+    CloseHandle(token);
+    return ok;
+}
+
+static int map_region(FaultThread* t) {
+    DWORD flags = MEM_RESERVE | MEM_COMMIT;
+    if (t->variant->page == PAGE_HUGETLB) flags |= MEM_LARGE_PAGES;
+    DWORD node = t->node >= 0 ? (DWORD)t->node : NUMA_NO_PREFERRED_NODE;
+    t->mapping = VirtualAllocExNuma(GetCurrentProcess(), NULL, t->bytes, flags, PAGE_READWRITE, node);
+    if (!t->mapping) {
+        t->error = t->variant->page == PAGE_HUGETLB ? "no_large_pages" : "alloc_failed";
+        return -1;
+    }
+    t->region = (unsigned char*)t->mapping;
+    return 0;
+}
+
+static void unmap_region(FaultThread* t) {
+    if (t->mapping) VirtualFree(t->mapping, 0, MEM_RELEASE);
+    t->mapping = NULL;
+}
+
+static void bind_node(int node) { (void)node; }  // VirtualAllocExNuma takes the node
+#else
+static int map_region(FaultThread* t) {
+    int page = t->variant->page;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (page == PAGE_HUGETLB) flags |= MAP_HUGETLB;
+    // The page size is only settled by the madvise, so 4k and THP populate
+    // with MADV_POPULATE_WRITE after it; MAP_POPULATE would fault in first
+    if (t->variant->populate && page == PAGE_HUGETLB) flags |= MAP_POPULATE;
+    t->mapping_bytes = t->bytes + (page == PAGE_THP ? HUGE_PAGE_SIZE : 0);
+    t->mapping = mmap(NULL, t->mapping_bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (t->mapping == MAP_FAILED) {
+        t->mapping = NULL;
+        t->error = page == PAGE_HUGETLB ? "no_free_hugepages" : "mmap_failed";
+        return -1;
+    }
+    t->region = (unsigned char*)t->mapping;
+    if (page == PAGE_THP) {
+        // Huge pages need 2 MB aligned virtual addresses
+        t->region = (unsigned char*)(((uintptr_t)t->mapping + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+        madvise(t->region, t->bytes, MADV_HUGEPAGE);
+    } else if (page == PAGE_4K) {
+        madvise(t->region, t->bytes, MADV_NOHUGEPAGE);
+    }
+    if (t->variant->populate && page != PAGE_HUGETLB && madvise(t->region, t->bytes, MADV_POPULATE_WRITE) != 0) {
+        t->error = "no_madv_populate_write";
+        return -1;
+    }
+    return 0;
+}
+
+static void unmap_region(FaultThread* t) {
+    if (t->mapping) munmap(t->mapping, t->mapping_bytes);
+    t->mapping = NULL;
+}
+
+// Bind the calling thread's allocations to 'node'
+static void bind_node(int node) {
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long)) + 1];
+    if (node < 0 || node >= MAX_NODES) return;
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+    syscall(SYS_set_mempolicy, MPOL_BIND_MODE, mask, (unsigned long)(sizeof(mask) * 8));
+}
+#endif
+
+// AnonHugePages of this process in KB, or -1
+static long read_anon_huge_kb(void) {
+#ifdef _WIN32
+    return -1;
+#else
+    char text[4096];
+    if (bench_read_text("/proc/self/smaps_rollup", text, sizeof(text)) < 0) return -1;
+    const char* p = strstr(text, "AnonHugePages:");
+    return p ? strtol(p + 14, NULL, 10) : -1;
+#endif
+}
+
+// Free 2 MB hugetlbfs pages on 'node' (the system pool without NUMA), or 0
+static long free_hugepages(int node) {
+#ifdef _WIN32
+    (void)node;
+    return 0;
+#else
+    char path[BENCH_PATH_MAX];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/hugepages/hugepages-2048kB/free_hugepages", node);
+    long pages = node >= 0 ? bench_read_long(path, -1) : -1;
+    if (pages < 0) pages = bench_read_long("/sys/kernel/mm/hugepages/hugepages-2048kB/free_hugepages", 0);
+    return pages;
+#endif
+}
+
+// ---------------------------------------------------------------- runs
+
+static void fault_thread(void* arg) {
+    FaultThread* t = (FaultThread*)arg;
+    int pinned = bench_pin(t->cpu->cpu);
+    if (pinned) bind_node(t->node);
+    bench_start_line_wait(t->start_line);
+    if (!pinned) {
+        t->error = "not_pinned";
+        return;
+    }
+    uint64_t start = bench_now_ns();
+    if (map_region(t) != 0) return;
+    if (!t->variant->populate) {
+        size_t step = page_bytes(t->variant->page);
+        for (size_t offset = 0; offset < t->bytes; offset += step) {
+            uint64_t before = bench_now_ns();
+            t->region[offset] = 1;
+            hdr_record(&t->fault_ns, bench_now_ns() - before);
+        }
+    }
+    uint64_t faulted = bench_now_ns();
+    memset(t->region, 0, t->bytes);
+    uint64_t zeroed = bench_now_ns();
+    g_bench_sink += t->region[t->bytes - 1];
+    t->fault_rate = faulted > start ? (double)t->bytes * 1e9 / (double)(faulted - start) : 0;
+    t->zero_rate = zeroed > faulted ? (double)t->bytes * 1e9 / (double)(zeroed - faulted) : 0;
+}
+
+// All 'count' threads map and fault 'bytes' each at once; the run holds
+// their combined rates and merged latencies, or the first thread's error
+static void run_variant(FaultRun* run, const BenchCpu** cpus, int count, size_t bytes) {
+    static FaultThread threads[MAX_THREADS];
+    BenchThread handles[MAX_THREADS];
+    BenchStartLine start_line = {0, count};
+    memset(threads, 0, sizeof(threads));
+    run->bytes = bytes * (size_t)count;
+    run->huge_percent = -1;
+    if (hdr_init(&run->fault_ns, FAULT_HIGHEST_NS, 7) != 0) {
+        run->error = "out_of_memory";
+        return;
+    }
+    long huge_before = read_anon_huge_kb();
+    int started = 0;
+    for (int i = 0; i < count; i++) {
+        FaultThread* t = &threads[i];
+        t->cpu = cpus[i];
+        t->start_line = &start_line;
+        t->variant = run->variant;
+        t->node = run->node;
+        t->bytes = bytes;
+        if (hdr_init(&t->fault_ns, FAULT_HIGHEST_NS, 7) != 0) break;
+        if (!bench_thread_start(&handles[i], fault_thread, t)) {
+            hdr_free(&t->fault_ns);
+            break;
+        }
+        started++;
+    }
+    start_line.expected = started;
+    for (int i = 0; i < started; i++) bench_thread_join(&handles[i]);
+    if (started < count) run->error = "thread_start_failed";
+
+    // Huge page coverage while every region is still mapped
+    long huge_after = read_anon_huge_kb();
+    if (run->variant->page == PAGE_HUGETLB) run->huge_percent = 100;
+    else if (run->variant->page == PAGE_4K) run->huge_percent = 0;   // MADV_NOHUGEPAGE
+    else if (huge_before >= 0 && huge_after >= 0) {
+        run->huge_percent = 100.0 * (double)(huge_after - huge_before) * 1024 / (double)run->bytes;
+        if (run->huge_percent < 0) run->huge_percent = 0;
+        if (run->huge_percent > 100) run->huge_percent = 100;
+    }
+
+    for (int i = 0; i < started; i++) {
+        FaultThread* t = &threads[i];
+        if (t->error && !run->error) run->error = t->error;
+        run->fault_rate += t->fault_rate;
+        run->zero_rate += t->zero_rate;
+        hdr_merge(&run->fault_ns, &t->fault_ns);
+        hdr_free(&t->fault_ns);
+        unmap_region(t);
+    }
+}
+
+// Why 'variant' cannot run on this host at all, or NULL
+static const char* variant_unsupported(const Variant* variant, const char* thp_mode, int large_pages) {
+#ifdef _WIN32
+    (void)thp_mode;
+    if (variant->page == PAGE_THP) return "no_thp";
+    if (variant->page == PAGE_4K && variant->populate) return "no_populate";
+    if (variant->page == PAGE_HUGETLB && !variant->populate) return "large_pages_commit_at_allocation";
+    if (variant->page == PAGE_HUGETLB && !large_pages) return "no_lock_memory_privilege";
+#else
+    (void)large_pages;
+    if (variant->page == PAGE_THP && (!thp_mode || strcmp(thp_mode, "never") == 0)) return "thp_disabled";
+#endif
+    return NULL;
+}
+
+int main(int argc, char* argv[]) {
+    double size_mb = bench_arg_double(argc, argv, "--size-mb", 256);
+    int max_threads = (int)bench_arg_double(argc, argv, "--threads", 16);
+    if (size_mb < 2) size_mb = 2;
+    if (max_threads < 1) max_threads = 1;
+    if (max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+
+    deadline_init(argc, argv);
+
+    static BenchCpu cpus[BENCH_MAX_CPUS];
+    int cpu_count = bench_topology(cpus, BENCH_MAX_CPUS);
+    if (!cpu_count) {
+        printf("{\"error\": \"No CPUs selected\"}\n");
+        return 1;
+    }
+    static char unavailable[MAX_NODES * 8][96];
+    int unavailable_count = 0;
+
+    // Nodes in CPU order (-1 when the host reports none)
+    int nodes[MAX_NODES];
+    int node_count = 0;
+    for (int i = 0; i < cpu_count; i++) {
+        int known = 0;
+        for (int n = 0; n < node_count; n++) known |= nodes[n] == cpus[i].node;
+        if (!known && node_count < MAX_NODES) nodes[node_count++] = cpus[i].node;
+    }
+
+    // The active THP mode is the bracketed word ("always [madvise] never")
+    char thp_text[128], thp_mode[32];
+    const char* thp = NULL;
+    if (bench_read_text("/sys/kernel/mm/transparent_hugepage/enabled", thp_text, sizeof(thp_text)) > 0) {
+        char* open = strchr(thp_text, '[');
+        char* close = open ? strchr(open, ']') : NULL;
+        if (close) {
+            snprintf(thp_mode, sizeof(thp_mode), "%.*s", (int)(close - open - 1), open + 1);
+            thp = thp_mode;
+        }
+    }
+    int large_pages = 0;
+#ifdef _WIN32
+    large_pages = GetLargePageMinimum() == HUGE_PAGE_SIZE && enable_lock_memory();
+#endif
+    int supported[VARIANT_COUNT];
+    for (int v = 0; v < VARIANT_COUNT; v++) {
+        const char* reason = variant_unsupported(&g_variants[v], thp, large_pages);
+        supported[v] = reason == NULL;
+        if (reason) snprintf(unavailable[unavailable_count++], sizeof(unavailable[0]),
+                             "{\"name\": \"%s\", \"reason\": \"%s\"}", g_variants[v].name, reason);
+    }
+
+    FaultRun* runs = (FaultRun*)calloc((size_t)node_count * VARIANT_COUNT * 2, sizeof(FaultRun));
+    int* node_threads = (int*)calloc((size_t)node_count, sizeof(int));
+    long* node_hugepages = (long*)calloc((size_t)node_count, sizeof(long));
+    if (!runs || !node_threads || !node_hugepages) {
+        printf("{\"error\": \"Out of memory\"}\n");
+        return 1;
+    }
+    int run_count = 0, skipped = 0;
+    double last_ms = 0;
+    size_t total = (size_t)(size_mb * 1024 * 1024);
+    for (int n = 0; n < node_count && !skipped; n++) {
+        const BenchCpu* node_cpus[MAX_THREADS];
+        int count = 0;
+        for (int i = 0; i < cpu_count && count < max_threads; i++) {
+            if (cpus[i].node == nodes[n] && cpus[i].smt_index == 0) node_cpus[count++] = &cpus[i];
+        }
+        node_threads[n] = count;
+        node_hugepages[n] = free_hugepages(nodes[n]);
+        for (int v = 0; v < VARIANT_COUNT && !skipped; v++) {
+            if (!supported[v]) continue;
+            for (int pass = 0; pass < 2; pass++) {
+                int threads = pass ? count : 1;
+                if (pass && count < 2) continue;
+                // Whole huge pages per thread; hugetlbfs is limited to the node's free pool
+                size_t bytes = total / (size_t)threads / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+#ifndef _WIN32
+                if (g_variants[v].page == PAGE_HUGETLB) {
+                    size_t pool = (size_t)node_hugepages[n] / (size_t)threads * HUGE_PAGE_SIZE;
+                    if (pool < bytes) bytes = pool;
+                }
+#endif
+                if (bytes == 0) {
+                    snprintf(unavailable[unavailable_count++], sizeof(unavailable[0]),
+                             "{\"name\": \"node%d_%s\", \"reason\": \"%s\"}", nodes[n], g_variants[v].name,
+                             g_variants[v].page == PAGE_HUGETLB ? "no_free_hugepages" : "size_too_small");
+                    break;
+                }
+                // A run has to fit the deadline with time left for the output
+                if (!deadline_allows(last_ms * 2 + BENCH_OUTPUT_RESERVE_MS)) {
+                    deadline_skip("remaining_runs", "budget");
+                    skipped = 1;
+                    break;
+                }
+                FaultRun* run = &runs[run_count++];
+                run->node = nodes[n];
+                run->variant = &g_variants[v];
+                run->threads = threads;
+                double started = deadline_elapsed_ms();
+                run_variant(run, node_cpus, threads, bytes);
+                last_ms = deadline_elapsed_ms() - started;
+            }
+        }
+    }
+
+    printf("{");
+    deadline_print_json();
+    printf("\"method\": \"first_touch\", \"size_mb\": %.0f, \"max_threads\": %d, \"cpu_count\": %d", size_mb,
+           max_threads, cpu_count);
+    if (thp) printf(", \"thp_enabled\": \"%s\"", thp);
+    else printf(", \"thp_enabled\": null");
+    printf(",\n \"nodes\": [");
+    for (int n = 0; n < node_count; n++) {
+        printf("%s\n  {\"node\": %d, \"threads\": %d, \"hugetlb_free_pages\": %ld, \"runs\": [", n ? "," : "", nodes[n],
+               node_threads[n], node_hugepages[n]);
+        int printed = 0;
+        for (int r = 0; r < run_count; r++) {
+            FaultRun* run = &runs[r];
+            if (run->node != nodes[n]) continue;
+            size_t step = page_bytes(run->variant->page);
+            printf("%s\n    {\"variant\": \"%s\", \"threads\": %d, \"page_kb\": %zu, \"bytes\": %zu", printed++ ? "," : "",
+                   run->variant->name, run->threads, step / 1024, run->bytes);
+            if (run->error) {
+                printf(", \"error\": \"%s\"}", run->error);
+                hdr_free(&run->fault_ns);
+                continue;
+            }
+            // THP falls back to 4 KB pages for whatever did not get a huge page
+            printf(", \"fault_gb_per_s\": %.3f", run->fault_rate / 1e9);
+            if (run->variant->page != PAGE_THP) {
+                printf(", \"faults_per_s\": %.4g", run->fault_rate / (double)step);
+            } else if (run->huge_percent >= 0) {
+                double huge = run->huge_percent / 100;
+                printf(", \"faults_per_s\": %.4g", run->fault_rate * (huge / HUGE_PAGE_SIZE + (1 - huge) / 4096));
+            } else {
+                printf(", \"faults_per_s\": null");
+            }
+            printf(", \"zero_gb_per_s\": %.3f", run->zero_rate / 1e9);
+            if (run->huge_percent >= 0) printf(", \"huge_percent\": %.1f", run->huge_percent);
+            else printf(", \"huge_percent\": null");
+            printf(", \"fault_ns\": ");
+            if (run->variant->populate) printf("null");
+            else hdr_json(stdout, &run->fault_ns, "ns");
+            printf("}");
+            hdr_free(&run->fault_ns);
+        }
+        printf("]}");
+    }
+    printf("],\n \"unavailable\": [");
+    for (int i = 0; i < unavailable_count; i++) printf("%s%s", i ? ", " : "", unavailable[i]);
+    printf("]}\n");
+    free(runs);
+    free(node_threads);
+    free(node_hugepages);
+    return 0;
+}
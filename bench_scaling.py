@@ -0,0 +1,172 @@
+"""
+Collector scaling benchmark for Halfax System Reporter.
+
+Synthesizes the same host shape at several sizes (synth_host.py), runs every
+built native collector against each one with --replay, and fits the cost
+growth between the two largest sizes on a log-log scale. A collector whose
+exponent exceeds --max-exponent (default 1.25, i.e. clearly worse than
+linear), or that reports "supported": false about the synthetic host (so it
+measured nothing), fails the run with exit status 1, so this can gate a build:
+
+    python bench_scaling.py                          # 1/8, 1/4, 1/2, full
+    python bench_scaling.py --scales 0.0625,0.125 --runs 3 --json out.json
+
+Times are medians of --runs runs minus the median against an empty replay
+root, so process start-up does not hide (or fake) growth.
+"""
+import argparse
+import json
+import math
+import os
+import platform
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+from capture_host import HERE, NATIVE_HELPERS
+from synth_host import DEFAULTS, scaled, synth_host
+
+DEFAULT_SCALES = '0.125,0.25,0.5,1'
+
+
+def find_collectors(names):
+    exe_suffix = '.exe' if platform.system() == 'Windows' else ''
+    found = {}
+    for name in names:
+        path = os.path.join(HERE, name + exe_suffix)
+        if os.path.exists(path):
+            found[name] = path
+    return found
+
+
+def time_collector(path, root, runs, timeout):
+    """(median wall time in seconds of 'runs' replays, last stdout); (None, None)
+    if the collector fails"""
+    samples = []
+    output = None
+    for _ in range(runs):
+        start = time.perf_counter()
+        try:
+            result = subprocess.run([path, '--replay', root], stdout=subprocess.PIPE,
+                                    stderr=subprocess.DEVNULL, timeout=timeout)
+        except (subprocess.TimeoutExpired, OSError):
+            return None, None
+        if result.returncode != 0:
+            return None, None
+        samples.append(time.perf_counter() - start)
+        output = result.stdout
+    return statistics.median(samples), output
+
+
+def replay_supported(output):
+    """False if the helper said 'supported: false' about the synthetic host,
+    i.e. it found none of its inputs and the timing measures nothing"""
+    try:
+        data = json.loads(output)
+    except (TypeError, ValueError):
+        return True
+    return not (isinstance(data, dict) and data.get('supported') is False)
+
+
+def growth_exponent(size_a, cost_a, size_b, cost_b, floor):
+    """log-log slope between two points; costs under 'floor' count as flat"""
+    if cost_b <= floor:
+        return 0.0
+    return math.log(cost_b / max(cost_a, floor)) / math.log(size_b / size_a)
+
+
+def run_benchmark(scales, collectors, runs, timeout, max_exponent, floor):
+    work = tempfile.mkdtemp(prefix='halfax-scaling-')
+    results = {name: {'points': []} for name in collectors}
+    try:
+        empty = os.path.join(work, 'empty')
+        os.makedirs(empty)
+        baseline = {name: time_collector(path, empty, runs, timeout)[0] or 0.0
+                    for name, path in collectors.items()}
+
+        for scale in scales:
+            root = os.path.join(work, 'host')
+            params = synth_host(root, scaled(DEFAULTS, scale))['params']
+            for name, path in collectors.items():
+                elapsed, output = time_collector(path, root, runs, timeout)
+                point = {'scale': scale, 'cpus': params['cpus'],
+                         'seconds': None if elapsed is None else
+                         max(0.0, elapsed - baseline[name]),
+                         'supported': elapsed is not None and replay_supported(output)}
+                results[name]['points'].append(point)
+                shown = ('FAILED' if elapsed is None else
+                         f"{point['seconds'] * 1000:.1f} ms" +
+                         ('' if point['supported'] else ' (unsupported)'))
+                print(f"  {name:<14} scale {scale:<6g} {params['cpus']:>5} cpus  {shown}")
+            shutil.rmtree(root, ignore_errors=True)
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+    failed = False
+    for name, result in results.items():
+        points = result['points']
+        if any(p['seconds'] is None for p in points):
+            result['status'] = 'error'
+            failed = True
+            continue
+        if not all(p['supported'] for p in points):
+            result['status'] = 'unsupported'
+            failed = True
+            continue
+        a, b = points[-2], points[-1]
+        exponent = growth_exponent(a['scale'], a['seconds'], b['scale'], b['seconds'], floor)
+        result['exponent'] = round(exponent, 3)
+        result['status'] = 'ok' if exponent <= max_exponent else 'superlinear'
+        failed = failed or result['status'] != 'ok'
+    return results, failed
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Fail when a collector scales superlinearly')
+    parser.add_argument('--scales', default=DEFAULT_SCALES,
+                        help='comma-separated host sizes relative to synth_host defaults')
+    parser.add_argument('--runs', type=int, default=5, help='runs per size (median is used)')
+    parser.add_argument('--timeout', type=float, default=120, help='per-run timeout (s)')
+    parser.add_argument('--max-exponent', type=float, default=1.25,
+                        help='largest allowed log-log cost growth between the two largest sizes')
+    parser.add_argument('--floor-ms', type=float, default=5.0,
+                        help='costs below this are treated as noise (flat)')
+    parser.add_argument('--collectors', default=','.join(NATIVE_HELPERS),
+                        help='comma-separated collector names to benchmark')
+    parser.add_argument('--json', help='also write results to this file')
+    args = parser.parse_args()
+
+    scales = sorted(float(s) for s in args.scales.split(',') if s)
+    if len(scales) < 2:
+        parser.error('need at least two --scales')
+
+    collectors = find_collectors([c for c in args.collectors.split(',') if c])
+    if not collectors:
+        print('No collectors built next to bench_scaling.py; nothing to measure.',
+              file=sys.stderr)
+        return 0
+
+    print(f"Benchmarking {', '.join(collectors)} at scales {', '.join(f'{s:g}' for s in scales)}")
+    results, failed = run_benchmark(scales, collectors, args.runs, args.timeout,
+                                    args.max_exponent, args.floor_ms / 1000.0)
+
+    for name, result in results.items():
+        if result['status'] == 'error':
+            print(f"{name}: FAILED (collector exited with an error or timed out)")
+        elif result['status'] == 'unsupported':
+            print(f"{name}: FAILED (reported supported: false; synth_host.py "
+                  f"does not write its inputs)")
+        else:
+            print(f"{name}: exponent {result['exponent']:.2f} ({result['status']})")
+
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump({'max_exponent': args.max_exponent, 'results': results}, f, indent=2)
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
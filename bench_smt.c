@@ -0,0 +1,242 @@
+/*
+ * SMT Benchmark - throughput of kernel pairs on SMT siblings vs separate cores
+ *
+ * Whether SMT pays off depends on what the two threads do: two FP-heavy
+ * threads fight over the same units, a memory-latency thread next to an
+ * integer thread mostly fills the other's stall cycles. For every pair of
+ * bench_kernels.h kernels (int, fp, mem, branch; --kernels selects) this
+ * benchmark runs
+ *
+ *   alone           each kernel by itself on the primary CPU (the baseline)
+ *   siblings        kernel A on the primary CPU, kernel B on its SMT sibling
+ *   separate_cores  kernel A on the primary CPU, kernel B on another core of
+ *                   the same package and core type, with both siblings idle
+ *
+ * for --duration-ms each and reports the ops per second of each thread, its
+ * share of the alone rate, and the pair's combined throughput as a percent
+ * of one thread alone: 100 means the second thread added nothing, 200 means
+ * it ran as if on a core of its own. The siblings/separate ratio is what SMT
+ * is worth for that mix on this host.
+ *
+ * CPUs: the highest-numbered core that has an SMT sibling (CPU 0 takes most
+ * housekeeping), or the core of --cpu N. Without SMT only the separate-core
+ * runs are made.
+ *
+ * Usage:
+ *   bench_smt [--cpu N] [--kernels int,fp,mem,branch] [--duration-ms N]
+ *             [--mem-mb N] [--deadline-ms N]
+ */
+
+#include "bench_common.h"
+#include "bench_kernels.h"
+#include "helper_deadline.h"
+
+#define MAX_PAIRS (BENCH_KERNEL_COUNT * (BENCH_KERNEL_COUNT + 1) / 2)
+
+typedef struct {
+    const BenchCpu* cpu;
+    BenchStartLine* start_line;
+    BenchKernelState* state;
+    uint64_t duration_ns;
+    int pinned;
+    double rate;            // ops per second
+} PairThread;
+
+typedef struct {
+    int ran;
+    double rate_a, rate_b;
+} Placement;
+
+static void pair_thread(void* arg) {
+    PairThread* t = (PairThread*)arg;
+    t->pinned = bench_pin(t->cpu->cpu);
+    bench_start_line_wait(t->start_line);
+    if (t->pinned) t->rate = bench_kernel_rate(t->state, t->duration_ns);
+}
+
+// Run kernel A on 'cpu_a' and (if 'cpu_b') kernel B on 'cpu_b' at the same
+// time; returns 0 if a thread could not be pinned
+static int run_placement(const BenchCpu* cpu_a, BenchKernelState* a, const BenchCpu* cpu_b, BenchKernelState* b,
+                         double duration_ms, Placement* out) {
+    PairThread threads[2];
+    BenchThread handles[2];
+    int count = cpu_b ? 2 : 1;
+    BenchStartLine start_line = {0, count};
+    memset(threads, 0, sizeof(threads));
+    threads[0].cpu = cpu_a;
+    threads[0].state = a;
+    threads[1].cpu = cpu_b;
+    threads[1].state = b;
+    int started = 0;
+    for (int i = 0; i < count; i++) {
+        threads[i].start_line = &start_line;
+        threads[i].duration_ns = (uint64_t)(duration_ms * 1e6);
+        if (!bench_thread_start(&handles[i], pair_thread, &threads[i])) break;
+        started++;
+    }
+    start_line.expected = started;
+    for (int i = 0; i < started; i++) bench_thread_join(&handles[i]);
+
+    memset(out, 0, sizeof(*out));
+    out->ran = started == count && threads[0].pinned && (count < 2 || threads[1].pinned);
+    out->rate_a = threads[0].rate;
+    out->rate_b = count > 1 ? threads[1].rate : 0;
+    return out->ran;
+}
+
+static void print_placement(const char* name, const Placement* p, double alone_a, double alone_b) {
+    printf(", \"%s\": ", name);
+    if (!p->ran) {
+        printf("null");
+        return;
+    }
+    double share_a = alone_a > 0 ? 100.0 * p->rate_a / alone_a : 0;
+    double share_b = alone_b > 0 ? 100.0 * p->rate_b / alone_b : 0;
+    printf("{\"a_per_s\": %.4g, \"b_per_s\": %.4g, \"a_percent_of_alone\": %.1f, \"b_percent_of_alone\": %.1f, "
+           "\"combined_percent\": %.1f}", p->rate_a, p->rate_b, share_a, share_b, share_a + share_b);
+}
+
+int main(int argc, char* argv[]) {
+    double duration_ms = bench_arg_double(argc, argv, "--duration-ms", 500);
+    double mem_mb = bench_arg_double(argc, argv, "--mem-mb", 64);
+    if (duration_ms < 20) duration_ms = 20;
+    if (mem_mb < 1) mem_mb = 1;
+
+    deadline_init(argc, argv);
+
+    int kernels[BENCH_KERNEL_COUNT];
+    int kernel_count = bench_kernel_list(bench_arg(argc, argv, "--kernels"), kernels);
+    static BenchCpu cpus[BENCH_MAX_CPUS];
+    int cpu_count = bench_topology(cpus, BENCH_MAX_CPUS);
+    const char* cpu_arg = bench_arg(argc, argv, "--cpu");
+    const BenchCpu* primary = NULL;
+    if (cpu_arg) {
+        const BenchCpu* c = bench_find_cpu(cpus, cpu_count, atoi(cpu_arg));
+        // The first thread of that core; its sibling takes kernel B
+        for (int i = 0; c && i < cpu_count && !primary; i++) {
+            if (cpus[i].package == c->package && cpus[i].core == c->core && cpus[i].smt_index == 0) primary = &cpus[i];
+        }
+    } else {
+        for (int i = cpu_count - 1; i >= 0 && !primary; i--) {
+            if (cpus[i].smt_index == 0 && bench_find_sibling(cpus, cpu_count, &cpus[i])) primary = &cpus[i];
+        }
+        for (int i = cpu_count - 1; i >= 0 && !primary; i--) {
+            if (cpus[i].smt_index == 0) primary = &cpus[i];
+        }
+    }
+    if (!primary || !kernel_count) {
+        printf("{\"error\": \"%s\"}\n", primary ? "No kernels selected" : "No CPUs selected");
+        return 1;
+    }
+    const BenchCpu* sibling = bench_find_sibling(cpus, cpu_count, primary);
+    // Another core of the same package and core type, sharing the L3 if possible
+    const BenchCpu* other = bench_find_other_core(cpus, cpu_count, primary, BENCH_SAME_L3, 1);
+    if (!other) other = bench_find_other_core(cpus, cpu_count, primary, BENCH_OTHER_L3, 1);
+
+    // Two states per kernel (thread A and thread B never share buffers)
+    BenchKernelState states[2][BENCH_KERNEL_COUNT];
+    size_t mem_bytes = (size_t)(mem_mb * 1024 * 1024);
+    for (int k = 0; k < kernel_count; k++) {
+        for (int side = 0; side < 2; side++) {
+            if (bench_kernel_init(&states[side][k], kernels[k], mem_bytes) != 0) {
+                printf("{\"error\": \"Out of memory\"}\n");
+                return 1;
+            }
+        }
+    }
+
+    // Every run has to fit the deadline with time left for the output
+    int pair_count = kernel_count * (kernel_count + 1) / 2;
+    int runs = kernel_count + pair_count * ((sibling ? 1 : 0) + (other ? 1 : 0));
+    duration_ms = bench_scale_ms(duration_ms, bench_fit_budget(duration_ms * runs, BENCH_OUTPUT_RESERVE_MS), 20);
+
+    // Baselines: each kernel alone on the primary CPU, its sibling idle
+    double alone[BENCH_KERNEL_COUNT];
+    for (int k = 0; k < kernel_count; k++) {
+        Placement p;
+        bench_kernel_rate(&states[0][k], 20 * 1000000ull);   // warm the buffers and the clock
+        alone[k] = run_placement(primary, &states[0][k], NULL, NULL, duration_ms, &p) ? p.rate_a : 0;
+    }
+
+    Placement siblings[MAX_PAIRS], separate[MAX_PAIRS];
+    int pair_a[MAX_PAIRS], pair_b[MAX_PAIRS];
+    int pairs = 0;
+    for (int a = 0; a < kernel_count; a++) {
+        for (int b = a; b < kernel_count; b++) {
+            pair_a[pairs] = a;
+            pair_b[pairs] = b;
+            memset(&siblings[pairs], 0, sizeof(Placement));
+            memset(&separate[pairs], 0, sizeof(Placement));
+            if (sibling) run_placement(primary, &states[0][a], sibling, &states[1][b], duration_ms, &siblings[pairs]);
+            if (other) run_placement(primary, &states[0][a], other, &states[1][b], duration_ms, &separate[pairs]);
+            pairs++;
+        }
+    }
+
+    printf("{");
+    deadline_print_json();
+    printf("\"method\": \"paired_kernels\", \"duration_ms\": %.0f, \"mem_mb\": %.0f, \"smt\": %s, \"cpu_count\": %d",
+           duration_ms, mem_mb, sibling ? "true" : "false", cpu_count);
+    printf(",\n \"primary\": {");
+    bench_print_cpu(primary);
+    printf("}, \"sibling\": ");
+    if (sibling) {
+        printf("{");
+        bench_print_cpu(sibling);
+        printf("}");
+    } else {
+        printf("null");
+    }
+    printf(", \"other_core\": ");
+    if (other) {
+        printf("{");
+        bench_print_cpu(other);
+        printf("}");
+    } else {
+        printf("null");
+    }
+
+    // Per kernel: the alone rate and what a copy of itself on the sibling costs
+    printf(",\n \"kernels\": [");
+    for (int k = 0; k < kernel_count; k++) {
+        printf("%s\n  {\"kernel\": \"%s\", \"unit\": \"%s\", \"alone_per_s\": %.4g", k ? "," : "",
+               g_bench_kernel_names[kernels[k]], g_bench_kernel_units[kernels[k]], alone[k]);
+        for (int p = 0; p < pairs; p++) {
+            if (pair_a[p] != k || pair_b[p] != k) continue;
+            if (siblings[p].ran) {
+                printf(", \"siblings_combined_percent\": %.1f",
+                       alone[k] > 0 ? 100.0 * (siblings[p].rate_a + siblings[p].rate_b) / alone[k] : 0);
+            } else {
+                printf(", \"siblings_combined_percent\": null");
+            }
+            if (separate[p].ran) {
+                printf(", \"separate_combined_percent\": %.1f",
+                       alone[k] > 0 ? 100.0 * (separate[p].rate_a + separate[p].rate_b) / alone[k] : 0);
+            } else {
+                printf(", \"separate_combined_percent\": null");
+            }
+        }
+        printf("}");
+    }
+
+    printf("],\n \"pairs\": [");
+    for (int p = 0; p < pairs; p++) {
+        int a = pair_a[p], b = pair_b[p];
+        printf("%s\n  {\"a\": \"%s\", \"b\": \"%s\"", p ? "," : "", g_bench_kernel_names[kernels[a]],
+               g_bench_kernel_names[kernels[b]]);
+        print_placement("siblings", &siblings[p], alone[a], alone[b]);
+        print_placement("separate_cores", &separate[p], alone[a], alone[b]);
+        // What SMT is worth for this mix: sibling throughput over two full cores
+        double sib = siblings[p].rate_a / (alone[a] > 0 ? alone[a] : 1) + siblings[p].rate_b / (alone[b] > 0 ? alone[b] : 1);
+        double sep = separate[p].rate_a / (alone[a] > 0 ? alone[a] : 1) + separate[p].rate_b / (alone[b] > 0 ? alone[b] : 1);
+        if (siblings[p].ran && separate[p].ran && sep > 0) printf(", \"siblings_vs_separate_percent\": %.1f}", 100.0 * sib / sep);
+        else printf(", \"siblings_vs_separate_percent\": null}");
+    }
+    printf("]}\n");
+
+    for (int k = 0; k < kernel_count; k++) {
+        bench_kernel_free(&states[0][k]);
+        bench_kernel_free(&states[1][k]);
+    }
+    return 0;
+}
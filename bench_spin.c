@@ -0,0 +1,709 @@
+/*
+ * Spin Benchmark - cost of the spin-wait primitives and spin-then-park handoffs
+ *
+ * Spin-lock and thread-pool tuning assumes a PAUSE costs what it did on the
+ * machine the spin counts were picked on, but PAUSE went from ~10 cycles to
+ * ~140 (Skylake) and back to ~40 across Intel generations. This benchmark
+ * measures, on this host:
+ *
+ *   pause     PAUSE (YIELD on Arm) latency in ns, TSC ticks and core cycles,
+ *             on one core of each type
+ *   tpause    with WAITPKG: how late TPAUSE returns after its TSC deadline in
+ *             C0.1 and C0.2 for 1, 10 and 100 us waits, and how often the OS
+ *             limit (IA32_UMWAIT_CONTROL, umwait_control/max_time on Linux)
+ *             cut the wait short
+ *   power     Linux with readable RAPL: package power with one waiter per
+ *             core sleeping, spinning on PAUSE, or in TPAUSE C0.1/C0.2
+ *   handoff   a waker bumps a counter after a --gaps-us delay and a waiter on
+ *             another CPU notices; the delay from the bump to the waiter's
+ *             wakeup goes into an HDR histogram. Waiters spin on PAUSE, sleep
+ *             in UMWAIT (WAITPKG) or MWAITX (AMD MONITORX), park straight
+ *             away (futex / WaitOnAddress), or spin --spin-counts PAUSEs
+ *             before parking. Each run reports how often the waiter parked
+ *             and the CPU time it burnt, for the waker and waiter on SMT
+ *             siblings, on two cores sharing an L3, and across L3s/packages,
+ *             for --run-ms each.
+ *
+ * The handoff table is what spin counts are tuned from: the shortest spin
+ * count whose latency matches pure spinning at the gaps the workload sees.
+ *
+ * Usage:
+ *   bench_spin [--run-ms N] [--gaps-us 0,20,200]
+ *              [--spin-counts 100,1000,10000] [--power-ms N] [--deadline-ms N]
+ */
+
+// WaitOnAddress/WakeByAddressSingle are Windows 8+; MinGW defaults to an
+// older _WIN32_WINNT, so raise it before bench_common.h pulls in windows.h
+#if defined(_WIN32) && (!defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0602)
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x0602
+#endif
+
+#include "bench_common.h"
+#include "hdr_histogram.h"
+#include "helper_deadline.h"
+
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SPIN_X86 1
+#endif
+
+#ifdef _WIN32
+#include <intrin.h>
+#pragma comment(lib, "synchronization.lib")
+#else
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#if defined(SPIN_X86) && !defined(_MSC_VER)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+#define MAX_GAPS 8
+#define MAX_SPIN_COUNTS 8
+#define MAX_PLACEMENTS 3
+#define HANDOFF_HIGHEST_NS (10ull * 1000000000ull)
+#define PAUSE_BATCH 10000
+
+enum { STRATEGY_SPIN, STRATEGY_UMWAIT, STRATEGY_MWAITX, STRATEGY_PARK, STRATEGY_SPIN_PARK };
+static const char* g_strategy_names[] = {"spin", "umwait", "mwaitx", "park", "spin_then_park"};
+
+// ---------------------------------------------------------------- primitives
+
+static int g_waitpkg, g_monitorx;
+static double g_tsc_per_ns;     // 0 where there is no TSC
+
+static uint64_t spin_tsc(void) {
+#ifdef SPIN_X86
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void detect_features(void) {
+#ifdef SPIN_X86
+    unsigned int r[4] = {0, 0, 0, 0};
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] >= 7) {
+        __cpuidex(regs, 7, 0);
+        g_waitpkg = (regs[2] >> 5) & 1;
+    }
+    __cpuid(regs, 0x80000000);
+    if ((unsigned int)regs[0] >= 0x80000001) {
+        __cpuid(regs, 0x80000001);
+        g_monitorx = (regs[2] >> 29) & 1;
+    }
+    (void)r;
+#else
+    if (__get_cpuid_count(7, 0, &r[0], &r[1], &r[2], &r[3])) g_waitpkg = (r[2] >> 5) & 1;
+    if (__get_cpuid(0x80000001, &r[0], &r[1], &r[2], &r[3])) g_monitorx = (r[2] >> 29) & 1;
+#endif
+#endif
+}
+
+// TPAUSE/UMONITOR/UMWAIT and MONITORX/MWAITX. GCC gets the raw opcodes so no
+// -mwaitpkg/-mmwaitx is needed; only called once CPUID reports the feature.
+// TPAUSE and UMWAIT return the carry flag: 1 if the OS time limit ended the wait.
+#if defined(_MSC_VER)
+static int spin_tpause(unsigned int ctrl, uint64_t deadline) { return _tpause(ctrl, deadline); }
+static void spin_umonitor(volatile void* addr) { _umonitor((void*)addr); }
+static int spin_umwait(unsigned int ctrl, uint64_t deadline) { return _umwait(ctrl, deadline); }
+static void spin_monitorx(volatile void* addr) { _mm_monitorx((void*)addr, 0, 0); }
+static void spin_mwaitx(unsigned int tsc_timeout) { _mm_mwaitx(2, 0, tsc_timeout); }
+#elif defined(SPIN_X86)
+static int spin_tpause(unsigned int ctrl, uint64_t deadline) {
+    unsigned char cf;
+    __asm__ volatile(".byte 0x66, 0x0f, 0xae, 0xf1\n\tsetc %0" : "=qm"(cf)
+                     : "c"(ctrl), "a"((uint32_t)deadline), "d"((uint32_t)(deadline >> 32)) : "memory", "cc");
+    return cf;
+}
+static void spin_umonitor(volatile void* addr) {
+    __asm__ volatile(".byte 0xf3, 0x0f, 0xae, 0xf0" : : "a"(addr) : "memory");
+}
+static int spin_umwait(unsigned int ctrl, uint64_t deadline) {
+    unsigned char cf;
+    __asm__ volatile(".byte 0xf2, 0x0f, 0xae, 0xf1\n\tsetc %0" : "=qm"(cf)
+                     : "c"(ctrl), "a"((uint32_t)deadline), "d"((uint32_t)(deadline >> 32)) : "memory", "cc");
+    return cf;
+}
+static void spin_monitorx(volatile void* addr) {
+    __asm__ volatile(".byte 0x0f, 0x01, 0xfa" : : "a"(addr), "c"(0), "d"(0) : "memory");
+}
+// ECX bit 1 enables the EBX timeout (in TSC ticks)
+static void spin_mwaitx(unsigned int tsc_timeout) {
+    __asm__ volatile(".byte 0x0f, 0x01, 0xfb" : : "a"(0), "b"(tsc_timeout), "c"(2) : "memory");
+}
+#else
+static int spin_tpause(unsigned int ctrl, uint64_t deadline) { (void)ctrl; (void)deadline; return 0; }
+static void spin_umonitor(volatile void* addr) { (void)addr; }
+static int spin_umwait(unsigned int ctrl, uint64_t deadline) { (void)ctrl; (void)deadline; return 0; }
+static void spin_monitorx(volatile void* addr) { (void)addr; }
+static void spin_mwaitx(unsigned int tsc_timeout) { (void)tsc_timeout; }
+#endif
+
+// Sleep until *addr != expected (or a spurious wakeup)
+static void spin_park(volatile long* addr, long expected) {
+#ifdef _WIN32
+    WaitOnAddress(addr, &expected, sizeof(long), INFINITE);
+#else
+    // The futex word is the low 32 bits of the counter (little-endian hosts;
+    // the counter stays far below 2^31)
+    syscall(SYS_futex, (int*)addr, FUTEX_WAIT_PRIVATE, (int)expected, NULL, NULL, 0);
+#endif
+}
+
+static void spin_wake(volatile long* addr) {
+#ifdef _WIN32
+    WakeByAddressSingle((PVOID)addr);
+#else
+    syscall(SYS_futex, (int*)addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#endif
+}
+
+// CPU time of the calling thread
+static uint64_t thread_cpu_ns(void) {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user)) return 0;
+    uint64_t k = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    uint64_t u = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+    return (k + u) * 100;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// TSC ticks per ns over a short interval
+static double calibrate_tsc(void) {
+    if (!spin_tsc()) return 0;
+    uint64_t t0 = bench_now_ns(), c0 = spin_tsc();
+    bench_sleep_ms(50);
+    uint64_t t1 = bench_now_ns(), c1 = spin_tsc();
+    return t1 > t0 ? (double)(c1 - c0) / (double)(t1 - t0) : 0;
+}
+
+// ---------------------------------------------------------------- PAUSE
+
+typedef struct {
+    const BenchCpu* cpu;
+    int measured;
+    double pause_ns;
+    double pause_tsc;
+    double core_mhz;
+} PauseResult;
+
+static void measure_pause(PauseResult* r) {
+    if (!bench_pin(r->cpu->cpu)) return;
+    bench_chain(4000000);   // ramp the core up first
+    r->pause_ns = 1e30;
+    for (int rep = 0; rep < 7; rep++) {
+        uint64_t start = bench_now_ns();
+        bench_chain(400000);
+        uint64_t chain_ns = bench_now_ns() - start;
+        double mhz = chain_ns ? 400000.0 * BENCH_CHAIN_CYCLES * 1000.0 / (double)chain_ns : 0;
+
+        uint64_t c0 = spin_tsc();
+        start = bench_now_ns();
+        for (int i = 0; i < PAUSE_BATCH; i++) BENCH_PAUSE();
+        uint64_t ns = bench_now_ns() - start;
+        uint64_t ticks = spin_tsc() - c0;
+
+        // The fastest repetition: the others include interrupts
+        if ((double)ns / PAUSE_BATCH < r->pause_ns) {
+            r->pause_ns = (double)ns / PAUSE_BATCH;
+            r->pause_tsc = (double)ticks / PAUSE_BATCH;
+            r->core_mhz = mhz;
+        }
+    }
+    r->measured = 1;
+}
+
+// ---------------------------------------------------------------- TPAUSE
+
+static const double g_tpause_waits_us[] = {1, 10, 100};
+#define TPAUSE_WAITS (int)(sizeof(g_tpause_waits_us) / sizeof(g_tpause_waits_us[0]))
+
+typedef struct {
+    unsigned int ctrl;      // 0 = C0.2, 1 = C0.1
+    double wait_us;
+    uint64_t waits, early, os_limited;
+    HdrHistogram lateness_ns;
+} TpauseResult;
+
+static void measure_tpause(const BenchCpu* cpu, TpauseResult* r, double run_ms) {
+    if (!bench_pin(cpu->cpu) || hdr_init(&r->lateness_ns, HANDOFF_HIGHEST_NS, 7) != 0) return;
+    uint64_t wait_ticks = (uint64_t)(r->wait_us * 1000.0 * g_tsc_per_ns);
+    uint64_t end = bench_now_ns() + (uint64_t)(run_ms * 1e6);
+    while (bench_now_ns() < end) {
+        uint64_t deadline = spin_tsc() + wait_ticks;
+        int limited = spin_tpause(r->ctrl, deadline);
+        uint64_t now = spin_tsc();
+        r->waits++;
+        if (limited) r->os_limited++;
+        if (now < deadline) r->early++;
+        else hdr_record(&r->lateness_ns, (uint64_t)((double)(now - deadline) / g_tsc_per_ns));
+    }
+}
+
+// ---------------------------------------------------------------- power
+
+enum { WAIT_SLEEP, WAIT_PAUSE, WAIT_TPAUSE_C01, WAIT_TPAUSE_C02, WAIT_COUNT };
+static const char* g_wait_names[WAIT_COUNT] = {"sleep", "pause", "tpause_c0.1", "tpause_c0.2"};
+
+typedef struct {
+    const BenchCpu* cpu;
+    BenchStartLine* start_line;
+    volatile long* stop;
+    int wait;
+} PowerThread;
+
+static void power_thread(void* arg) {
+    PowerThread* t = (PowerThread*)arg;
+    bench_pin(t->cpu->cpu);
+    bench_start_line_wait(t->start_line);
+    uint64_t ticks = (uint64_t)(100000.0 * g_tsc_per_ns);   // 100 us
+    while (!bench_atomic_load(t->stop)) {
+        if (t->wait == WAIT_SLEEP) bench_sleep_ms(1);
+        else if (t->wait == WAIT_PAUSE) for (int i = 0; i < 64; i++) BENCH_PAUSE();
+        else spin_tpause(t->wait == WAIT_TPAUSE_C01 ? 1 : 0, spin_tsc() + ticks);
+    }
+}
+
+// Package energy summed over the RAPL packages in uJ; -1 if unreadable
+static double read_package_energy_uj(double* range_uj) {
+#ifdef _WIN32
+    (void)range_uj;
+    return -1;
+#else
+    char path[BENCH_PATH_MAX];
+    double total = -1, range = 0;
+    for (int package = 0; package < 64; package++) {
+        snprintf(path, sizeof(path), "/sys/class/powercap/intel-rapl:%d/energy_uj", package);
+        long long uj = bench_read_long(path, -1);
+        if (uj < 0) break;
+        snprintf(path, sizeof(path), "/sys/class/powercap/intel-rapl:%d/max_energy_range_uj", package);
+        range += (double)bench_read_long(path, 0);
+        total = (total < 0 ? 0 : total) + (double)uj;
+    }
+    *range_uj = range;
+    return total;
+#endif
+}
+
+// Package watts with one thread per core in 'wait'; -1 if RAPL is unreadable
+static double measure_power(const BenchCpu** cores, int core_count, int wait, double run_ms) {
+    PowerThread* threads = (PowerThread*)calloc(core_count, sizeof(PowerThread));
+    BenchThread* handles = (BenchThread*)calloc(core_count, sizeof(BenchThread));
+    if (!threads || !handles) {
+        free(threads);
+        free(handles);
+        return -1;
+    }
+    volatile long stop = 0;
+    BenchStartLine start_line = {0, core_count + 1};
+    int started = 0;
+    for (int i = 0; i < core_count; i++) {
+        threads[i].cpu = cores[i];
+        threads[i].start_line = &start_line;
+        threads[i].stop = &stop;
+        threads[i].wait = wait;
+        if (!bench_thread_start(&handles[i], power_thread, &threads[i])) break;
+        started++;
+    }
+    start_line.expected = started + 1;
+    bench_start_line_wait(&start_line);
+    bench_sleep_ms(100);    // settle into the wait before measuring
+
+    double range = 0;
+    double before = read_package_energy_uj(&range);
+    uint64_t t0 = bench_now_ns();
+    bench_sleep_ms(run_ms);
+    double after = read_package_energy_uj(&range);
+    uint64_t t1 = bench_now_ns();
+    bench_atomic_add(&stop, 1);
+    for (int i = 0; i < started; i++) bench_thread_join(&handles[i]);
+    free(threads);
+    free(handles);
+
+    if (before < 0 || after < 0 || t1 <= t0) return -1;
+    double delta = after - before;
+    if (delta < 0) delta += range;      // the counter wrapped
+    return delta / ((double)(t1 - t0) / 1000.0);    // uJ per us = W
+}
+
+// ---------------------------------------------------------------- handoff
+
+// The waker and waiter fields live on separate lines (128 bytes covers the
+// adjacent-line prefetcher), so the waiter's monitor only fires on the bump
+typedef struct {
+    volatile long seq;              // bumped by the waker; the monitored/futex word
+    volatile long stop;
+    volatile uint64_t stamp;        // bench_now_ns() just before the bump
+    char pad0[128 - 2 * sizeof(long) - sizeof(uint64_t)];
+    volatile long parked;           // the waiter is in (or about to enter) spin_park()
+    char pad1[128 - sizeof(long)];
+    volatile long ack;              // last bump the waiter saw
+    char pad2[128 - sizeof(long)];
+} Handoff;
+
+typedef struct {
+    int strategy;
+    long spin_count;                // spin_then_park: PAUSEs before parking
+    double gap_us;
+    uint64_t handoffs, parked;
+    double waiter_cpu_percent;
+    HdrHistogram latency_ns;
+} HandoffRun;
+
+typedef struct {
+    const BenchCpu* cpu;
+    Handoff* h;
+    BenchStartLine* start_line;
+    HandoffRun* run;
+    double run_ms;
+} HandoffThread;
+
+// Wait until h->seq reaches 'want' or the run stops; returns 1 if the waiter parked
+static int wait_for(Handoff* h, long want, const HandoffRun* run) {
+    switch (run->strategy) {
+    case STRATEGY_SPIN:
+        while (bench_atomic_load(&h->seq) < want) BENCH_PAUSE();
+        return 0;
+    case STRATEGY_UMWAIT:
+        while (bench_atomic_load(&h->seq) < want) {
+            spin_umonitor(&h->seq);
+            if (bench_atomic_load(&h->seq) >= want) break;
+            spin_umwait(0, spin_tsc() + (uint64_t)(1e6 * g_tsc_per_ns));   // C0.2, 1 ms cap
+        }
+        return 0;
+    case STRATEGY_MWAITX:
+        while (bench_atomic_load(&h->seq) < want) {
+            spin_monitorx(&h->seq);
+            if (bench_atomic_load(&h->seq) >= want) break;
+            spin_mwaitx((unsigned int)(1e6 * g_tsc_per_ns));
+        }
+        return 0;
+    default:
+        for (long i = 0; i < run->spin_count; i++) {
+            if (bench_atomic_load(&h->seq) >= want) return 0;
+            BENCH_PAUSE();
+        }
+        if (bench_atomic_load(&h->seq) >= want) return 0;
+        // Announce the park before the last check; the waker bumps before it
+        // checks 'parked', so one of the two always sees the other
+        bench_atomic_add(&h->parked, 1);
+        long seen;
+        while ((seen = bench_atomic_load(&h->seq)) < want) spin_park(&h->seq, seen);
+        bench_atomic_add(&h->parked, -1);
+        return 1;
+    }
+}
+
+static void waiter_thread(void* arg) {
+    HandoffThread* t = (HandoffThread*)arg;
+    Handoff* h = t->h;
+    bench_pin(t->cpu->cpu);
+    bench_start_line_wait(t->start_line);
+    uint64_t cpu0 = thread_cpu_ns(), wall0 = bench_now_ns();
+    for (long want = 1; ; want++) {
+        int parked = wait_for(h, want, t->run);
+        uint64_t now = bench_now_ns();
+        if (bench_atomic_load(&h->stop)) break;
+        hdr_record(&t->run->latency_ns, now > h->stamp ? now - h->stamp : 0);
+        t->run->handoffs++;
+        t->run->parked += parked;
+        bench_atomic_add(&h->ack, 1);
+    }
+    uint64_t wall = bench_now_ns() - wall0;
+    t->run->waiter_cpu_percent = wall ? 100.0 * (double)(thread_cpu_ns() - cpu0) / (double)wall : 0;
+}
+
+static void waker_thread(void* arg) {
+    HandoffThread* t = (HandoffThread*)arg;
+    Handoff* h = t->h;
+    bench_pin(t->cpu->cpu);
+    bench_start_line_wait(t->start_line);
+    uint64_t gap_ns = (uint64_t)(t->run->gap_us * 1000.0);
+    uint64_t end = bench_now_ns() + (uint64_t)(t->run_ms * 1e6);
+    for (long i = 1; ; i++) {
+        while (bench_atomic_load(&h->ack) < i - 1) BENCH_PAUSE();   // the waiter took the last one
+        uint64_t now = bench_now_ns();
+        int last = now >= end;
+        if (last) bench_atomic_add(&h->stop, 1);
+        else while (bench_now_ns() - now < gap_ns) BENCH_PAUSE();  // busy gap: the waker's own timing stays exact
+        h->stamp = bench_now_ns();
+        bench_atomic_add(&h->seq, 1);
+        if (bench_atomic_load(&h->parked)) spin_wake(&h->seq);
+        if (last) break;
+    }
+}
+
+static void run_handoff(const BenchCpu* waker, const BenchCpu* waiter, HandoffRun* run, double run_ms) {
+    Handoff* h = (Handoff*)calloc(1, sizeof(Handoff) + 128);
+    if (!h) return;
+    // calloc only guarantees 16 bytes; put the struct on a line boundary
+    Handoff* aligned = (Handoff*)(((uintptr_t)h + 127) & ~(uintptr_t)127);
+    BenchStartLine start_line = {0, 2};
+    HandoffThread threads[2] = {{waiter, aligned, &start_line, run, run_ms}, {waker, aligned, &start_line, run, run_ms}};
+    BenchThread handles[2];
+    if (bench_thread_start(&handles[0], waiter_thread, &threads[0])) {
+        if (bench_thread_start(&handles[1], waker_thread, &threads[1])) {
+            bench_thread_join(&handles[1]);
+        } else {
+            // No waker: release and stop the waiter
+            bench_atomic_add(&start_line.arrived, 1);
+            bench_atomic_add(&aligned->stop, 1);
+            bench_atomic_add(&aligned->seq, 1000000);
+            spin_wake(&aligned->seq);
+        }
+        bench_thread_join(&handles[0]);
+    }
+    free(h);
+}
+
+// ---------------------------------------------------------------- arguments
+
+static int parse_list(const char* spec, double* out, int max_count, const double* defaults, int default_count) {
+    if (!spec) {
+        for (int i = 0; i < default_count; i++) out[i] = defaults[i];
+        return default_count;
+    }
+    int count = 0;
+    for (const char* p = spec; *p && count < max_count; ) {
+        char* end;
+        double value = strtod(p, &end);
+        if (end == p) break;
+        if (value >= 0) out[count++] = value;
+        p = end;
+        if (*p == ',') p++;
+    }
+    return count;
+}
+
+// ---------------------------------------------------------------- output
+
+static void print_handoff_run(const HandoffRun* r) {
+    printf("{\"strategy\": \"%s\", \"spin_count\": ", g_strategy_names[r->strategy]);
+    if (r->strategy == STRATEGY_SPIN_PARK) printf("%ld", r->spin_count);
+    else if (r->strategy == STRATEGY_PARK) printf("0");
+    else printf("null");
+    printf(", \"gap_us\": %g, \"handoffs\": %llu, \"parked_percent\": %.1f, \"waiter_cpu_percent\": %.1f, \"latency_ns\": ",
+           r->gap_us, (unsigned long long)r->handoffs, r->handoffs ? 100.0 * (double)r->parked / (double)r->handoffs : 0.0,
+           r->waiter_cpu_percent);
+    hdr_json(stdout, &r->latency_ns, "ns");
+    printf("}");
+}
+
+int main(int argc, char* argv[]) {
+    double run_ms = bench_arg_double(argc, argv, "--run-ms", 200);
+    double power_ms = bench_arg_double(argc, argv, "--power-ms", 1000);
+    if (run_ms < 10) run_ms = 10;
+    if (power_ms < 100) power_ms = 100;
+    static const double default_gaps[] = {0, 20, 200};
+    static const double default_spins[] = {100, 1000, 10000};
+    double gaps[MAX_GAPS], spins[MAX_SPIN_COUNTS];
+    int gap_count = parse_list(bench_arg(argc, argv, "--gaps-us"), gaps, MAX_GAPS, default_gaps, 3);
+    int spin_count = parse_list(bench_arg(argc, argv, "--spin-counts"), spins, MAX_SPIN_COUNTS, default_spins, 3);
+
+    deadline_init(argc, argv);
+    detect_features();
+    g_tsc_per_ns = calibrate_tsc();
+    // The TSC-deadline primitives need the TSC rate
+    if (!g_tsc_per_ns) g_waitpkg = g_monitorx = 0;
+
+    static BenchCpu cpus[BENCH_MAX_CPUS];
+    int cpu_count = bench_topology(cpus, BENCH_MAX_CPUS);
+    if (!cpu_count) {
+        printf("{\"error\": \"No CPUs selected\"}\n");
+        return 1;
+    }
+    char unavailable[16][96];
+    int unavailable_count = 0;
+
+    // PAUSE on the highest-numbered first thread of each core type
+    const char* types[3] = {"P-core", "E-core", NULL};
+    PauseResult pause[3];
+    int pause_count = 0;
+    for (int t = 0; t < 3; t++) {
+        for (int i = cpu_count - 1; i >= 0; i--) {
+            if (!bench_same_type(cpus[i].core_type, types[t]) || cpus[i].smt_index != 0) continue;
+            memset(&pause[pause_count], 0, sizeof(PauseResult));
+            pause[pause_count].cpu = &cpus[i];
+            measure_pause(&pause[pause_count++]);
+            break;
+        }
+    }
+    const BenchCpu* primary = pause[0].cpu;
+    for (int i = cpu_count - 1; i >= 0; i--) {
+        if (cpus[i].smt_index == 0 && bench_same_type(cpus[i].core_type, primary->core_type) && bench_find_sibling(cpus, cpu_count, &cpus[i])) {
+            primary = &cpus[i];
+            break;
+        }
+    }
+
+    // Placements of the handoff pairs (the waker stays on the primary CPU);
+    // "other_l3" is on another package when the primary's has a single L3
+    const BenchCpu* other_l3 = bench_find_other_core(cpus, cpu_count, primary, BENCH_OTHER_L3, 1);
+    if (!other_l3) other_l3 = bench_find_other_core(cpus, cpu_count, primary, BENCH_OTHER_PACKAGE, 1);
+    const char* placement_names[MAX_PLACEMENTS] = {"smt_sibling", "same_l3", "other_l3"};
+    const BenchCpu* waiters[MAX_PLACEMENTS] = {
+        bench_find_sibling(cpus, cpu_count, primary),
+        bench_find_other_core(cpus, cpu_count, primary, BENCH_SAME_L3, 1),
+        other_l3,
+    };
+    for (int p = 0; p < MAX_PLACEMENTS; p++) {
+        if (!waiters[p]) snprintf(unavailable[unavailable_count++], sizeof(unavailable[0]),
+                                  "{\"name\": \"%s\", \"reason\": \"no_such_cpu\"}", placement_names[p]);
+    }
+    if (!g_waitpkg) snprintf(unavailable[unavailable_count++], sizeof(unavailable[0]),
+                             "{\"name\": \"tpause\", \"reason\": \"no_waitpkg\"}");
+    if (!g_monitorx) snprintf(unavailable[unavailable_count++], sizeof(unavailable[0]),
+                              "{\"name\": \"mwaitx\", \"reason\": \"no_monitorx\"}");
+
+    // Handoff runs: every strategy the CPU supports at every gap
+    int strategies[4 + MAX_SPIN_COUNTS];
+    long strategy_spins[4 + MAX_SPIN_COUNTS];
+    int strategy_count = 0;
+    strategies[strategy_count] = STRATEGY_SPIN, strategy_spins[strategy_count++] = 0;
+    if (g_waitpkg) strategies[strategy_count] = STRATEGY_UMWAIT, strategy_spins[strategy_count++] = 0;
+    if (g_monitorx) strategies[strategy_count] = STRATEGY_MWAITX, strategy_spins[strategy_count++] = 0;
+    strategies[strategy_count] = STRATEGY_PARK, strategy_spins[strategy_count++] = 0;
+    for (int s = 0; s < spin_count; s++) strategies[strategy_count] = STRATEGY_SPIN_PARK, strategy_spins[strategy_count++] = (long)spins[s];
+
+    int placements = 0;
+    for (int p = 0; p < MAX_PLACEMENTS; p++) placements += waiters[p] != NULL;
+    int handoff_runs = placements * strategy_count * gap_count;
+    int tpause_runs = g_waitpkg ? 2 * TPAUSE_WAITS : 0;
+    double range_uj = 0;
+    int rapl = read_package_energy_uj(&range_uj) >= 0;
+    if (!rapl) snprintf(unavailable[unavailable_count++], sizeof(unavailable[0]),
+                        "{\"name\": \"power\", \"reason\": \"%s\"}",
+#ifdef _WIN32
+                        "no_rapl_interface"
+#else
+                        "rapl_unreadable"
+#endif
+                        );
+    int power_runs = rapl ? (g_waitpkg ? WAIT_COUNT : 2) : 0;
+
+    // Every run has to fit the deadline with time left for the (larger) output
+    double needed = run_ms * (handoff_runs + tpause_runs) + (power_ms + 100) * power_runs;
+    double scale = bench_fit_budget(needed, 2 * BENCH_OUTPUT_RESERVE_MS);
+    run_ms = bench_scale_ms(run_ms, scale, 10);
+    power_ms = bench_scale_ms(power_ms, scale, 100);
+
+    TpauseResult tpause[2 * TPAUSE_WAITS];
+    memset(tpause, 0, sizeof(tpause));
+    for (int i = 0; i < tpause_runs; i++) {
+        tpause[i].ctrl = i < TPAUSE_WAITS ? 1 : 0;
+        tpause[i].wait_us = g_tpause_waits_us[i % TPAUSE_WAITS];
+        measure_tpause(primary, &tpause[i], run_ms);
+    }
+
+    double watts[WAIT_COUNT];
+    const BenchCpu** cores = (const BenchCpu**)malloc(cpu_count * sizeof(BenchCpu*));
+    int core_count = 0;
+    for (int i = 0; cores && i < cpu_count; i++) if (cpus[i].smt_index == 0) cores[core_count++] = &cpus[i];
+    for (int w = 0; w < power_runs; w++) watts[w] = measure_power(cores, core_count, w, power_ms);
+    free(cores);
+
+    HandoffRun* runs = (HandoffRun*)calloc(handoff_runs ? handoff_runs : 1, sizeof(HandoffRun));
+    if (!runs) {
+        printf("{\"error\": \"Out of memory\"}\n");
+        return 1;
+    }
+    int run_index = 0;
+    for (int p = 0; p < MAX_PLACEMENTS; p++) {
+        if (!waiters[p]) continue;
+        for (int s = 0; s < strategy_count; s++) {
+            for (int g = 0; g < gap_count; g++) {
+                HandoffRun* r = &runs[run_index++];
+                r->strategy = strategies[s];
+                r->spin_count = strategy_spins[s];
+                r->gap_us = gaps[g];
+                if (hdr_init(&r->latency_ns, HANDOFF_HIGHEST_NS, 7) != 0) continue;
+                run_handoff(primary, waiters[p], r, run_ms);
+            }
+        }
+    }
+
+    printf("{");
+    deadline_print_json();
+    printf("\"method\": \"spin_wait\", \"waitpkg\": %s, \"monitorx\": %s, \"run_ms\": %.0f, \"cpu_count\": %d",
+           g_waitpkg ? "true" : "false", g_monitorx ? "true" : "false", run_ms, cpu_count);
+    if (g_tsc_per_ns) printf(", \"tsc_mhz\": %.1f", g_tsc_per_ns * 1000.0);
+    else printf(", \"tsc_mhz\": null");
+#ifndef _WIN32
+    long max_time = bench_read_long("/sys/devices/system/cpu/umwait_control/max_time", -1);
+    long c02 = bench_read_long("/sys/devices/system/cpu/umwait_control/enable_c02", -1);
+    if (max_time >= 0) printf(", \"umwait_control\": {\"max_time_tsc\": %ld, \"enable_c02\": %ld}", max_time, c02);
+    else printf(", \"umwait_control\": null");
+#else
+    printf(", \"umwait_control\": null");
+#endif
+
+    printf(",\n \"pause\": [");
+    for (int i = 0; i < pause_count; i++) {
+        PauseResult* r = &pause[i];
+        printf("%s\n  {", i ? "," : "");
+        bench_print_cpu(r->cpu);
+        if (!r->measured) {
+            printf(", \"pause_ns\": null}");
+            continue;
+        }
+        printf(", \"pause_ns\": %.2f, \"core_mhz\": %.0f, \"pause_cycles\": %.1f", r->pause_ns, r->core_mhz,
+               r->pause_ns * r->core_mhz / 1000.0);
+        if (g_tsc_per_ns) printf(", \"pause_tsc\": %.1f}", r->pause_tsc);
+        else printf(", \"pause_tsc\": null}");
+    }
+
+    printf("],\n \"tpause\": ");
+    if (!tpause_runs) printf("null");
+    for (int i = 0; i < tpause_runs; i++) {
+        TpauseResult* r = &tpause[i];
+        printf("%s\n  {\"state\": \"%s\", \"wait_us\": %g, \"waits\": %llu, \"early\": %llu, \"os_limited\": %llu, \"lateness_ns\": ",
+               i ? "," : "[", r->ctrl ? "C0.1" : "C0.2", r->wait_us, (unsigned long long)r->waits,
+               (unsigned long long)r->early, (unsigned long long)r->os_limited);
+        hdr_json(stdout, &r->lateness_ns, "ns");
+        printf("}");
+        hdr_free(&r->lateness_ns);
+    }
+    if (tpause_runs) printf("]");
+
+    printf(",\n \"power\": ");
+    if (!power_runs) printf("null");
+    for (int w = 0; w < power_runs; w++) {
+        printf("%s{\"wait\": \"%s\", \"package_watts\": ", w ? ", " : "[", g_wait_names[w]);
+        if (watts[w] >= 0) printf("%.2f}", watts[w]);
+        else printf("null}");
+    }
+    if (power_runs) printf("]");
+
+    printf(",\n \"handoff\": [");
+    run_index = 0;
+    int printed = 0;
+    for (int p = 0; p < MAX_PLACEMENTS; p++) {
+        if (!waiters[p]) continue;
+        printf("%s\n  {\"placement\": \"%s\", \"waker\": {", printed++ ? "," : "", placement_names[p]);
+        bench_print_cpu(primary);
+        printf("}, \"waiter\": {");
+        bench_print_cpu(waiters[p]);
+        printf("}, \"runs\": [");
+        for (int k = 0; k < strategy_count * gap_count; k++) {
+            printf("%s\n    ", k ? "," : "");
+            print_handoff_run(&runs[run_index]);
+            hdr_free(&runs[run_index++].latency_ns);
+        }
+        printf("]}");
+    }
+    printf("],\n \"unavailable\": [");
+    for (int i = 0; i < unavailable_count; i++) printf("%s%s", i ? ", " : "", unavailable[i]);
+    printf("]}\n");
+    free(runs);
+    return 0;
+}
@@ -0,0 +1,346 @@
+/*
+ * Split Lock Benchmark - what a split-locked atomic on one core costs the others
+ *
+ * A locked read-modify-write whose operand straddles two cache lines cannot
+ * be done by locking one line, so the CPU falls back to a bus lock that
+ * blocks memory access on every core of the host (in a VM: of the whole
+ * physical machine). Recent Intel and AMD parts can trap these ("split lock
+ * detect", IA32_CORE_CAPABILITIES bit 5, and "bus lock detect"), and Linux
+ * warns about, slows down or kills the offending task depending on
+ * split_lock_detect= (see cpuid_helper's features and the tuning section of
+ * the report).
+ *
+ * Victim threads, one on the first thread of each other core, stream-read
+ * their own --buffer-mb buffers while a locker thread on the first core runs
+ *
+ *   baseline      nothing (the victims alone)
+ *   aligned_lock  LOCK ADD on a naturally aligned counter (the control)
+ *   split_lock    LOCK ADD on a 4-byte counter at line offset 62
+ *
+ * for --duration-ms each. Each phase reports the victims' read bandwidth,
+ * in total and per victim, as a percent of the baseline, and the locker's
+ * atomics per second (which shows the kernel's slowdown when it throttles
+ * split-locking tasks). With split_lock_detect=fatal the split phase would
+ * get the benchmark killed, so it is skipped.
+ *
+ * Usage:
+ *   bench_split_lock [--duration-ms N] [--victims N] [--buffer-mb N] [--deadline-ms N]
+ */
+
+#include "bench_common.h"
+#include "helper_deadline.h"
+
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+#define SPLIT_X86 1
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#ifndef _WIN32
+#include <setjmp.h>
+#include <signal.h>
+#endif
+
+#define MAX_VICTIMS 64
+#define READ_CHUNK (256 * 1024)
+#define LOCK_CHUNK 1024
+#define SPLIT_OFFSET 62         // a 4-byte operand here straddles the line boundary
+
+enum { PHASE_BASELINE, PHASE_ALIGNED, PHASE_SPLIT, PHASE_COUNT };
+static const char* g_phase_names[PHASE_COUNT] = {"baseline", "aligned_lock", "split_lock"};
+
+typedef struct {
+    const BenchCpu* cpu;
+    BenchStartLine* start_line;
+    uint64_t* buffer;           // allocated by the victim on its first run (node-local)
+    size_t words;
+    uint64_t duration_ns;
+    int phase;
+    int pinned;
+    double rate[PHASE_COUNT];   // bytes read per second
+} VictimThread;
+
+typedef struct {
+    const BenchCpu* cpu;
+    BenchStartLine* start_line;
+    unsigned char* target;
+    uint64_t duration_ns;
+    int pinned;
+    int faulted;                // SIGBUS: the kernel killed the split lock
+    double rate;                // locked adds per second
+} LockerThread;
+
+static void locked_add(unsigned char* target) {
+#if defined(_MSC_VER)
+    _InterlockedExchangeAdd((volatile long*)target, 1);
+#elif defined(SPLIT_X86)
+    __asm__ volatile("lock addl $1, %0" : "+m"(*(volatile uint32_t*)target) : : "memory");
+#else
+    (void)target;
+#endif
+}
+
+#ifndef _WIN32
+// split_lock_detect=fatal sends SIGBUS to the locker; jump out of the locked add
+static sigjmp_buf g_locker_jump;
+
+static void sigbus_handler(int sig) {
+    (void)sig;
+    siglongjmp(g_locker_jump, 1);
+}
+#endif
+
+static void victim_thread(void* arg) {
+    VictimThread* t = (VictimThread*)arg;
+    t->pinned = bench_pin(t->cpu->cpu);
+    if (t->pinned && !t->buffer) {
+        t->buffer = (uint64_t*)malloc(t->words * sizeof(uint64_t));
+        if (t->buffer) {
+            for (size_t i = 0; i < t->words; i++) t->buffer[i] = i;
+        }
+    }
+    bench_start_line_wait(t->start_line);
+    if (!t->pinned || !t->buffer) return;
+    size_t chunk = READ_CHUNK / sizeof(uint64_t), pos = 0;
+    uint64_t sum = 0, bytes = 0;
+    uint64_t start = bench_now_ns(), now = start;
+    uint64_t end = start + t->duration_ns;
+    while (now < end) {
+        if (pos + chunk > t->words) pos = 0;
+        const uint64_t* p = t->buffer + pos;
+        for (size_t i = 0; i < chunk; i += 4) sum += p[i] + p[i + 1] + p[i + 2] + p[i + 3];
+        pos += chunk;
+        bytes += READ_CHUNK;
+        now = bench_now_ns();
+    }
+    g_bench_sink += sum;
+    t->rate[t->phase] = now > start ? (double)bytes * 1e9 / (double)(now - start) : 0;
+}
+
+static void locker_thread(void* arg) {
+    LockerThread* t = (LockerThread*)arg;
+    t->pinned = bench_pin(t->cpu->cpu);
+    bench_start_line_wait(t->start_line);
+    if (!t->pinned) return;
+#ifndef _WIN32
+    if (sigsetjmp(g_locker_jump, 1)) {
+        t->faulted = 1;
+        return;
+    }
+#endif
+    uint64_t start = bench_now_ns(), now = start;
+    uint64_t end = start + t->duration_ns;
+    uint64_t ops = 0;
+    while (now < end) {
+        for (int i = 0; i < LOCK_CHUNK; i++) locked_add(t->target);
+        ops += LOCK_CHUNK;
+        now = bench_now_ns();
+    }
+    t->rate = now > start ? (double)ops * 1e9 / (double)(now - start) : 0;
+}
+
+// One phase: the victims and (except for the baseline) the locker, all
+// released together; returns 0 if a thread could not be started or pinned
+static int run_phase(VictimThread* victims, int victim_count, LockerThread* locker, unsigned char* target,
+                     int phase, double duration_ms) {
+    BenchThread handles[MAX_VICTIMS + 1];
+    int with_locker = phase != PHASE_BASELINE;
+    BenchStartLine start_line = {0, victim_count + with_locker};
+    int started = 0, ok = 1;
+    for (int i = 0; i < victim_count; i++) {
+        victims[i].start_line = &start_line;
+        victims[i].duration_ns = (uint64_t)(duration_ms * 1e6);
+        victims[i].phase = phase;
+        if (!bench_thread_start(&handles[started], victim_thread, &victims[i])) {
+            ok = 0;
+            break;
+        }
+        started++;
+    }
+    if (ok && with_locker) {
+        locker->start_line = &start_line;
+        locker->target = target;
+        locker->duration_ns = (uint64_t)(duration_ms * 1e6);
+        locker->rate = 0;
+        if (bench_thread_start(&handles[started], locker_thread, locker)) started++;
+        else ok = 0;
+    }
+    start_line.expected = started;
+    for (int i = 0; i < started; i++) bench_thread_join(&handles[i]);
+    for (int i = 0; i < victim_count; i++) ok &= victims[i].pinned && victims[i].buffer != NULL;
+    if (with_locker) ok &= locker->pinned;
+    return ok;
+}
+
+// Kernel split_lock_detect mode ("off", "warn", "fatal", "ratelimit:N"),
+// "unsupported" when the CPU traps neither split nor bus locks, or NULL
+// when it cannot be read (Windows)
+static const char* read_kernel_mode(char* mode, size_t size) {
+#ifdef _WIN32
+    (void)mode;
+    (void)size;
+    return NULL;
+#else
+    static char cpuinfo[16384];
+    if (bench_read_text("/proc/cpuinfo", cpuinfo, sizeof(cpuinfo)) < 0) return NULL;
+    char* flags = strstr(cpuinfo, "\nflags");
+    if (!flags) return NULL;
+    char* eol = strchr(flags + 1, '\n');
+    if (eol) *eol = '\0';
+    if (!strstr(flags, " split_lock_detect") && !strstr(flags, " bus_lock_detect")) return "unsupported";
+    char cmdline[4096];
+    snprintf(mode, size, "warn");
+    if (bench_read_text("/proc/cmdline", cmdline, sizeof(cmdline)) > 0) {
+        for (char* arg = strtok(cmdline, " "); arg; arg = strtok(NULL, " ")) {
+            if (strncmp(arg, "split_lock_detect=", 18) == 0) snprintf(mode, size, "%s", arg + 18);
+        }
+    }
+    return mode;
+#endif
+}
+
+int main(int argc, char* argv[]) {
+    double duration_ms = bench_arg_double(argc, argv, "--duration-ms", 1000);
+    int max_victims = (int)bench_arg_double(argc, argv, "--victims", 16);
+    double buffer_mb = bench_arg_double(argc, argv, "--buffer-mb", 32);
+    if (duration_ms < 50) duration_ms = 50;
+    if (max_victims < 0) max_victims = 0;
+    if (max_victims > MAX_VICTIMS) max_victims = MAX_VICTIMS;
+    if (buffer_mb < 1) buffer_mb = 1;
+
+    deadline_init(argc, argv);
+
+    static BenchCpu cpus[BENCH_MAX_CPUS];
+    int cpu_count = bench_topology(cpus, BENCH_MAX_CPUS);
+    if (!cpu_count) {
+        printf("{\"error\": \"No CPUs selected\"}\n");
+        return 1;
+    }
+    char unavailable[8][96];
+    int unavailable_count = 0;
+
+    // The locker takes the first core and the victims the first thread of
+    // the other cores, starting with one on another package (a bus lock
+    // blocks every socket, a contended line only its neighbours)
+    const BenchCpu* locker_cpu = &cpus[0];
+    static VictimThread victims[MAX_VICTIMS];
+    int victim_count = 0;
+    size_t words = (size_t)(buffer_mb * 1024 * 1024) / sizeof(uint64_t);
+    words -= words % (READ_CHUNK / sizeof(uint64_t));
+    for (int i = 0; i < cpu_count; i++) {
+        if (cpus[i].smt_index == 0 && cpus[i].package != locker_cpu->package) {
+            if (max_victims) victims[victim_count++].cpu = &cpus[i];
+            break;
+        }
+    }
+    for (int i = 0; i < cpu_count && victim_count < max_victims; i++) {
+        const BenchCpu* c = &cpus[i];
+        if (c->smt_index != 0 || (c->package == locker_cpu->package && c->core == locker_cpu->core)) continue;
+        if (victim_count && victims[0].cpu == c) continue;
+        victims[victim_count++].cpu = c;
+    }
+    for (int i = 0; i < victim_count; i++) victims[i].words = words;
+    if (!victim_count) snprintf(unavailable[unavailable_count++], sizeof(unavailable[0]),
+                                "{\"name\": \"victims\", \"reason\": \"no_other_core\"}");
+
+    char mode_buf[64];
+    const char* kernel_mode = read_kernel_mode(mode_buf, sizeof(mode_buf));
+    int run_split = 1, run_locker = 1;
+#ifndef SPLIT_X86
+    run_locker = run_split = 0;
+    snprintf(unavailable[unavailable_count++], sizeof(unavailable[0]),
+             "{\"name\": \"split_lock\", \"reason\": \"not_x86\"}");
+#endif
+    if (run_split && kernel_mode && strcmp(kernel_mode, "fatal") == 0) {
+        run_split = 0;
+        snprintf(unavailable[unavailable_count++], sizeof(unavailable[0]),
+                 "{\"name\": \"split_lock\", \"reason\": \"split_lock_detect_fatal\"}");
+    }
+#ifndef _WIN32
+    struct sigaction action, previous;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = sigbus_handler;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGBUS, &action, &previous);
+#endif
+
+    // Two lines, line-aligned: the aligned counter at 0, the split one at 62
+    unsigned char* raw = (unsigned char*)malloc(4 * 64);
+    if (!raw) {
+        printf("{\"error\": \"Out of memory\"}\n");
+        return 1;
+    }
+    unsigned char* lines = (unsigned char*)(((uintptr_t)raw + 63) & ~(uintptr_t)63);
+    memset(lines, 0, 128);
+
+    // Every phase has to fit the deadline with time left for the output
+    int phases = 1 + run_locker + run_split;
+    duration_ms = bench_scale_ms(duration_ms, bench_fit_budget(duration_ms * phases, BENCH_OUTPUT_RESERVE_MS), 50);
+
+    LockerThread lockers[PHASE_COUNT];
+    int ran[PHASE_COUNT] = {0, 0, 0};
+    memset(lockers, 0, sizeof(lockers));
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        if ((phase == PHASE_ALIGNED && !run_locker) || (phase == PHASE_SPLIT && !run_split)) continue;
+        lockers[phase].cpu = locker_cpu;
+        ran[phase] = run_phase(victims, victim_count, &lockers[phase],
+                               phase == PHASE_SPLIT ? lines + SPLIT_OFFSET : lines, phase, duration_ms);
+    }
+#ifndef _WIN32
+    sigaction(SIGBUS, &previous, NULL);
+#endif
+    if (lockers[PHASE_SPLIT].faulted) snprintf(unavailable[unavailable_count++], sizeof(unavailable[0]),
+                                               "{\"name\": \"split_lock\", \"reason\": \"sigbus\"}");
+
+    double totals[PHASE_COUNT] = {0, 0, 0};
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        for (int i = 0; i < victim_count; i++) totals[phase] += victims[i].rate[phase];
+    }
+
+    printf("{");
+    deadline_print_json();
+    printf("\"method\": \"split_locked_atomics\", \"duration_ms\": %.0f, \"buffer_mb\": %.0f, \"cpu_count\": %d",
+           duration_ms, buffer_mb, cpu_count);
+    if (kernel_mode) printf(", \"kernel_mode\": \"%s\"", kernel_mode);
+    else printf(", \"kernel_mode\": null");
+    printf(", \"victim_count\": %d", victim_count);
+    if (ran[PHASE_SPLIT] && !lockers[PHASE_SPLIT].faulted && totals[PHASE_BASELINE] > 0)
+        printf(", \"split_lock_percent_of_baseline\": %.1f", 100.0 * totals[PHASE_SPLIT] / totals[PHASE_BASELINE]);
+    else printf(", \"split_lock_percent_of_baseline\": null");
+    printf(",\n \"locker\": {");
+    bench_print_cpu(locker_cpu);
+    printf("},\n \"phases\": [");
+    int printed = 0;
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        if (!ran[phase] || lockers[phase].faulted) continue;
+        printf("%s\n  {\"phase\": \"%s\"", printed++ ? "," : "", g_phase_names[phase]);
+        // No victims ran: there is no bandwidth to report, not a measured zero
+        if (victim_count) printf(", \"victims_gb_per_s\": %.3f", totals[phase] / 1e9);
+        else printf(", \"victims_gb_per_s\": null");
+        if (totals[PHASE_BASELINE] > 0 && victim_count)
+            printf(", \"percent_of_baseline\": %.1f", 100.0 * totals[phase] / totals[PHASE_BASELINE]);
+        else printf(", \"percent_of_baseline\": null");
+        if (phase != PHASE_BASELINE) printf(", \"locker_ops_per_s\": %.4g}", lockers[phase].rate);
+        else printf(", \"locker_ops_per_s\": null}");
+    }
+    printf("],\n \"victims\": [");
+    for (int i = 0; i < victim_count; i++) {
+        printf("%s\n  {", i ? "," : "");
+        bench_print_cpu(victims[i].cpu);
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            if (!ran[phase] || lockers[phase].faulted) continue;
+            printf(", \"%s_gb_per_s\": %.3f", g_phase_names[phase], victims[i].rate[phase] / 1e9);
+        }
+        if (ran[PHASE_SPLIT] && !lockers[PHASE_SPLIT].faulted && victims[i].rate[PHASE_BASELINE] > 0)
+            printf(", \"split_lock_percent_of_baseline\": %.1f}",
+                   100.0 * victims[i].rate[PHASE_SPLIT] / victims[i].rate[PHASE_BASELINE]);
+        else printf(", \"split_lock_percent_of_baseline\": null}");
+        free(victims[i].buffer);
+    }
+    printf("],\n \"unavailable\": [");
+    for (int i = 0; i < unavailable_count; i++) printf("%s%s", i ? ", " : "", unavailable[i]);
+    printf("]}\n");
+    free(raw);
+    return 0;
+}
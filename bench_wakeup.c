@@ -0,0 +1,507 @@
+/*
+ * Wakeup Benchmark - timer wakeup latency per core and C-state configuration
+ *
+ * An event-driven service pays the exit latency of whatever idle state its
+ * core fell into every time a timer or packet wakes it. Like cyclictest, one
+ * thread per selected CPU (the first SMT thread of every core by default)
+ * is pinned there and sleeps until an absolute deadline every --interval-us
+ * (clock_nanosleep(TIMER_ABSTIME) on Linux, a high-resolution waitable timer
+ * on Windows) for --duration-ms. How late each wakeup arrives goes into an
+ * HDR histogram per CPU. The threads run SCHED_FIFO at --priority (Linux,
+ * when permitted; 0 keeps the normal policy) with a 1 ns timer slack, so the
+ * lateness is the hardware and kernel wakeup path rather than the scheduler.
+ *
+ * Each CPU reports its idle-state entries and residency over the run
+ * (cpuidle usage/time), showing which states the wakeups came out of.
+ *
+ * With --cstates (Linux, root) the run is repeated under each C-state limit:
+ * the default configuration, then the deepest state lowered one step at a
+ * time through the per-state "disable" files of the selected CPUs, and
+ * finally /dev/cpu_dma_latency held at 0 (which keeps every CPU out of any
+ * state with an exit latency). Limits the kernel refuses are listed under
+ * "unavailable"; the original settings are restored on exit, including on
+ * SIGINT/SIGTERM.
+ *
+ * Usage:
+ *   bench_wakeup [--cpus LIST|all] [--interval-us N] [--duration-ms N]
+ *                [--priority N] [--cstates] [--deadline-ms N]
+ */
+
+#include "bench_common.h"
+#include "hdr_histogram.h"
+#include "helper_deadline.h"
+
+#ifndef _WIN32
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/prctl.h>
+#endif
+
+#ifdef _WIN32
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#endif
+
+#define MAX_IDLE_STATES 16
+#define MAX_CONFIGS (MAX_IDLE_STATES + 2)
+#define SETTING_MAX 48
+#define LATENESS_HIGHEST_NS (10ull * 1000000000ull)
+
+typedef struct {
+    char name[SETTING_MAX];         // "default", "C1E", "cpu_dma_latency"
+    const char* constraint;         // NULL, "cpuidle_disable" or "cpu_dma_latency"
+    int deepest;                    // deepest enabled state index under cpuidle_disable
+} WakeConfig;
+
+typedef struct {
+    uint64_t usage[MAX_IDLE_STATES];    // entries
+    uint64_t time_us[MAX_IDLE_STATES];  // residency
+} IdleCounters;
+
+typedef struct {
+    const BenchCpu* cpu;
+    BenchStartLine* start_line;
+    uint64_t interval_ns;
+    uint64_t duration_ns;
+    int priority;
+    int pinned;
+    int realtime;
+    uint64_t wakeups;
+    uint64_t overruns;
+    HdrHistogram lateness;
+    IdleCounters idle_before, idle_after;
+} WakeThread;
+
+static const BenchCpu* g_selected[BENCH_MAX_CPUS];
+static int g_selected_count = 0;
+
+// Idle states of the first selected CPU (the same set is offered on every CPU)
+static int g_state_count = 0;
+static char g_state_name[MAX_IDLE_STATES][SETTING_MAX];
+static long g_state_latency_us[MAX_IDLE_STATES];
+
+// ---------------------------------------------------------------- C-state settings (Linux)
+
+static signed char g_saved_disable[BENCH_MAX_CPUS][MAX_IDLE_STATES];
+static int g_settings_changed = 0;
+
+// Opened before the sweep changes anything so restore_and_exit() can put the
+// "disable" files back with write() alone; -1 where not opened
+static int g_restore_fd[BENCH_MAX_CPUS][MAX_IDLE_STATES];
+static int g_dma_latency_fd = -1;
+
+static void cpuidle_path(char* path, size_t size, int cpu, int state, const char* file) {
+    snprintf(path, size, "/sys/devices/system/cpu/cpu%d/cpuidle/state%d/%s", cpu, state, file);
+}
+
+static void read_idle_states(int cpu) {
+    char path[BENCH_PATH_MAX];
+    for (g_state_count = 0; g_state_count < MAX_IDLE_STATES; g_state_count++) {
+        cpuidle_path(path, sizeof(path), cpu, g_state_count, "name");
+        if (bench_read_text(path, g_state_name[g_state_count], SETTING_MAX) < 0) break;
+        cpuidle_path(path, sizeof(path), cpu, g_state_count, "latency");
+        g_state_latency_us[g_state_count] = bench_read_long(path, -1);
+    }
+}
+
+static void read_idle_counters(int cpu, IdleCounters* counters) {
+    char path[BENCH_PATH_MAX];
+    char buf[64];
+    memset(counters, 0, sizeof(*counters));
+    for (int s = 0; s < g_state_count; s++) {
+        cpuidle_path(path, sizeof(path), cpu, s, "usage");
+        if (bench_read_text(path, buf, sizeof(buf)) > 0) counters->usage[s] = strtoull(buf, NULL, 10);
+        cpuidle_path(path, sizeof(path), cpu, s, "time");
+        if (bench_read_text(path, buf, sizeof(buf)) > 0) counters->time_us[s] = strtoull(buf, NULL, 10);
+    }
+}
+
+#ifndef _WIN32
+static void open_restore_fds(void) {
+    char path[BENCH_PATH_MAX];
+    for (int i = 0; i < g_selected_count; i++) {
+        for (int s = 0; s < MAX_IDLE_STATES; s++) {
+            g_restore_fd[i][s] = -1;
+            if (g_saved_disable[i][s] < 0) continue;
+            cpuidle_path(path, sizeof(path), g_selected[i]->cpu, s, "disable");
+            g_restore_fd[i][s] = open(path, O_WRONLY | O_CLOEXEC);
+        }
+    }
+}
+#endif
+
+static void restore_settings(void) {
+#ifndef _WIN32
+    if (g_dma_latency_fd >= 0) {
+        close(g_dma_latency_fd);   // the request ends with the file descriptor
+        g_dma_latency_fd = -1;
+    }
+    if (!g_settings_changed) return;
+    char path[BENCH_PATH_MAX];
+    for (int i = 0; i < g_selected_count; i++) {
+        for (int s = 0; s < g_state_count; s++) {
+            if (g_saved_disable[i][s] < 0) continue;
+            cpuidle_path(path, sizeof(path), g_selected[i]->cpu, s, "disable");
+            bench_write_text(path, g_saved_disable[i][s] ? "1" : "0");
+        }
+    }
+    g_settings_changed = 0;
+#endif
+}
+
+#ifndef _WIN32
+// Signal handler: async-signal-safe calls only, so no restore_settings().
+// The cpu_dma_latency request ends when _exit() closes its descriptor.
+static void restore_and_exit(int sig) {
+    if (g_settings_changed) {
+        for (int i = 0; i < g_selected_count; i++) {
+            for (int s = 0; s < g_state_count; s++) {
+                if (g_saved_disable[i][s] >= 0) bench_write_fd(g_restore_fd[i][s], g_saved_disable[i][s] ? "1" : "0");
+            }
+        }
+    }
+    _exit(128 + sig);
+}
+#endif
+
+static const char* write_error_reason(int err) {
+    if (err == EACCES || err == EPERM || err == EROFS) return "permission";
+    if (err == EBUSY) return "busy";
+    return "rejected";
+}
+
+// Apply a configuration to every selected CPU; returns NULL or why it failed
+static const char* apply_config(const WakeConfig* config) {
+    restore_settings();
+    if (!config->constraint) return NULL;
+#ifdef _WIN32
+    return "unsupported";
+#else
+    if (strcmp(config->constraint, "cpu_dma_latency") == 0) {
+        int fd = open("/dev/cpu_dma_latency", O_RDWR);
+        if (fd < 0) return write_error_reason(errno);
+        int32_t target_us = 0;
+        if (write(fd, &target_us, sizeof(target_us)) != (ssize_t)sizeof(target_us)) {
+            int err = errno;
+            close(fd);
+            return write_error_reason(err);
+        }
+        g_dma_latency_fd = fd;
+        return NULL;
+    }
+
+    char path[BENCH_PATH_MAX];
+    g_settings_changed = 1;
+    for (int i = 0; i < g_selected_count; i++) {
+        for (int s = 1; s < g_state_count; s++) {   // state 0 stays enabled: the shallowest limit
+            cpuidle_path(path, sizeof(path), g_selected[i]->cpu, s, "disable");
+            int err = bench_write_text(path, s > config->deepest ? "1" : "0");
+            if (err) return write_error_reason(err);
+        }
+    }
+    return NULL;
+#endif
+}
+
+// ---------------------------------------------------------------- measurement
+
+#ifdef _WIN32
+static void wait_until(HANDLE timer, uint64_t target_ns) {
+    uint64_t now = bench_now_ns();
+    if (target_ns <= now) return;
+    LARGE_INTEGER due;
+    due.QuadPart = -(LONGLONG)((target_ns - now + 99) / 100);   // relative, 100 ns units
+    if (SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE)) WaitForSingleObject(timer, INFINITE);
+}
+#else
+static void wait_until(uint64_t target_ns) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(target_ns / 1000000000ull);
+    ts.tv_nsec = (long)(target_ns % 1000000000ull);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+#endif
+
+static void wakeup_thread(void* arg) {
+    WakeThread* t = (WakeThread*)arg;
+    t->pinned = bench_pin(t->cpu->cpu);
+    bench_start_line_wait(t->start_line);
+    if (!t->pinned) return;
+
+    // Raised only after the start line: spinning FIFO threads on every CPU
+    // would keep the unpinned main thread from arriving
+#ifdef _WIN32
+    t->realtime = t->priority > 0 && SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+    HANDLE timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (!timer) timer = CreateWaitableTimerW(NULL, FALSE, NULL);
+    if (!timer) return;
+#else
+    prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+    if (t->priority > 0) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = t->priority;
+        t->realtime = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+    }
+#endif
+
+    uint64_t start = bench_now_ns();
+    uint64_t end = start + t->duration_ns;
+    uint64_t next = start + t->interval_ns;
+    while (next < end) {
+#ifdef _WIN32
+        wait_until(timer, next);
+#else
+        wait_until(next);
+#endif
+        uint64_t now = bench_now_ns();
+        hdr_record(&t->lateness, now > next ? now - next : 0);
+        t->wakeups++;
+        next += t->interval_ns;
+        if (now >= next) {
+            // Missed whole periods: restart the cadence instead of firing a burst
+            t->overruns++;
+            next = now + t->interval_ns;
+        }
+    }
+
+#ifdef _WIN32
+    CloseHandle(timer);
+    if (t->realtime) SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL);
+#else
+    if (t->realtime) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+    }
+#endif
+}
+
+static void run_config(WakeThread* threads, double interval_us, double duration_ms, int priority) {
+    BenchThread* handles = (BenchThread*)calloc(g_selected_count, sizeof(BenchThread));
+    if (!handles) return;
+    BenchStartLine start_line = {0, g_selected_count + 1};
+    for (int i = 0; i < g_selected_count; i++) {
+        WakeThread* t = &threads[i];
+        HdrHistogram lateness = t->lateness;
+        memset(t, 0, sizeof(*t));
+        t->lateness = lateness;
+        hdr_reset(&t->lateness);
+        t->cpu = g_selected[i];
+        t->start_line = &start_line;
+        t->interval_ns = (uint64_t)(interval_us * 1000.0);
+        t->duration_ns = (uint64_t)(duration_ms * 1e6);
+        t->priority = priority;
+    }
+
+    int started = 0;
+    for (int i = 0; i < g_selected_count; i++) {
+        if (!bench_thread_start(&handles[i], wakeup_thread, &threads[i])) break;
+        started++;
+    }
+    start_line.expected = started + 1;
+    for (int i = 0; i < started; i++) read_idle_counters(threads[i].cpu->cpu, &threads[i].idle_before);
+    bench_start_line_wait(&start_line);
+    for (int i = 0; i < started; i++) bench_thread_join(&handles[i]);
+    for (int i = 0; i < started; i++) read_idle_counters(threads[i].cpu->cpu, &threads[i].idle_after);
+    free(handles);
+}
+
+// ---------------------------------------------------------------- output
+
+static void select_cpus(const BenchCpu* cpus, int count, const char* spec) {
+    if (spec && strcmp(spec, "all") != 0) {
+        int* list = (int*)malloc(BENCH_MAX_CPUS * sizeof(int));
+        int n = list ? bench_cpu_list(spec, list, BENCH_MAX_CPUS) : 0;
+        for (int k = 0; k < n; k++) {
+            const BenchCpu* c = bench_find_cpu(cpus, count, list[k]);
+            if (c) g_selected[g_selected_count++] = c;
+        }
+        free(list);
+        return;
+    }
+    // One thread per core by default; "all" adds the SMT siblings
+    for (int i = 0; i < count; i++) {
+        if (spec || cpus[i].smt_index == 0) g_selected[g_selected_count++] = &cpus[i];
+    }
+}
+
+static void print_idle_states(const WakeThread* t) {
+    char path[BENCH_PATH_MAX];
+    uint64_t total_us = 0;
+    for (int s = 0; s < g_state_count; s++) total_us += t->idle_after.time_us[s] - t->idle_before.time_us[s];
+    printf(", \"idle_states\": [");
+    for (int s = 0; s < g_state_count; s++) {
+        uint64_t usage = t->idle_after.usage[s] - t->idle_before.usage[s];
+        uint64_t time_us = t->idle_after.time_us[s] - t->idle_before.time_us[s];
+        cpuidle_path(path, sizeof(path), t->cpu->cpu, s, "disable");
+        printf("%s{\"name\": \"%s\", \"latency_us\": %ld, \"disabled\": %s, \"entries\": %llu, \"residency_percent\": %.1f}",
+               s ? ", " : "", g_state_name[s], g_state_latency_us[s], bench_read_long(path, 0) ? "true" : "false",
+               (unsigned long long)usage, total_us ? 100.0 * (double)time_us / (double)total_us : 0.0);
+    }
+    printf("]");
+}
+
+static void print_config(const WakeConfig* config, WakeThread* threads) {
+    printf("    {\"name\": \"%s\"", config->name);
+    if (config->constraint) printf(", \"constraint\": \"%s\"", config->constraint);
+    else printf(", \"constraint\": null");
+    if (config->constraint && strcmp(config->constraint, "cpuidle_disable") == 0) {
+        printf(", \"deepest_state\": \"%s\", \"deepest_exit_latency_us\": %ld",
+               g_state_name[config->deepest], g_state_latency_us[config->deepest]);
+    } else {
+        printf(", \"deepest_state\": null, \"deepest_exit_latency_us\": null");
+    }
+
+    // Every CPU merged, then per CPU
+    HdrHistogram merged;
+    uint64_t wakeups = 0, overruns = 0;
+    int realtime = 1;
+    int have_merged = hdr_init(&merged, LATENESS_HIGHEST_NS, 7) == 0;
+    for (int i = 0; i < g_selected_count; i++) {
+        if (!threads[i].pinned) continue;
+        if (have_merged) hdr_merge(&merged, &threads[i].lateness);
+        wakeups += threads[i].wakeups;
+        overruns += threads[i].overruns;
+        realtime &= threads[i].realtime;
+    }
+    printf(", \"realtime\": %s, \"wakeups\": %llu, \"overruns\": %llu, \"lateness_ns\": ", realtime ? "true" : "false",
+           (unsigned long long)wakeups, (unsigned long long)overruns);
+    if (have_merged) {
+        hdr_json(stdout, &merged, "ns");
+        hdr_free(&merged);
+    } else {
+        printf("null");
+    }
+
+    printf(",\n     \"cpus\": [");
+    for (int i = 0; i < g_selected_count; i++) {
+        const WakeThread* t = &threads[i];
+        printf("%s\n      {", i ? "," : "");
+        bench_print_cpu(t->cpu);
+        printf(", \"pinned\": %s", t->pinned ? "true" : "false");
+        if (!t->pinned) {
+            printf("}");
+            continue;
+        }
+        printf(", \"realtime\": %s, \"wakeups\": %llu, \"overruns\": %llu", t->realtime ? "true" : "false",
+               (unsigned long long)t->wakeups, (unsigned long long)t->overruns);
+        print_idle_states(t);
+        printf(", \"lateness_ns\": ");
+        hdr_json(stdout, &t->lateness, "ns");
+        printf("}");
+    }
+    printf("]}");
+}
+
+int main(int argc, char* argv[]) {
+    double interval_us = bench_arg_double(argc, argv, "--interval-us", 1000);
+    double duration_ms = bench_arg_double(argc, argv, "--duration-ms", 5000);
+    int priority = (int)bench_arg_double(argc, argv, "--priority", 80);
+    int sweep = bench_has_flag(argc, argv, "--cstates");
+    if (interval_us < 10) interval_us = 10;
+    if (duration_ms < 10 * interval_us / 1000) duration_ms = 10 * interval_us / 1000;
+    if (priority > 99) priority = 99;
+
+    deadline_init(argc, argv);
+
+    static BenchCpu cpus[BENCH_MAX_CPUS];
+    int cpu_count = bench_topology(cpus, BENCH_MAX_CPUS);
+    select_cpus(cpus, cpu_count, bench_arg(argc, argv, "--cpus"));
+    if (!g_selected_count) {
+        printf("{\"error\": \"No CPUs selected\"}\n");
+        return 1;
+    }
+
+    // Configurations: the current settings, then each C-state limit
+    static WakeConfig configs[MAX_CONFIGS];
+    int config_count = 1;
+    memset(configs, 0, sizeof(configs));
+    snprintf(configs[0].name, SETTING_MAX, "default");
+#ifndef _WIN32
+    read_idle_states(g_selected[0]->cpu);
+    for (int i = 0; i < g_selected_count; i++) {
+        for (int s = 0; s < MAX_IDLE_STATES; s++) {
+            char path[BENCH_PATH_MAX];
+            cpuidle_path(path, sizeof(path), g_selected[i]->cpu, s, "disable");
+            g_saved_disable[i][s] = (signed char)(s < g_state_count ? bench_read_long(path, -1) : -1);
+        }
+    }
+    if (sweep) {
+        for (int deepest = g_state_count - 2; deepest >= 0 && config_count < MAX_CONFIGS; deepest--) {
+            WakeConfig* config = &configs[config_count++];
+            memcpy(config->name, g_state_name[deepest], SETTING_MAX);
+            config->constraint = "cpuidle_disable";
+            config->deepest = deepest;
+        }
+        WakeConfig* config = &configs[config_count++];
+        snprintf(config->name, SETTING_MAX, "cpu_dma_latency");
+        config->constraint = "cpu_dma_latency";
+        open_restore_fds();
+        signal(SIGINT, restore_and_exit);
+        signal(SIGTERM, restore_and_exit);
+        atexit(restore_settings);
+    }
+#else
+    sweep = 0;
+#endif
+
+    WakeThread* threads = (WakeThread*)calloc(g_selected_count, sizeof(WakeThread));
+    if (!threads) {
+        printf("{\"error\": \"Out of memory\"}\n");
+        return 1;
+    }
+    for (int i = 0; i < g_selected_count; i++) hdr_init(&threads[i].lateness, LATENESS_HIGHEST_NS, 7);
+
+    // Configurations are printed as they finish; the deadline members need
+    // the final elapsed time, so they go at the end
+    printf("{");
+#ifdef _WIN32
+    printf("\"method\": \"waitable_timer\"");
+#else
+    printf("\"method\": \"clock_nanosleep\"");
+#endif
+    printf(", \"interval_us\": %.0f, \"duration_ms\": %.0f, \"priority\": %d, \"cstates\": %s,\n \"configs\": [\n",
+           interval_us, duration_ms, priority, sweep ? "true" : "false");
+
+    int printed = 0;
+    char unavailable[MAX_CONFIGS][SETTING_MAX + 64];
+    int unavailable_count = 0;
+    for (int c = 0; c < config_count; c++) {
+        // A configuration has to fit the deadline with time left for the
+        // output; the first one is shortened instead of dropped
+        if (printed && !deadline_allows(duration_ms + BENCH_OUTPUT_RESERVE_MS)) {
+            deadline_skip("remaining_configs", "budget");
+            break;
+        }
+        double run_ms = bench_scale_ms(duration_ms, bench_fit_budget(duration_ms, BENCH_OUTPUT_RESERVE_MS), 100);
+        const char* failure = apply_config(&configs[c]);
+        if (failure) {
+            snprintf(unavailable[unavailable_count++], sizeof(unavailable[0]),
+                     "{\"name\": \"%.40s\", \"reason\": \"%s\"}", configs[c].name, failure);
+            continue;
+        }
+        if (configs[c].constraint) bench_sleep_ms(50);   // let idle governors see the new limits
+        run_config(threads, interval_us, run_ms, priority);
+        printf("%s", printed++ ? ",\n" : "");
+        print_config(&configs[c], threads);
+        fflush(stdout);
+    }
+    restore_settings();
+
+    printf("\n ], \"unavailable\": [");
+    for (int i = 0; i < unavailable_count; i++) printf("%s%s", i ? ", " : "", unavailable[i]);
+    printf("], \"idle_states\": [");
+    for (int s = 0; s < g_state_count; s++) {
+        printf("%s{\"name\": \"%s\", \"latency_us\": %ld}", s ? ", " : "", g_state_name[s], g_state_latency_us[s]);
+    }
+    printf("], ");
+    deadline_print_json();
+    printf("\"cpu_count\": %d}\n", cpu_count);
+
+    for (int i = 0; i < g_selected_count; i++) hdr_free(&threads[i].lateness);
+    free(threads);
+    return 0;
+}
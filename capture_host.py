@@ -0,0 +1,292 @@
+"""
+Host capture tool for Halfax System Reporter.
+
+Snapshots every raw input the native collectors read (DMI/SMBIOS and ACPI
+tables, CPUID dumps, NVMe descriptors and log pages, EDID blobs, selected
+sysfs/procfs trees) into one .tar.gz archive. The archive (or its unpacked
+directory) is a replay root:
+
+    python capture_host.py -o myhost.tar.gz        # on the machine of interest
+    python main.py --replay myhost.tar.gz          # anywhere else
+    cpuid_helper.exe --replay <dir>                # a single helper
+
+The layout is documented in helper_replay.h; the Windows helpers write their
+own inputs when run with --capture, Linux inputs are copied here.
+"""
+import argparse
+import atexit
+import ctypes
+import datetime
+import glob
+import json
+import os
+import platform
+import shutil
+import struct
+import subprocess
+import sys
+import tarfile
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+NATIVE_HELPERS = ['cpuid_helper', 'spd_helper', 'nvme_helper', 'edid_helper', 'cpufreq_helper',
+                  'isolation_helper']
+
+# Linux files and trees copied verbatim (relative layout under sys/ and proc/)
+LINUX_FILES = [
+    '/proc/cpuinfo', '/proc/meminfo', '/proc/stat', '/proc/interrupts',
+    '/proc/softirqs', '/proc/cmdline', '/proc/version', '/proc/swaps',
+]
+LINUX_TREES = [
+    ('/sys/devices/system/cpu', 5),
+    ('/sys/devices/system/node', 2),
+    ('/sys/devices/system/edac', 4),
+    ('/sys/devices/cpu_core', 1),
+    ('/sys/devices/cpu_atom', 1),
+    ('/sys/devices/virtual/workqueue', 2),
+    ('/sys/kernel/mm/transparent_hugepage', 2),
+    ('/sys/kernel/mm/hugepages', 2),
+    ('/sys/class/thermal', 2),
+    ('/sys/class/powercap', 2),
+    ('/proc/irq', 2),
+]
+# Class directories whose entries are symlinks into /sys/devices: copied resolved
+LINUX_CLASS_TREES = [
+    ('/sys/bus/pci/devices', 1),
+    ('/sys/class/net', 2),
+    ('/sys/block', 2),
+    ('/sys/class/nvme', 1),
+]
+MAX_FILE_BYTES = 1 << 20
+
+STORAGE_BUS_TYPE_NVME = 0x11
+
+
+def rsmb_blob(major, minor, table, dmi_revision=0):
+    """Wrap a raw SMBIOS structure table in the RawSMBIOSData header Windows returns for 'RSMB'"""
+    return struct.pack('<BBBBI', 0, major, minor, dmi_revision, len(table)) + table
+
+
+def storage_descriptor(product_id, bus_type=STORAGE_BUS_TYPE_NVME):
+    """Build a STORAGE_DEVICE_DESCRIPTOR as returned by IOCTL_STORAGE_QUERY_PROPERTY"""
+    header_size = 40
+    product = product_id.encode('ascii', 'replace')[:63] + b'\0'
+    size = header_size + len(product)
+    # Version, Size, DeviceType, Modifier, Removable, CommandQueueing,
+    # Vendor/Product/Revision/Serial offsets, BusType, RawPropertiesLength
+    header = struct.pack('<IIBBBBIIIIII', size, size, 0, 0, 0, 1,
+                         0, header_size, 0, 0, bus_type, 0)
+    return header.ljust(header_size, b'\0') + product
+
+
+def write_file(root, rel, data):
+    path = os.path.join(root, *rel.split('/'))
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    mode = 'wb' if isinstance(data, bytes) else 'w'
+    with open(path, mode) as f:
+        f.write(data)
+
+
+def read_bytes(path):
+    try:
+        with open(path, 'rb') as f:
+            return f.read(MAX_FILE_BYTES)
+    except (OSError, IOError):
+        return None
+
+
+def copy_host_file(root, path):
+    data = read_bytes(path)
+    if data is None:
+        return 0
+    write_file(root, path.lstrip('/'), data)
+    return 1
+
+
+def copy_tree(root, src, dst, depth):
+    """Copy readable regular files below src without following symlinks (sysfs has cycles)"""
+    copied = 0
+    try:
+        entries = os.listdir(src)
+    except OSError:
+        return 0
+    for name in entries:
+        path = os.path.join(src, name)
+        if os.path.islink(path):
+            continue
+        if os.path.isdir(path):
+            if depth > 0:
+                copied += copy_tree(root, path, dst + '/' + name, depth - 1)
+        else:
+            data = read_bytes(path)
+            if data is not None:
+                write_file(root, dst + '/' + name, data)
+                copied += 1
+    return copied
+
+
+def capture_linux(root, stats):
+    for path in LINUX_FILES:
+        stats['files'] += copy_host_file(root, path)
+    for tree, depth in LINUX_TREES:
+        stats['files'] += copy_tree(root, tree, tree.lstrip('/'), depth)
+    for tree, depth in LINUX_CLASS_TREES:
+        for entry in sorted(glob.glob(tree + '/*')):
+            stats['files'] += copy_tree(root, os.path.realpath(entry),
+                                        entry.lstrip('/'), depth)
+
+    # DMI table -> smbios/RSMB.bin so spd_helper replays Linux captures too
+    entry = read_bytes('/sys/firmware/dmi/tables/smbios_entry_point')
+    table = read_bytes('/sys/firmware/dmi/tables/DMI')
+    if entry and table:
+        if entry.startswith(b'_SM3_'):
+            major, minor, rev = entry[7], entry[8], entry[9]
+        else:
+            major, minor, rev = entry[6], entry[7], 0
+        write_file(root, 'smbios/RSMB.bin', rsmb_blob(major, minor, table, rev))
+        stats['smbios'] = True
+
+    for path in sorted(glob.glob('/sys/firmware/acpi/tables/*')):
+        if os.path.isfile(path):
+            data = read_bytes(path)
+            if data:
+                write_file(root, f'acpi/{os.path.basename(path)}.bin', data)
+                stats['acpi_tables'] += 1
+
+    for path in sorted(glob.glob('/sys/class/drm/*/edid')):
+        data = read_bytes(path)
+        if data:
+            connector = os.path.basename(os.path.dirname(path))
+            write_file(root, f'edid/{connector}/edid.bin', data)
+            stats['edid_blobs'] += 1
+
+    for index, dev in enumerate(sorted(glob.glob('/dev/nvme[0-9]*'))):
+        if not dev[len('/dev/nvme'):].isdigit():
+            continue
+        model = read_bytes(f'/sys/class/nvme/{os.path.basename(dev)}/model') or b'NVMe Drive'
+        write_file(root, f'nvme/PhysicalDrive{index}/descriptor.bin',
+                   storage_descriptor(model.decode('ascii', 'replace').strip()))
+        log = nvme_get_log_page(dev, 0x02)
+        if log:
+            write_file(root, f'nvme/PhysicalDrive{index}/log_02.bin', log)
+            stats['nvme_log_pages'] += 1
+
+
+def nvme_get_log_page(dev, log_id, size=512):
+    """Read an NVMe log page with the Linux admin passthrough ioctl (needs root)"""
+    try:
+        import fcntl
+    except ImportError:
+        return None
+    NVME_IOCTL_ADMIN_CMD = 0xC0484E41
+    buf = ctypes.create_string_buffer(size)
+    numd = size // 4 - 1
+    # struct nvme_passthru_cmd: opcode, flags, rsvd1, nsid, cdw2, cdw3, metadata,
+    # addr, metadata_len, data_len, cdw10..cdw15, timeout_ms, result
+    cmd = struct.pack('<BBHIIIQQIIIIIIIIII', 0x02, 0, 0, 0xFFFFFFFF, 0, 0, 0,
+                      ctypes.addressof(buf), 0, size, (numd << 16) | log_id,
+                      0, 0, 0, 0, 0, 0, 0)
+    try:
+        with open(dev, 'rb') as f:
+            fcntl.ioctl(f.fileno(), NVME_IOCTL_ADMIN_CMD, bytearray(cmd))
+    except (OSError, IOError):
+        return None
+    return buf.raw
+
+
+def capture_windows_acpi(root, stats):
+    """Copy every ACPI table through EnumSystemFirmwareTables/GetSystemFirmwareTable"""
+    kernel32 = ctypes.windll.kernel32
+    provider = struct.unpack('>I', b'ACPI')[0]
+    size = kernel32.EnumSystemFirmwareTables(provider, None, 0)
+    if size <= 0:
+        return
+    ids = ctypes.create_string_buffer(size)
+    kernel32.EnumSystemFirmwareTables(provider, ids, size)
+    for i in range(0, size, 4):
+        table_id = struct.unpack('<I', ids.raw[i:i + 4])[0]
+        length = kernel32.GetSystemFirmwareTable(provider, table_id, None, 0)
+        if length <= 0:
+            continue
+        data = ctypes.create_string_buffer(length)
+        kernel32.GetSystemFirmwareTable(provider, table_id, data, length)
+        sig = ids.raw[i:i + 4].decode('ascii', 'replace')
+        write_file(root, f'acpi/{sig}.bin', data.raw)
+        stats['acpi_tables'] += 1
+
+
+def capture_helpers(root, stats):
+    """Let each native helper copy its own inputs, keeping its live output for comparison"""
+    exe_suffix = '.exe' if platform.system() == 'Windows' else ''
+    for name in NATIVE_HELPERS:
+        path = os.path.join(HERE, name + exe_suffix)
+        if not os.path.exists(path):
+            continue
+        try:
+            result = subprocess.run([path, '--capture', root], capture_output=True,
+                                    text=True, timeout=60)
+            write_file(root, f'helpers/{name}.json', result.stdout)
+            stats['helpers'].append(name)
+        except (subprocess.TimeoutExpired, OSError) as e:
+            print(f"{name}: capture failed ({e})", file=sys.stderr)
+
+
+def capture_host(output):
+    stage = tempfile.mkdtemp(prefix='halfax-capture-')
+    root = os.path.join(stage, 'capture')
+    os.makedirs(root)
+    stats = {'files': 0, 'smbios': False, 'acpi_tables': 0, 'edid_blobs': 0,
+             'nvme_log_pages': 0, 'helpers': []}
+
+    capture_helpers(root, stats)
+    if platform.system() == 'Windows':
+        capture_windows_acpi(root, stats)
+        stats['smbios'] = os.path.exists(os.path.join(root, 'smbios', 'RSMB.bin'))
+    elif platform.system() == 'Linux':
+        capture_linux(root, stats)
+
+    manifest = {
+        'hostname': platform.node(),
+        'platform': platform.platform(),
+        'captured_at': datetime.datetime.now().isoformat(timespec='seconds'),
+        'stats': stats,
+    }
+    write_file(root, 'manifest.json', json.dumps(manifest, indent=2))
+
+    with tarfile.open(output, 'w:gz') as tar:
+        tar.add(root, arcname='capture')
+    shutil.rmtree(stage, ignore_errors=True)
+    return manifest
+
+
+def open_replay_root(path):
+    """
+    Return a replay root directory for a capture directory or archive. An
+    archive is extracted to a temporary directory that is removed at exit.
+    """
+    if os.path.isdir(path):
+        return os.path.abspath(path)
+    stage = tempfile.mkdtemp(prefix='halfax-replay-')
+    atexit.register(shutil.rmtree, stage, ignore_errors=True)
+    with tarfile.open(path, 'r:*') as tar:
+        if hasattr(tarfile, 'data_filter'):
+            tar.extractall(stage, filter='data')
+        else:
+            tar.extractall(stage)
+    root = os.path.join(stage, 'capture')
+    return root if os.path.isdir(root) else stage
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Capture a replay root for the native collectors')
+    default_name = f"capture-{platform.node()}-{datetime.datetime.now():%Y%m%d-%H%M%S}.tar.gz"
+    parser.add_argument('-o', '--output', default=default_name, help='archive to write')
+    args = parser.parse_args()
+
+    manifest = capture_host(args.output)
+    print(f"Captured {manifest['hostname']} -> {args.output}")
+    print(json.dumps(manifest['stats'], indent=2))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,448 @@
+/*
+ * CPUFreq Helper - per-policy frequency residency from Linux cpufreq statistics
+ *
+ * Instantaneous frequency samples miss short excursions; the kernel's
+ * cpufreq statistics do not. For every policy under
+ * /sys/devices/system/cpu/cpufreq/policy* this helper reads
+ *
+ *   stats/time_in_state   time spent at each frequency (10 ms units)
+ *   stats/total_trans     number of frequency changes
+ *   stats/trans_table     changes between each pair of frequencies
+ *
+ * twice, --interval-ms apart (default 1000), and reports the time-at-frequency
+ * histogram and transition rate over that interval next to the policy's
+ * limits, governor and energy_performance_preference. Without a second
+ * sample (replay, or no budget left) the counters since boot are used.
+ *
+ * Each policy is labelled with its core type from the hybrid PMU lists
+ * (/sys/devices/cpu_core/cpus, /sys/devices/cpu_atom/cpus), so main.py can
+ * show, for example, E-cores parked at minimum while P-cores are capped
+ * below turbo. Drivers without statistics (intel_pstate in active mode)
+ * still report their limits and the current frequency.
+ *
+ * Usage:
+ *   cpufreq_helper [--interval-ms N] [--deadline-ms N] [--trace FILE]
+ *                  [--replay DIR | --capture DIR]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "helper_replay.h"
+#include "helper_trace.h"
+#include "helper_deadline.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define CPUFREQ_ROOT "/sys/devices/system/cpu/cpufreq"
+#define INITIAL_POLICIES 64
+#define MAX_STATES 64
+#define MAX_CPUS 8192
+#define MAX_TOP_TRANSITIONS 5
+#define FILE_BUF_SIZE 65536
+#define DEFAULT_INTERVAL_MS 1000
+
+typedef struct {
+    uint64_t time[MAX_STATES];      // 10 ms units, in state order
+    uint64_t total_trans;
+    uint64_t* table;                // state_count x state_count, NULL if unavailable
+} PolicyStats;
+
+typedef struct {
+    int id;
+    int* cpus;
+    int cpu_count;
+    const char* core_type;          // static string or NULL
+    char governor[32];
+    char driver[32];
+    char epp[48];
+    long min_khz, max_khz, base_khz, scaling_min_khz, scaling_max_khz, cur_khz;
+    int state_count;
+    long state_khz[MAX_STATES];
+    int has_stats;
+    PolicyStats before;
+    PolicyStats after;
+} Policy;
+
+static Policy* g_policies = NULL;
+static int g_policy_capacity = 0;
+static int g_policy_count = 0;
+static const char* g_core_types[MAX_CPUS];
+
+static void sleep_ms(double ms) {
+#ifdef _WIN32
+    Sleep((DWORD)(ms + 0.5));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ms / 1000.0);
+    ts.tv_nsec = (long)((ms - (double)ts.tv_sec * 1000.0) * 1e6);
+    nanosleep(&ts, NULL);
+#endif
+}
+
+// Read a sysfs file (from the replay root when replaying, copying it into
+// the capture root when capturing). Returns the length, or -1.
+static int read_sys_file(const char* abs_path, char* buf, size_t size) {
+    char replay_buf[REPLAY_PATH_MAX];
+    FILE* f = fopen(replay_host_path(abs_path, replay_buf, sizeof(replay_buf)), "rb");
+    if (!f) return -1;
+    size_t len = fread(buf, 1, size - 1, f);
+    fclose(f);
+    buf[len] = '\0';
+    capture_write_file(abs_path + 1, buf, len);
+    return (int)len;
+}
+
+static long read_sys_long(const char* abs_path) {
+    char buf[64];
+    if (read_sys_file(abs_path, buf, sizeof(buf)) <= 0) return -1;
+    return strtol(buf, NULL, 10);
+}
+
+static void read_sys_word(const char* abs_path, char* out, size_t size) {
+    char buf[256];
+    out[0] = '\0';
+    if (read_sys_file(abs_path, buf, sizeof(buf)) <= 0) return;
+    size_t n = strcspn(buf, " \t\r\n");
+    if (n >= size) n = size - 1;
+    memcpy(out, buf, n);
+    out[n] = '\0';
+}
+
+// Parse a cpu list ("0-3,8 10") into 'out'; returns the number of CPUs
+static int parse_cpu_list(const char* text, int* out, int max_count) {
+    int count = 0;
+    const char* p = text;
+    while (*p) {
+        while (*p == ',' || *p == ' ' || *p == '\n' || *p == '\t') p++;
+        if (*p < '0' || *p > '9') break;
+        char* end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long cpu = first; cpu <= last && count < max_count; cpu++) {
+            if (out) out[count] = (int)cpu;
+            count++;
+        }
+    }
+    return count;
+}
+
+// Label CPUs from the hybrid PMU cpu lists (Intel P-cores and E-cores)
+static void load_core_types(void) {
+    static const struct { const char* path; const char* type; } lists[] = {
+        {"/sys/devices/cpu_core/cpus", "P-core"},
+        {"/sys/devices/cpu_atom/cpus", "E-core"},
+    };
+    char buf[4096];
+    int* cpus = (int*)malloc(MAX_CPUS * sizeof(int));
+    if (!cpus) return;
+    for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); i++) {
+        if (read_sys_file(lists[i].path, buf, sizeof(buf)) <= 0) continue;
+        int n = parse_cpu_list(buf, cpus, MAX_CPUS);
+        for (int k = 0; k < n; k++) {
+            if (cpus[k] >= 0 && cpus[k] < MAX_CPUS) g_core_types[cpus[k]] = lists[i].type;
+        }
+    }
+    free(cpus);
+}
+
+static int compare_policy_ids(const void* a, const void* b) {
+    return ((const Policy*)a)->id - ((const Policy*)b)->id;
+}
+
+static int collect_policy_dir(const char* name, int is_dir, void* ctx) {
+    (void)ctx;
+    if (!is_dir || strncmp(name, "policy", 6) != 0 || name[6] < '0' || name[6] > '9') return 0;
+    if (g_policy_count >= g_policy_capacity) {
+        // A policy covers at least one CPU, so MAX_CPUS bounds the table
+        int grown = g_policy_capacity * 2;
+        if (grown > MAX_CPUS) grown = MAX_CPUS;
+        Policy* bigger = grown > g_policy_capacity
+            ? (Policy*)realloc(g_policies, (size_t)grown * sizeof(Policy)) : NULL;
+        if (!bigger) {
+            deadline_truncate("policies");
+            return 1;
+        }
+        g_policies = bigger;
+        g_policy_capacity = grown;
+    }
+    memset(&g_policies[g_policy_count], 0, sizeof(Policy));
+    g_policies[g_policy_count].id = atoi(name + 6);
+    g_policy_count++;
+    return 0;
+}
+
+// Read time_in_state, total_trans and trans_table; the first call also fixes
+// the state list. Returns 1 if time_in_state was readable.
+static int read_policy_stats(Policy* policy, PolicyStats* stats, char* buf) {
+    char path[256];
+    snprintf(path, sizeof(path), CPUFREQ_ROOT "/policy%d/stats/time_in_state", policy->id);
+    if (read_sys_file(path, buf, FILE_BUF_SIZE) <= 0) return 0;
+
+    int first = policy->state_count == 0;
+    int index = 0;
+    for (char* line = buf; *line && index < MAX_STATES; ) {
+        char* next = strchr(line, '\n');
+        unsigned long long khz, ticks;
+        if (sscanf(line, "%llu %llu", &khz, &ticks) == 2) {
+            if (first) policy->state_khz[index] = (long)khz;
+            if (first || policy->state_khz[index] == (long)khz) stats->time[index] = ticks;
+            index++;
+        }
+        if (!next) break;
+        line = next + 1;
+    }
+    if (first) policy->state_count = index;
+
+    snprintf(path, sizeof(path), CPUFREQ_ROOT "/policy%d/stats/total_trans", policy->id);
+    long trans = read_sys_long(path);
+    stats->total_trans = trans > 0 ? (uint64_t)trans : 0;
+
+    // trans_table: two header lines, then "<from>: <count to each state>"
+    // (the kernel refuses to print it when it exceeds a page)
+    snprintf(path, sizeof(path), CPUFREQ_ROOT "/policy%d/stats/trans_table", policy->id);
+    int n = policy->state_count;
+    if (n > 0 && read_sys_file(path, buf, FILE_BUF_SIZE) > 0) {
+        stats->table = (uint64_t*)calloc((size_t)n * n, sizeof(uint64_t));
+        char* line = buf;
+        int row = -2;
+        while (stats->table && line && *line) {
+            char* next = strchr(line, '\n');
+            if (next) *next = '\0';
+            char* colon = strchr(line, ':');
+            if (row >= 0 && row < n && colon) {
+                char* p = colon + 1;
+                for (int col = 0; col < n; col++) {
+                    char* end;
+                    unsigned long long count = strtoull(p, &end, 10);
+                    if (end == p) break;
+                    stats->table[row * n + col] = count;
+                    p = end;
+                }
+            }
+            row++;
+            line = next ? next + 1 : NULL;
+        }
+    }
+    return index > 0;
+}
+
+static void read_policy(Policy* policy, char* buf) {
+    char path[256];
+    snprintf(path, sizeof(path), CPUFREQ_ROOT "/policy%d/related_cpus", policy->id);
+    if (read_sys_file(path, buf, FILE_BUF_SIZE) > 0) {
+        int n = parse_cpu_list(buf, NULL, MAX_CPUS);
+        policy->cpus = (int*)calloc(n > 0 ? n : 1, sizeof(int));
+        if (policy->cpus) policy->cpu_count = parse_cpu_list(buf, policy->cpus, n);
+    }
+    if (policy->cpu_count > 0 && policy->cpus[0] >= 0 && policy->cpus[0] < MAX_CPUS) {
+        policy->core_type = g_core_types[policy->cpus[0]];
+    }
+
+#define POLICY_FILE(name) (snprintf(path, sizeof(path), CPUFREQ_ROOT "/policy%d/" name, policy->id), path)
+    read_sys_word(POLICY_FILE("scaling_governor"), policy->governor, sizeof(policy->governor));
+    read_sys_word(POLICY_FILE("scaling_driver"), policy->driver, sizeof(policy->driver));
+    read_sys_word(POLICY_FILE("energy_performance_preference"), policy->epp, sizeof(policy->epp));
+    policy->min_khz = read_sys_long(POLICY_FILE("cpuinfo_min_freq"));
+    policy->max_khz = read_sys_long(POLICY_FILE("cpuinfo_max_freq"));
+    policy->base_khz = read_sys_long(POLICY_FILE("base_frequency"));
+    policy->scaling_min_khz = read_sys_long(POLICY_FILE("scaling_min_freq"));
+    policy->scaling_max_khz = read_sys_long(POLICY_FILE("scaling_max_freq"));
+    policy->cur_khz = read_sys_long(POLICY_FILE("scaling_cur_freq"));
+#undef POLICY_FILE
+
+    policy->has_stats = read_policy_stats(policy, &policy->before, buf);
+}
+
+static void print_string_or_null(const char* name, const char* value) {
+    if (value && value[0]) printf(", \"%s\": \"%s\"", name, value);
+    else printf(", \"%s\": null", name);
+}
+
+static void print_mhz_or_null(const char* name, long khz) {
+    if (khz > 0) printf(", \"%s\": %ld", name, khz / 1000);
+    else printf(", \"%s\": null", name);
+}
+
+static void print_policy(const Policy* policy, int interval) {
+    printf("    {\"policy\": %d, \"cpus\": [", policy->id);
+    for (int i = 0; i < policy->cpu_count; i++) printf("%s%d", i ? ", " : "", policy->cpus[i]);
+    printf("]");
+    print_string_or_null("core_type", policy->core_type);
+    print_string_or_null("driver", policy->driver);
+    print_string_or_null("governor", policy->governor);
+    print_string_or_null("epp", policy->epp);
+    print_mhz_or_null("min_mhz", policy->min_khz);
+    print_mhz_or_null("max_mhz", policy->max_khz);
+    print_mhz_or_null("base_mhz", policy->base_khz);
+    print_mhz_or_null("scaling_min_mhz", policy->scaling_min_khz);
+    print_mhz_or_null("scaling_max_mhz", policy->scaling_max_khz);
+    print_mhz_or_null("cur_mhz", policy->cur_khz);
+    printf(", \"capped\": %s",
+           policy->scaling_max_khz > 0 && policy->max_khz > 0 && policy->scaling_max_khz < policy->max_khz ? "true" : "false");
+    printf(", \"stats\": %s", policy->has_stats ? "true" : "false");
+    if (!policy->has_stats) {
+        printf("}");
+        return;
+    }
+
+    // Deltas over the interval, or the counters since boot
+    int n = policy->state_count;
+    const PolicyStats* a = &policy->before;
+    const PolicyStats* b = &policy->after;
+    uint64_t time[MAX_STATES];
+    uint64_t total_ticks = 0;
+    for (int i = 0; i < n; i++) {
+        time[i] = interval ? (b->time[i] >= a->time[i] ? b->time[i] - a->time[i] : 0) : a->time[i];
+        total_ticks += time[i];
+    }
+    uint64_t trans = interval ? (b->total_trans >= a->total_trans ? b->total_trans - a->total_trans : 0)
+                              : a->total_trans;
+    double seconds = (double)total_ticks / 100.0;
+
+    long low = 0, high = 0;
+    double weighted = 0;
+    for (int i = 0; i < n; i++) {
+        if (!low || policy->state_khz[i] < low) low = policy->state_khz[i];
+        if (policy->state_khz[i] > high) high = policy->state_khz[i];
+        weighted += (double)policy->state_khz[i] * (double)time[i];
+    }
+    uint64_t at_low = 0, at_high = 0;
+    for (int i = 0; i < n; i++) {
+        if (policy->state_khz[i] == low) at_low += time[i];
+        if (policy->state_khz[i] == high) at_high += time[i];
+    }
+
+    printf(", \"window\": \"%s\", \"window_s\": %.2f", interval ? "interval" : "since_boot", seconds);
+    if (total_ticks) {
+        printf(", \"mean_mhz\": %.0f", weighted / (double)total_ticks / 1000.0);
+        printf(", \"at_min_percent\": %.1f", 100.0 * (double)at_low / (double)total_ticks);
+        printf(", \"at_max_percent\": %.1f", 100.0 * (double)at_high / (double)total_ticks);
+        printf(", \"transitions_per_s\": %.1f", (double)trans / seconds);
+    } else {
+        printf(", \"mean_mhz\": null, \"at_min_percent\": null, \"at_max_percent\": null, \"transitions_per_s\": null");
+    }
+    printf(", \"transitions\": %llu", (unsigned long long)trans);
+
+    printf(", \"residency\": [");
+    int printed = 0;
+    for (int i = 0; i < n; i++) {
+        if (!time[i]) continue;
+        printf("%s{\"mhz\": %ld, \"percent\": %.1f, \"ms\": %llu}", printed++ ? ", " : "",
+               policy->state_khz[i] / 1000, 100.0 * (double)time[i] / (double)total_ticks,
+               (unsigned long long)time[i] * 10);
+    }
+    printf("]");
+
+    // Most frequent transitions over the window
+    printf(", \"top_transitions\": [");
+    if (a->table && (!interval || b->table)) {
+        int used[MAX_TOP_TRANSITIONS];
+        int count = 0;
+        for (int k = 0; k < MAX_TOP_TRANSITIONS; k++) {
+            int best = -1;
+            uint64_t best_count = 0;
+            for (int cell = 0; cell < n * n; cell++) {
+                uint64_t c = interval ? (b->table[cell] >= a->table[cell] ? b->table[cell] - a->table[cell] : 0)
+                                      : a->table[cell];
+                int taken = 0;
+                for (int u = 0; u < count; u++) taken |= used[u] == cell;
+                if (!taken && c > best_count) {
+                    best = cell;
+                    best_count = c;
+                }
+            }
+            if (best < 0) break;
+            used[count++] = best;
+            printf("%s{\"from_mhz\": %ld, \"to_mhz\": %ld, \"count\": %llu}", k ? ", " : "",
+                   policy->state_khz[best / n] / 1000, policy->state_khz[best % n] / 1000,
+                   (unsigned long long)best_count);
+        }
+    }
+    printf("]}");
+}
+
+int main(int argc, char* argv[]) {
+    double interval_ms = DEFAULT_INTERVAL_MS;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--interval-ms") == 0) interval_ms = atof(argv[++i]);
+    }
+
+    replay_init(argc, argv);
+    trace_init(argc, argv);
+    deadline_init(argc, argv);
+
+    char* buf = (char*)malloc(FILE_BUF_SIZE);
+    g_policy_capacity = INITIAL_POLICIES;
+    g_policies = (Policy*)calloc(g_policy_capacity, sizeof(Policy));
+    if (!buf || !g_policies) {
+        printf("{\"error\": \"Out of memory\"}\n");
+        return 1;
+    }
+
+    trace_begin("probe", "cpufreq_policies");
+    load_core_types();
+    replay_list_dir(CPUFREQ_ROOT + 1, collect_policy_dir, NULL);
+    qsort(g_policies, g_policy_count, sizeof(Policy), compare_policy_ids);
+    for (int i = 0; i < g_policy_count; i++) read_policy(&g_policies[i], buf);
+    trace_end();
+    if (g_policy_count) deadline_source("policies", "sysfs_cpufreq");
+
+    int any_stats = 0;
+    for (int i = 0; i < g_policy_count; i++) any_stats |= g_policies[i].has_stats;
+
+    // Second sample: the interval is shortened to fit the deadline, and
+    // replayed hosts have only one snapshot to read
+    int interval = 0;
+    double measured_ms = 0;
+    if (any_stats && !replay_enabled() && interval_ms > 0) {
+        double budget = deadline_remaining_ms() / 2;
+        if (interval_ms > budget) interval_ms = budget;
+        if (interval_ms >= 10) {
+            trace_begin("probe", "cpufreq_interval");
+            double start = deadline_clock_ms();
+            sleep_ms(interval_ms);
+            for (int i = 0; i < g_policy_count; i++) {
+                Policy* policy = &g_policies[i];
+                if (policy->has_stats) read_policy_stats(policy, &policy->after, buf);
+            }
+            measured_ms = deadline_clock_ms() - start;
+            trace_end();
+            interval = 1;
+            deadline_source("residency", "time_in_state_interval");
+        } else {
+            deadline_skip("cpufreq_interval", "budget");
+        }
+    }
+    if (any_stats && !interval) deadline_source("residency", "time_in_state_since_boot");
+
+    trace_begin("output", "emit_json");
+    printf("{");
+    deadline_print_json();
+    printf("\"supported\": %s, \"interval_ms\": %.1f, \"policies\": [\n", g_policy_count ? "true" : "false", measured_ms);
+    for (int i = 0; i < g_policy_count; i++) {
+        print_policy(&g_policies[i], interval);
+        printf("%s\n", i + 1 < g_policy_count ? "," : "");
+    }
+    printf("]}\n");
+    trace_end();
+
+    for (int i = 0; i < g_policy_count; i++) {
+        free(g_policies[i].cpus);
+        free(g_policies[i].before.table);
+        free(g_policies[i].after.table);
+    }
+    free(g_policies);
+    free(buf);
+    return 0;
+}
@@ -5,6 +5,9 @@
 #include <stdlib.h>
 #include <wbemidl.h>
 #include <comdef.h>
+#include "helper_replay.h"
+#include "helper_trace.h"
+#include "helper_deadline.h"
 
 #pragma comment(lib, "ole32.lib")
 #pragma comment(lib, "oleaut32.lib")
@@ -29,16 +32,39 @@ typedef struct {
     int is_inclusive;      // 1=inclusive, 0=exclusive, -1=unknown
 } CacheInfo;
 
-// Per-core APIC topology structure
+// CPUID 0xB/0x1F level types (ECX[15:8]); 0xB only reports SMT and core
+enum {
+    TOPO_LEVEL_INVALID, TOPO_LEVEL_SMT, TOPO_LEVEL_CORE, TOPO_LEVEL_MODULE,
+    TOPO_LEVEL_TILE, TOPO_LEVEL_DIE, TOPO_LEVEL_DIE_GROUP, TOPO_LEVEL_COUNT
+};
+
+static const char* g_topo_level_names[TOPO_LEVEL_COUNT] = {
+    "invalid", "smt", "core", "module", "tile", "die", "die_group"
+};
+
+// Levels the processor enumerates, as read on the first logical processor
+typedef struct {
+    int shift[TOPO_LEVEL_COUNT];      // EAX[4:0]: APIC ID bits up to and including the level, -1 if not enumerated
+    int processors[TOPO_LEVEL_COUNT]; // EBX[15:0]: logical processors per instance of the level
+    int top_shift;                    // shift of the highest level: APIC ID >> top_shift = package
+    int leaf;                         // 0x1F or 0xB, 0 if neither is supported
+} TopologyLevels;
+
+// Per-core APIC topology structure. Level IDs are unique system-wide (the
+// APIC ID with the bits of the levels below shifted out); -1 where the
+// processor does not enumerate the level.
 typedef struct {
     int apic_id;           // APIC ID of this core
-    int core_type;         // 0=reserved, 1=performance, 2=efficiency, 3+=reserved
-    int core_index;        // Index within core type
+    int core_type;         // CPUID 0x1A EAX[31:24]: 0x40 (64)=P-core, 0x20 (32)=E-core, 0=not hybrid
+    int core_index;        // Index of the core within its module/tile/die/package
     int logical_index;     // Logical processor number
     int package_id;        // Package/socket ID
-    int tile_id;           // Tile ID (Meteor Lake)
+    int die_group_id;      // Die group ID
     int die_id;            // Die ID
-    int module_id;         // Module ID (cluster of cores)
+    int tile_id;           // Tile ID (Meteor Lake)
+    int module_id;         // Module ID (cluster of cores sharing an L2, e.g. four E-cores)
+    int core_id;           // Core ID
+    int smt_id;            // Thread index within the core
 } PerCoreTopology;
 
 // Simple vendor detection
@@ -56,8 +82,80 @@ CpuVendor get_cpu_vendor() {
     return VENDOR_UNKNOWN;
 }
 
+// CPUID replay state: the dump of the logical processor currently "pinned" in replay mode
+typedef struct {
+    unsigned int leaf, subleaf;
+    CPUIDResult r;
+} CPUIDReplayEntry;
+
+static int g_replay_lp = 0;
+static int g_replay_loaded_lp = -1;
+static CPUIDReplayEntry* g_replay_entries = NULL;
+static int g_replay_count = 0;
+
+// Load cpuid/cpu<N>.txt for the current replay LP (only one LP is kept in memory)
+static void load_replay_cpuid(int lp) {
+    if (g_replay_loaded_lp == lp) return;
+    free(g_replay_entries);
+    g_replay_entries = NULL;
+    g_replay_count = 0;
+    g_replay_loaded_lp = lp;
+
+    char rel[64];
+    snprintf(rel, sizeof(rel), "cpuid/cpu%d.txt", lp);
+    size_t size = 0;
+    trace_begin_arg("syscall", "replay_read_cpuid", "lp", lp);
+    char* text = (char*)replay_read_file(rel, &size);
+    trace_end();
+    if (!text) return;
+
+    int capacity = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (text[i] == '\n') capacity++;
+    }
+    g_replay_entries = (CPUIDReplayEntry*)calloc(capacity + 1, sizeof(CPUIDReplayEntry));
+    if (!g_replay_entries) {
+        free(text);
+        return;
+    }
+
+    char* line = text;
+    while (line && *line && g_replay_count <= capacity) {
+        CPUIDReplayEntry* e = &g_replay_entries[g_replay_count];
+        unsigned int a, b, c, d;
+        if (sscanf(line, "%x %x %x %x %x %x", &e->leaf, &e->subleaf, &a, &b, &c, &d) == 6) {
+            e->r.eax = (int)a;
+            e->r.ebx = (int)b;
+            e->r.ecx = (int)c;
+            e->r.edx = (int)d;
+            g_replay_count++;
+        }
+        line = strchr(line, '\n');
+        if (line) line++;
+    }
+    free(text);
+}
+
+// Look up a leaf/subleaf in the replayed dump; missing entries read as zero like invalid leaves
+static void replay_cpuid(int leaf, int subleaf, CPUIDResult* result) {
+    memset(result, 0, sizeof(*result));
+    load_replay_cpuid(g_replay_lp);
+    for (int i = 0; i < g_replay_count; i++) {
+        if (g_replay_entries[i].leaf == (unsigned int)leaf &&
+            g_replay_entries[i].subleaf == (unsigned int)subleaf) {
+            *result = g_replay_entries[i].r;
+            return;
+        }
+    }
+}
+
 // Read CPUID leaf and return results
 void read_cpuid(int leaf, int subleaf, CPUIDResult* result) {
+    if (replay_enabled()) {
+        replay_cpuid(leaf, subleaf, result);
+        return;
+    }
+    
     int cpuInfo[4] = {0};
     __cpuidex(cpuInfo, leaf, subleaf);
     
@@ -99,6 +197,9 @@ int get_turbo_ratios(int* base_freq, int* max_turbo_1c, int* max_turbo_ac) {
     return 1;  // Success
 }
 
+// Typical cost of a cold COM/WMI connection; skipped when less budget is left
+#define WMI_COST_MS 1500
+
 // WMI fallback for MaxClockSpeed (in MHz)
 int get_max_clock_wmi() {
     HRESULT hr;
@@ -110,6 +211,15 @@ int get_max_clock_wmi() {
     ULONG uReturn = 0;
     int max_mhz = 0;
 
+    if (replay_enabled()) {
+        char* text = (char*)replay_read_file("wmi/Win32_Processor.MaxClockSpeed.txt", NULL);
+        if (text) {
+            max_mhz = atoi(text);
+            free(text);
+        }
+        return max_mhz;
+    }
+
     hr = CoInitializeEx(0, COINIT_MULTITHREADED);
     if (FAILED(hr)) return 0;
 
@@ -163,9 +273,20 @@ int get_max_clock_wmi() {
     if (pSvc) pSvc->Release();
     if (pLoc) pLoc->Release();
     CoUninitialize();
+
+    if (capture_enabled()) {
+        char text[32];
+        int len = snprintf(text, sizeof(text), "%d\n", max_mhz);
+        capture_write_file("wmi/Win32_Processor.MaxClockSpeed.txt", text, len);
+    }
     return max_mhz;
 }
 
+// deadline_run() body: the result slot outlives the call if the query is abandoned
+static void wmi_max_clock_worker(void* ctx) {
+    *(int*)ctx = get_max_clock_wmi();
+}
+
 // Gather the 48-byte processor brand string from CPUID leaves 0x80000002-4
 void get_brand_string(char* buffer, size_t buffer_size) {
     if (!buffer || buffer_size < 49) {
@@ -193,6 +314,60 @@ void get_brand_string(char* buffer, size_t buffer_size) {
     buffer[48] = '\0';
 }
 
+// Feature flags reported in "features" as name: 0/1
+enum { REG_EAX, REG_EBX, REG_ECX, REG_EDX };
+
+typedef struct {
+    const char* name;
+    unsigned int leaf, subleaf;
+    int reg, bit;
+} CpuFeature;
+
+static const CpuFeature g_cpu_features[] = {
+    // Spin-wait primitives
+    {"monitor", 0x1, 0, REG_ECX, 3},            // MONITOR/MWAIT (ring 0 on most OSes)
+    {"waitpkg", 0x7, 0, REG_ECX, 5},            // UMONITOR/UMWAIT/TPAUSE (user mode)
+    {"monitorx", 0x80000001, 0, REG_ECX, 29},   // AMD MONITORX/MWAITX (user mode)
+    // Split-lock and bus-lock detection. Split-lock detection itself is bit 5
+    // of the IA32_CORE_CAPABILITIES MSR, which user mode cannot read; the OS
+    // reports whether it is armed (split_lock_detect in Linux /proc/cpuinfo)
+    {"core_capabilities", 0x7, 0, REG_EDX, 30}, // IA32_CORE_CAPABILITIES MSR present
+    {"bus_lock_detect", 0x7, 0, REG_ECX, 24},   // #DB trap after a bus lock
+    // Copy and fill strategy. AVX2/AVX-512 also need the OS to save their
+    // state (osxsave, then XCR0), which bench_memcpy checks before using them
+    {"erms", 0x7, 0, REG_EBX, 9},               // enhanced REP MOVSB/STOSB
+    {"fsrm", 0x7, 0, REG_EDX, 4},               // fast short REP MOVSB (under 128 bytes)
+    {"fzrm", 0x7, 1, REG_EAX, 10},              // fast zero-length REP MOVSB
+    {"fsrs", 0x7, 1, REG_EAX, 11},              // fast short REP STOSB
+    {"avx2", 0x7, 0, REG_EBX, 5},
+    {"avx512f", 0x7, 0, REG_EBX, 16},
+    {"avx512bw", 0x7, 0, REG_EBX, 30},          // byte/word ops (masked tail copies)
+    {"osxsave", 0x1, 0, REG_ECX, 27},           // OS enabled XSAVE/XGETBV
+};
+
+// 1 if the feature's bit is set and its leaf is within the supported range
+static int cpu_feature_present(const CpuFeature* f, unsigned int max_leaf, unsigned int max_ext) {
+    if (f->leaf >= 0x80000000 ? f->leaf > max_ext : f->leaf > max_leaf) return 0;
+    CPUIDResult r;
+    read_cpuid((int)f->leaf, (int)f->subleaf, &r);
+    int regs[4] = {r.eax, r.ebx, r.ecx, r.edx};
+    return ((unsigned int)regs[f->reg] >> f->bit) & 1;
+}
+
+static void print_cpu_features() {
+    CPUIDResult r;
+    read_cpuid(0, 0, &r);
+    unsigned int max_leaf = (unsigned int)r.eax;
+    read_cpuid(0x80000000, 0, &r);
+    unsigned int max_ext = (unsigned int)r.eax;
+    printf("\"features\": {");
+    for (size_t i = 0; i < sizeof(g_cpu_features) / sizeof(g_cpu_features[0]); i++) {
+        printf("%s\"%s\": %d", i ? ", " : "", g_cpu_features[i].name,
+               cpu_feature_present(&g_cpu_features[i], max_leaf, max_ext));
+    }
+    printf("}, ");
+}
+
 // Parse frequency (MHz) from brand string; returns 1 if parsed
 int parse_frequency_from_brand(const char* brand, int* freq_mhz_out) {
     if (!brand || !freq_mhz_out) return 0;
@@ -336,38 +511,40 @@ void detect_amd_caches(CacheInfo* l1d, CacheInfo* l1i, CacheInfo* l2, CacheInfo*
     }
 }
 
-// Detect per-core APIC ID topology using CPUID 0xB (Intel) or 0x1F (Meteor Lake)
-// CRITICAL: Must set thread affinity to each logical processor to get unique APIC IDs
-void detect_apic_topology(PerCoreTopology* topo_array, int* num_cores) {
-    if (!topo_array || !num_cores) return;
-    *num_cores = 0;
-    
-    CPUIDResult r0;
-    read_cpuid(0, 0, &r0);
-    int max_leaf = r0.eax;
-    
-    // Try CPUID 0x1F first (Meteor Lake+ with tile info), fall back to 0xB
-    int topo_leaf = (max_leaf >= 0x1F) ? 0x1F : 0xB;
+// Replay: the LP count is the highest captured cpuid/cpu<N>.txt index + 1
+static int replay_cpu_count_cb(const char* name, int is_dir, void* ctx) {
+    int idx = 0;
+    if (!is_dir && sscanf(name, "cpu%d.txt", &idx) == 1) {
+        int* count = (int*)ctx;
+        if (idx + 1 > *count) *count = idx + 1;
+    }
+    return 0;
+}
+
+// Count logical processors via GetLogicalProcessorInformationEx (or the replay dumps)
+int count_logical_processors() {
+    int total_logical_processors = 0;
     
-    if (max_leaf < 0xB) return; // CPUID 0xB/0x1F not supported
+    if (replay_enabled()) {
+        replay_list_dir("cpuid", replay_cpu_count_cb, &total_logical_processors);
+        return total_logical_processors;
+    }
     
-    // Step 1: Use GetLogicalProcessorInformationEx to enumerate all logical processors
     DWORD buffer_size = 0;
     GetLogicalProcessorInformationEx(RelationProcessorCore, NULL, &buffer_size);
-    if (buffer_size == 0) return;
+    if (buffer_size == 0) return 0;
     
     BYTE* buffer = (BYTE*)malloc(buffer_size);
-    if (!buffer) return;
+    if (!buffer) return 0;
     
     if (!GetLogicalProcessorInformationEx(RelationProcessorCore, 
         (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buffer, &buffer_size)) {
         free(buffer);
-        return;
+        return 0;
     }
     
     // Parse the returned structures to count logical processors
     DWORD offset = 0;
-    int total_logical_processors = 0;
     
     while (offset < buffer_size) {
         PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX info = 
@@ -387,81 +564,267 @@ void detect_apic_topology(PerCoreTopology* topo_array, int* num_cores) {
         offset += info->Size;
     }
     
-    // Step 2: For each logical processor, set thread affinity and read CPUID
-    HANDLE current_thread = GetCurrentThread();
-    DWORD_PTR original_affinity = SetThreadAffinityMask(current_thread, 1);
+    free(buffer);
+    return total_logical_processors;
+}
+
+// Make subsequent read_cpuid() calls execute on logical processor 'lp'.
+// 'lp' is a flat index across processor groups, so hosts with more than
+// 64 logical processors are covered too.
+int pin_to_logical_processor(int lp) {
+    if (replay_enabled()) {
+        g_replay_lp = lp;
+        return 1;
+    }
     
-    for (int lp = 0; lp < total_logical_processors && *num_cores < 256; lp++) {
-        // Set thread affinity to logical processor 'lp'
-        DWORD_PTR affinity_mask = (DWORD_PTR)1 << lp;
+    GROUP_AFFINITY affinity;
+    memset(&affinity, 0, sizeof(affinity));
+    WORD group_count = GetActiveProcessorGroupCount();
+    WORD group = 0;
+    for (; group < group_count; group++) {
+        DWORD in_group = GetActiveProcessorCount(group);
+        if ((DWORD)lp < in_group) break;
+        lp -= (int)in_group;
+    }
+    if (group == group_count) return 0;
+    
+    affinity.Group = group;
+    affinity.Mask = (KAFFINITY)1 << lp;
+    if (!SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL)) {
+        return 0;
+    }
+    
+    // Small delay to ensure thread migration completes
+    Sleep(1);
+    return 1;
+}
+
+// Append one "leaf subleaf eax ebx ecx edx" line to a capture buffer
+static void append_cpuid_line(char* buf, size_t buf_size, size_t* len,
+                              unsigned int leaf, unsigned int subleaf, const int* regs) {
+    if (*len >= buf_size) return;
+    int n = snprintf(buf + *len, buf_size - *len, "%08x %02x %08x %08x %08x %08x\n",
+                     leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+    if (n > 0) *len += (size_t)n;
+}
+
+// Dump every CPUID leaf of the current logical processor into cpuid/cpu<lp>.txt.
+// Dumps the full leaf range rather than just what this helper reads, so newer
+// helper builds can still replay older captures.
+void capture_cpuid_leaves(int lp) {
+    // Leaves whose output depends on the subleaf (ECX)
+    static const unsigned int indexed_leaves[] = {
+        0x4, 0x7, 0xB, 0xD, 0xF, 0x10, 0x12, 0x14, 0x17, 0x18, 0x1A, 0x1D, 0x1E,
+        0x1F, 0x20, 0x23, 0x8000001D, 0x80000020, 0x80000026
+    };
+    const size_t buf_size = 256 * 1024;
+    char* buf = (char*)malloc(buf_size);
+    if (!buf) return;
+    size_t len = 0;
+    
+    int regs[4];
+    __cpuidex(regs, 0, 0);
+    unsigned int max_leaf = (unsigned int)regs[0];
+    __cpuidex(regs, 0x80000000, 0);
+    unsigned int max_ext = (unsigned int)regs[0];
+    if (max_ext > 0x80000040) max_ext = 0x80000040;
+    
+    for (int range = 0; range < 2; range++) {
+        unsigned int first = range ? 0x80000000 : 0;
+        unsigned int last = range ? max_ext : max_leaf;
+        if (last > first + 0x40) last = first + 0x40;
         
-        if (SetThreadAffinityMask(current_thread, affinity_mask) == 0) {
+        for (unsigned int leaf = first; leaf <= last; leaf++) {
+            int indexed = 0;
+            for (size_t k = 0; k < sizeof(indexed_leaves) / sizeof(indexed_leaves[0]); k++) {
+                if (indexed_leaves[k] == leaf) indexed = 1;
+            }
+            
+            for (unsigned int sub = 0; sub < (indexed ? 64u : 1u); sub++) {
+                __cpuidex(regs, (int)leaf, (int)sub);
+                
+                // Enumerations terminated by a null entry: cache (4, 8000001D) and topology (B, 1F) leaves
+                int terminator = 0;
+                if ((leaf == 0x4 || leaf == 0x8000001D) && (regs[0] & 0x1F) == 0) terminator = 1;
+                if ((leaf == 0xB || leaf == 0x1F) && ((regs[2] >> 8) & 0xFF) == 0) terminator = 1;
+                
+                if (sub == 0 || terminator || regs[0] || regs[1] || regs[2] || regs[3]) {
+                    append_cpuid_line(buf, buf_size, &len, leaf, sub, regs);
+                }
+                if (terminator) break;
+            }
+        }
+    }
+    
+    char rel[64];
+    snprintf(rel, sizeof(rel), "cpuid/cpu%d.txt", lp);
+    capture_write_file(rel, buf, len);
+    free(buf);
+}
+
+// Capture mode: pin to every logical processor in turn and dump its CPUID leaves
+void capture_all_cpuid(void) {
+    int total = count_logical_processors();
+    GROUP_AFFINITY original_affinity;
+    int restore = GetThreadGroupAffinity(GetCurrentThread(), &original_affinity);
+    
+    for (int lp = 0; lp < total; lp++) {
+        trace_begin_arg("probe", "capture_cpuid_leaves", "lp", lp);
+        if (pin_to_logical_processor(lp)) {
+            capture_cpuid_leaves(lp);
+        }
+        trace_end();
+    }
+    
+    if (restore) {
+        SetThreadGroupAffinity(GetCurrentThread(), &original_affinity, NULL);
+    }
+}
+
+// Read the enumerated levels of CPUID 0xB/0x1F on the current logical processor
+static void read_topology_levels(int topo_leaf, TopologyLevels* levels) {
+    for (int type = 0; type < TOPO_LEVEL_COUNT; type++) {
+        levels->shift[type] = -1;
+        levels->processors[type] = 0;
+    }
+    levels->top_shift = 0;
+    for (int subleaf = 0; subleaf < 8; subleaf++) {
+        CPUIDResult r_sub;
+        read_cpuid(topo_leaf, subleaf, &r_sub);
+
+        int level_type = (r_sub.ecx >> 8) & 0xFF;  // ECX bits 15:8 = level type
+        int shift_bits = r_sub.eax & 0x1F;          // EAX bits 4:0 = bits to shift
+
+        if (level_type == TOPO_LEVEL_INVALID) break;  // End of topology levels
+        if (level_type >= TOPO_LEVEL_COUNT) {
+            // Unknown level type: its bits still sit below the package
+            if (shift_bits > levels->top_shift) levels->top_shift = shift_bits;
+            continue;
+        }
+        levels->shift[level_type] = shift_bits;
+        levels->processors[level_type] = r_sub.ebx & 0xFFFF;
+        if (shift_bits > levels->top_shift) levels->top_shift = shift_bits;
+    }
+}
+
+// Split an x2APIC ID into the ID of every enumerated level. Bits of a level the
+// processor does not enumerate belong to the next enumerated level above it.
+static void decode_apic_levels(PerCoreTopology* t, unsigned int apic_id, const TopologyLevels* levels) {
+    int ids[TOPO_LEVEL_COUNT];
+    int below = 0;          // shift of the enumerated level below the current one
+    int core_parent = -1;   // shift of the first enumerated level above the core
+    for (int type = TOPO_LEVEL_SMT; type < TOPO_LEVEL_COUNT; type++) {
+        ids[type] = -1;
+        if (levels->shift[type] < 0) continue;
+        if (type == TOPO_LEVEL_SMT) ids[type] = (int)(apic_id & ((1u << levels->shift[type]) - 1));
+        else ids[type] = (int)(apic_id >> below);
+        if (type > TOPO_LEVEL_CORE && core_parent < 0) core_parent = levels->shift[type];
+        below = levels->shift[type];
+    }
+    int smt_bits = levels->shift[TOPO_LEVEL_SMT] > 0 ? levels->shift[TOPO_LEVEL_SMT] : 0;
+    int core_bits = core_parent >= 0 ? core_parent : levels->top_shift;
+
+    t->apic_id = (int)apic_id;
+    t->package_id = (int)(apic_id >> levels->top_shift);
+    t->core_index = (int)((apic_id >> smt_bits) & ((1u << (core_bits - smt_bits)) - 1));
+    t->smt_id = ids[TOPO_LEVEL_SMT];
+    t->core_id = ids[TOPO_LEVEL_CORE];
+    t->module_id = ids[TOPO_LEVEL_MODULE];
+    t->tile_id = ids[TOPO_LEVEL_TILE];
+    t->die_id = ids[TOPO_LEVEL_DIE];
+    t->die_group_id = ids[TOPO_LEVEL_DIE_GROUP];
+}
+
+// Detect per-core APIC ID topology using CPUID 0x1F (module/tile/die/die group
+// levels) or 0xB (SMT and core only)
+// CRITICAL: Must set thread affinity to each logical processor to get unique APIC IDs
+// Returns a malloc'd array with one entry per logical processor (NULL if unsupported)
+PerCoreTopology* detect_apic_topology(int* num_cores, TopologyLevels* levels) {
+    if (!num_cores || !levels) return NULL;
+    *num_cores = 0;
+
+    CPUIDResult r0;
+    read_cpuid(0, 0, &r0);
+    int max_leaf = r0.eax;
+
+    // Prefer CPUID 0x1F where it is valid (subleaf 0 reports a level), fall back to 0xB
+    int topo_leaf = 0xB;
+    if (max_leaf >= 0x1F) {
+        CPUIDResult r1f;
+        read_cpuid(0x1F, 0, &r1f);
+        if (r1f.ebx != 0) topo_leaf = 0x1F;
+    }
+
+    if (max_leaf < 0xB) return NULL; // CPUID 0xB/0x1F not supported
+    
+    // Step 1: Enumerate all logical processors
+    int total_logical_processors = count_logical_processors();
+    if (total_logical_processors == 0) return NULL;
+    
+    PerCoreTopology* topo_array = (PerCoreTopology*)calloc(total_logical_processors, sizeof(PerCoreTopology));
+    if (!topo_array) return NULL;
+    
+    // Step 2: For each logical processor, set thread affinity and read CPUID
+    GROUP_AFFINITY original_affinity;
+    int restore = !replay_enabled() && GetThreadGroupAffinity(GetCurrentThread(), &original_affinity);
+    
+    deadline_source("apic_ids", topo_leaf == 0x1F ? "cpuid_0x1f" : "cpuid_0xb");
+    for (int lp = 0; lp < total_logical_processors; lp++) {
+        // Pinning costs a migration per LP; stop with a partial list when out of budget
+        if (deadline_expired()) {
+            deadline_skip("apic_topology", "budget");
+            deadline_truncate("apic_ids");
+            break;
+        }
+        trace_begin_arg("probe", "logical_processor", "lp", lp);
+        trace_begin("syscall", "pin_to_logical_processor");
+        int pinned = pin_to_logical_processor(lp);
+        trace_end();
+        if (!pinned) {
             // Failed to set affinity - skip this LP
+            trace_end();
             continue;
         }
         
-        // Small delay to ensure thread migration completes
-        Sleep(1);
-        
         // Step 3: Execute CPUID 0xB/0x1F on THIS specific logical processor
         CPUIDResult r;
         read_cpuid(topo_leaf, 0, &r);  // Subleaf 0 for SMT level
         
         // EDX contains the x2APIC ID for this logical processor
-        int apic_id = r.edx;
-        
-        // Decode topology levels by iterating subleaves
-        int smt_bits = 0, core_bits = 0, tile_bits = 0;
-        
-        for (int subleaf = 0; subleaf < 8; subleaf++) {
-            CPUIDResult r_sub;
-            read_cpuid(topo_leaf, subleaf, &r_sub);
-            
-            int level_type = (r_sub.ecx >> 8) & 0xFF;  // ECX bits 15:8 = level type
-            int shift_bits = r_sub.eax & 0x1F;          // EAX bits 4:0 = bits to shift
-            
-            if (level_type == 0) break;  // End of topology levels
-            
-            if (level_type == 1) {       // SMT (thread) level
-                smt_bits = shift_bits;
-            } else if (level_type == 2) { // Core level
-                core_bits = shift_bits;
-            } else if (level_type == 5) { // Tile/die level (0x1F only)
-                tile_bits = shift_bits;
-            }
+        unsigned int apic_id = (unsigned int)r.edx;
+
+        // Decode topology levels by iterating subleaves (the same on every LP;
+        // the first one is kept for the level summary)
+        TopologyLevels lp_levels;
+        read_topology_levels(topo_leaf, &lp_levels);
+        if (*num_cores == 0) {
+            *levels = lp_levels;
+            levels->leaf = topo_leaf;
         }
-        
-        // Decode APIC ID fields
-        int smt_mask = (1 << smt_bits) - 1;
-        int core_mask = ((1 << core_bits) - 1) & ~smt_mask;
-        
-        topo_array[*num_cores].apic_id = apic_id;
+
         topo_array[*num_cores].logical_index = lp;
-        topo_array[*num_cores].package_id = apic_id >> core_bits;
-        topo_array[*num_cores].core_index = (apic_id & core_mask) >> smt_bits;
-        topo_array[*num_cores].tile_id = (tile_bits > 0) ? (apic_id >> tile_bits) : 0;
-        topo_array[*num_cores].die_id = 0;     // Could extract from higher levels
-        topo_array[*num_cores].module_id = 0;  // Could extract from CPUID 0x1F level 3
-        
+        decode_apic_levels(&topo_array[*num_cores], apic_id, &lp_levels);
+
         // Extract core type from CPUID 0x1A if available (P-core vs E-core, Intel hybrid)
         if (max_leaf >= 0x1A) {
             CPUIDResult r1a;
             read_cpuid(0x1A, 0, &r1a);
-            // Bits 31:24 = core type (0x20=performance/Atom, 0x40=efficiency/Core)
+            // Bits 31:24 = core type (0x20=E-core/Atom, 0x40=P-core/Core)
             topo_array[*num_cores].core_type = (r1a.eax >> 24) & 0xFF;
         } else {
             topo_array[*num_cores].core_type = 0;  // Unknown
         }
         
         (*num_cores)++;
+        trace_end();
     }
     
     // Restore original thread affinity
-    if (original_affinity != 0) {
-        SetThreadAffinityMask(current_thread, original_affinity);
+    if (restore) {
+        SetThreadGroupAffinity(GetCurrentThread(), &original_affinity, NULL);
     }
-    
-    free(buffer);
+    g_replay_lp = 0;
+    return topo_array;
 }
 
 // Derive cache sharing groups from APIC IDs and cache topology
@@ -526,11 +889,113 @@ void derive_cache_sharing_groups(PerCoreTopology* topo_array, int num_cores,
     }
 }
 
-int main(void) {
+static int compare_ints(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Count distinct cache instances in a group-ID array (any group ID range, any core count)
+int count_unique_groups(const int* groups, int count) {
+    if (!groups || count <= 0) return 0;
+    int* sorted = (int*)malloc(count * sizeof(int));
+    if (!sorted) return 0;
+    memcpy(sorted, groups, count * sizeof(int));
+    qsort(sorted, count, sizeof(int), compare_ints);
+    
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        if (sorted[i] >= 0 && (i == 0 || sorted[i] != sorted[i - 1])) unique++;
+    }
+    free(sorted);
+    return unique;
+}
+
+// Order logical processors by package, die group, die, tile, module, core and thread
+static int compare_topology(const void* a, const void* b) {
+    const PerCoreTopology* x = (const PerCoreTopology*)a;
+    const PerCoreTopology* y = (const PerCoreTopology*)b;
+    int keys_x[] = {x->package_id, x->die_group_id, x->die_id, x->tile_id, x->module_id, x->core_id, x->smt_id, x->logical_index};
+    int keys_y[] = {y->package_id, y->die_group_id, y->die_id, y->tile_id, y->module_id, y->core_id, y->smt_id, y->logical_index};
+    for (int i = 0; i < 8; i++) {
+        if (keys_x[i] != keys_y[i]) return (keys_x[i] > keys_y[i]) - (keys_x[i] < keys_y[i]);
+    }
+    return 0;
+}
+
+static int topology_level_id(const PerCoreTopology* t, int type) {
+    switch (type) {
+    case TOPO_LEVEL_DIE_GROUP: return t->die_group_id;
+    case TOPO_LEVEL_DIE: return t->die_id;
+    case TOPO_LEVEL_TILE: return t->tile_id;
+    case TOPO_LEVEL_MODULE: return t->module_id;
+    case TOPO_LEVEL_CORE: return t->core_id;
+    default: return t->package_id;
+    }
+}
+
+// Print the topology as a tree of {"level", "id", "children"} nodes: the package,
+// then every enumerated level above SMT, down to cores listing their logical processors
+static void print_topology_hierarchy(const PerCoreTopology* topo_array, int num_cores, const TopologyLevels* levels) {
+    printf("\"topology_hierarchy\": [");
+    PerCoreTopology* sorted = (PerCoreTopology*)malloc((num_cores > 0 ? num_cores : 1) * sizeof(PerCoreTopology));
+    if (!sorted || !topo_array) num_cores = 0;
+    if (num_cores > 0) {
+        memcpy(sorted, topo_array, num_cores * sizeof(PerCoreTopology));
+        qsort(sorted, num_cores, sizeof(PerCoreTopology), compare_topology);
+    }
+
+    int order[TOPO_LEVEL_COUNT];
+    int depth = 0;
+    order[depth++] = TOPO_LEVEL_INVALID;  // the package
+    for (int type = TOPO_LEVEL_DIE_GROUP; type >= TOPO_LEVEL_CORE; type--) {
+        if (levels->shift[type] >= 0) order[depth++] = type;
+    }
+
+    // Stream the sorted list: close the branches the next LP leaves, open the ones it enters
+    for (int i = 0; i < num_cores; i++) {
+        const PerCoreTopology* t = &sorted[i];
+        int split = i == 0 ? 0 : depth;
+        for (int d = 0; i > 0 && d < depth; d++) {
+            if (topology_level_id(t, order[d]) != topology_level_id(&sorted[i - 1], order[d])) {
+                split = d;
+                break;
+            }
+        }
+        if (i > 0) {
+            for (int d = depth - 1; d >= split; d--) printf("]}");
+        }
+        for (int d = split; d < depth; d++) {
+            if (d == split && i > 0) printf(", ");
+            printf("{\"level\": \"%s\", \"id\": %d", d == 0 ? "package" : g_topo_level_names[order[d]],
+                   topology_level_id(t, order[d]));
+            if (d == depth - 1) printf(", \"core_type\": %d, \"cpus\": [", t->core_type);
+            else printf(", \"children\": [");
+        }
+        printf("%s%d", split == depth ? ", " : "", t->logical_index);
+    }
+    if (num_cores > 0) {
+        for (int d = depth - 1; d >= 0; d--) printf("]}");
+    }
+    printf("], ");
+    free(sorted);
+}
+
+int main(int argc, char* argv[]) {
+    replay_init(argc, argv);
+    trace_init(argc, argv);
+    deadline_init(argc, argv);
+    if (capture_enabled()) {
+        trace_begin("probe", "capture_all_cpuid");
+        capture_all_cpuid();
+        trace_end();
+    }
+    
+    
     int base_mhz = 0, max_mhz = 0, bus_mhz = 0;
     int turbo_supported = 0;
     int success = 0;
     char brand[64] = {0};
+    trace_begin("probe", "frequency_leaves");
     get_brand_string(brand, sizeof(brand));
     
     // Detect vendor for cache handling
@@ -553,6 +1018,9 @@ int main(void) {
         max_mhz  = result.ebx & 0xFFFF;
         bus_mhz  = result.ecx & 0xFFFF;
         
+        if (base_mhz > 0) deadline_source("base_mhz", "cpuid_0x16");
+        if (max_mhz > 0) deadline_source("max_mhz", "cpuid_0x16");
+        if (bus_mhz > 0) deadline_source("bus_mhz", "cpuid_0x16");
         if (base_mhz > 0 && max_mhz > 0) {
             success = 1;
         }
@@ -570,13 +1038,16 @@ int main(void) {
             // Use bus clock from crystal if we don't already have one
             if (bus_mhz == 0) {
                 bus_mhz = (int)(crystal_mhz + 0.5);
+                deadline_source("bus_mhz", "cpuid_0x15");
             }
 
             // If base still missing, use derived value
             if (base_mhz == 0 && derived_base > 0.0) {
                 base_mhz = (int)(derived_base + 0.5);
+                deadline_source("base_mhz", "cpuid_0x15");
                 if (max_mhz == 0) {
                     max_mhz = base_mhz; // conservative
+                    deadline_source("max_mhz", "cpuid_0x15");
                 }
                 success = 1;
             }
@@ -590,22 +1061,49 @@ int main(void) {
         turbo_supported = (result.eax & 0x02) ? 1 : 0;
     }
 
+    trace_end();
+
     // Fallback: parse brand string for base frequency (works on most Intel/AMD)
     if (!success || base_mhz == 0 || max_mhz == 0) {
         int parsed_mhz = 0;
         if (parse_frequency_from_brand(brand, &parsed_mhz) && parsed_mhz > 0) {
-            if (base_mhz == 0) base_mhz = parsed_mhz;
-            if (max_mhz == 0) max_mhz = parsed_mhz;
+            if (base_mhz == 0) {
+                base_mhz = parsed_mhz;
+                deadline_source("base_mhz", "brand_string");
+            }
+            if (max_mhz == 0) {
+                max_mhz = parsed_mhz;
+                deadline_source("max_mhz", "brand_string");
+            }
             success = 1; // treat as successful because brand gives nominal/base
         }
     }
 
     // Final fallback: WMI MaxClockSpeed if still missing
-    if (max_mhz == 0) {
-        int wmi_max = get_max_clock_wmi();
-        if (wmi_max > 0) {
+    // (always queried when capturing so a replay can take the same path)
+    // (skipped when the deadline leaves no room for a COM/WMI round trip, abandoned if it overruns)
+    if (max_mhz == 0 || capture_enabled()) {
+        int wmi_max = 0;
+        trace_begin("probe", "get_max_clock_wmi");
+        if (!replay_enabled() && !deadline_allows(WMI_COST_MS)) {
+            deadline_skip("wmi_max_clock", "budget");
+        } else {
+            int* wmi_result = (int*)calloc(1, sizeof(int));
+            if (wmi_result && deadline_run(wmi_max_clock_worker, wmi_result)) {
+                wmi_max = *wmi_result;
+                free(wmi_result);
+            } else if (wmi_result) {
+                deadline_skip("wmi_max_clock", "timeout");
+            }
+        }
+        trace_end();
+        if (wmi_max > 0 && max_mhz == 0) {
             max_mhz = wmi_max;
-            if (base_mhz == 0) base_mhz = wmi_max; // conservative use same as nominal
+            deadline_source("max_mhz", "wmi");
+            if (base_mhz == 0) {
+                base_mhz = wmi_max; // conservative use same as nominal
+                deadline_source("base_mhz", "wmi");
+            }
             success = 1;
         }
     }
@@ -620,29 +1118,40 @@ int main(void) {
     
     // Cache detection (vendor-specific)
     CacheInfo l1d = {0}, l1i = {0}, l2 = {0}, l3 = {0};
+    trace_begin("probe", "cache_leaves");
     if (vendor == VENDOR_INTEL) {
         detect_intel_caches(&l1d, &l1i, &l2, &l3);
+        deadline_source("caches", "cpuid_0x4");
     } else if (vendor == VENDOR_AMD) {
         detect_amd_caches(&l1d, &l1i, &l2, &l3);
+        deadline_source("caches", "cpuid_0x80000005");
     }
+    trace_end();
     
     // APIC topology detection
-    PerCoreTopology topo_array[256] = {0};
     int num_logical_cores = 0;
-    detect_apic_topology(topo_array, &num_logical_cores);
+    TopologyLevels topo_levels;
+    memset(&topo_levels, 0, sizeof(topo_levels));
+    for (int type = 0; type < TOPO_LEVEL_COUNT; type++) topo_levels.shift[type] = -1;
+    trace_begin("probe", "detect_apic_topology");
+    PerCoreTopology* topo_array = detect_apic_topology(&num_logical_cores, &topo_levels);
+    trace_end();
     
     // Derive cache sharing groups
     int* l1d_groups = NULL;
     int* l2_groups = NULL;
     int* l3_groups = NULL;
+    trace_begin("parse", "derive_cache_sharing_groups");
     derive_cache_sharing_groups(topo_array, num_logical_cores, l1d, l2, l3,
                                 &l1d_groups, &l2_groups, &l3_groups);
+    trace_end();
 
     // Get turbo ratio limits (CPUID 0x16)
     int turbo_base = 0, turbo_1c = 0, turbo_ac = 0;
     int turbo_ratios_available = get_turbo_ratios(&turbo_base, &turbo_1c, &turbo_ac);
     
     // Output JSON format
+    trace_begin("output", "emit_json");
     printf("{");
     printf("\"base_mhz\": %d, ", base_mhz);
     printf("\"max_mhz\": %d, ", max_mhz);
@@ -704,6 +1213,7 @@ int main(void) {
         printf("\"l3_cores_sharing\": %d, ", l3.cores_sharing);
         printf("\"l3_inclusive\": %d, ", l3.is_inclusive);
     }
+    print_cpu_features();
     printf("\"max_cpuid_leaf\": %d, ", max_leaf);
     printf("\"num_logical_cores\": %d, ", num_logical_cores);
     
@@ -711,46 +1221,44 @@ int main(void) {
     printf("\"apic_ids\": [");
     for (int i = 0; i < num_logical_cores; i++) {
         if (i > 0) printf(", ");
-        printf("{\"index\": %d, \"apic\": %d, \"core_type\": %d, \"l1d_group\": %d, \"l2_group\": %d, \"l3_group\": %d}", 
+        printf("{\"index\": %d, \"apic\": %d, \"core_type\": %d, \"l1d_group\": %d, \"l2_group\": %d, \"l3_group\": %d, ", 
                topo_array[i].logical_index, 
                topo_array[i].apic_id, 
                topo_array[i].core_type,
                l1d_groups ? l1d_groups[i] : -1,
                l2_groups ? l2_groups[i] : -1,
                l3_groups ? l3_groups[i] : -1);
+        printf("\"package\": %d, \"die_group\": %d, \"die\": %d, \"tile\": %d, \"module\": %d, \"core\": %d, \"smt\": %d}",
+               topo_array[i].package_id,
+               topo_array[i].die_group_id,
+               topo_array[i].die_id,
+               topo_array[i].tile_id,
+               topo_array[i].module_id,
+               topo_array[i].core_id,
+               topo_array[i].smt_id);
     }
     printf("], ");
+
+    // Enumerated CPUID 0xB/0x1F levels, lowest first, and the tree they form
+    if (topo_levels.leaf) printf("\"topology_leaf\": \"0x%x\", ", topo_levels.leaf);
+    else printf("\"topology_leaf\": null, ");
+    printf("\"topology_levels\": [");
+    int printed_levels = 0;
+    for (int type = TOPO_LEVEL_SMT; type < TOPO_LEVEL_COUNT; type++) {
+        if (topo_levels.shift[type] < 0) continue;
+        printf("%s{\"level\": \"%s\", \"shift\": %d, \"logical_processors\": %d}", printed_levels++ ? ", " : "",
+               g_topo_level_names[type], topo_levels.shift[type], topo_levels.processors[type]);
+    }
+    printf("], ");
+    print_topology_hierarchy(topo_array, num_logical_cores, &topo_levels);
     
     // Output cache sharing group summary
     // Count unique groups for each cache level
     int l1d_unique = 0, l2_unique = 0, l3_unique = 0;
     if (l1d_groups && l2_groups && l3_groups) {
-        // Count unique L1D groups
-        int seen_l1d[256] = {0};
-        for (int i = 0; i < num_logical_cores; i++) {
-            if (l1d_groups[i] >= 0 && l1d_groups[i] < 256 && !seen_l1d[l1d_groups[i]]) {
-                seen_l1d[l1d_groups[i]] = 1;
-                l1d_unique++;
-            }
-        }
-        
-        // Count unique L2 groups
-        int seen_l2[256] = {0};
-        for (int i = 0; i < num_logical_cores; i++) {
-            if (l2_groups[i] >= 0 && l2_groups[i] < 256 && !seen_l2[l2_groups[i]]) {
-                seen_l2[l2_groups[i]] = 1;
-                l2_unique++;
-            }
-        }
-        
-        // Count unique L3 groups
-        int seen_l3[256] = {0};
-        for (int i = 0; i < num_logical_cores; i++) {
-            if (l3_groups[i] >= 0 && l3_groups[i] < 256 && !seen_l3[l3_groups[i]]) {
-                seen_l3[l3_groups[i]] = 1;
-                l3_unique++;
-            }
-        }
+        l1d_unique = count_unique_groups(l1d_groups, num_logical_cores);
+        l2_unique = count_unique_groups(l2_groups, num_logical_cores);
+        l3_unique = count_unique_groups(l3_groups, num_logical_cores);
     }
     
     printf("\"cache_sharing\": {");
@@ -759,10 +1267,14 @@ int main(void) {
     printf("\"l3_instances\": %d", l3_unique);
     printf("}, ");
     
+    deadline_print_json();
     printf("\"success\": %d", success);
     printf("}\n");
     
+    trace_end();
+    
     // Cleanup
+    if (topo_array) free(topo_array);
     if (l1d_groups) free(l1d_groups);
     if (l2_groups) free(l2_groups);
     if (l3_groups) free(l3_groups);
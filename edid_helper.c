@@ -5,6 +5,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include "helper_replay.h"
+#include "helper_trace.h"
+#include "helper_deadline.h"
 
 #pragma comment(lib, "setupapi.lib")
 #pragma comment(lib, "cfgmgr32.lib")
@@ -191,6 +194,11 @@ void enumerate_edid_from_registry() {
     int first = 1;
     
     while (1) {
+        if (deadline_expired()) {
+            deadline_skip("edid_displays", "budget");
+            deadline_truncate("edid_devices");
+            break;
+        }
         display_id_size = sizeof(display_id);
         ret = RegEnumKeyExA(hkeyDevEnum, index, display_id, &display_id_size, 
                             NULL, NULL, NULL, NULL);
@@ -216,23 +224,32 @@ void enumerate_edid_from_registry() {
                 
                 if (ret != ERROR_SUCCESS) break;
                 
-                // Read EDID value
+                // Read EDID value (stored under the instance's "Device Parameters" key)
                 HKEY hkeyMonitor = NULL;
                 CHAR monitor_path[512];
-                sprintf(monitor_path, "SYSTEM\\CurrentControlSet\\Enum\\DISPLAY\\%s\\%s", 
+                sprintf(monitor_path, "SYSTEM\\CurrentControlSet\\Enum\\DISPLAY\\%s\\%s\\Device Parameters", 
                         display_id, monitor_id);
                 
                 ret = RegOpenKeyExA(HKEY_LOCAL_MACHINE, monitor_path, 0, KEY_READ, &hkeyMonitor);
                 if (ret == ERROR_SUCCESS) {
-                    BYTE edid_data[256];
+                    // Base block plus extension blocks
+                    BYTE edid_data[1024];
                     DWORD edid_size = sizeof(edid_data);
                     
+                    trace_begin("syscall", "RegQueryValueExA");
                     ret = RegQueryValueExA(hkeyMonitor, "EDID", NULL, NULL, 
                                           edid_data, &edid_size);
+                    trace_end();
                     
                     if (ret == ERROR_SUCCESS && edid_size > 0) {
+                        CHAR capture_rel[600];
+                        snprintf(capture_rel, sizeof(capture_rel), "edid/%s/%s.bin", display_id, monitor_id);
+                        capture_write_file(capture_rel, edid_data, edid_size);
+                        
                         if (!first) printf(",\n");
+                        trace_begin("parse", "parse_edid_to_json");
                         parse_edid_to_json(edid_data, edid_size, display_id);
+                        trace_end();
                         first = 0;
                     }
                     
@@ -251,13 +268,80 @@ void enumerate_edid_from_registry() {
     RegCloseKey(hkeyDevEnum);
 }
 
-int main() {
+// Replay: walk edid/<display>/<monitor>.bin in place of the DISPLAY registry tree
+typedef struct {
+    char display_id[256];
+    int first;
+} EdidReplayWalk;
+
+static int replay_monitor_cb(const char* name, int is_dir, void* ctx) {
+    EdidReplayWalk* walk = (EdidReplayWalk*)ctx;
+    if (is_dir) return 0;
+    
+    char rel[600];
+    snprintf(rel, sizeof(rel), "edid/%s/%s", walk->display_id, name);
+    size_t edid_size = 0;
+    trace_begin("syscall", "replay_read_edid");
+    BYTE* edid_data = replay_read_file(rel, &edid_size);
+    trace_end();
+    if (!edid_data) return 0;
+    
+    if (edid_size > 0) {
+        if (!walk->first) printf(",\n");
+        trace_begin("parse", "parse_edid_to_json");
+        parse_edid_to_json(edid_data, edid_size, walk->display_id);
+        trace_end();
+        walk->first = 0;
+    }
+    free(edid_data);
+    return 0;
+}
+
+static int replay_display_cb(const char* name, int is_dir, void* ctx) {
+    EdidReplayWalk* walk = (EdidReplayWalk*)ctx;
+    if (deadline_expired()) {
+        deadline_skip("edid_displays", "budget");
+        deadline_truncate("edid_devices");
+        return 1;
+    }
+    if (!is_dir) return 0;
+    
+    char rel[300];
+    strncpy(walk->display_id, name, sizeof(walk->display_id) - 1);
+    snprintf(rel, sizeof(rel), "edid/%s", name);
+    replay_list_dir(rel, replay_monitor_cb, walk);
+    return 0;
+}
+
+void enumerate_edid_from_replay() {
+    EdidReplayWalk walk;
+    memset(&walk, 0, sizeof(walk));
+    walk.first = 1;
+    replay_list_dir("edid", replay_display_cb, &walk);
+}
+
+int main(int argc, char* argv[]) {
+    replay_init(argc, argv);
+    trace_init(argc, argv);
+    deadline_init(argc, argv);
+    
     printf("{\n");
     printf("  \"edid_devices\": [\n");
     
-    enumerate_edid_from_registry();
+    const char* source = replay_enabled() ? "replay" : "registry";
+    trace_begin("probe", "enumerate_edid");
+    if (replay_enabled()) {
+        enumerate_edid_from_replay();
+    } else {
+        enumerate_edid_from_registry();
+    }
+    trace_end();
+    deadline_source("edid_devices", source);
     
-    printf("\n  ]\n");
+    printf("\n  ],\n");
+    printf("  ");
+    deadline_print_json();
+    printf("\"method\": \"%s\"\n", source);
     printf("}\n");
     
     return 0;
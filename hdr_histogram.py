@@ -0,0 +1,180 @@
+"""
+HDR Histogram - Python side of hdr_histogram.h
+
+Decodes the "histogram" strings the native benchmarks and the telemetry
+sampler write, merges them (e.g. per host into a fleet distribution) and
+answers percentile queries with the same bucket layout and rounding as the
+C code, so a merged p99 matches what one big native histogram would report.
+
+    from hdr_histogram import HdrHistogram
+    total = HdrHistogram.decode(result['latency']['histogram'])
+    total.merge(HdrHistogram.decode(other['latency']['histogram']))
+    print(total.value_at(99.9), total.summary())
+"""
+
+import base64
+
+FORMAT_VERSION = 1
+SUMMARY_PERCENTILES = (('p50', 50.0), ('p90', 90.0), ('p99', 99.0), ('p99_9', 99.9), ('p99_99', 99.99))
+
+
+def _varints(data):
+    value = shift = 0
+    for byte in data:
+        value |= (byte & 0x7f) << shift
+        shift += 7
+        if not byte & 0x80:
+            yield (value >> 1) ^ -(value & 1)   # ZigZag
+            value = shift = 0
+    if shift:
+        raise ValueError('truncated histogram')
+
+
+def _varint_bytes(value):
+    zz = (value << 1) ^ (value >> 63)
+    zz &= (1 << 64) - 1
+    out = bytearray()
+    while True:
+        byte = zz & 0x7f
+        zz >>= 7
+        out.append(byte | (0x80 if zz else 0))
+        if not zz:
+            return bytes(out)
+
+
+class HdrHistogram:
+    """Log-linear histogram: 2**precision_bits buckets per power of two"""
+
+    def __init__(self, highest, precision_bits=7):
+        if not 1 <= precision_bits <= 14 or highest < 1:
+            raise ValueError('precision_bits must be 1-14 and highest at least 1')
+        self.precision_bits = precision_bits
+        self.highest = highest
+        self.counts = [0] * (self._index(highest) + 1)
+        self.total = self.sum = self.clamped = self.max = 0
+        self.min = None
+
+    def _index(self, value):
+        sub = 1 << self.precision_bits
+        if value < sub:
+            return value
+        shift = value.bit_length() - 1 - self.precision_bits
+        return (shift + 1) * sub + ((value >> shift) - sub)
+
+    def bucket_range(self, index):
+        """(lowest, highest) value of bucket 'index'"""
+        sub = 1 << self.precision_bits
+        if index < sub:
+            return index, index
+        shift = index // sub - 1
+        low = (sub + index % sub) << shift
+        return low, low + (1 << shift) - 1
+
+    def record(self, value, count=1):
+        value = int(value)
+        if value > self.highest:
+            value = self.highest
+            self.clamped += count
+        self.counts[self._index(value)] += count
+        self.total += count
+        self.sum += value * count
+        self.min = value if self.min is None else min(self.min, value)
+        self.max = max(self.max, value)
+
+    def merge(self, other):
+        if other.precision_bits != self.precision_bits:
+            raise ValueError('histograms have different precision')
+        shared = min(len(self.counts), len(other.counts))
+        for i in range(shared):
+            self.counts[i] += other.counts[i]
+        overflow = sum(other.counts[shared:])
+        self.counts[-1] += overflow
+        self.clamped += overflow + other.clamped
+        self.total += other.total
+        self.sum += other.sum
+        if other.total:
+            self.min = other.min if self.min is None else min(self.min, other.min)
+        self.max = max(self.max, min(other.max, self.highest))
+        return self
+
+    def value_at(self, percentile):
+        """Highest value equivalent to the bucket holding 'percentile' (0-100), capped at max"""
+        if not self.total:
+            return 0
+        if percentile <= 0:
+            return self.min
+        rank = max(int(percentile / 100.0 * self.total + 0.5), 1)
+        if rank >= self.total:
+            return self.max
+        seen = 0
+        for index, count in enumerate(self.counts):
+            seen += count
+            if seen >= rank:
+                return min(self.bucket_range(index)[1], self.max)
+        return self.max
+
+    def mean(self):
+        return self.sum / self.total if self.total else 0.0
+
+    def summary(self):
+        """The same fields hdr_json() writes, except the encoded histogram"""
+        result = {'count': self.total, 'min': self.min or 0, 'mean': round(self.mean(), 1)}
+        result.update((name, self.value_at(p)) for name, p in SUMMARY_PERCENTILES)
+        result['max'] = self.max
+        if self.clamped:
+            result['clamped'] = self.clamped
+        return result
+
+    def encode(self):
+        header = (FORMAT_VERSION, self.precision_bits, len(self.counts), self.highest, self.total,
+                  self.min or 0, self.max, self.sum, self.clamped)
+        out = bytearray(b''.join(_varint_bytes(v) for v in header))
+        zeros = 0
+        for count in self.counts:
+            if count:
+                if zeros:
+                    out += _varint_bytes(-zeros)
+                    zeros = 0
+                out += _varint_bytes(count)
+            else:
+                zeros += 1
+        if zeros:
+            out += _varint_bytes(-zeros)
+        return base64.b64encode(bytes(out)).decode('ascii')
+
+    @classmethod
+    def decode(cls, text):
+        values = _varints(base64.b64decode(text))
+        try:
+            header = [next(values) for _ in range(9)]
+        except StopIteration:
+            raise ValueError('truncated histogram') from None
+        version, precision_bits, bucket_count, highest, total, low, high, total_sum, clamped = header
+        if version != FORMAT_VERSION:
+            raise ValueError(f'unsupported histogram version {version}')
+        hist = cls(highest & ((1 << 64) - 1), precision_bits)
+        if len(hist.counts) != bucket_count:
+            raise ValueError('histogram layout mismatch')
+        index = 0
+        for value in values:
+            if value < 0:
+                index -= value
+            elif index < bucket_count:
+                hist.counts[index] = value
+                index += 1
+        hist.total, hist.max, hist.sum, hist.clamped = total, high, total_sum, clamped
+        hist.min = low if total else None
+        return hist
+
+
+def decode(text):
+    return HdrHistogram.decode(text)
+
+
+def merge(encoded_histograms):
+    """Merge several encoded histograms into one HdrHistogram (None if the list is empty)"""
+    result = None
+    for text in encoded_histograms:
+        hist = HdrHistogram.decode(text)
+        result = hist if result is None else result.merge(hist)
+    return result
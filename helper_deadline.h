@@ -0,0 +1,277 @@
+/*
+ * Helper Deadline - per-probe time budget shared by the native helpers
+ *
+ *   --deadline-ms N   finish within N milliseconds of start-up: expensive
+ *                     sources are skipped when their estimated cost no longer
+ *                     fits, slow calls are abandoned when the budget runs out,
+ *                     and whatever was collected is still printed
+ *
+ * Every helper reports where each field came from and what was cut short:
+ *
+ *   "sources": {"max_mhz": "cpuid_0x16", ...},
+ *   "skipped": [{"probe": "wmi_max_clock", "reason": "budget"}],
+ *   "truncated_fields": ["apic_ids"],
+ *   "truncated": true, "deadline_ms": 4000, "elapsed_ms": 3998.2
+ *
+ * A skipped probe leaves its fields out (or to a slower source's value in
+ * "sources"); a field in "truncated_fields" is present but partial, e.g. a
+ * list that stopped early. "truncated" is true if anything at all was cut.
+ *
+ * Usage:
+ *   deadline_init(argc, argv);
+ *   if (deadline_allows(WMI_COST_MS)) {
+ *       if (!deadline_run(wmi_worker, job)) deadline_skip("wmi_max_clock", "timeout");
+ *   } else {
+ *       deadline_skip("wmi_max_clock", "budget");
+ *   }
+ *   deadline_source("max_mhz", "wmi");
+ *   for (...) { if (deadline_expired()) { deadline_truncate("apic_ids"); break; } ... }
+ *   ...
+ *   deadline_print_json();   // inside the top-level JSON object
+ */
+
+#ifndef HELPER_DEADLINE_H
+#define HELPER_DEADLINE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#endif
+
+#define DEADLINE_MAX_SOURCES 64
+#define DEADLINE_MAX_SKIPPED 32
+
+typedef struct {
+    const char* field;   // static strings only: stored by pointer
+    const char* source;
+} DeadlineSource;
+
+static double g_deadline_ms = 0.0;   // 0 = no deadline
+static double g_deadline_start_ms = 0.0;
+static int g_deadline_truncated = 0;
+static DeadlineSource g_deadline_sources[DEADLINE_MAX_SOURCES];
+static int g_deadline_source_count = 0;
+static DeadlineSource g_deadline_skipped[DEADLINE_MAX_SKIPPED];
+static int g_deadline_skipped_count = 0;
+static const char* g_deadline_truncated_fields[DEADLINE_MAX_SOURCES];
+static int g_deadline_truncated_field_count = 0;
+
+static inline double deadline_clock_ms(void) {
+#ifdef _WIN32
+    LARGE_INTEGER now, freq;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&freq);
+    return (double)now.QuadPart * 1000.0 / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+#endif
+}
+
+// Pick up --deadline-ms N from the command line (other flags are ignored)
+static inline void deadline_init(int argc, char* argv[]) {
+    g_deadline_start_ms = deadline_clock_ms();
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--deadline-ms") == 0) {
+            g_deadline_ms = atof(argv[++i]);
+            if (g_deadline_ms < 0) g_deadline_ms = 0;
+        }
+    }
+}
+
+static inline int deadline_enabled(void) { return g_deadline_ms > 0; }
+
+static inline double deadline_elapsed_ms(void) {
+    return deadline_clock_ms() - g_deadline_start_ms;
+}
+
+// Milliseconds left in the budget (a very large value when there is no deadline)
+static inline double deadline_remaining_ms(void) {
+    if (!deadline_enabled()) return 1e12;
+    double left = g_deadline_ms - deadline_elapsed_ms();
+    return left > 0 ? left : 0;
+}
+
+// True once the budget is spent; marks the output truncated
+static inline int deadline_expired(void) {
+    if (deadline_remaining_ms() > 0) return 0;
+    g_deadline_truncated = 1;
+    return 1;
+}
+
+// True if a source estimated to cost 'cost_ms' still fits in the budget
+static inline int deadline_allows(double cost_ms) {
+    return deadline_remaining_ms() >= cost_ms;
+}
+
+// Record which source produced a field (last call for a field wins)
+static inline void deadline_source(const char* field, const char* source) {
+    for (int i = 0; i < g_deadline_source_count; i++) {
+        if (strcmp(g_deadline_sources[i].field, field) == 0) {
+            g_deadline_sources[i].source = source;
+            return;
+        }
+    }
+    if (g_deadline_source_count < DEADLINE_MAX_SOURCES) {
+        g_deadline_sources[g_deadline_source_count].field = field;
+        g_deadline_sources[g_deadline_source_count].source = source;
+        g_deadline_source_count++;
+    }
+}
+
+// Record a probe that was not run ("budget") or abandoned ("timeout"); marks the output truncated
+static inline void deadline_skip(const char* probe, const char* reason) {
+    g_deadline_truncated = 1;
+    if (g_deadline_skipped_count < DEADLINE_MAX_SKIPPED) {
+        g_deadline_skipped[g_deadline_skipped_count].field = probe;
+        g_deadline_skipped[g_deadline_skipped_count].source = reason;
+        g_deadline_skipped_count++;
+    }
+}
+
+// Record a field that is present but partial, e.g. a list that stopped early;
+// marks the output truncated
+static inline void deadline_truncate(const char* field) {
+    g_deadline_truncated = 1;
+    for (int i = 0; i < g_deadline_truncated_field_count; i++) {
+        if (strcmp(g_deadline_truncated_fields[i], field) == 0) return;
+    }
+    if (g_deadline_truncated_field_count < DEADLINE_MAX_SOURCES) {
+        g_deadline_truncated_fields[g_deadline_truncated_field_count++] = field;
+    }
+}
+
+typedef void (*deadline_fn)(void* ctx);
+
+typedef struct {
+    deadline_fn fn;
+    void* ctx;
+#ifndef _WIN32
+    pthread_mutex_t lock;
+    pthread_cond_t done_cond;
+    int done;
+#endif
+} DeadlineJob;
+
+#ifdef _WIN32
+static inline DWORD WINAPI deadline_thread(LPVOID param) {
+    DeadlineJob* job = (DeadlineJob*)param;
+    job->fn(job->ctx);
+    return 0;
+}
+#else
+static inline void* deadline_thread(void* param) {
+    DeadlineJob* job = (DeadlineJob*)param;
+    job->fn(job->ctx);
+    pthread_mutex_lock(&job->lock);
+    job->done = 1;
+    pthread_cond_signal(&job->done_cond);
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+#endif
+
+// Run fn(ctx) on a worker thread and wait at most for the remaining budget.
+// Returns 1 if fn finished. Returns 0 if it was abandoned: the worker keeps
+// running until the process exits, so ctx (and anything fn touches) must stay
+// valid - callers leak it instead of freeing it.
+static inline int deadline_run(deadline_fn fn, void* ctx) {
+    if (!deadline_enabled()) {
+        fn(ctx);
+        return 1;
+    }
+    if (deadline_expired()) return 0;
+
+    DeadlineJob* job = (DeadlineJob*)calloc(1, sizeof(DeadlineJob));
+    if (!job) {
+        fn(ctx);
+        return 1;
+    }
+    job->fn = fn;
+    job->ctx = ctx;
+
+#ifdef _WIN32
+    HANDLE thread = CreateThread(NULL, 0, deadline_thread, job, 0, NULL);
+    if (!thread) {
+        free(job);
+        fn(ctx);
+        return 1;
+    }
+    DWORD wait = WaitForSingleObject(thread, (DWORD)(deadline_remaining_ms() + 0.5));
+    CloseHandle(thread);
+    if (wait != WAIT_OBJECT_0) {
+        g_deadline_truncated = 1;
+        return 0;   // job stays allocated for the abandoned worker
+    }
+    free(job);
+    return 1;
+#else
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->done_cond, NULL);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, deadline_thread, job) != 0) {
+        free(job);
+        fn(ctx);
+        return 1;
+    }
+
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    double wait_ms = deadline_remaining_ms();
+    until.tv_sec += (time_t)(wait_ms / 1000.0);
+    until.tv_nsec += (long)((wait_ms - (double)(long)(wait_ms / 1000.0) * 1000.0) * 1e6);
+    if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+
+    int rc = 0;
+    pthread_mutex_lock(&job->lock);
+    while (!job->done && rc != ETIMEDOUT) {
+        rc = pthread_cond_timedwait(&job->done_cond, &job->lock, &until);
+    }
+    int finished = job->done;
+    pthread_mutex_unlock(&job->lock);
+
+    if (!finished) {
+        pthread_detach(thread);
+        g_deadline_truncated = 1;
+        return 0;
+    }
+    pthread_join(thread, NULL);
+    free(job);
+    return 1;
+#endif
+}
+
+// Print the "sources", "skipped", "truncated_fields", "truncated",
+// "deadline_ms" and "elapsed_ms" members followed by ", " so the caller can continue the object
+static inline void deadline_print_json(void) {
+    printf("\"sources\": {");
+    for (int i = 0; i < g_deadline_source_count; i++) {
+        printf("%s\"%s\": \"%s\"", i ? ", " : "",
+               g_deadline_sources[i].field, g_deadline_sources[i].source);
+    }
+    printf("}, \"skipped\": [");
+    for (int i = 0; i < g_deadline_skipped_count; i++) {
+        printf("%s{\"probe\": \"%s\", \"reason\": \"%s\"}", i ? ", " : "",
+               g_deadline_skipped[i].field, g_deadline_skipped[i].source);
+    }
+    printf("], \"truncated_fields\": [");
+    for (int i = 0; i < g_deadline_truncated_field_count; i++) {
+        printf("%s\"%s\"", i ? ", " : "", g_deadline_truncated_fields[i]);
+    }
+    printf("], \"truncated\": %s, ", g_deadline_truncated ? "true" : "false");
+    printf("\"deadline_ms\": %.0f, \"elapsed_ms\": %.1f, ", g_deadline_ms, deadline_elapsed_ms());
+}
+
+#endif // HELPER_DEADLINE_H
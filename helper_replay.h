@@ -0,0 +1,180 @@
+/*
+ * Helper Replay - capture/replay roots shared by the native helpers
+ *
+ *   --capture DIR   collect from the live host as usual, and also copy every
+ *                   raw input the helper reads (firmware tables, CPUID dumps,
+ *                   IOCTL payloads, registry blobs) into DIR
+ *   --replay DIR    read those raw inputs back from DIR instead of the host,
+ *                   so the unchanged parsing code runs against a captured
+ *                   (or synthesized) machine
+ *
+ * Layout under the root (shared with capture_host.py):
+ *   smbios/RSMB.bin                  GetSystemFirmwareTable('RSMB') payload
+ *   acpi/<SIG>.bin                   ACPI tables
+ *   cpuid/cpu<N>.txt                 "leaf subleaf eax ebx ecx edx" (hex) per line
+ *   wmi/<Class>.<Property>.txt       WMI scalars used as fallbacks
+ *   nvme/PhysicalDrive<N>/<name>.bin storage descriptor and NVMe log pages
+ *   edid/<display>/<monitor>.bin     raw EDID blocks
+ *   sys/..., proc/...                Linux sysfs/procfs files
+ */
+
+#ifndef HELPER_REPLAY_H
+#define HELPER_REPLAY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#endif
+
+#define REPLAY_PATH_MAX 1024
+
+static char g_replay_root[REPLAY_PATH_MAX] = {0};
+static char g_capture_root[REPLAY_PATH_MAX] = {0};
+
+// Pick up --replay/--capture from the command line (other flags are ignored)
+static inline void replay_init(int argc, char* argv[]) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--replay") == 0) {
+            strncpy(g_replay_root, argv[++i], sizeof(g_replay_root) - 1);
+        } else if (strcmp(argv[i], "--capture") == 0) {
+            strncpy(g_capture_root, argv[++i], sizeof(g_capture_root) - 1);
+        }
+    }
+    // Replay wins: capturing a replayed host would only copy the root onto itself
+    if (g_replay_root[0]) g_capture_root[0] = '\0';
+}
+
+static inline int replay_enabled(void) { return g_replay_root[0] != '\0'; }
+static inline int capture_enabled(void) { return g_capture_root[0] != '\0'; }
+
+// Map a root-relative path to a full path (forward slashes work on Windows too).
+// Returns 0 and leaves 'out' empty, so opening it fails, if the path does not fit.
+static inline int replay_join(char* out, size_t out_size, const char* root, const char* rel) {
+    int len = snprintf(out, out_size, "%s/%s", root, rel);
+    if (len < 0 || (size_t)len >= out_size) {
+        out[0] = '\0';
+        return 0;
+    }
+    return 1;
+}
+
+// Resolve an absolute host path ("/sys/...", "/proc/...") against the replay root.
+// Returns the host path unchanged when not replaying.
+static inline const char* replay_host_path(const char* abs_path, char* buf, size_t buf_size) {
+    if (!replay_enabled()) return abs_path;
+    while (*abs_path == '/') abs_path++;
+    replay_join(buf, buf_size, g_replay_root, abs_path);
+    return buf;
+}
+
+// Read a whole file from the replay root. Caller frees; NULL if missing.
+static inline unsigned char* replay_read_file(const char* rel, size_t* size_out) {
+    char path[REPLAY_PATH_MAX];
+    replay_join(path, sizeof(path), g_replay_root, rel);
+
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    // One spare byte so text files can be NUL-terminated by the caller
+    unsigned char* data = (unsigned char*)malloc((size_t)size + 1);
+    if (!data) {
+        fclose(f);
+        return NULL;
+    }
+    size_t got = fread(data, 1, (size_t)size, f);
+    fclose(f);
+    data[got] = 0;
+
+    if (size_out) *size_out = got;
+    return data;
+}
+
+// Create every missing directory along 'path' (the last component is a file)
+static inline void replay_make_parents(const char* path) {
+    char tmp[REPLAY_PATH_MAX];
+    strncpy(tmp, path, sizeof(tmp) - 1);
+    tmp[sizeof(tmp) - 1] = '\0';
+
+    for (char* p = tmp + 1; *p; p++) {
+        if (*p != '/' && *p != '\\') continue;
+        char saved = *p;
+        *p = '\0';
+#ifdef _WIN32
+        CreateDirectoryA(tmp, NULL);
+#else
+        mkdir(tmp, 0755);
+#endif
+        *p = saved;
+    }
+}
+
+// Write a raw input under the capture root; no-op unless capturing
+static inline int capture_write_file(const char* rel, const void* data, size_t size) {
+    if (!capture_enabled() || !data) return 0;
+
+    char path[REPLAY_PATH_MAX];
+    replay_join(path, sizeof(path), g_capture_root, rel);
+    replay_make_parents(path);
+
+    FILE* f = fopen(path, "wb");
+    if (!f) return 0;
+    size_t written = fwrite(data, 1, size, f);
+    fclose(f);
+    return written == size;
+}
+
+// Call cb(name, is_dir, ctx) for each entry of a replay directory.
+// Stops early when cb returns non-zero; returns the number of entries visited.
+typedef int (*replay_dir_cb)(const char* name, int is_dir, void* ctx);
+
+static inline int replay_list_dir(const char* rel, replay_dir_cb cb, void* ctx) {
+    char path[REPLAY_PATH_MAX];
+    int visited = 0;
+    replay_join(path, sizeof(path), g_replay_root, rel);
+
+#ifdef _WIN32
+    char pattern[REPLAY_PATH_MAX];
+    WIN32_FIND_DATAA fd;
+    if (!replay_join(pattern, sizeof(pattern), path, "*")) return 0;
+    HANDLE h = FindFirstFileA(pattern, &fd);
+    if (h == INVALID_HANDLE_VALUE) return 0;
+    do {
+        if (strcmp(fd.cFileName, ".") == 0 || strcmp(fd.cFileName, "..") == 0) continue;
+        visited++;
+        if (cb(fd.cFileName, (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0, ctx)) break;
+    } while (FindNextFileA(h, &fd));
+    FindClose(h);
+#else
+    DIR* dir = opendir(path);
+    if (!dir) return 0;
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+        char child[REPLAY_PATH_MAX];
+        struct stat st;
+        int is_dir = replay_join(child, sizeof(child), path, ent->d_name) &&
+                     stat(child, &st) == 0 && S_ISDIR(st.st_mode);
+        visited++;
+        if (cb(ent->d_name, is_dir, ctx)) break;
+    }
+    closedir(dir);
+#endif
+    return visited;
+}
+
+#endif // HELPER_REPLAY_H
@@ -0,0 +1,296 @@
+/*
+ * Helper Trace - Chrome/Perfetto trace-event output for the native helpers
+ *
+ *   --trace FILE    record begin/end spans for every probe, syscall batch and
+ *                   parse stage, and write them to FILE as trace-event JSON
+ *                   when the helper exits (open in chrome://tracing or
+ *                   ui.perfetto.dev)
+ *
+ * Each thread appends to its own chunked buffer; buffers are linked into a
+ * global list with a compare-and-swap on first use, so recording never takes
+ * a lock. Timestamps come from QueryPerformanceCounter / CLOCK_MONOTONIC, the
+ * same clocks as Python's time.perf_counter(), so main.py can merge helper
+ * traces with its own spans on one timeline.
+ *
+ * Usage:
+ *   trace_init(argc, argv);
+ *   trace_begin("probe", "detect_apic_topology");
+ *   trace_begin_arg("syscall", "pin_to_logical_processor", "lp", lp);
+ *   trace_end();
+ *   trace_end();
+ */
+
+#ifndef HELPER_TRACE_H
+#define HELPER_TRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL __thread
+#endif
+
+#define TRACE_PATH_MAX 1024
+#define TRACE_CHUNK_EVENTS 4096
+#define TRACE_MAX_EVENTS (1 << 20)   // per thread; later events are counted as dropped
+
+typedef struct {
+    const char* cat;       // static strings only: stored by pointer
+    const char* name;
+    const char* arg_name;  // NULL when the event has no argument
+    int64_t arg;
+    uint64_t ticks;
+    char phase;            // 'B' or 'E'
+} TraceEvent;
+
+typedef struct TraceChunk {
+    TraceEvent events[TRACE_CHUNK_EVENTS];
+    volatile long count;   // published with release ordering after the event is written
+    struct TraceChunk* next;
+} TraceChunk;
+
+typedef struct TraceThread {
+    uint64_t tid;
+    TraceChunk* first;
+    TraceChunk* last;
+    long total;
+    long dropped;
+    struct TraceThread* volatile next;
+} TraceThread;
+
+static char g_trace_path[TRACE_PATH_MAX] = {0};
+static char g_trace_process[64] = "helper";
+static TraceThread* volatile g_trace_threads = NULL;
+static TRACE_THREAD_LOCAL TraceThread* t_trace_thread = NULL;
+
+static inline int trace_enabled(void) { return g_trace_path[0] != '\0'; }
+
+static inline uint64_t trace_now_ticks(void) {
+#ifdef _WIN32
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (uint64_t)now.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Ticks per second of trace_now_ticks()
+static inline uint64_t trace_tick_rate(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    return (uint64_t)freq.QuadPart;
+#else
+    return 1000000000ull;
+#endif
+}
+
+static inline uint64_t trace_thread_id(void) {
+#ifdef _WIN32
+    return (uint64_t)GetCurrentThreadId();
+#elif defined(__linux__)
+    return (uint64_t)syscall(SYS_gettid);
+#else
+    return (uint64_t)(uintptr_t)pthread_self();
+#endif
+}
+
+static inline uint64_t trace_process_id(void) {
+#ifdef _WIN32
+    return (uint64_t)GetCurrentProcessId();
+#else
+    return (uint64_t)getpid();
+#endif
+}
+
+static inline void trace_publish(volatile long* slot, long value) {
+#ifdef _WIN32
+    InterlockedExchange(slot, value);
+#else
+    __atomic_store_n(slot, value, __ATOMIC_RELEASE);
+#endif
+}
+
+static inline long trace_observe(volatile long* slot) {
+#ifdef _WIN32
+    return InterlockedCompareExchange(slot, 0, 0);
+#else
+    return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// Push a new thread buffer onto the global list (lock-free)
+static inline void trace_register_thread(TraceThread* thread) {
+    TraceThread* head;
+    do {
+        head = g_trace_threads;
+        thread->next = head;
+#ifdef _WIN32
+    } while (InterlockedCompareExchangePointer((PVOID volatile*)&g_trace_threads, thread, head) != head);
+#else
+    } while (!__atomic_compare_exchange_n(&g_trace_threads, &head, thread, 0,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+#endif
+}
+
+static inline TraceThread* trace_current_thread(void) {
+    if (t_trace_thread) return t_trace_thread;
+
+    TraceThread* thread = (TraceThread*)calloc(1, sizeof(TraceThread));
+    TraceChunk* chunk = (TraceChunk*)calloc(1, sizeof(TraceChunk));
+    if (!thread || !chunk) {
+        free(thread);
+        free(chunk);
+        return NULL;
+    }
+    thread->tid = trace_thread_id();
+    thread->first = thread->last = chunk;
+    trace_register_thread(thread);
+    t_trace_thread = thread;
+    return thread;
+}
+
+static inline void trace_record(char phase, const char* cat, const char* name,
+                         const char* arg_name, int64_t arg) {
+    if (!trace_enabled()) return;
+
+    uint64_t ticks = trace_now_ticks();
+    TraceThread* thread = trace_current_thread();
+    if (!thread) return;
+    if (thread->total >= TRACE_MAX_EVENTS) {
+        thread->dropped++;
+        return;
+    }
+
+    TraceChunk* chunk = thread->last;
+    if (chunk->count == TRACE_CHUNK_EVENTS) {
+        TraceChunk* next = (TraceChunk*)calloc(1, sizeof(TraceChunk));
+        if (!next) {
+            thread->dropped++;
+            return;
+        }
+        chunk->next = next;
+        thread->last = chunk = next;
+    }
+
+    TraceEvent* ev = &chunk->events[chunk->count];
+    ev->cat = cat;
+    ev->name = name;
+    ev->arg_name = arg_name;
+    ev->arg = arg;
+    ev->ticks = ticks;
+    ev->phase = phase;
+    trace_publish(&chunk->count, chunk->count + 1);
+    thread->total++;
+}
+
+static inline void trace_begin(const char* cat, const char* name) {
+    trace_record('B', cat, name, NULL, 0);
+}
+
+static inline void trace_begin_arg(const char* cat, const char* name, const char* arg_name, int64_t arg) {
+    trace_record('B', cat, name, arg_name, arg);
+}
+
+// Closes the innermost open span of the calling thread
+static inline void trace_end(void) {
+    trace_record('E', NULL, NULL, NULL, 0);
+}
+
+static inline void trace_write_string(FILE* f, const char* s) {
+    fputc('"', f);
+    for (; s && *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        if ((unsigned char)*s >= 0x20) fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+// Write every recorded event as {"traceEvents": [...]}; registered with atexit()
+static inline void trace_flush(void) {
+    if (!trace_enabled()) return;
+
+    FILE* f = fopen(g_trace_path, "w");
+    if (!f) return;
+
+    uint64_t pid = trace_process_id();
+    double us_per_tick = 1000000.0 / (double)trace_tick_rate();
+    long dropped = 0;
+
+    fprintf(f, "{\"traceEvents\": [\n");
+    fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %llu, \"tid\": 0, \"args\": {\"name\": ",
+            (unsigned long long)pid);
+    trace_write_string(f, g_trace_process);
+    fprintf(f, "}}");
+
+    for (TraceThread* thread = g_trace_threads; thread; thread = thread->next) {
+        dropped += thread->dropped;
+        for (TraceChunk* chunk = thread->first; chunk; chunk = chunk->next) {
+            long count = trace_observe(&chunk->count);
+            for (long i = 0; i < count; i++) {
+                const TraceEvent* ev = &chunk->events[i];
+                fprintf(f, ",\n{\"ph\": \"%c\", \"ts\": %.3f, \"pid\": %llu, \"tid\": %llu",
+                        ev->phase, (double)ev->ticks * us_per_tick,
+                        (unsigned long long)pid, (unsigned long long)thread->tid);
+                if (ev->name) {
+                    fprintf(f, ", \"name\": ");
+                    trace_write_string(f, ev->name);
+                }
+                if (ev->cat) {
+                    fprintf(f, ", \"cat\": ");
+                    trace_write_string(f, ev->cat);
+                }
+                if (ev->arg_name) {
+                    fprintf(f, ", \"args\": {");
+                    trace_write_string(f, ev->arg_name);
+                    fprintf(f, ": %lld}", (long long)ev->arg);
+                }
+                fputc('}', f);
+            }
+        }
+    }
+
+    fprintf(f, "\n], \"displayTimeUnit\": \"ms\", \"otherData\": {\"dropped_events\": %ld}}\n", dropped);
+    fclose(f);
+}
+
+// Pick up --trace FILE from the command line (other flags are ignored)
+static inline void trace_init(int argc, char* argv[]) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0) {
+            strncpy(g_trace_path, argv[++i], sizeof(g_trace_path) - 1);
+        }
+    }
+    if (!trace_enabled()) return;
+
+    if (argc > 0 && argv[0]) {
+        const char* base = argv[0];
+        for (const char* p = argv[0]; *p; p++) {
+            if (*p == '/' || *p == '\\') base = p + 1;
+        }
+        strncpy(g_trace_process, base, sizeof(g_trace_process) - 1);
+        char* ext = strstr(g_trace_process, ".exe");
+        if (ext) *ext = '\0';
+    }
+    atexit(trace_flush);
+}
+
+#endif // HELPER_TRACE_H
@@ -0,0 +1,835 @@
+/*
+ * Isolation Helper - CPU isolation settings and what actually runs on the isolated CPUs
+ *
+ * Low-latency hosts reserve CPUs with kernel parameters, and those
+ * reservations silently erode: a driver update adds an IRQ with a default
+ * affinity, a new kernel thread is created unbound, a workqueue mask is
+ * reset. This helper reports the intended isolation
+ *
+ *   /proc/cmdline                            isolcpus, nohz_full, rcu_nocbs, irqaffinity
+ *   /sys/devices/system/cpu/{isolated,nohz_full}
+ *   /sys/devices/virtual/workqueue/cpumask   unbound workqueue CPUs (and per-workqueue masks)
+ *   /proc/irq/default_smp_affinity, /proc/irq/N/{smp,effective}_affinity_list
+ *
+ * and then checks it against the host: it samples /proc/interrupts and the
+ * run time of every kernel thread twice, --interval-ms apart (default 1000),
+ * and lists the IRQs, kernel threads and workqueues that are routed to, or
+ * ran on, an isolated CPU. Without a second sample (replay, or no budget
+ * left) the interrupt counts since boot are used.
+ *
+ * Per-CPU kernel threads (ksoftirqd/N, migration/N, kworker/N:M) exist on
+ * every CPU and are flagged only when they ran during the interval; unbound
+ * kernel threads allowed onto an isolated CPU are always flagged.
+ *
+ * Usage:
+ *   isolation_helper [--interval-ms N] [--deadline-ms N] [--trace FILE]
+ *                    [--replay DIR | --capture DIR]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "helper_replay.h"
+#include "helper_trace.h"
+#include "helper_deadline.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#define CPU_ROOT "/sys/devices/system/cpu"
+#define WORKQUEUE_ROOT "/sys/devices/virtual/workqueue"
+#define MAX_CPUS 8192
+#define INITIAL_KTHREADS 1024
+#define INITIAL_WORKQUEUES 16
+#define MAX_LISTED 64
+#define FILE_BUF_SIZE (1 << 20)
+#define FILE_MAX_SIZE (256 << 20)  // cap for files read whole (/proc/interrupts)
+#define DEFAULT_INTERVAL_MS 1000
+#define PF_KTHREAD 0x00200000
+
+typedef unsigned char CpuSet[MAX_CPUS];
+
+// One snapshot of /proc/interrupts
+typedef struct {
+    int columns;
+    int* column_cpu;        // logical CPU of each column
+    int rows;
+    char (*label)[24];      // "LOC", "34"
+    char (*name)[48];       // "Local timer interrupts", "nvme0q3"
+    uint64_t* counts;       // rows x columns
+} IrqTable;
+
+typedef struct {
+    int pid;
+    char name[32];
+    int cpu;                // CPU it last ran on
+    int bound;              // allowed on exactly one CPU
+    int allowed_isolated;   // allowed on at least one isolated CPU
+    char allowed[96];
+    uint64_t ticks_before, ticks_after;
+} KThread;
+
+typedef struct {
+    char name[64];
+    char cpus[96];
+} Workqueue;
+
+static CpuSet g_online, g_isolated, g_nohz_full, g_rcu_nocbs;
+static CpuSet g_cmd_isolcpus, g_cmd_nohz_full, g_sys_isolated, g_sys_nohz_full;
+static char g_cmd_value[4][256];    // isolcpus, nohz_full, rcu_nocbs, irqaffinity
+static int g_cmd_present[4];
+static char g_isolcpus_flags[64];
+static int g_isolcpus_domain = 1;
+static int g_isolcpus_nohz = 0;
+static KThread* g_kthreads = NULL;
+static int g_kthread_count = 0;
+static int g_kthread_capacity = 0;
+static int g_kthreads_scanned = 0;
+static Workqueue* g_workqueues = NULL;
+static int g_workqueue_count = 0;
+static int g_workqueue_capacity = 0;
+static char* g_buf = NULL;
+static size_t g_buf_size = FILE_BUF_SIZE;
+
+static void sleep_ms(double ms) {
+#ifdef _WIN32
+    Sleep((DWORD)(ms + 0.5));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ms / 1000.0);
+    ts.tv_nsec = (long)((ms - (double)ts.tv_sec * 1000.0) * 1e6);
+    nanosleep(&ts, NULL);
+#endif
+}
+
+// Read a host file (from the replay root when replaying) without capturing it
+static int read_host_file(const char* abs_path, char* buf, size_t size) {
+    char replay_buf[REPLAY_PATH_MAX];
+    FILE* f = fopen(replay_host_path(abs_path, replay_buf, sizeof(replay_buf)), "rb");
+    if (!f) return -1;
+    size_t len = fread(buf, 1, size - 1, f);
+    fclose(f);
+    buf[len] = '\0';
+    return (int)len;
+}
+
+// Read a sysfs/procfs file, copying it into the capture root when capturing.
+// Returns the length, or -1.
+static int read_sys_file(const char* abs_path, char* buf, size_t size) {
+    int len = read_host_file(abs_path, buf, size);
+    if (len >= 0) capture_write_file(abs_path + 1, buf, (size_t)len);
+    return len;
+}
+
+// Read a whole sysfs/procfs file into *buf, growing it until EOF (up to
+// FILE_MAX_SIZE): /proc/interrupts is ~11 bytes per CPU per row, several MB
+// on large hosts. A file cut at the cap is reported as skipped and 'field',
+// parsed from it, as truncated. Returns the length, or -1.
+static int read_sys_file_all(const char* abs_path, const char* field, char** buf, size_t* size) {
+    char replay_buf[REPLAY_PATH_MAX];
+    FILE* f = fopen(replay_host_path(abs_path, replay_buf, sizeof(replay_buf)), "rb");
+    if (!f) return -1;
+    size_t len = 0;
+    for (;;) {
+        len += fread(*buf + len, 1, *size - 1 - len, f);
+        if (len < *size - 1) break;
+        if (*size >= FILE_MAX_SIZE) {
+            deadline_skip(abs_path, "size_cap");
+            deadline_truncate(field);
+            break;
+        }
+        char* grown = (char*)realloc(*buf, *size * 2);
+        if (!grown) {
+            deadline_skip(abs_path, "out_of_memory");
+            deadline_truncate(field);
+            break;
+        }
+        *buf = grown;
+        *size *= 2;
+    }
+    fclose(f);
+    (*buf)[len] = '\0';
+    capture_write_file(abs_path + 1, *buf, len);
+    return (int)len;
+}
+
+static void trim(char* s) {
+    size_t n = strlen(s);
+    while (n && (s[n - 1] == '\n' || s[n - 1] == ' ' || s[n - 1] == '\t')) s[--n] = '\0';
+}
+
+// Parse a cpu list ("0-3,8 10") into 'set'; returns the number of CPUs added
+static int parse_cpu_list(const char* text, unsigned char* set) {
+    int count = 0;
+    const char* p = text;
+    while (*p) {
+        while (*p == ',' || *p == ' ' || *p == '\n' || *p == '\t') p++;
+        if (*p < '0' || *p > '9') break;
+        char* end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (cpu >= 0 && cpu < MAX_CPUS && !set[cpu]) {
+                set[cpu] = 1;
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+// Parse a hex cpumask ("ff,ffffffff", CPU 0 in the lowest bit of the last word)
+static int parse_cpu_mask(const char* text, unsigned char* set) {
+    int count = 0, bit = 0;
+    const char* end = text + strcspn(text, " \t\r\n");
+    for (const char* p = end; p > text; ) {
+        char c = *--p;
+        int digit;
+        if (c == ',') continue;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else break;
+        for (int k = 0; k < 4; k++, bit++) {
+            if ((digit >> k) & 1 && bit < MAX_CPUS && !set[bit]) {
+                set[bit] = 1;
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+static int set_count(const unsigned char* set) {
+    int count = 0;
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) count += set[cpu];
+    return count;
+}
+
+static int set_overlaps(const unsigned char* a, const unsigned char* b) {
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) if (a[cpu] && b[cpu]) return 1;
+    return 0;
+}
+
+static int set_equal(const unsigned char* a, const unsigned char* b) {
+    return memcmp(a, b, MAX_CPUS) == 0;
+}
+
+// Format a set as a cpu list ("2-7,10"), truncated to 'size'
+static void format_cpu_list(const unsigned char* set, char* out, size_t size) {
+    size_t len = 0;
+    out[0] = '\0';
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (!set[cpu]) continue;
+        int last = cpu;
+        while (last + 1 < MAX_CPUS && set[last + 1]) last++;
+        int n = last > cpu ? snprintf(out + len, size - len, "%s%d-%d", len ? "," : "", cpu, last)
+                           : snprintf(out + len, size - len, "%s%d", len ? "," : "", cpu);
+        if (n < 0 || (size_t)n >= size - len) break;
+        len += (size_t)n;
+        cpu = last;
+    }
+}
+
+static void print_json_string(const char* s) {
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') putchar('\\');
+        if ((unsigned char)*s >= 0x20) putchar(*s);
+    }
+    putchar('"');
+}
+
+static void print_cpu_set(const char* name, const unsigned char* set) {
+    static char list[4096];
+    format_cpu_list(set, list, sizeof(list));
+    printf(", \"%s\": \"%s\"", name, list);
+}
+
+// ---------------------------------------------------------------- intended isolation
+
+// isolcpus=[flag,...,]cpu-list with flags nohz, domain, managed_irq
+// (no flags means domain); the other parameters are plain cpu lists
+static void read_cmdline(void) {
+    static const char* params[4] = {"isolcpus", "nohz_full", "rcu_nocbs", "irqaffinity"};
+    if (read_sys_file("/proc/cmdline", g_buf, FILE_BUF_SIZE) <= 0) return;
+    deadline_source("cmdline", "proc_cmdline");
+
+    for (char* tok = strtok(g_buf, " \t\n"); tok; tok = strtok(NULL, " \t\n")) {
+        if (strcmp(tok, "--") == 0) break;  // init arguments follow
+        for (int i = 0; i < 4; i++) {
+            size_t n = strlen(params[i]);
+            if (strncmp(tok, params[i], n) != 0 || (tok[n] != '=' && tok[n] != '\0')) continue;
+            g_cmd_present[i] = 1;
+            snprintf(g_cmd_value[i], sizeof(g_cmd_value[i]), "%s", tok[n] == '=' ? tok + n + 1 : "");
+        }
+    }
+
+    const char* list = g_cmd_value[0];
+    if (g_cmd_present[0]) {
+        // Leading alphabetic words are flags
+        while ((*list >= 'a' && *list <= 'z') || *list == '_') {
+            size_t word = strcspn(list, ",");
+            size_t len = strlen(g_isolcpus_flags);
+            if (len + word + 2 < sizeof(g_isolcpus_flags)) {
+                snprintf(g_isolcpus_flags + len, sizeof(g_isolcpus_flags) - len, "%s%.*s",
+                         len ? "," : "", (int)word, list);
+            }
+            if (word == 4 && strncmp(list, "nohz", 4) == 0) g_isolcpus_nohz = 1;
+            list += word;
+            if (*list == ',') list++;
+        }
+        if (g_isolcpus_flags[0]) g_isolcpus_domain = strstr(g_isolcpus_flags, "domain") != NULL;
+        parse_cpu_list(list, g_cmd_isolcpus);
+    }
+    if (g_cmd_present[1]) parse_cpu_list(g_cmd_value[1], g_cmd_nohz_full);
+    // A bare rcu_nocbs offloads every CPU
+    if (g_cmd_present[2] && !g_cmd_value[2][0]) memset(g_rcu_nocbs, 1, sizeof(g_rcu_nocbs));
+    else if (g_cmd_present[2]) parse_cpu_list(g_cmd_value[2], g_rcu_nocbs);
+}
+
+static int read_cpu_list_file(const char* path, unsigned char* set) {
+    if (read_sys_file(path, g_buf, FILE_BUF_SIZE) < 0) return -1;
+    return parse_cpu_list(g_buf, set);   // "(null)" or an empty line parse as none
+}
+
+static void read_intended(void) {
+    read_cpu_list_file(CPU_ROOT "/online", g_online);
+    read_cmdline();
+    if (read_cpu_list_file(CPU_ROOT "/isolated", g_sys_isolated) >= 0) deadline_source("isolated", "sysfs_isolated");
+    if (read_cpu_list_file(CPU_ROOT "/nohz_full", g_sys_nohz_full) >= 0) deadline_source("nohz_full", "sysfs_nohz_full");
+
+    // Isolated: kept out of the scheduler domains or running tickless
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        g_nohz_full[cpu] = g_sys_nohz_full[cpu] || g_cmd_nohz_full[cpu] || (g_isolcpus_nohz && g_cmd_isolcpus[cpu]);
+        g_isolated[cpu] = g_sys_isolated[cpu] || g_cmd_isolcpus[cpu] || g_nohz_full[cpu];
+        // nohz_full CPUs have their RCU callbacks offloaded as well
+        if (g_nohz_full[cpu]) g_rcu_nocbs[cpu] = 1;
+    }
+}
+
+// ---------------------------------------------------------------- workqueues
+
+static int collect_workqueue(const char* name, int is_dir, void* ctx) {
+    (void)ctx;
+    if (!is_dir || strcmp(name, "power") == 0) return 0;
+    if (g_workqueue_count >= g_workqueue_capacity) {
+        int grown = g_workqueue_capacity ? g_workqueue_capacity * 2 : INITIAL_WORKQUEUES;
+        Workqueue* bigger = (Workqueue*)realloc(g_workqueues, (size_t)grown * sizeof(Workqueue));
+        if (!bigger) {
+            deadline_truncate("workqueue_list");
+            return 1;
+        }
+        g_workqueues = bigger;
+        g_workqueue_capacity = grown;
+    }
+    char path[REPLAY_PATH_MAX];
+    CpuSet* set = (CpuSet*)calloc(1, sizeof(CpuSet));
+    if (!set) return 1;
+    snprintf(path, sizeof(path), WORKQUEUE_ROOT "/%s/cpumask", name);
+    if (read_sys_file(path, g_buf, FILE_BUF_SIZE) > 0 && parse_cpu_mask(g_buf, *set) && set_overlaps(*set, g_isolated)) {
+        Workqueue* wq = &g_workqueues[g_workqueue_count++];
+        snprintf(wq->name, sizeof(wq->name), "%s", name);
+        format_cpu_list(*set, wq->cpus, sizeof(wq->cpus));
+    }
+    free(set);
+    return 0;
+}
+
+// ---------------------------------------------------------------- interrupts
+
+static void free_table(IrqTable* t) {
+    free(t->column_cpu);
+    free(t->label);
+    free(t->name);
+    free(t->counts);
+    memset(t, 0, sizeof(*t));
+}
+
+static int read_irq_table(IrqTable* t) {
+    memset(t, 0, sizeof(*t));
+    if (read_sys_file_all("/proc/interrupts", "irqs", &g_buf, &g_buf_size) <= 0) return 0;
+
+    int lines = 0;
+    for (char* p = g_buf; *p; p++) lines += *p == '\n';
+    char* line = g_buf;
+    char* next = strchr(line, '\n');
+    if (next) *next = '\0';
+
+    // Header: "CPU0 CPU1 ..." (online CPUs only)
+    for (char* p = line; (p = strstr(p, "CPU")) != NULL; p += 3) t->columns++;
+    t->column_cpu = (int*)calloc(t->columns ? t->columns : 1, sizeof(int));
+    t->label = (char(*)[24])calloc(lines ? lines : 1, sizeof(*t->label));
+    t->name = (char(*)[48])calloc(lines ? lines : 1, sizeof(*t->name));
+    t->counts = (uint64_t*)calloc((size_t)(lines ? lines : 1) * (t->columns ? t->columns : 1), sizeof(uint64_t));
+    if (!t->column_cpu || !t->label || !t->name || !t->counts || !t->columns) {
+        free_table(t);
+        return 0;
+    }
+    int column = 0;
+    for (char* p = line; (p = strstr(p, "CPU")) != NULL && column < t->columns; p += 3) {
+        t->column_cpu[column++] = atoi(p + 3);
+    }
+
+    while (next && t->rows < lines) {
+        line = next + 1;
+        next = strchr(line, '\n');
+        if (next) *next = '\0';
+        char* colon = strchr(line, ':');
+        if (!colon) continue;
+        char* start = line;
+        while (*start == ' ') start++;
+        size_t label_len = (size_t)(colon - start);
+        if (label_len >= sizeof(t->label[0])) label_len = sizeof(t->label[0]) - 1;
+        memcpy(t->label[t->rows], start, label_len);
+
+        // Counts, then the chip, the hwirq and the device name(s)
+        char* p = colon + 1;
+        uint64_t* row = t->counts + (size_t)t->rows * t->columns;
+        for (int c = 0; c < t->columns; c++) {
+            char* end;
+            unsigned long long value = strtoull(p, &end, 10);
+            if (end == p) break;
+            row[c] = value;
+            p = end;
+        }
+        while (*p == ' ') p++;
+        char* name = p;
+        if (label_len && start[0] >= '0' && start[0] <= '9') {
+            char* last = strrchr(p, ' ');
+            if (last && last[1]) name = last + 1;
+        }
+        snprintf(t->name[t->rows], sizeof(t->name[0]), "%s", name);
+        t->rows++;
+    }
+    return 1;
+}
+
+// Count of row 'row' of 'after' on 'cpu', less the same row in 'before' (if any)
+static uint64_t irq_count(const IrqTable* before, const IrqTable* after, int row, int cpu) {
+    int ca = -1, cb = -1;
+    for (int c = 0; c < after->columns; c++) if (after->column_cpu[c] == cpu) ca = c;
+    if (ca < 0) return 0;
+    uint64_t now = after->counts[(size_t)row * after->columns + ca];
+    if (!before || !before->columns) return now;
+    for (int c = 0; c < before->columns; c++) if (before->column_cpu[c] == cpu) cb = c;
+    int rb = row < before->rows && strcmp(before->label[row], after->label[row]) == 0 ? row : -1;
+    for (int r = 0; rb < 0 && r < before->rows; r++) {
+        if (strcmp(before->label[r], after->label[row]) == 0) rb = r;
+    }
+    uint64_t then = cb >= 0 && rb >= 0 ? before->counts[(size_t)rb * before->columns + cb] : 0;
+    return now > then ? now - then : 0;
+}
+
+static int irq_row(const IrqTable* t, const char* label) {
+    for (int r = 0; r < t->rows; r++) if (strcmp(t->label[r], label) == 0) return r;
+    return -1;
+}
+
+// ---------------------------------------------------------------- kernel threads
+
+// Fields of /proc/PID/stat after the ")" that ends the command name
+#define STAT_FLAGS 6
+#define STAT_UTIME 11
+#define STAT_STIME 12
+#define STAT_PROCESSOR 36
+
+// Parse /proc/PID/stat; returns 1 for a kernel thread
+static int parse_stat(char* text, char* name, size_t name_size, uint64_t* ticks, int* cpu) {
+    char* open = strchr(text, '(');
+    char* close = strrchr(text, ')');
+    if (!open || !close || close < open) return 0;
+    size_t len = (size_t)(close - open - 1);
+    if (len >= name_size) len = name_size - 1;
+    memcpy(name, open + 1, len);
+    name[len] = '\0';
+
+    unsigned long long flags = 0, utime = 0, stime = 0;
+    int field = 0;
+    *cpu = -1;
+    for (char* tok = strtok(close + 1, " \n"); tok; tok = strtok(NULL, " \n"), field++) {
+        if (field == STAT_FLAGS) flags = strtoull(tok, NULL, 10);
+        else if (field == STAT_UTIME) utime = strtoull(tok, NULL, 10);
+        else if (field == STAT_STIME) stime = strtoull(tok, NULL, 10);
+        else if (field == STAT_PROCESSOR) *cpu = atoi(tok);
+    }
+    *ticks = utime + stime;
+    return (flags & PF_KTHREAD) != 0;
+}
+
+static int collect_kthread(const char* name, int is_dir, void* ctx) {
+    (void)ctx;
+    if (!is_dir || name[0] < '0' || name[0] > '9') return 0;
+    if (g_kthread_count >= g_kthread_capacity) {
+        int grown = g_kthread_capacity * 2;
+        KThread* bigger = (KThread*)realloc(g_kthreads, (size_t)grown * sizeof(KThread));
+        if (!bigger) {
+            deadline_truncate("kthread_list");
+            return 1;
+        }
+        g_kthreads = bigger;
+        g_kthread_capacity = grown;
+    }
+
+    // Read without capturing: only kernel threads go into a capture
+    char path[64];
+    KThread k;
+    memset(&k, 0, sizeof(k));
+    k.pid = atoi(name);
+    snprintf(path, sizeof(path), "/proc/%d/stat", k.pid);
+    int len = read_host_file(path, g_buf, FILE_BUF_SIZE);
+    if (len <= 0) return 0;
+    char* raw = (char*)malloc((size_t)len + 1);
+    if (raw) memcpy(raw, g_buf, (size_t)len + 1);
+    int is_kthread = parse_stat(g_buf, k.name, sizeof(k.name), &k.ticks_before, &k.cpu);
+    g_kthreads_scanned++;
+    if (!is_kthread) {
+        free(raw);
+        return 0;
+    }
+    if (raw) capture_write_file(path + 1, raw, (size_t)len);
+    free(raw);
+
+    snprintf(path, sizeof(path), "/proc/%d/status", k.pid);
+    if (read_sys_file(path, g_buf, FILE_BUF_SIZE) <= 0) return 0;
+    char* allowed = strstr(g_buf, "Cpus_allowed_list:");
+    if (!allowed) return 0;
+    allowed += strlen("Cpus_allowed_list:");
+    while (*allowed == ' ' || *allowed == '\t') allowed++;
+    allowed[strcspn(allowed, "\n")] = '\0';
+    snprintf(k.allowed, sizeof(k.allowed), "%s", allowed);
+
+    CpuSet* set = (CpuSet*)calloc(1, sizeof(CpuSet));
+    if (!set) return 1;
+    k.bound = parse_cpu_list(allowed, *set) == 1;
+    k.allowed_isolated = set_overlaps(*set, g_isolated);
+    free(set);
+
+    // Only threads that can run on an isolated CPU are of interest
+    if (k.allowed_isolated || (k.cpu >= 0 && k.cpu < MAX_CPUS && g_isolated[k.cpu])) {
+        g_kthreads[g_kthread_count++] = k;
+    }
+    return 0;
+}
+
+static void resample_kthread(KThread* k) {
+    char path[64];
+    char name[32];
+    int cpu;
+    snprintf(path, sizeof(path), "/proc/%d/stat", k->pid);
+    k->ticks_after = k->ticks_before;
+    if (read_host_file(path, g_buf, FILE_BUF_SIZE) > 0 && parse_stat(g_buf, name, sizeof(name), &k->ticks_after, &cpu)) {
+        if (strcmp(name, k->name) == 0) k->cpu = cpu;   // the PID may have been reused
+        else k->ticks_after = k->ticks_before;
+    }
+}
+
+static int compare_kthreads(const void* a, const void* b) {
+    const KThread* x = (const KThread*)a;
+    const KThread* y = (const KThread*)b;
+    uint64_t dx = x->ticks_after - x->ticks_before, dy = y->ticks_after - y->ticks_before;
+    if (dx != dy) return dx < dy ? 1 : -1;
+    if (x->bound != y->bound) return x->bound - y->bound;   // unbound first
+    return x->pid - y->pid;
+}
+
+// An unbound thread allowed onto an isolated CPU, or a thread that ran on one
+static int kthread_flagged(const KThread* k, int interval) {
+    int ran = interval && k->ticks_after > k->ticks_before && k->cpu >= 0 && k->cpu < MAX_CPUS && g_isolated[k->cpu];
+    return (!k->bound && k->allowed_isolated) || ran;
+}
+
+// ---------------------------------------------------------------- output
+
+static void print_cmdline(void) {
+    static const char* params[4] = {"isolcpus", "nohz_full", "rcu_nocbs", "irqaffinity"};
+    printf(", \"cmdline\": {");
+    for (int i = 0; i < 4; i++) {
+        printf("%s\"%s\": ", i ? ", " : "", params[i]);
+        if (g_cmd_present[i]) print_json_string(g_cmd_value[i]);
+        else printf("null");
+    }
+    printf(", \"isolcpus_flags\": ");
+    if (g_isolcpus_flags[0]) print_json_string(g_isolcpus_flags);
+    else printf("null");
+    printf("}");
+}
+
+int main(int argc, char* argv[]) {
+    double interval_ms = DEFAULT_INTERVAL_MS;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--interval-ms") == 0) interval_ms = atof(argv[++i]);
+    }
+
+    replay_init(argc, argv);
+    trace_init(argc, argv);
+    deadline_init(argc, argv);
+
+    g_buf = (char*)malloc(FILE_BUF_SIZE);
+    g_kthread_capacity = INITIAL_KTHREADS;
+    g_kthreads = (KThread*)calloc(g_kthread_capacity, sizeof(KThread));
+    if (!g_buf || !g_kthreads) {
+        printf("{\"error\": \"Out of memory\"}\n");
+        return 1;
+    }
+
+    trace_begin("probe", "isolation_settings");
+    read_intended();
+    int isolated_count = set_count(g_isolated);
+
+    char default_irq[4096] = "";
+    // Scratch/default IRQ affinity, workqueue cpumask, requested cpumask, housekeeping
+    CpuSet* mask = (CpuSet*)calloc(4, sizeof(CpuSet));
+    if (!mask) {
+        printf("{\"error\": \"Out of memory\"}\n");
+        return 1;
+    }
+    if (read_sys_file("/proc/irq/default_smp_affinity", g_buf, FILE_BUF_SIZE) > 0 && parse_cpu_mask(g_buf, mask[0])) {
+        format_cpu_list(mask[0], default_irq, sizeof(default_irq));
+    }
+    int default_irq_isolated = set_overlaps(mask[0], g_isolated);
+
+    // Unbound workqueues: the effective and the requested global mask, then
+    // every workqueue created with WQ_SYSFS
+    static const char* wq_files[2] = {"cpumask", "cpumask_requested"};
+    int wq_present[2] = {0};
+    for (int i = 0; i < 2; i++) {
+        char path[128];
+        snprintf(path, sizeof(path), WORKQUEUE_ROOT "/%s", wq_files[i]);
+        if (read_sys_file(path, g_buf, FILE_BUF_SIZE) > 0) {
+            parse_cpu_mask(g_buf, mask[1 + i]);
+            wq_present[i] = 1;
+        }
+    }
+    if (wq_present[0]) deadline_source("workqueues", "sysfs_workqueue");
+    int workqueue_isolated = wq_present[0] && set_overlaps(mask[1], g_isolated);
+    if (isolated_count) replay_list_dir(WORKQUEUE_ROOT + 1, collect_workqueue, NULL);
+    trace_end();
+
+    // Validation: interrupts and kernel threads, sampled over the interval
+    IrqTable before, after;
+    memset(&before, 0, sizeof(before));
+    memset(&after, 0, sizeof(after));
+    int have_irqs = 0, interval = 0;
+    double measured_ms = 0;
+    if (isolated_count) {
+        trace_begin("probe", "isolation_scan");
+        have_irqs = read_irq_table(&before);
+        replay_list_dir("proc", collect_kthread, NULL);
+        trace_end();
+        if (have_irqs) deadline_source("irqs", "proc_interrupts");
+        if (g_kthreads_scanned) deadline_source("kthreads", "proc_pid_stat");
+
+        if (!replay_enabled() && interval_ms > 0) {
+            double budget = deadline_remaining_ms() / 2;
+            if (interval_ms > budget) interval_ms = budget;
+            if (interval_ms >= 10) {
+                trace_begin("probe", "isolation_interval");
+                double start = deadline_clock_ms();
+                sleep_ms(interval_ms);
+                if (have_irqs) have_irqs = read_irq_table(&after);
+                for (int i = 0; i < g_kthread_count; i++) resample_kthread(&g_kthreads[i]);
+                measured_ms = deadline_clock_ms() - start;
+                trace_end();
+                interval = 1;
+            } else {
+                deadline_skip("isolation_interval", "budget");
+            }
+        }
+        if (!interval) {
+            // Since boot: the single snapshot is the "after" side
+            after = before;
+            memset(&before, 0, sizeof(before));
+            for (int i = 0; i < g_kthread_count; i++) g_kthreads[i].ticks_after = g_kthreads[i].ticks_before;
+        }
+    }
+    double seconds = interval ? measured_ms / 1000.0 : 0;
+
+    trace_begin("output", "emit_json");
+    printf("{");
+    deadline_print_json();
+    printf("\"supported\": %s", set_count(g_online) || g_cmd_present[0] || g_cmd_present[1] ? "true" : "false");
+    print_cpu_set("online_cpus", g_online);
+    print_cpu_set("isolated_cpus", g_isolated);
+    printf(", \"isolated_count\": %d", isolated_count);
+    {
+        CpuSet* housekeeping = &mask[3];
+        int requested_isolated = wq_present[1] && set_overlaps(mask[2], g_isolated);
+        for (int cpu = 0; cpu < MAX_CPUS; cpu++) (*housekeeping)[cpu] = g_online[cpu] && !g_isolated[cpu];
+        print_cpu_set("housekeeping_cpus", *housekeeping);
+        print_cpu_set("nohz_full_cpus", g_nohz_full);
+        print_cpu_set("rcu_nocbs_cpus", g_rcu_nocbs);
+        print_cpu_set("sysfs_isolated", g_sys_isolated);
+        print_cpu_set("sysfs_nohz_full", g_sys_nohz_full);
+
+        // Drift: the running kernel does not apply what the command line asks for
+        if (g_cmd_present[0] && g_isolcpus_domain) printf(", \"isolcpus_applied\": %s", set_equal(g_cmd_isolcpus, g_sys_isolated) ? "true" : "false");
+        else printf(", \"isolcpus_applied\": null");
+        if (g_cmd_present[1] || g_isolcpus_nohz) {
+            CpuSet* wanted = (CpuSet*)calloc(1, sizeof(CpuSet));
+            if (wanted) {
+                for (int cpu = 0; cpu < MAX_CPUS; cpu++) (*wanted)[cpu] = g_cmd_nohz_full[cpu] || (g_isolcpus_nohz && g_cmd_isolcpus[cpu]);
+                printf(", \"nohz_full_applied\": %s", set_equal(*wanted, g_sys_nohz_full) ? "true" : "false");
+                free(wanted);
+            }
+        } else {
+            printf(", \"nohz_full_applied\": null");
+        }
+
+        printf(", \"default_irq_affinity\": \"%s\", \"default_irq_affinity_isolated\": %s", default_irq,
+               default_irq_isolated ? "true" : "false");
+        if (wq_present[0]) print_cpu_set("workqueue_cpumask", mask[1]);
+        else printf(", \"workqueue_cpumask\": null");
+        printf(", \"workqueue_cpumask_isolated\": %s", workqueue_isolated ? "true" : "false");
+        printf(", \"workqueue_requested_isolated\": %s", requested_isolated ? "true" : "false");
+    }
+
+    // Device IRQs routed to or fired on isolated CPUs
+    int irq_total = 0, irqs_allowed = 0, irqs_effective = 0, irqs_fired = 0;
+    char* flagged_irq = (char*)calloc(after.rows ? after.rows : 1, 1);
+    char (*affinity)[96] = (char(*)[96])calloc(after.rows ? after.rows : 1, sizeof(*affinity));
+    char (*effective)[96] = (char(*)[96])calloc(after.rows ? after.rows : 1, sizeof(*effective));
+    uint64_t* isolated_counts = (uint64_t*)calloc(after.rows ? after.rows : 1, sizeof(uint64_t));
+    for (int r = 0; flagged_irq && affinity && effective && isolated_counts && r < after.rows; r++) {
+        if (after.label[r][0] < '0' || after.label[r][0] > '9') continue;
+        char path[96];
+        CpuSet* set = &mask[0];
+        irq_total++;
+        snprintf(path, sizeof(path), "/proc/irq/%s/smp_affinity_list", after.label[r]);
+        if (read_sys_file(path, g_buf, FILE_BUF_SIZE) > 0) {
+            trim(g_buf);
+            snprintf(affinity[r], sizeof(affinity[r]), "%s", g_buf);
+            memset(*set, 0, sizeof(*set));
+            parse_cpu_list(g_buf, *set);
+            if (set_overlaps(*set, g_isolated)) irqs_allowed++;
+        }
+        snprintf(path, sizeof(path), "/proc/irq/%s/effective_affinity_list", after.label[r]);
+        if (read_sys_file(path, g_buf, FILE_BUF_SIZE) > 0) {
+            trim(g_buf);
+            snprintf(effective[r], sizeof(effective[r]), "%s", g_buf);
+            memset(*set, 0, sizeof(*set));
+            parse_cpu_list(g_buf, *set);
+            if (set_overlaps(*set, g_isolated)) {
+                irqs_effective++;
+                flagged_irq[r] = 1;
+            }
+        }
+        for (int c = 0; c < after.columns; c++) {
+            int cpu = after.column_cpu[c];
+            if (cpu >= 0 && cpu < MAX_CPUS && g_isolated[cpu]) isolated_counts[r] += irq_count(&before, &after, r, cpu);
+        }
+        if (isolated_counts[r]) {
+            irqs_fired++;
+            flagged_irq[r] = 1;
+        }
+    }
+
+    int unbound_kthreads = 0, kthreads_ran = 0;
+    qsort(g_kthreads, g_kthread_count, sizeof(KThread), compare_kthreads);
+    for (int i = 0; i < g_kthread_count; i++) {
+        const KThread* k = &g_kthreads[i];
+        if (!k->bound && k->allowed_isolated) unbound_kthreads++;
+        if (interval && k->ticks_after > k->ticks_before && k->cpu >= 0 && k->cpu < MAX_CPUS && g_isolated[k->cpu]) kthreads_ran++;
+    }
+
+    printf(", \"window\": %s, \"interval_ms\": %.1f",
+           !isolated_count ? "null" : interval ? "\"interval\"" : "\"since_boot\"", measured_ms);
+    printf(", \"irqs\": %d, \"irqs_allowed_on_isolated\": %d, \"irqs_effective_on_isolated\": %d, \"irqs_fired_on_isolated\": %d",
+           irq_total, irqs_allowed, irqs_effective, irqs_fired);
+    printf(", \"kthreads_scanned\": %d, \"unbound_kthreads_on_isolated\": %d, \"kthreads_ran_on_isolated\": %s",
+           g_kthreads_scanned, unbound_kthreads, interval ? "" : "null");
+    if (interval) printf("%d", kthreads_ran);
+    // WQ_SYSFS workqueues only; the global mask is workqueue_cpumask_isolated
+    printf(", \"workqueues_on_isolated\": %d", g_workqueue_count);
+    print_cmdline();
+
+    // Per isolated CPU: device interrupts, local timer ticks and kernel thread time
+    long tick_hz = 100;
+#ifndef _WIN32
+    if (!replay_enabled() && sysconf(_SC_CLK_TCK) > 0) tick_hz = sysconf(_SC_CLK_TCK);
+#endif
+    int loc = irq_row(&after, "LOC");
+    printf(", \"cpus\": [");
+    int printed = 0;
+    for (int cpu = 0; cpu < MAX_CPUS && isolated_count; cpu++) {
+        if (!g_isolated[cpu]) continue;
+        uint64_t device = 0, other = 0, ticks = 0;
+        for (int r = 0; r < after.rows; r++) {
+            uint64_t n = irq_count(&before, &after, r, cpu);
+            if (after.label[r][0] >= '0' && after.label[r][0] <= '9') device += n;
+            else if (r != loc) other += n;
+        }
+        for (int i = 0; i < g_kthread_count; i++) {
+            if (g_kthreads[i].cpu == cpu) ticks += g_kthreads[i].ticks_after - g_kthreads[i].ticks_before;
+        }
+        printf("%s\n    {\"cpu\": %d, \"online\": %s, \"nohz_full\": %s, \"rcu_nocbs\": %s, \"device_irqs\": %llu, "
+               "\"local_timer\": %llu, \"other_irqs\": %llu",
+               printed++ ? "," : "", cpu, g_online[cpu] ? "true" : "false", g_nohz_full[cpu] ? "true" : "false",
+               g_rcu_nocbs[cpu] ? "true" : "false", (unsigned long long)device,
+               (unsigned long long)(loc >= 0 ? irq_count(&before, &after, loc, cpu) : 0), (unsigned long long)other);
+        if (interval) {
+            printf(", \"device_irqs_per_s\": %.1f, \"local_timer_per_s\": %.1f, \"kthread_ms\": %.1f}",
+                   (double)device / seconds,
+                   (double)(loc >= 0 ? irq_count(&before, &after, loc, cpu) : 0) / seconds,
+                   1000.0 * (double)ticks / (double)tick_hz);
+        } else {
+            printf(", \"device_irqs_per_s\": null, \"local_timer_per_s\": null, \"kthread_ms\": null}");
+        }
+    }
+    printf("]");
+
+    printf(", \"irq_list\": [");
+    printed = 0;
+    for (int r = 0; flagged_irq && r < after.rows && printed < MAX_LISTED; r++) {
+        if (!flagged_irq[r]) continue;
+        printf("%s\n    {\"irq\": %s, \"name\": ", printed++ ? "," : "", after.label[r]);
+        print_json_string(after.name[r]);
+        printf(", \"affinity\": \"%s\", \"effective\": \"%s\", \"count_on_isolated\": %llu}",
+               affinity[r], effective[r], (unsigned long long)isolated_counts[r]);
+    }
+    printf("]");
+
+    printf(", \"kthread_list\": [");
+    printed = 0;
+    for (int i = 0; i < g_kthread_count && printed < MAX_LISTED; i++) {
+        const KThread* k = &g_kthreads[i];
+        if (!kthread_flagged(k, interval)) continue;
+        printf("%s\n    {\"pid\": %d, \"name\": ", printed++ ? "," : "", k->pid);
+        print_json_string(k->name);
+        printf(", \"cpu\": %d, \"allowed\": \"%s\", \"bound\": %s, \"ms\": ", k->cpu, k->allowed, k->bound ? "true" : "false");
+        if (interval) printf("%.1f}", 1000.0 * (double)(k->ticks_after - k->ticks_before) / (double)tick_hz);
+        else printf("null}");
+    }
+    printf("]");
+
+    printf(", \"workqueue_list\": [");
+    for (int i = 0; i < g_workqueue_count; i++) {
+        printf("%s{\"name\": ", i ? ", " : "");
+        print_json_string(g_workqueues[i].name);
+        printf(", \"cpus\": \"%s\"}", g_workqueues[i].cpus);
+    }
+    printf("]}\n");
+    trace_end();
+
+    free(flagged_irq);
+    free(affinity);
+    free(effective);
+    free(isolated_counts);
+    if (interval) free_table(&before);
+    free_table(&after);
+    free(mask);
+    free(g_kthreads);
+    free(g_workqueues);
+    free(g_buf);
+    return 0;
+}
@@ -0,0 +1,321 @@
+/*
+ * JSON Stream - constant-memory streaming JSON tokenizer for the native tools
+ *
+ * Reads a JSON document from a FILE* through a fixed read buffer and reports
+ * it as begin/end/scalar events, so documents of any size are processed with
+ * the same few kilobytes of memory. Strings are decoded (including \uXXXX
+ * escapes and surrogate pairs, emitted as UTF-8) and truncated to
+ * JSON_STREAM_STRING_MAX bytes; numbers are passed through as their literal
+ * text so no precision is lost.
+ *
+ * Usage:
+ *   JsonStreamHandler h = {on_begin, on_end, on_scalar};
+ *   JsonStream js;
+ *   json_stream_init(&js, stdin, &h, ctx);
+ *   if (!json_stream_parse(&js)) fprintf(stderr, "%s\n", js.error);
+ *
+ * 'key' is the member name inside objects and NULL inside arrays.
+ */
+
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JSON_STREAM_BUFFER 65536
+#define JSON_STREAM_STRING_MAX 1024
+#define JSON_STREAM_MAX_DEPTH 64
+
+typedef enum {
+    JSON_STRING,
+    JSON_NUMBER,
+    JSON_TRUE,
+    JSON_FALSE,
+    JSON_NULL
+} JsonType;
+
+typedef struct {
+    void (*begin)(void* ctx, const char* key, int is_array);
+    void (*end)(void* ctx, int is_array);
+    void (*scalar)(void* ctx, const char* key, JsonType type, const char* text);
+} JsonStreamHandler;
+
+typedef struct {
+    FILE* in;
+    const JsonStreamHandler* handler;
+    void* ctx;
+    unsigned char buffer[JSON_STREAM_BUFFER];
+    size_t pos;
+    size_t len;
+    long line;
+    int failed;
+    char key[JSON_STREAM_STRING_MAX];
+    char text[JSON_STREAM_STRING_MAX];
+    char error[128];
+} JsonStream;
+
+static void json_stream_init(JsonStream* js, FILE* in, const JsonStreamHandler* handler, void* ctx) {
+    memset(js, 0, sizeof(*js));
+    js->in = in;
+    js->handler = handler;
+    js->ctx = ctx;
+    js->line = 1;
+}
+
+static void json_stream_fail(JsonStream* js, const char* what) {
+    if (js->failed) return;
+    js->failed = 1;
+    snprintf(js->error, sizeof(js->error), "JSON error at line %ld: %s", js->line, what);
+}
+
+// Next byte without consuming it; -1 at end of input
+static int json_stream_peek(JsonStream* js) {
+    if (js->pos == js->len) {
+        js->len = fread(js->buffer, 1, sizeof(js->buffer), js->in);
+        js->pos = 0;
+        if (js->len == 0) return -1;
+    }
+    return js->buffer[js->pos];
+}
+
+static int json_stream_next(JsonStream* js) {
+    int c = json_stream_peek(js);
+    if (c >= 0) {
+        js->pos++;
+        if (c == '\n') js->line++;
+    }
+    return c;
+}
+
+static int json_stream_skip_space(JsonStream* js) {
+    int c;
+    while ((c = json_stream_peek(js)) == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        json_stream_next(js);
+    }
+    return c;
+}
+
+static int json_stream_expect(JsonStream* js, const char* word) {
+    for (; *word; word++) {
+        if (json_stream_next(js) != *word) {
+            json_stream_fail(js, "invalid literal");
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int json_stream_hex4(JsonStream* js, unsigned* out) {
+    unsigned value = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = json_stream_next(js);
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= (unsigned)(c - '0');
+        else if (c >= 'a' && c <= 'f') value |= (unsigned)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') value |= (unsigned)(c - 'A' + 10);
+        else {
+            json_stream_fail(js, "invalid \\u escape");
+            return 0;
+        }
+    }
+    *out = value;
+    return 1;
+}
+
+// Append one byte, dropping it (and everything after) once 'out' is full
+static void json_stream_put(char* out, size_t* len, int c) {
+    if (*len + 1 < JSON_STREAM_STRING_MAX) out[(*len)++] = (char)c;
+}
+
+// Encode a code point as UTF-8; a sequence cut off by truncation is trimmed later
+static void json_stream_put_utf8(char* out, size_t* len, unsigned cp) {
+    if (cp < 0x80) {
+        json_stream_put(out, len, (int)cp);
+    } else if (cp < 0x800) {
+        json_stream_put(out, len, 0xC0 | (cp >> 6));
+        json_stream_put(out, len, 0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        json_stream_put(out, len, 0xE0 | (cp >> 12));
+        json_stream_put(out, len, 0x80 | ((cp >> 6) & 0x3F));
+        json_stream_put(out, len, 0x80 | (cp & 0x3F));
+    } else {
+        json_stream_put(out, len, 0xF0 | (cp >> 18));
+        json_stream_put(out, len, 0x80 | ((cp >> 12) & 0x3F));
+        json_stream_put(out, len, 0x80 | ((cp >> 6) & 0x3F));
+        json_stream_put(out, len, 0x80 | (cp & 0x3F));
+    }
+}
+
+// Decode a string (opening quote already consumed) into 'out'
+static int json_stream_string(JsonStream* js, char* out) {
+    size_t len = 0;
+    for (;;) {
+        int c = json_stream_next(js);
+        if (c < 0) {
+            json_stream_fail(js, "unterminated string");
+            return 0;
+        }
+        if (c == '"') break;
+        if (c != '\\') {
+            json_stream_put(out, &len, c);
+            continue;
+        }
+        c = json_stream_next(js);
+        switch (c) {
+        case '"': case '\\': case '/': json_stream_put(out, &len, c); break;
+        case 'b': json_stream_put(out, &len, '\b'); break;
+        case 'f': json_stream_put(out, &len, '\f'); break;
+        case 'n': json_stream_put(out, &len, '\n'); break;
+        case 'r': json_stream_put(out, &len, '\r'); break;
+        case 't': json_stream_put(out, &len, '\t'); break;
+        case 'u': {
+            unsigned cp;
+            if (!json_stream_hex4(js, &cp)) return 0;
+            if (cp >= 0xD800 && cp <= 0xDBFF) {
+                unsigned low;
+                if (json_stream_next(js) != '\\' || json_stream_next(js) != 'u' ||
+                    !json_stream_hex4(js, &low) || low < 0xDC00 || low > 0xDFFF) {
+                    json_stream_fail(js, "unpaired surrogate");
+                    return 0;
+                }
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+            }
+            json_stream_put_utf8(out, &len, cp);
+            break;
+        }
+        default:
+            json_stream_fail(js, "invalid escape");
+            return 0;
+        }
+    }
+    if (len == JSON_STREAM_STRING_MAX - 1) {
+        // Truncated: drop a trailing UTF-8 sequence that lost its last bytes
+        size_t lead = len;
+        while (lead > 0 && ((unsigned char)out[lead - 1] & 0xC0) == 0x80) lead--;
+        if (lead > 0) {
+            unsigned char b = (unsigned char)out[lead - 1];
+            size_t need = b >= 0xF0 ? 4 : b >= 0xE0 ? 3 : b >= 0xC0 ? 2 : 1;
+            if (len - (lead - 1) < need) len = lead - 1;
+        }
+    }
+    out[len] = '\0';
+    return 1;
+}
+
+static int json_stream_number(JsonStream* js, char* out) {
+    size_t len = 0;
+    int c;
+    while ((c = json_stream_peek(js)) >= 0 &&
+           ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E')) {
+        json_stream_put(out, &len, json_stream_next(js));
+    }
+    out[len] = '\0';
+    if (len == 0) {
+        json_stream_fail(js, "unexpected character");
+        return 0;
+    }
+    return 1;
+}
+
+static int json_stream_value(JsonStream* js, const char* key, int depth);
+
+static int json_stream_container(JsonStream* js, const char* key, int depth, int is_array) {
+    if (depth >= JSON_STREAM_MAX_DEPTH) {
+        json_stream_fail(js, "nesting too deep");
+        return 0;
+    }
+    json_stream_next(js);   // '{' or '['
+    if (js->handler->begin) js->handler->begin(js->ctx, key, is_array);
+
+    int close = is_array ? ']' : '}';
+    if (json_stream_skip_space(js) == close) {
+        json_stream_next(js);
+    } else {
+        for (;;) {
+            const char* member = NULL;
+            if (!is_array) {
+                if (json_stream_next(js) != '"') {
+                    json_stream_fail(js, "expected member name");
+                    return 0;
+                }
+                if (!json_stream_string(js, js->key)) return 0;
+                if (json_stream_skip_space(js) != ':') {
+                    json_stream_fail(js, "expected ':'");
+                    return 0;
+                }
+                json_stream_next(js);
+                member = js->key;
+            }
+            if (!json_stream_value(js, member, depth + 1)) return 0;
+
+            int c = json_stream_skip_space(js);
+            json_stream_next(js);
+            if (c == close) break;
+            if (c != ',') {
+                json_stream_fail(js, is_array ? "expected ',' or ']'" : "expected ',' or '}'");
+                return 0;
+            }
+            json_stream_skip_space(js);
+        }
+    }
+    if (js->handler->end) js->handler->end(js->ctx, is_array);
+    return 1;
+}
+
+// 'key' may point into js->key; handlers must copy it before the next event
+static int json_stream_value(JsonStream* js, const char* key, int depth) {
+    int c = json_stream_skip_space(js);
+    switch (c) {
+    case '{': return json_stream_container(js, key, depth, 0);
+    case '[': return json_stream_container(js, key, depth, 1);
+    case '"':
+        json_stream_next(js);
+        if (key) {
+            // The member name lives in js->key; keep it while decoding the value
+            char name[JSON_STREAM_STRING_MAX];
+            strcpy(name, key);
+            if (!json_stream_string(js, js->text)) return 0;
+            if (js->handler->scalar) js->handler->scalar(js->ctx, name, JSON_STRING, js->text);
+            return 1;
+        }
+        if (!json_stream_string(js, js->text)) return 0;
+        if (js->handler->scalar) js->handler->scalar(js->ctx, NULL, JSON_STRING, js->text);
+        return 1;
+    case 't':
+        if (!json_stream_expect(js, "true")) return 0;
+        if (js->handler->scalar) js->handler->scalar(js->ctx, key, JSON_TRUE, "true");
+        return 1;
+    case 'f':
+        if (!json_stream_expect(js, "false")) return 0;
+        if (js->handler->scalar) js->handler->scalar(js->ctx, key, JSON_FALSE, "false");
+        return 1;
+    case 'n':
+        if (!json_stream_expect(js, "null")) return 0;
+        if (js->handler->scalar) js->handler->scalar(js->ctx, key, JSON_NULL, "null");
+        return 1;
+    case -1:
+        json_stream_fail(js, "unexpected end of input");
+        return 0;
+    default:
+        if (!json_stream_number(js, js->text)) return 0;
+        if (js->handler->scalar) js->handler->scalar(js->ctx, key, JSON_NUMBER, js->text);
+        return 1;
+    }
+}
+
+// Parse one JSON document; returns 1 on success, 0 with js->error set on failure
+static int json_stream_parse(JsonStream* js) {
+    if (!json_stream_value(js, NULL, 0)) {
+        json_stream_fail(js, "invalid document");
+        return 0;
+    }
+    if (json_stream_skip_space(js) != -1) {
+        json_stream_fail(js, "trailing data after document");
+        return 0;
+    }
+    return 1;
+}
+
+#endif // JSON_STREAM_H
@@ -3,8 +3,14 @@ import platform
 import os
 import cpuinfo
 import subprocess
+import sys
 import json
 import glob
+import tempfile
+import threading
+import time
+import queue
+import traceback
 
 # Try to import WMI (Windows only)
 try:
@@ -28,6 +34,110 @@ try:
 except:
     pass
 
+# Replay root: run the native helpers against a host captured with capture_host.py
+# (set via --replay PATH or HALFAX_REPLAY_ROOT)
+REPLAY_ROOT = os.environ.get('HALFAX_REPLAY_ROOT')
+
+# Trace output: Chrome/Perfetto trace-event JSON for one refresh
+# (set via --trace FILE or HALFAX_TRACE; helpers get --trace and are merged in)
+TRACE_PATH = os.environ.get('HALFAX_TRACE')
+_trace_buffers = []            # one event list per thread, registered on first use
+_trace_local = threading.local()
+
+def _trace_buffer():
+    buffer = getattr(_trace_local, 'events', None)
+    if buffer is None:
+        buffer = _trace_local.events = []
+        _trace_buffers.append(buffer)
+    return buffer
+
+def trace_begin(name, cat='collector'):
+    if TRACE_PATH:
+        _trace_buffer().append({'name': name, 'cat': cat, 'ph': 'B',
+                                'ts': time.perf_counter() * 1e6,
+                                'pid': os.getpid(), 'tid': threading.get_native_id()})
+
+def trace_end():
+    if TRACE_PATH:
+        _trace_buffer().append({'ph': 'E', 'ts': time.perf_counter() * 1e6,
+                                'pid': os.getpid(), 'tid': threading.get_native_id()})
+
+def traced(func, *args):
+    """Call func(*args) inside a trace span named after it"""
+    trace_begin(func.__name__)
+    try:
+        return func(*args)
+    finally:
+        trace_end()
+
+def write_trace():
+    """Write (and reset) every span recorded since the last write"""
+    if not TRACE_PATH:
+        return
+    events = [{'name': 'process_name', 'ph': 'M', 'pid': os.getpid(), 'tid': 0,
+               'args': {'name': 'main.py'}}]
+    for buffer in list(_trace_buffers):
+        events.extend(buffer)
+        del buffer[:len(buffer)]
+    with open(TRACE_PATH, 'w') as f:
+        json.dump({'traceEvents': events, 'displayTimeUnit': 'ms'}, f)
+
+def merge_helper_trace(helper_trace):
+    """Append a helper's --trace output to this thread's spans and delete the file"""
+    try:
+        with open(helper_trace) as f:
+            _trace_buffer().extend(json.load(f).get('traceEvents', []))
+    except (OSError, ValueError):
+        pass
+    os.remove(helper_trace)
+
+def find_native_helper(name):
+    """Locate a native helper binary next to main.py or in the current directory"""
+    exe_name = name + '.exe' if IS_WINDOWS else name
+    for base in (os.path.dirname(os.path.abspath(__file__)), os.getcwd()):
+        path = os.path.join(base, exe_name)
+        if os.path.exists(path):
+            return path
+    return None
+
+# Share of the subprocess timeout handed to a helper as --deadline-ms; the rest
+# covers process start-up and JSON output so partial results arrive in time
+HELPER_DEADLINE_FRACTION = 0.8
+
+def run_native_helper(name, args=(), timeout=5):
+    """
+    Run a native helper and return its parsed JSON output.
+    The helper gets a deadline inside 'timeout' and reports skipped sources in
+    'skipped'/'truncated' instead of being killed.
+    Returns None if the helper is missing or exits with an error; JSON errors propagate.
+    """
+    helper_path = find_native_helper(name)
+    if not helper_path:
+        return None
+    
+    cmd = [helper_path] + list(args)
+    cmd += ['--deadline-ms', str(int(timeout * 1000 * HELPER_DEADLINE_FRACTION))]
+    if REPLAY_ROOT:
+        cmd += ['--replay', REPLAY_ROOT]
+    
+    helper_trace = None
+    if TRACE_PATH:
+        fd, helper_trace = tempfile.mkstemp(prefix=name + '-', suffix='.json')
+        os.close(fd)
+        cmd += ['--trace', helper_trace]
+    
+    trace_begin(name, 'subprocess')
+    try:
+        result = subprocess.run(cmd, capture_output=True, text=True, timeout=timeout)
+    finally:
+        trace_end()
+        if helper_trace:
+            merge_helper_trace(helper_trace)
+    
+    if result.returncode != 0:
+        return None
+    return json.loads(result.stdout)
+
 def get_memory_info():
     mem = psutil.virtual_memory()
     Total_Memory = mem.total / (1024 ** 3)
@@ -550,13 +660,8 @@ def get_spd_helper_info():
     }
     
     try:
-        spd_helper_path = os.path.join(os.path.dirname(__file__), 'spd_helper.exe')
-        if not os.path.exists(spd_helper_path):
-            return spd_info
-        
-        result = subprocess.run([spd_helper_path], capture_output=True, text=True, timeout=5)
-        if result.returncode == 0:
-            data = json.loads(result.stdout)
+        data = run_native_helper('spd_helper')
+        if data is not None:
             spd_info['dimms'] = data.get('dimms', [])
             spd_info['available'] = True
             spd_info['method'] = data.get('method', 'Unknown')
@@ -645,21 +750,10 @@ def read_cpuid_frequencies():
     if not IS_WINDOWS:
         return None
     
-    helper_path = os.path.join(os.path.dirname(__file__), 'cpuid_helper.exe')
-    
-    # Try current directory if not found in script directory
-    if not os.path.exists(helper_path):
-        helper_path = os.path.join(os.getcwd(), 'cpuid_helper.exe')
-    
-    if not os.path.exists(helper_path):
-        return None
-    
     try:
-        result = subprocess.run([helper_path], capture_output=True, text=True, timeout=5)
-        if result.returncode == 0:
-            data = json.loads(result.stdout.strip())
-            if data.get('success'):
-                return data
+        data = run_native_helper('cpuid_helper')
+        if data and data.get('success'):
+            return data
     except (subprocess.TimeoutExpired, json.JSONDecodeError, FileNotFoundError, OSError):
         pass
     
@@ -907,6 +1001,125 @@ def get_c_state_residency():
     
     return c_state_data
 
+def get_frequency_residency(apic_ids=None, interval_ms=500):
+    """
+    Get per-policy time-at-frequency histograms and transition rates from
+    cpufreq_helper (Linux cpufreq stats, sampled 'interval_ms' apart).
+    Policies the helper could not type are labelled from the CPUID APIC list
+    ('apic_ids', core_type 64 = P-core, 32 = E-core), and the policies are
+    summarised per core type. Returns None if cpufreq is unavailable.
+    """
+    try:
+        data = run_native_helper('cpufreq_helper', ['--interval-ms', str(interval_ms)],
+                                 timeout=interval_ms / 1000 + 4)
+    except (subprocess.TimeoutExpired, json.JSONDecodeError, OSError):
+        return None
+    if not data or not data.get('supported'):
+        return None
+
+    apic_types = {}
+    for core_info in apic_ids or []:
+        core_type = core_info.get('core_type', 0)
+        if core_type in (64, 32):
+            apic_types[core_info.get('index')] = 'P-core' if core_type == 64 else 'E-core'
+
+    policies = data.get('policies', [])
+    core_types = {}
+    for policy in policies:
+        cpus = policy.get('cpus', [])
+        if not policy.get('core_type') and cpus:
+            policy['core_type'] = apic_types.get(cpus[0])
+
+        summary = core_types.setdefault(policy.get('core_type') or 'All', {
+            'policies': 0, 'cpus': 0, 'capped': 0, 'min_mhz': None, 'max_mhz': None,
+            'mean_mhz': None, 'at_min_percent': None, 'at_max_percent': None, '_weight': 0,
+        })
+        summary['policies'] += 1
+        summary['cpus'] += len(cpus)
+        summary['capped'] += 1 if policy.get('capped') else 0
+        for key, pick in (('min_mhz', min), ('max_mhz', max)):
+            if policy.get(key) is not None:
+                summary[key] = policy[key] if summary[key] is None else pick(summary[key], policy[key])
+
+        # Average residency over the policies of this type, weighted by CPU count
+        if policy.get('mean_mhz') is not None:
+            weight = max(len(cpus), 1)
+            for key in ('mean_mhz', 'at_min_percent', 'at_max_percent'):
+                summary[key] = (summary[key] or 0) + policy[key] * weight
+            summary['_weight'] += weight
+
+    for summary in core_types.values():
+        weight = summary.pop('_weight')
+        if weight:
+            summary['mean_mhz'] = round(summary['mean_mhz'] / weight)
+            summary['at_min_percent'] = round(summary['at_min_percent'] / weight, 1)
+            summary['at_max_percent'] = round(summary['at_max_percent'] / weight, 1)
+
+    return {
+        'interval_ms': data.get('interval_ms', 0),
+        'window': 'interval' if data.get('interval_ms') else 'since_boot',
+        'core_types': [dict(core_type=name, **summary) for name, summary in core_types.items()],
+        'policies': policies,
+    }
+
+def format_topology_hierarchy(nodes, depth=1):
+    """Format cpuid_helper's topology_hierarchy tree as indented lines, one per node"""
+    text = ""
+    for node in nodes:
+        text += f"{'  ' * depth}{node['level'].replace('_', ' ').title()} {node['id']}"
+        if 'cpus' in node:
+            core_type = node.get('core_type', 0)
+            type_str = 'P-core' if core_type == 64 else ('E-core' if core_type == 32 else '')
+            text += f"{' (' + type_str + ')' if type_str else ''}: LP {', '.join(str(cpu) for cpu in node['cpus'])}\n"
+        else:
+            text += "\n" + format_topology_hierarchy(node.get('children', []), depth + 1)
+    return text
+
+def format_frequency_residency(residency):
+    """Format get_frequency_residency() output for the CPU tab and text report"""
+    text = "\n╔══════════════════════════════════════════════════════════════╗\n"
+    text += "║              FREQUENCY RESIDENCY                             ║\n"
+    text += "╚══════════════════════════════════════════════════════════════╝\n\n"
+    if residency['window'] == 'interval':
+        text += f"Window: {residency['interval_ms']:.0f} ms sample (cpufreq stats)\n\n"
+    else:
+        text += "Window: since boot (cpufreq stats)\n\n"
+
+    for summary in residency['core_types']:
+        text += f"{summary['core_type']} ({summary['cpus']} CPUs, {summary['policies']} policies): "
+        if summary['mean_mhz'] is not None:
+            text += (f"mean {summary['mean_mhz']} MHz, {summary['at_min_percent']}% at minimum, "
+                     f"{summary['at_max_percent']}% at maximum")
+        else:
+            text += "no residency statistics"
+        if summary['capped']:
+            text += f", {summary['capped']} capped below {summary['max_mhz']} MHz"
+        text += "\n"
+
+    for policy in residency['policies']:
+        cpus = policy.get('cpus', [])
+        cpu_range = f"{cpus[0]}-{cpus[-1]}" if len(cpus) > 1 else ''.join(str(c) for c in cpus)
+        text += f"\n  Policy {policy['policy']} (CPU {cpu_range}, {policy.get('core_type') or 'core type unknown'}): "
+        text += f"{policy.get('driver') or '?'}/{policy.get('governor') or '?'}"
+        if policy.get('epp'):
+            text += f", EPP {policy['epp']}"
+        text += "\n"
+        text += f"    Limits: {policy.get('scaling_min_mhz') or policy.get('min_mhz')}-"
+        text += f"{policy.get('scaling_max_mhz') or policy.get('max_mhz')} MHz"
+        text += f" (hardware {policy.get('min_mhz')}-{policy.get('max_mhz')} MHz)"
+        text += " CAPPED\n" if policy.get('capped') else "\n"
+        if not policy.get('stats'):
+            text += "    No residency statistics (driver does not export cpufreq stats)\n"
+            continue
+        if policy.get('mean_mhz') is not None:
+            text += (f"    Mean {policy['mean_mhz']} MHz, {policy['transitions_per_s']} transitions/s, "
+                     f"{policy['at_min_percent']}% at min, {policy['at_max_percent']}% at max\n")
+        for state in policy.get('residency', []):
+            if state['percent'] >= 1:
+                bar = '█' * int(state['percent'] / 5)
+                text += f"    {state['mhz']:5d} MHz {state['percent']:5.1f}% {bar}\n"
+    return text
+
 def get_detailed_cache_info():
     """Get cache information from OS-specific sources"""
     cache_info = {
@@ -1131,8 +1344,12 @@ def get_cpu_extended_info():
         'thermal_throttling': 'Unknown',
         'per_core_frequency': [],  # List of {core, frequency_mhz, percentage}
         'c_state_residency': [],   # List of {core, C0%, C1%, C6%, etc}
+        'frequency_residency': None, # {window, policies, core_types} from cpufreq stats
         'cache_sharing_groups': {}, # Summary: {l1d_instances, l2_instances, l3_instances}
-        'apic_ids': []             # List of {index, apic, core_type, l1d_group, l2_group, l3_group}
+        'apic_ids': [],            # List of {index, apic, core_type, l1d/l2/l3_group, package, die_group, die, tile, module, core, smt}
+        'topology_levels': [],     # CPUID 0xB/0x1F levels: {level, shift, logical_processors}
+        'topology_hierarchy': [],  # Tree of {level, id, children} from package down to cores with their cpus
+        'cpuid_features': {}       # {name: 0/1} decoded by cpuid_helper (waitpkg, monitorx, ...)
     }
     
     # Infer SMT status from logical vs physical core count
@@ -1396,9 +1613,17 @@ def get_cpu_extended_info():
             cache_sharing = cpuid_data.get('cache_sharing', {})
             if cache_sharing:
                 cpu_details['cache_sharing_groups'] = cache_sharing
+
+            # Module/tile/die hierarchy decoded from CPUID 0x1F (0xB: packages and cores only)
+            cpu_details['topology_levels'] = cpuid_data.get('topology_levels', [])
+            cpu_details['topology_hierarchy'] = cpuid_data.get('topology_hierarchy', [])
+            cpu_details['cpuid_features'] = cpuid_data.get('features', {})
     except:
         cpu_details['apic_ids'] = []
         cpu_details['cache_sharing_groups'] = {}
+        cpu_details['topology_levels'] = []
+        cpu_details['topology_hierarchy'] = []
+        cpu_details['cpuid_features'] = {}
         
         # Try to get TDP from OS-specific sources
         tdp_info = get_detailed_tdp_info()
@@ -1413,6 +1638,12 @@ def get_cpu_extended_info():
         except:
             pass
     
+    # Time-at-frequency per cpufreq policy, typed with the APIC topology
+    try:
+        cpu_details['frequency_residency'] = get_frequency_residency(cpu_details['apic_ids'])
+    except:
+        cpu_details['frequency_residency'] = None
+    
     return cpu_details
 
 def get_nvme_helper_info():
@@ -1427,13 +1658,8 @@ def get_nvme_helper_info():
         return nvme_info
     
     try:
-        nvme_helper_path = os.path.join(os.path.dirname(__file__), 'nvme_helper.exe')
-        if not os.path.exists(nvme_helper_path):
-            return nvme_info
-        
-        result = subprocess.run([nvme_helper_path], capture_output=True, text=True, timeout=5)
-        if result.returncode == 0:
-            data = json.loads(result.stdout)
+        data = run_native_helper('nvme_helper')
+        if data is not None:
             nvme_info['devices'] = data.get('nvme_devices', [])
             nvme_info['available'] = len(nvme_info['devices']) > 0
             nvme_info['method'] = data.get('method', 'Unknown')
@@ -1459,13 +1685,8 @@ def get_edid_helper_info():
         return edid_info
     
     try:
-        edid_helper_path = os.path.join(os.path.dirname(__file__), 'edid_helper.exe')
-        if not os.path.exists(edid_helper_path):
-            return edid_info
-        
-        result = subprocess.run([edid_helper_path], capture_output=True, text=True, timeout=5)
-        if result.returncode == 0:
-            data = json.loads(result.stdout)
+        data = run_native_helper('edid_helper')
+        if data is not None:
             edid_info['edid_devices'] = data.get('edid_devices', [])
             edid_info['available'] = len(edid_info['edid_devices']) > 0
     except json.JSONDecodeError:
@@ -2401,6 +2622,605 @@ def get_disk_info():
     
     return disks
 
+def get_os_display():
+    """OS name and build as shown in the Overview and Text Report tabs"""
+    if IS_WINDOWS:
+        win_ver = platform.win32_ver()
+        full_version = win_ver[1]
+        version_parts = full_version.split('.')
+        build_major = int(version_parts[2]) if len(version_parts) > 2 else 0
+        build_revision = version_parts[3] if len(version_parts) > 3 else "0"
+        
+        if build_major >= 22000:
+            os_name = "Windows 11"
+            if build_major >= 26100:
+                version_name = "25H2"
+            elif build_major >= 22631:
+                version_name = "23H2"
+            elif build_major >= 22621:
+                version_name = "22H2"
+            else:
+                version_name = "21H2"
+        else:
+            os_name = "Windows 10"
+            version_name = win_ver[0] if win_ver[0] else "Unknown"
+        
+        os_display = f"{os_name} Version {version_name}"
+        os_build = f"{build_major}.{build_revision}"
+    
+    elif IS_LINUX:
+        # Try to get Linux distribution info
+        try:
+            result = subprocess.run(['lsb_release', '-ds'], capture_output=True, text=True, timeout=5)
+            if result.returncode == 0:
+                os_display = result.stdout.strip().strip('"')
+            else:
+                os_display = f"{platform.system()} {platform.release()}"
+        except:
+            os_display = f"{platform.system()} {platform.release()}"
+        os_build = platform.version() if platform.version() else "N/A"
+        
+        # Special handling for Pi
+        if IS_PI:
+            os_display += " (Raspberry Pi)"
+    
+    elif IS_MAC:
+        os_display = f"macOS {platform.release()}"
+        os_build = platform.version() if platform.version() else "N/A"
+    
+    else:
+        os_display = f"{platform.system()} {platform.release()}"
+        os_build = "N/A"
+    
+    return os_display, os_build
+
+def host_path(path):
+    """Absolute host path, mapped under the replay root when one is set"""
+    if REPLAY_ROOT:
+        return os.path.join(REPLAY_ROOT, path.lstrip('/'))
+    return path
+
+def read_host_file(path):
+    """Stripped contents of a host (sysfs/procfs) file, or None if unreadable"""
+    try:
+        with open(host_path(path), 'r', errors='replace') as f:
+            return f.read().strip()
+    except OSError:
+        return None
+
+def host_glob(pattern):
+    """Host paths matching 'pattern' (replay-relative paths are mapped back)"""
+    root = host_path('/')
+    return sorted('/' + os.path.relpath(p, root).replace(os.sep, '/') if REPLAY_ROOT else p
+                  for p in glob.glob(host_path(pattern)))
+
+def parse_cpu_list(text):
+    """'0-3,8,10-11' -> {0, 1, 2, 3, 8, 10, 11}"""
+    cpus = set()
+    for part in (text or '').split(','):
+        part = part.strip()
+        if '-' in part:
+            lo, hi = part.split('-', 1)
+            if lo.isdigit() and hi.isdigit():
+                cpus.update(range(int(lo), int(hi) + 1))
+        elif part.isdigit():
+            cpus.add(int(part))
+    return cpus
+
+def get_isolation_info(interval_ms=500):
+    """
+    CPU isolation settings (isolcpus, nohz_full, rcu_nocbs, irqaffinity, the
+    workqueue and default IRQ masks) and the IRQs, kernel threads and
+    workqueues found on the isolated CPUs, from isolation_helper sampling
+    'interval_ms' apart. Returns None if the helper is unavailable.
+    """
+    try:
+        data = run_native_helper('isolation_helper', ['--interval-ms', str(interval_ms)],
+                                 timeout=interval_ms / 1000 + 4)
+    except (subprocess.TimeoutExpired, json.JSONDecodeError, OSError):
+        return None
+    if not data or not data.get('supported'):
+        return None
+    for key in ('sources', 'skipped', 'truncated_fields', 'truncated', 'deadline_ms', 'elapsed_ms'):
+        data.pop(key, None)
+    return data
+
+def get_split_lock_info():
+    """
+    Split-lock and bus-lock handling: whether the CPU can trap them (the
+    split_lock_detect / bus_lock_detect flags in /proc/cpuinfo), the kernel
+    split_lock_detect= mode (off, warn, fatal or ratelimit:N; warn when the
+    command line does not set it) and split_lock_mitigate (1 = a task that
+    split-locks is also slowed down). Returns None if neither trap exists.
+    """
+    flags = set()
+    for line in (read_host_file('/proc/cpuinfo') or '').splitlines():
+        if line.startswith('flags'):
+            flags = set(line.split(':', 1)[1].split())
+            break
+    info = {
+        'split_lock_detect': 'split_lock_detect' in flags,
+        'bus_lock_detect': 'bus_lock_detect' in flags,
+        'mode': 'warn',
+        'mode_source': 'default',
+        'ratelimit': None,
+        'mitigate': None,
+    }
+    if not info['split_lock_detect'] and not info['bus_lock_detect']:
+        return None
+    for arg in (read_host_file('/proc/cmdline') or '').split():
+        if arg.startswith('split_lock_detect='):
+            mode = arg.split('=', 1)[1]
+            info['mode_source'] = 'cmdline'
+            if mode.startswith('ratelimit:'):
+                rate = mode.split(':', 1)[1]
+                mode, info['ratelimit'] = 'ratelimit', int(rate) if rate.isdigit() else None
+            info['mode'] = mode
+    mitigate = read_host_file('/proc/sys/kernel/split_lock_mitigate')
+    if mitigate and mitigate.isdigit():
+        info['mitigate'] = int(mitigate)
+    return info
+
+def get_tuning_info():
+    """
+    Performance-relevant OS settings for the configuration audit (audit_rules.txt):
+    cpufreq governors, THP mode, idle states, PCIe link training, NIC IRQ
+    placement, CPU isolation, split-lock detection, partition alignment and the
+    Windows power plan.
+    Linux settings are read from sysfs/procfs (or the replay root).
+    """
+    tuning = {
+        'cpufreq_driver': None,
+        'thp_enabled': None,
+        'thp_defrag': None,
+        'power_plan': None,
+        'cpu_governors': [],
+        'cpuidle_states': [],
+        'pcie_links': [],
+        'nic_irqs': [],
+        'partitions': [],
+        'isolation': None,
+        'split_lock': None,
+    }
+    
+    if IS_WINDOWS:
+        try:
+            result = subprocess.run(['powercfg', '/getactivescheme'], capture_output=True, text=True, timeout=5)
+            if result.returncode == 0 and '(' in result.stdout:
+                tuning['power_plan'] = result.stdout.rsplit('(', 1)[1].split(')', 1)[0].strip()
+        except (OSError, subprocess.TimeoutExpired):
+            pass
+        if HAS_WMI:
+            try:
+                c = wmi.WMI()
+                for part in c.Win32_DiskPartition():
+                    offset = int(part.StartingOffset or 0)
+                    tuning['partitions'].append({
+                        'partition': part.Name,
+                        'disk': f"PhysicalDrive{part.DiskIndex}",
+                        'offset_bytes': offset,
+                        'aligned_4k': offset % 4096 == 0,
+                        'aligned_1m': offset % (1 << 20) == 0,
+                        'nvme': None,  # bus type is not part of Win32_DiskPartition
+                    })
+            except Exception:
+                pass
+        return tuning
+    
+    if not IS_LINUX and not REPLAY_ROOT:
+        return tuning
+    
+    # cpufreq governors, grouped
+    governors = {}
+    for path in host_glob('/sys/devices/system/cpu/cpu[0-9]*/cpufreq/scaling_governor'):
+        name = read_host_file(path)
+        if name:
+            governors[name] = governors.get(name, 0) + 1
+    tuning['cpu_governors'] = [{'name': name, 'cpus': count} for name, count in sorted(governors.items())]
+    tuning['cpufreq_driver'] = read_host_file('/sys/devices/system/cpu/cpu0/cpufreq/scaling_driver')
+    
+    # THP: the active mode is the bracketed word ("always [madvise] never")
+    for key, name in (('thp_enabled', 'enabled'), ('thp_defrag', 'defrag')):
+        text = read_host_file(f'/sys/kernel/mm/transparent_hugepage/{name}') or ''
+        if '[' in text:
+            tuning[key] = text.split('[', 1)[1].split(']', 1)[0]
+    
+    # Idle states of CPU 0 (the same set is offered on every CPU)
+    for path in host_glob('/sys/devices/system/cpu/cpu0/cpuidle/state[0-9]*'):
+        latency = read_host_file(path + '/latency')
+        tuning['cpuidle_states'].append({
+            'name': read_host_file(path + '/name'),
+            'latency_us': int(latency) if latency and latency.isdigit() else None,
+            'disabled': read_host_file(path + '/disable') == '1',
+        })
+    
+    # PCIe link training: current vs maximum speed and width
+    for path in host_glob('/sys/bus/pci/devices/*'):
+        speed, max_speed = read_host_file(path + '/current_link_speed'), read_host_file(path + '/max_link_speed')
+        width, max_width = read_host_file(path + '/current_link_width'), read_host_file(path + '/max_link_width')
+        try:
+            link = {
+                'address': os.path.basename(path),
+                'class': read_host_file(path + '/class'),
+                'current_speed_gt': float(speed.split()[0]),
+                'max_speed_gt': float(max_speed.split()[0]),
+                'current_width': int(width),
+                'max_width': int(max_width),
+            }
+        except (AttributeError, ValueError, IndexError):
+            continue  # not a PCIe function, or the link state is "Unknown"
+        if link['current_width'] > 0:
+            tuning['pcie_links'].append(link)
+    
+    # NIC queue interrupts whose effective CPUs are all outside the NIC's NUMA node
+    node_cpus = {}
+    for path in host_glob('/sys/devices/system/node/node[0-9]*'):
+        node_cpus[int(os.path.basename(path)[4:])] = parse_cpu_list(read_host_file(path + '/cpulist'))
+    for path in host_glob('/sys/class/net/*'):
+        node = read_host_file(path + '/device/numa_node')
+        if node is None or not node.lstrip('-').isdigit() or int(node) < 0 or int(node) not in node_cpus:
+            continue
+        irqs = [os.path.basename(p) for p in host_glob(path + '/device/msi_irqs/*')]
+        off_node = 0
+        for irq in irqs:
+            affinity = (read_host_file(f'/proc/irq/{irq}/effective_affinity_list') or
+                        read_host_file(f'/proc/irq/{irq}/smp_affinity_list'))
+            cpus = parse_cpu_list(affinity)
+            if cpus and not cpus & node_cpus[int(node)]:
+                off_node += 1
+        tuning['nic_irqs'].append({
+            'interface': os.path.basename(path),
+            'numa_node': int(node),
+            'irqs': len(irqs),
+            'irqs_off_node': off_node,
+        })
+    
+    # CPU isolation: intended settings and what runs on the isolated CPUs
+    tuning['isolation'] = get_isolation_info()
+    
+    # Split-lock detection: a split-locked atomic stalls memory on every core
+    tuning['split_lock'] = get_split_lock_info()
+    
+    # Partition start offsets (sysfs reports 512-byte sectors)
+    for path in host_glob('/sys/block/*/*/start'):
+        start = read_host_file(path)
+        if not start or not start.isdigit():
+            continue
+        offset = int(start) * 512
+        disk = os.path.basename(os.path.dirname(os.path.dirname(path)))
+        tuning['partitions'].append({
+            'partition': os.path.basename(os.path.dirname(path)),
+            'disk': disk,
+            'offset_bytes': offset,
+            'aligned_4k': offset % 4096 == 0,
+            'aligned_1m': offset % (1 << 20) == 0,
+            'nvme': disk.startswith('nvme'),
+        })
+    
+    return tuning
+
+# Layout for the native text report (see report_renderer.c for the syntax)
+REPORT_TEMPLATE = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'report_template.txt')
+
+def build_report_snapshot(system_info, cpu_extended, memory_info, gpu_info, monitor_info,
+                          disk_info, network_info, nvme_info, edid_info, tuning_info,
+                          os_display, os_build):
+    """Collected sections in report order, as rendered by report_renderer"""
+    memory = dict(memory_info)
+    spd_helper = memory.get('spd_helper') or {}
+    if spd_helper.get('available') and spd_helper.get('dimms'):
+        memory.pop('modules', None)  # DIMM details replace the legacy module list
+    
+    return {
+        'generated': platform.node(),
+        'os_display': os_display,
+        'os_build': os_build,
+        'machine': platform.machine(),
+        'platform_detail': platform.platform(),
+        'python_version': platform.python_version(),
+        'processor': platform.processor(),
+        'system': system_info,
+        'cpu': cpu_extended,
+        'memory': memory,
+        'gpu': gpu_info,
+        'monitors': monitor_info,
+        'disks': disk_info,
+        'nvme': nvme_info,
+        'edid': edid_info,
+        'network': network_info,
+        'tuning': tuning_info,
+    }
+
+def _snapshot_chunks(value):
+    """
+    JSON text of a snapshot value, piece by piece. Every object lists its
+    scalar members before its nested objects and lists: report_renderer
+    streams the document and writes an object's lines when its first nested
+    container starts.
+    """
+    if isinstance(value, dict):
+        members = sorted(value.items(), key=lambda item: isinstance(item[1], (dict, list, tuple)))
+        yield '{'
+        for i, (key, member) in enumerate(members):
+            yield (', ' if i else '') + json.dumps(str(key)) + ': '
+            yield from _snapshot_chunks(member)
+        yield '}'
+    elif isinstance(value, (list, tuple)):
+        yield '['
+        for i, item in enumerate(value):
+            if i:
+                yield ', '
+            yield from _snapshot_chunks(item)
+        yield ']'
+    elif isinstance(value, float) and (value != value or value in (float('inf'), float('-inf'))):
+        yield 'null'
+    else:
+        try:
+            yield json.dumps(value)
+        except TypeError:
+            yield json.dumps(str(value))
+
+def render_text_report(snapshot, output_path=None, timeout=30):
+    """
+    Render the text report with the native report_renderer.
+    Writes the report to output_path and returns the path when one is given,
+    otherwise returns the report text.
+    Returns None if the renderer or its template is missing or rendering fails.
+    """
+    helper_path = find_native_helper('report_renderer')
+    if not helper_path or not os.path.exists(REPORT_TEMPLATE):
+        return None
+    
+    snapshot_path = write_snapshot(snapshot)
+    
+    target = output_path
+    if target is None:
+        fd, target = tempfile.mkstemp(prefix='report-', suffix='.txt')
+        os.close(fd)
+    
+    cmd = [helper_path, '--template', REPORT_TEMPLATE, '--output', target, snapshot_path]
+    helper_trace = None
+    if TRACE_PATH:
+        fd, helper_trace = tempfile.mkstemp(prefix='report_renderer-', suffix='.json')
+        os.close(fd)
+        cmd += ['--trace', helper_trace]
+    
+    trace_begin('report_renderer', 'subprocess')
+    try:
+        result = subprocess.run(cmd, capture_output=True, timeout=timeout)
+        if result.returncode != 0:
+            return None
+        if output_path is not None:
+            return output_path
+        with open(target, encoding='utf-8', errors='replace') as f:
+            return f.read()
+    except (subprocess.TimeoutExpired, OSError):
+        return None
+    finally:
+        trace_end()
+        if helper_trace:
+            merge_helper_trace(helper_trace)
+        os.remove(snapshot_path)
+        if output_path is None and os.path.exists(target):
+            os.remove(target)
+
+# Rules checked by the configuration audit (see rules_engine.c for the syntax)
+AUDIT_RULES = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'audit_rules.txt')
+
+def write_snapshot(snapshot, path=None):
+    """Write a snapshot as JSON (to a temporary file unless 'path' is given) and return the path"""
+    if path is None:
+        fd, path = tempfile.mkstemp(prefix='snapshot-', suffix='.json')
+        f = os.fdopen(fd, 'w', encoding='utf-8')
+    else:
+        f = open(path, 'w', encoding='utf-8')
+    with f:
+        f.writelines(_snapshot_chunks(snapshot))
+    return path
+
+def run_audit(snapshot, timeout=10):
+    """
+    Check a report snapshot against audit_rules.txt with the native rules_engine.
+    HALFAX_HOST_ROLE (e.g. latency, database) enables the role-specific rules.
+    Returns the host result (findings, passed/not_applicable counts), or None
+    if the engine or its rules are missing or the audit fails.
+    """
+    helper_path = find_native_helper('rules_engine')
+    if not helper_path or not os.path.exists(AUDIT_RULES):
+        return None
+    
+    snapshot_path = write_snapshot(snapshot)
+    cmd = [helper_path, '--rules', AUDIT_RULES, snapshot_path]
+    role = os.environ.get('HALFAX_HOST_ROLE')
+    if role:
+        cmd += ['--define', f'role={role}']
+    helper_trace = None
+    if TRACE_PATH:
+        fd, helper_trace = tempfile.mkstemp(prefix='rules_engine-', suffix='.json')
+        os.close(fd)
+        cmd += ['--trace', helper_trace]
+    
+    trace_begin('rules_engine', 'subprocess')
+    try:
+        result = subprocess.run(cmd, capture_output=True, text=True, timeout=timeout)
+        if result.returncode != 0:
+            return None
+        hosts = json.loads(result.stdout).get('hosts') or [None]
+        return hosts[0]
+    except (subprocess.TimeoutExpired, OSError, ValueError):
+        return None
+    finally:
+        trace_end()
+        if helper_trace:
+            merge_helper_trace(helper_trace)
+        os.remove(snapshot_path)
+
+def attach_audit(snapshot, audit):
+    """The snapshot with 'audit' placed after the header fields, so the report shows it first"""
+    if audit is None:
+        return snapshot
+    scalars = {k: v for k, v in snapshot.items() if not isinstance(v, (dict, list, tuple))}
+    return {**scalars, 'audit': audit, **{k: v for k, v in snapshot.items() if k not in scalars}}
+
+# Sections collected by a refresh, and the collector for each
+SECTION_COLLECTORS = {
+    'system': get_system_info,
+    'brand': get_cpu_info_cores,
+    'os': get_os_display,
+    'memory': get_memory_extended_info,
+    'cpu': get_cpu_extended_info,
+    'disk': get_disk_info,
+    'network': get_network_info,
+    'tuning': get_tuning_info,
+    'gpu': get_gpu_info,
+    'monitor': get_monitor_info,
+    'pci': get_pci_topology,
+    'nvme': get_nvme_helper_info,
+    'edid': get_edid_helper_info,
+}
+
+# Collection order: Overview inputs first, slow helper probes (SMART, EDID) last.
+# HALFAX_SECTION_PRIORITY=name,name,... moves the listed sections to the front.
+SECTION_PRIORITY = ['system', 'brand', 'os', 'memory', 'cpu', 'disk', 'network',
+                    'tuning', 'gpu', 'monitor', 'pci', 'nvme', 'edid']
+
+# How often the GUI picks up sections finished by the collection thread (ms)
+SECTION_POLL_MS = 15
+
+# Sections each tab needs; a tab is drawn as soon as all of them are in
+TAB_SECTIONS = {
+    'overview': ('system', 'brand', 'os', 'memory'),
+    'cpu': ('cpu',),
+    'memory': ('memory',),
+    'gpu': ('gpu', 'monitor'),
+    'disk': ('disk',),
+    'storage': ('nvme',),
+    'display': ('edid',),
+    'architecture': ('pci',),
+    'network': ('network',),
+    'report': ('system', 'os', 'cpu', 'memory', 'gpu', 'monitor', 'disk', 'nvme', 'edid', 'network',
+               'tuning'),
+}
+
+def section_priority():
+    """SECTION_PRIORITY with the sections named in HALFAX_SECTION_PRIORITY moved to the front"""
+    override = [name.strip() for name in os.environ.get('HALFAX_SECTION_PRIORITY', '').split(',')
+                if name.strip() in SECTION_COLLECTORS]
+    return override + [name for name in SECTION_PRIORITY if name not in override]
+
+def collect_sections(order, deliver):
+    """
+    Run the collector of each section in 'order' and call deliver(name, value)
+    as soon as it returns. A collector that raises is reported on stderr and
+    its section is skipped. Safe to run on a worker thread.
+    """
+    com = None
+    if IS_WINDOWS and HAS_WMI:
+        # WMI needs COM initialised on every thread that uses it
+        try:
+            import pythoncom
+            pythoncom.CoInitialize()
+            com = pythoncom
+        except ImportError:
+            pass
+    try:
+        for name in order:
+            try:
+                value = traced(SECTION_COLLECTORS[name])
+            except Exception:
+                traceback.print_exc()
+                continue
+            deliver(name, value)
+    finally:
+        if com:
+            com.CoUninitialize()
+
+def collect_report_snapshot():
+    """Collect every report section without the GUI; returns the snapshot, or None on failure"""
+    sections = {}
+    collect_sections([name for name in section_priority() if name in TAB_SECTIONS['report']],
+                     sections.__setitem__)
+    missing = [name for name in TAB_SECTIONS['report'] if name not in sections]
+    if missing:
+        print(f"Collection failed for: {', '.join(missing)}", file=sys.stderr)
+        return None
+    os_display, os_build = sections['os']
+    return build_report_snapshot(sections['system'], sections['cpu'], sections['memory'],
+                                 sections['gpu'], sections['monitor'], sections['disk'],
+                                 sections['network'], sections['nvme'], sections['edid'],
+                                 sections['tuning'], os_display, os_build)
+
+def export_report(path):
+    """Collect every section and write the text report to 'path' without the GUI"""
+    trace_begin('export_report', 'scheduler')
+    snapshot = collect_report_snapshot()
+    rendered = None
+    if snapshot is not None:
+        rendered = render_text_report(attach_audit(snapshot, run_audit(snapshot)), path)
+    trace_end()
+    write_trace()
+    if snapshot is None:
+        return 1
+    if rendered is None:
+        print("report_renderer (or report_template.txt) not found or failed; "
+              "build it with build_report_renderer.bat", file=sys.stderr)
+        return 1
+    return 0
+
+def export_snapshot(path):
+    """Collect every section and save the snapshot JSON (e.g. for a fleet audit archive)"""
+    trace_begin('export_snapshot', 'scheduler')
+    snapshot = collect_report_snapshot()
+    if snapshot is not None:
+        write_snapshot(snapshot, path)
+    trace_end()
+    write_trace()
+    return 0 if snapshot is not None else 1
+
+def export_audit(path):
+    """Collect every section and write the configuration audit result as JSON ('-' for stdout)"""
+    trace_begin('export_audit', 'scheduler')
+    snapshot = collect_report_snapshot()
+    audit = run_audit(snapshot) if snapshot is not None else None
+    trace_end()
+    write_trace()
+    if snapshot is None:
+        return 1
+    if audit is None:
+        print("rules_engine (or audit_rules.txt) not found or failed; "
+              "build it with build_rules_engine.bat", file=sys.stderr)
+        return 1
+    text = json.dumps(audit, indent=2)
+    if path == '-':
+        print(text)
+    else:
+        with open(path, 'w', encoding='utf-8') as f:
+            f.write(text + '\n')
+    return 0
+
+# Native benchmarks (bench_<name>) measure the live host for seconds to minutes,
+# so they only run on request: python main.py --bench NAME [ARGS...]
+BENCHMARK_TIMEOUT = 600
+
+def run_benchmark(name, args=(), timeout=BENCHMARK_TIMEOUT):
+    """Run bench_<name> with 'args'; returns its JSON result, or None if it is missing or fails"""
+    try:
+        return run_native_helper('bench_' + name, args, timeout=timeout)
+    except (subprocess.TimeoutExpired, json.JSONDecodeError, OSError):
+        return None
+
+def export_benchmark(name, args):
+    """Run one benchmark and print its JSON result to stdout"""
+    trace_begin('bench_' + name, 'scheduler')
+    result = run_benchmark(name, args)
+    trace_end()
+    write_trace()
+    if result is None:
+        print(f"bench_{name} not found or failed; build it with build_bench_{name}.bat", file=sys.stderr)
+        return 1
+    print(json.dumps(result, indent=2))
+    return 0
+
 def create_gui():
     import tkinter as tk
     from tkinter import ttk, scrolledtext
@@ -2497,69 +3317,97 @@ def create_gui():
     # Storage for text widgets and info
     text_widgets = {}
     
+    # Sections of the refresh in flight, and the tabs already drawn from them
+    refresh_state = {'generation': 0, 'sections': {}, 'rendered': set(), 'active': False}
+    
     def refresh_all_tabs():
-        """Refresh data for all tabs"""
-        # Collect fresh system information
-        memory_info = get_memory_extended_info()
-        brand, Arch = get_cpu_info_cores()
-        cpu_extended = get_cpu_extended_info()
-        gpu_info = get_gpu_info()
-        monitor_info = get_monitor_info()
-        disk_info = get_disk_info()
-        system_info = get_system_info()
-        network_info = get_network_info()
+        """
+        Start a refresh: sections are collected on a worker thread in
+        section_priority() order and each tab is drawn as soon as its inputs
+        (TAB_SECTIONS) arrive, so the window stays interactive throughout.
+        """
+        if refresh_state['active']:
+            trace_end()  # refresh_all_tabs of the superseded refresh
+        refresh_state['generation'] += 1
+        refresh_state['sections'] = {}
+        refresh_state['rendered'] = set()
+        refresh_state['active'] = True
         
-        # Get OS version info (cross-platform)
-        if IS_WINDOWS:
-            win_ver = platform.win32_ver()
-            full_version = win_ver[1]
-            version_parts = full_version.split('.')
-            build_major = int(version_parts[2]) if len(version_parts) > 2 else 0
-            build_revision = version_parts[3] if len(version_parts) > 3 else "0"
-            
-            if build_major >= 22000:
-                os_name = "Windows 11"
-                if build_major >= 26100:
-                    version_name = "25H2"
-                elif build_major >= 22631:
-                    version_name = "23H2"
-                elif build_major >= 22621:
-                    version_name = "22H2"
-                else:
-                    version_name = "21H2"
-            else:
-                os_name = "Windows 10"
-                version_name = win_ver[0] if win_ver[0] else "Unknown"
-            
-            os_display = f"{os_name} Version {version_name}"
-            os_build = f"{build_major}.{build_revision}"
+        for widget in text_widgets.values():
+            if not widget.get('1.0', 'end-1c'):
+                widget.configure(state='normal')
+                widget.insert('1.0', "Collecting system information...")
+                widget.configure(state='disabled')
+        
+        trace_begin('refresh_all_tabs', 'scheduler')
+        results = queue.Queue()
+        
+        def worker():
+            collect_sections(section_priority(), lambda name, value: results.put((name, value)))
+            results.put(None)  # done
+        
+        threading.Thread(target=worker, name='collect_sections', daemon=True).start()
+        root.after(SECTION_POLL_MS, poll_sections, refresh_state['generation'], results)
+    
+    def poll_sections(generation, results):
+        """Draw the tabs whose sections have arrived; reschedules itself until collection ends"""
+        if generation != refresh_state['generation']:
+            return  # superseded by a newer refresh
         
-        elif IS_LINUX:
-            # Try to get Linux distribution info
+        arrived = False
+        finished = False
+        while True:
             try:
-                result = subprocess.run(['lsb_release', '-ds'], capture_output=True, text=True, timeout=5)
-                if result.returncode == 0:
-                    os_display = result.stdout.strip().strip('"')
-                else:
-                    os_display = f"{platform.system()} {platform.release()}"
-            except:
-                os_display = f"{platform.system()} {platform.release()}"
-            os_build = platform.version() if platform.version() else "N/A"
-            
-            # Special handling for Pi
-            if IS_PI:
-                os_display += " (Raspberry Pi)"
+                item = results.get_nowait()
+            except queue.Empty:
+                break
+            if item is None:
+                finished = True
+                break
+            refresh_state['sections'][item[0]] = item[1]
+            arrived = True
         
-        elif IS_MAC:
-            os_display = f"macOS {platform.release()}"
-            os_build = platform.version() if platform.version() else "N/A"
+        if arrived:
+            render_ready_tabs()
+        if not finished:
+            root.after(SECTION_POLL_MS, poll_sections, generation, results)
+            return
         
-        else:
-            os_display = f"{platform.system()} {platform.release()}"
-            os_build = "N/A"
+        for name, widget in text_widgets.items():
+            if name not in refresh_state['rendered']:
+                widget.configure(state='normal')
+                widget.delete('1.0', tk.END)
+                widget.insert('1.0', "Not available: a collector for this tab failed (see console output).")
+                widget.configure(state='disabled')
+        refresh_state['active'] = False
+        trace_end()  # refresh_all_tabs
+        write_trace()
+    
+    def tab_ready(name):
+        """True once for each tab whose sections have all arrived"""
+        if name not in text_widgets or name in refresh_state['rendered']:
+            return False
+        if any(section not in refresh_state['sections'] for section in TAB_SECTIONS[name]):
+            return False
+        refresh_state['rendered'].add(name)
+        return True
+    
+    def render_ready_tabs():
+        """Draw every tab whose sections are all in and that is not drawn yet"""
+        trace_begin('render', 'scheduler')
+        sections = refresh_state['sections']
+        memory_info = sections.get('memory')
+        brand, Arch = sections.get('brand', (None, None))
+        cpu_extended = sections.get('cpu')
+        gpu_info = sections.get('gpu')
+        monitor_info = sections.get('monitor')
+        disk_info = sections.get('disk')
+        system_info = sections.get('system')
+        network_info = sections.get('network')
+        os_display, os_build = sections.get('os', (None, None))
         
         # Update Overview tab
-        if 'overview' in text_widgets:
+        if tab_ready('overview'):
             overview_text = text_widgets['overview']
             overview_text.configure(state='normal')
             overview_text.delete('1.0', tk.END)
@@ -2643,7 +3491,7 @@ Available Memory:  {memory_info['available']:.2f} GB
             overview_text.configure(state='disabled')
         
         # Update CPU tab
-        if 'cpu' in text_widgets:
+        if tab_ready('cpu'):
             cpu_text = text_widgets['cpu']
             cpu_text.configure(state='normal')
             cpu_text.delete('1.0', tk.END)
@@ -2711,6 +3559,10 @@ Socket:            {cpu_extended['socket']}
                     c1_plus = core_data.get('C1+', 0)
                     cpu_content += f"  Core {core:2d}: C0={c0:3d}% (active)  C1+={c1_plus:3d}% (idle)\n"
             
+            # Add frequency residency (cpufreq stats)
+            if cpu_extended.get('frequency_residency'):
+                cpu_content += format_frequency_residency(cpu_extended['frequency_residency'])
+            
             # Add APIC topology and cache sharing groups
             if cpu_extended.get('cache_sharing_groups'):
                 cpu_content += "\n╔══════════════════════════════════════════════════════════════╗\n"
@@ -2738,6 +3590,17 @@ Socket:            {cpu_extended['socket']}
                         type_str = 'P-core' if core_type == 64 else ('E-core' if core_type == 32 else 'Unknown')
                         cpu_content += f"  LP{lp:2d} (APIC {apic:3d}, {type_str}): L2 Group {l2_grp}\n"
 
+            # Add the package/die/module/core tree from CPUID 0x1F
+            if cpu_extended.get('topology_hierarchy'):
+                levels = ', '.join(level['level'] for level in cpu_extended.get('topology_levels', []))
+                cpu_content += f"\nTopology Hierarchy (CPUID levels: {levels or 'unknown'}):\n"
+                cpu_content += format_topology_hierarchy(cpu_extended['topology_hierarchy'])
+
+            # CPUID feature bits the benchmarks and tuning care about
+            if cpu_extended.get('cpuid_features'):
+                present = [name for name, value in cpu_extended['cpuid_features'].items() if value]
+                cpu_content += f"\nCPUID Features: {', '.join(present) if present else 'none of the tracked features'}\n"
+
             # Add temperature if available
             if cpu_extended['temperatures']:
                 cpu_content += "\nTEMPERATURE:\n"
@@ -2811,7 +3674,7 @@ Socket:            {cpu_extended['socket']}
             cpu_text.configure(state='disabled')
         
         # Update Memory tab
-        if 'memory' in text_widgets:
+        if tab_ready('memory'):
             memory_text = text_widgets['memory']
             memory_text.configure(state='normal')
             memory_text.delete('1.0', tk.END)
@@ -3016,7 +3879,7 @@ NUMA Mapping:      {memory_info.get('numa_mapping', 'Not reported by system API'
             memory_text.configure(state='disabled')
         
         # Update GPU tab
-        if 'gpu' in text_widgets:
+        if tab_ready('gpu'):
             gpu_text = text_widgets['gpu']
             gpu_text.configure(state='normal')
             gpu_text.delete('1.0', tk.END)
@@ -3128,7 +3991,7 @@ NUMA Mapping:      {memory_info.get('numa_mapping', 'Not reported by system API'
             gpu_text.configure(state='disabled')
         
         # Update Disk tab
-        if 'disk' in text_widgets:
+        if tab_ready('disk'):
             disk_text = text_widgets['disk']
             disk_text.configure(state='normal')
             disk_text.delete('1.0', tk.END)
@@ -3179,7 +4042,7 @@ NUMA Mapping:      {memory_info.get('numa_mapping', 'Not reported by system API'
             disk_text.configure(state='disabled')
         
         # Update Storage tab (Phase 2 - NVMe SMART)
-        if 'storage' in text_widgets:
+        if tab_ready('storage'):
             storage_text = text_widgets['storage']
             storage_text.configure(state='normal')
             storage_text.delete('1.0', tk.END)
@@ -3191,7 +4054,7 @@ NUMA Mapping:      {memory_info.get('numa_mapping', 'Not reported by system API'
 
 """
             
-            nvme_info = get_nvme_helper_info()
+            nvme_info = sections['nvme']
             
             if isinstance(nvme_info, dict) and 'error' in nvme_info:
                 storage_content += f"Error: {nvme_info['error']}\n"
@@ -3241,7 +4104,7 @@ NUMA Mapping:      {memory_info.get('numa_mapping', 'Not reported by system API'
             storage_text.configure(state='disabled')
         
         # Update Display tab (Phase 3 - EDID Information)
-        if 'display' in text_widgets:
+        if tab_ready('display'):
             display_text = text_widgets['display']
             display_text.configure(state='normal')
             display_text.delete('1.0', tk.END)
@@ -3253,7 +4116,7 @@ NUMA Mapping:      {memory_info.get('numa_mapping', 'Not reported by system API'
 
 """
             
-            edid_info = get_edid_helper_info()
+            edid_info = sections['edid']
             
             if isinstance(edid_info, dict) and 'error' in edid_info and edid_info['error']:
                 display_content += f"Error: {edid_info['error']}\n"
@@ -3311,7 +4174,7 @@ NUMA Mapping:      {memory_info.get('numa_mapping', 'Not reported by system API'
             display_text.configure(state='disabled')
         
         # Update System Architecture tab (Phase 3 - PCI Topology)
-        if 'architecture' in text_widgets:
+        if tab_ready('architecture'):
             arch_text = text_widgets['architecture']
             arch_text.configure(state='normal')
             arch_text.delete('1.0', tk.END)
@@ -3323,7 +4186,7 @@ NUMA Mapping:      {memory_info.get('numa_mapping', 'Not reported by system API'
 
 """
             
-            pci_info = get_pci_topology()
+            pci_info = sections['pci']
             
             arch_content += """
 PCI DEVICE TREE:
@@ -3370,7 +4233,7 @@ PCI DEVICE TREE:
             arch_text.configure(state='disabled')
         
         # Update Network tab
-        if 'network' in text_widgets:
+        if tab_ready('network'):
             network_text = text_widgets['network']
             network_text.configure(state='normal')
             network_text.delete('1.0', tk.END)
@@ -3434,8 +4297,25 @@ PCI DEVICE TREE:
             network_text.insert('1.0', network_content)
             network_text.configure(state='disabled')
         
-        # Update Text Report tab
-        if 'report' in text_widgets:
+        # Update Text Report tab: the native renderer streams it section by
+        # section; the f-string report below is the fallback when it is not built
+        report_ready = tab_ready('report')
+        native_report = None
+        if report_ready:
+            snapshot = build_report_snapshot(
+                system_info, cpu_extended, memory_info, gpu_info, monitor_info,
+                disk_info, network_info, sections['nvme'], sections['edid'],
+                sections['tuning'], os_display, os_build)
+            audit = run_audit(snapshot)
+            native_report = render_text_report(attach_audit(snapshot, audit))
+        
+        if native_report is not None:
+            report_text = text_widgets['report']
+            report_text.configure(state='normal')
+            report_text.delete('1.0', tk.END)
+            report_text.insert('1.0', native_report)
+            report_text.configure(state='disabled')
+        elif report_ready:
             report_text = text_widgets['report']
             report_text.configure(state='normal')
             report_text.delete('1.0', tk.END)
@@ -3541,6 +4421,10 @@ Socket:            {cpu_extended['socket']}
                     c1_plus = core_data.get('C1+', 0)
                     report_content += f"  Core {core:2d}: C0={c0:3d}% (active)  C1+={c1_plus:3d}% (idle)\n"
             
+            # Add frequency residency (cpufreq stats)
+            if cpu_extended.get('frequency_residency'):
+                report_content += format_frequency_residency(cpu_extended['frequency_residency'])
+            
             # Add APIC topology and cache sharing groups to text report
             if cpu_extended.get('cache_sharing_groups'):
                 report_content += "\n╔══════════════════════════════════════════════════════════════╗\n"
@@ -3906,7 +4790,7 @@ NUMA Mapping:      {memory_info.get('numa_mapping', 'Not reported by system API'
                 report_content += "No disk information available\n"
             
             # Add NVMe SMART information to report (Phase 2)
-            nvme_info = get_nvme_helper_info()
+            nvme_info = sections['nvme']
             report_content += """
 ════════════════════════════════════════════════════════════════
  NVMe SMART INFORMATION
@@ -3959,7 +4843,7 @@ NUMA Mapping:      {memory_info.get('numa_mapping', 'Not reported by system API'
                 report_content += "NVMe helper not available or no SMART data collected\n"
             
             # Add EDID display information to report (Phase 3)
-            edid_info = get_edid_helper_info()
+            edid_info = sections['edid']
             report_content += """
 ════════════════════════════════════════════════════════════════
  DISPLAY & EDID INFORMATION
@@ -4058,13 +4942,31 @@ NUMA Mapping:      {memory_info.get('numa_mapping', 'Not reported by system API'
                     report_content += f"  Active Connections: {network_info.get('connections', 0)}\n"
                 else:
                     report_content += "No network interfaces detected\n"
-            
+
+            # Add configuration audit findings
+            if audit is not None:
+                report_content += "\n" + "═" * 64 + "\n"
+                report_content += " CONFIGURATION AUDIT\n"
+                report_content += "═" * 64 + "\n\n"
+                report_content += (f"Rules Passed:      {audit['passed']} of {audit['rules']} "
+                                   f"({audit['not_applicable']} not applicable)\n\n")
+                for finding in audit['findings']:
+                    report_content += f"{finding['severity'].upper()}: {finding['title']}\n"
+                    report_content += f"  {finding['message']}\n"
+                    if finding['fix']:
+                        report_content += f"  Fix: {finding['fix']}\n"
+                    report_content += "\n"
+                if not audit['findings']:
+                    report_content += "No configuration problems found\n"
+
             report_content += "\n" + "═" * 64 + "\n"
             report_content += "End of Report\n"
             report_content += "═" * 64 + "\n"
             
             report_text.insert('1.0', report_content)
             report_text.configure(state='disabled')
+        
+        trace_end()  # render
     
     # System Overview Tab
     overview_frame = ttk.Frame(notebook)
@@ -4156,14 +5058,44 @@ NUMA Mapping:      {memory_info.get('numa_mapping', 'Not reported by system API'
     report_text.pack(fill='both', expand=True, padx=10, pady=10)
     text_widgets['report'] = report_text
     
-    # Populate all tabs with initial data
-    refresh_all_tabs()
-    
-    # Close splash screen and show main window
+    # Show the main window right away; tabs fill in as their sections arrive
     splash.destroy()
-    root.deiconify()  # Show the main window
+    root.deiconify()
+    refresh_all_tabs()
     
     root.mainloop()
         
+def option_value(flag, metavar):
+    """The argument after 'flag' on the command line; exits with a usage error if it is missing"""
+    index = sys.argv.index(flag)
+    if index + 1 >= len(sys.argv) or sys.argv[index + 1].startswith('--'):
+        print(f"usage: {os.path.basename(sys.argv[0])} {flag} {metavar}", file=sys.stderr)
+        sys.exit(2)
+    return sys.argv[index + 1]
+
 if __name__ == "__main__":
+    import sys
+    if '--replay' in sys.argv[1:]:
+        REPLAY_ROOT = option_value('--replay', 'DIR|ARCHIVE')
+    if REPLAY_ROOT:
+        # --replay and HALFAX_REPLAY_ROOT both take a directory or a capture archive
+        import tarfile
+        from capture_host import open_replay_root
+        try:
+            REPLAY_ROOT = open_replay_root(REPLAY_ROOT)
+        except (OSError, tarfile.TarError) as e:
+            print(f"Cannot open replay root {REPLAY_ROOT}: {e}", file=sys.stderr)
+            sys.exit(2)
+    if '--trace' in sys.argv[1:]:
+        TRACE_PATH = os.path.abspath(option_value('--trace', 'FILE'))
+    if '--bench' in sys.argv[1:-1]:
+        index = sys.argv.index('--bench')
+        sys.exit(export_benchmark(sys.argv[index + 1], sys.argv[index + 2:]))
+    if '--report' in sys.argv[1:]:
+        sys.exit(export_report(os.path.abspath(option_value('--report', 'FILE'))))
+    if '--snapshot' in sys.argv[1:]:
+        sys.exit(export_snapshot(os.path.abspath(option_value('--snapshot', 'FILE'))))
+    if '--audit' in sys.argv[1:]:
+        target = option_value('--audit', 'FILE|-')
+        sys.exit(export_audit(target if target == '-' else os.path.abspath(target)))
     create_gui()
\ No newline at end of file
@@ -11,6 +11,9 @@
 #include <stdint.h>
 #include <string.h>
 #include <setupapi.h>
+#include "helper_replay.h"
+#include "helper_trace.h"
+#include "helper_deadline.h"
 
 #pragma comment(lib, "setupapi.lib")
 #pragma comment(lib, "cfgmgr32.lib")
@@ -24,25 +27,23 @@
 #define NVME_OP_GET_FEATURES 0x0A
 #define NVME_OP_GET_LOG_PAGE 0x02
 
-// SMART/Health Information Log Page
-typedef struct {
-    uint8_t critical_warning;           // Byte 0
-    uint16_t composite_temperature;      // Bytes 1-2
-    uint8_t available_spare;             // Byte 3
-    uint8_t spare_threshold;             // Byte 4
-    uint8_t percentage_used;             // Byte 5
-    uint8_t reserved_6_7[2];
-    uint64_t data_units_read[2];         // Bytes 8-23 (128-bit)
-    uint64_t data_units_written[2];      // Bytes 24-39 (128-bit)
-    uint64_t host_read_commands[2];      // Bytes 40-55 (128-bit)
-    uint64_t host_write_commands[2];     // Bytes 56-71 (128-bit)
-    uint64_t controller_busy_time[2];    // Bytes 72-87 (128-bit)
-    uint64_t power_on_hours[2];          // Bytes 88-103 (128-bit)
-    uint8_t unsafe_shutdowns[4];         // Bytes 104-107
-    uint8_t media_errors[4];             // Bytes 108-111
-    uint8_t crc_errors[4];               // Bytes 112-115
-    uint8_t reserved_116_511[396];
-} NVMe_SMART_Info;
+// Number of PhysicalDrive<N> indices probed on a live host
+#define MAX_PHYSICAL_DRIVES 256
+
+// SMART/Health Information Log Page (log identifier 0x02, 512 bytes)
+// Byte offsets per the NVMe base specification; 128-bit counters are read as their low 64 bits
+#define NVME_LOG_PAGE_HEALTH 0x02
+#define NVME_LOG_PAGE_SIZE 512
+#define SMART_CRITICAL_WARNING 0
+#define SMART_COMPOSITE_TEMP 1          // 2 bytes, Kelvin
+#define SMART_AVAILABLE_SPARE 3
+#define SMART_SPARE_THRESHOLD 4
+#define SMART_PERCENTAGE_USED 5
+#define SMART_DATA_UNITS_READ 32        // 16 bytes, units of 1000 x 512 bytes
+#define SMART_DATA_UNITS_WRITTEN 48     // 16 bytes
+#define SMART_POWER_ON_HOURS 128        // 16 bytes
+#define SMART_UNSAFE_SHUTDOWNS 144      // 16 bytes
+#define SMART_MEDIA_ERRORS 160          // 16 bytes
 
 typedef struct {
     char device_name[64];           // e.g., "\\.\PHYSICALDRIVE0"
@@ -50,12 +51,26 @@ typedef struct {
     uint64_t capacity_bytes;
     int temperature_c;
     int wear_level_percent;
-    uint64_t data_units_written;    // In 512-byte units
+    uint64_t data_units_written;    // In units of 1000 x 512 bytes
     uint64_t power_on_hours;
     uint32_t media_errors;
+    int available_spare;
+    int critical_warning;
+    int smart_available;            // Health log page was read
     int available;
 } NVMe_Info;
 
+// Little-endian field readers for raw log pages
+static uint64_t read_le64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static uint16_t read_le16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
 // Helper to get temperature in Celsius from NVMe composite temp
 int get_temperature_c(uint16_t composite_temp) {
     // NVMe composite temperature: 0 = not reported, else Temp = (value - 273) K
@@ -87,70 +102,248 @@ int query_nvme_device(const char* device_path, NVMe_Info* info) {
     return 1;
 }
 
+// Query the storage device descriptor (bus type, product id) of an open drive.
+// Replayed from / captured to nvme/PhysicalDrive<N>/descriptor.bin.
+DWORD read_device_descriptor(HANDLE handle, int drive, uint8_t* buffer, DWORD size) {
+    char rel[64];
+    snprintf(rel, sizeof(rel), "nvme/PhysicalDrive%d/descriptor.bin", drive);
+    
+    if (replay_enabled()) {
+        size_t replay_size = 0;
+        uint8_t* data = replay_read_file(rel, &replay_size);
+        if (!data) return 0;
+        if (replay_size > size) replay_size = size;
+        memcpy(buffer, data, replay_size);
+        free(data);
+        return (DWORD)replay_size;
+    }
+    
+    STORAGE_PROPERTY_QUERY query;
+    DWORD bytes_returned = 0;
+    
+    memset(&query, 0, sizeof(query));
+    query.PropertyId = StorageDeviceProperty;
+    query.QueryType = PropertyStandardQuery;
+    
+    if (!DeviceIoControl(handle, IOCTL_STORAGE_QUERY_PROPERTY, &query, sizeof(query),
+                         buffer, size, &bytes_returned, NULL)) {
+        return 0;
+    }
+    
+    capture_write_file(rel, buffer, bytes_returned);
+    return bytes_returned;
+}
+
+// Read the SMART/Health log page through the Windows 10+ protocol-specific
+// storage query (no vendor passthrough driver needed).
+// Replayed from / captured to nvme/PhysicalDrive<N>/log_02.bin.
+int read_health_log(HANDLE handle, int drive, uint8_t* log) {
+    char rel[64];
+    snprintf(rel, sizeof(rel), "nvme/PhysicalDrive%d/log_%02x.bin", drive, NVME_LOG_PAGE_HEALTH);
+    
+    if (replay_enabled()) {
+        size_t replay_size = 0;
+        uint8_t* data = replay_read_file(rel, &replay_size);
+        if (!data) return 0;
+        int ok = replay_size >= NVME_LOG_PAGE_SIZE;
+        if (ok) memcpy(log, data, NVME_LOG_PAGE_SIZE);
+        free(data);
+        return ok;
+    }
+    
+    DWORD buffer_length = FIELD_OFFSET(STORAGE_PROPERTY_QUERY, AdditionalParameters) +
+                          sizeof(STORAGE_PROTOCOL_SPECIFIC_DATA) + NVME_LOG_PAGE_SIZE;
+    uint8_t* buffer = (uint8_t*)calloc(1, buffer_length);
+    if (!buffer) return 0;
+    
+    STORAGE_PROPERTY_QUERY* query = (STORAGE_PROPERTY_QUERY*)buffer;
+    STORAGE_PROTOCOL_SPECIFIC_DATA* protocol_data =
+        (STORAGE_PROTOCOL_SPECIFIC_DATA*)query->AdditionalParameters;
+    
+    query->PropertyId = StorageDeviceProtocolSpecificProperty;
+    query->QueryType = PropertyStandardQuery;
+    protocol_data->ProtocolType = ProtocolTypeNvme;
+    protocol_data->DataType = NVMeDataTypeLogPage;
+    protocol_data->ProtocolDataRequestValue = NVME_LOG_PAGE_HEALTH;
+    protocol_data->ProtocolDataRequestSubValue = 0;
+    protocol_data->ProtocolDataOffset = sizeof(STORAGE_PROTOCOL_SPECIFIC_DATA);
+    protocol_data->ProtocolDataLength = NVME_LOG_PAGE_SIZE;
+    
+    DWORD bytes_returned = 0;
+    int ok = DeviceIoControl(handle, IOCTL_STORAGE_QUERY_PROPERTY, buffer, buffer_length,
+                             buffer, buffer_length, &bytes_returned, NULL);
+    
+    if (ok) {
+        // The driver answers with a STORAGE_PROTOCOL_DATA_DESCRIPTOR in the same buffer
+        STORAGE_PROTOCOL_DATA_DESCRIPTOR* descriptor = (STORAGE_PROTOCOL_DATA_DESCRIPTOR*)buffer;
+        protocol_data = &descriptor->ProtocolSpecificData;
+        ok = descriptor->Version == sizeof(STORAGE_PROTOCOL_DATA_DESCRIPTOR) &&
+             descriptor->Size == sizeof(STORAGE_PROTOCOL_DATA_DESCRIPTOR) &&
+             protocol_data->ProtocolDataLength >= NVME_LOG_PAGE_SIZE;
+        if (ok) {
+            memcpy(log, (uint8_t*)protocol_data + protocol_data->ProtocolDataOffset, NVME_LOG_PAGE_SIZE);
+            capture_write_file(rel, log, NVME_LOG_PAGE_SIZE);
+        }
+    }
+    
+    free(buffer);
+    return ok;
+}
+
+// Fill SMART fields from a raw health log page
+void parse_health_log(const uint8_t* log, NVMe_Info* info) {
+    info->critical_warning = log[SMART_CRITICAL_WARNING];
+    info->temperature_c = get_temperature_c(read_le16(log + SMART_COMPOSITE_TEMP));
+    info->available_spare = log[SMART_AVAILABLE_SPARE];
+    info->wear_level_percent = log[SMART_PERCENTAGE_USED];
+    info->data_units_written = read_le64(log + SMART_DATA_UNITS_WRITTEN);
+    info->power_on_hours = read_le64(log + SMART_POWER_ON_HOURS);
+    info->media_errors = (uint32_t)read_le64(log + SMART_MEDIA_ERRORS);
+    info->smart_available = 1;
+}
+
+// Print a string as a JSON string literal (device paths contain backslashes)
+void print_json_string(const char* str) {
+    putchar('"');
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\') putchar('\\');
+        putchar(*str);
+    }
+    putchar('"');
+}
+
+static int replay_drive_cb(const char* name, int is_dir, void* ctx) {
+    int* slots = (int*)ctx;
+    int index;
+    if (is_dir && sscanf(name, "PhysicalDrive%d", &index) == 1 && index >= *slots) {
+        *slots = index + 1;
+    }
+    return 0;
+}
+
+// Number of PhysicalDrive indices to probe: everything present in the replay root,
+// or MAX_PHYSICAL_DRIVES on a live host (indices can have gaps after hot-removal)
+int count_drive_slots(void) {
+    if (!replay_enabled()) return MAX_PHYSICAL_DRIVES;
+    int slots = 0;
+    replay_list_dir("nvme", replay_drive_cb, &slots);
+    return slots;
+}
+
+// IOCTLs for one drive; runs under deadline_run() so a hung drive cannot stall the helper.
+// Heap-allocated: an abandoned query keeps using it after the caller moves on.
+typedef struct {
+    HANDLE handle;
+    int drive;
+    uint8_t descriptor[4096];
+    DWORD descriptor_size;
+    uint8_t log[NVME_LOG_PAGE_SIZE];
+    int have_log;
+} DriveQuery;
+
+static void query_drive_worker(void* ctx) {
+    DriveQuery* q = (DriveQuery*)ctx;
+    
+    // Check if it's an NVMe device by querying device properties
+    trace_begin("syscall", "read_device_descriptor");
+    q->descriptor_size = read_device_descriptor(q->handle, q->drive, q->descriptor, sizeof(q->descriptor));
+    trace_end();
+    
+    if (q->descriptor_size >= sizeof(STORAGE_DEVICE_DESCRIPTOR) &&
+        ((STORAGE_DEVICE_DESCRIPTOR*)q->descriptor)->BusType == BusTypeNvme) {
+        trace_begin("syscall", "read_health_log");
+        q->have_log = read_health_log(q->handle, q->drive, q->log);
+        trace_end();
+    }
+}
+
 // Get list of NVMe devices
-int enumerate_nvme_devices(NVMe_Info* devices, int max_devices) {
+int enumerate_nvme_devices(NVMe_Info* devices, int max_devices, int drive_slots) {
     int device_count = 0;
     
     // Try to find NVMe drives by checking physical drives
-    for (int i = 0; i < 8 && device_count < max_devices; i++) {
+    for (int i = 0; i < drive_slots && device_count < max_devices; i++) {
+        if (deadline_expired()) {
+            deadline_skip("physical_drives", "budget");
+            deadline_truncate("nvme_devices");
+            break;
+        }
+        
         char device_path[64];
         snprintf(device_path, sizeof(device_path), "\\\\.\\PhysicalDrive%d", i);
         
-        HANDLE handle = CreateFileA(
-            device_path,
-            GENERIC_READ,
-            FILE_SHARE_READ | FILE_SHARE_WRITE,
-            NULL,
-            OPEN_EXISTING,
-            0,
-            NULL
-        );
+        trace_begin_arg("probe", "physical_drive", "drive", i);
+        HANDLE handle = INVALID_HANDLE_VALUE;
+        if (!replay_enabled()) {
+            trace_begin("syscall", "CreateFileA");
+            handle = CreateFileA(
+                device_path,
+                GENERIC_READ,
+                FILE_SHARE_READ | FILE_SHARE_WRITE,
+                NULL,
+                OPEN_EXISTING,
+                0,
+                NULL
+            );
+            trace_end();
+            if (handle == INVALID_HANDLE_VALUE) {
+                trace_end();
+                continue;
+            }
+        }
         
-        if (handle != INVALID_HANDLE_VALUE) {
-            // Check if it's an NVMe device by querying device properties
-            STORAGE_PROPERTY_QUERY query;
-            DWORD bytes_returned = 0;
-            uint8_t buffer[4096];
-            
-            memset(&query, 0, sizeof(query));
-            query.PropertyId = StorageDeviceProperty;
-            query.QueryType = PropertyStandardQuery;
+        DriveQuery* q = (DriveQuery*)calloc(1, sizeof(DriveQuery));
+        if (!q) {
+            if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+            trace_end();
+            break;
+        }
+        q->handle = handle;
+        q->drive = i;
+        if (!deadline_run(query_drive_worker, q)) {
+            // The abandoned IOCTL still owns the handle and the query buffer
+            deadline_skip("physical_drives", "timeout");
+            deadline_truncate("nvme_devices");
+            trace_end();
+            break;
+        }
+        
+        if (q->descriptor_size >= sizeof(STORAGE_DEVICE_DESCRIPTOR)) {
+            // Parse device property to detect NVMe
+            STORAGE_DEVICE_DESCRIPTOR* desc = (STORAGE_DEVICE_DESCRIPTOR*)q->descriptor;
             
-            if (DeviceIoControl(
-                handle,
-                IOCTL_STORAGE_QUERY_PROPERTY,
-                &query,
-                sizeof(query),
-                buffer,
-                sizeof(buffer),
-                &bytes_returned,
-                NULL
-            )) {
-                // Parse device property to detect NVMe
-                STORAGE_DEVICE_DESCRIPTOR* desc = (STORAGE_DEVICE_DESCRIPTOR*)buffer;
+            if (desc->BusType == BusTypeNvme) {
+                // This is an NVMe device
+                NVMe_Info* info = &devices[device_count];
                 
-                if (desc->BusType == BusTypeNvme) {
-                    // This is an NVMe device
-                    NVMe_Info* info = &devices[device_count];
-                    
-                    strncpy(info->device_name, device_path, sizeof(info->device_name) - 1);
+                strncpy(info->device_name, device_path, sizeof(info->device_name) - 1);
+                if (desc->ProductIdOffset > 0 && desc->ProductIdOffset < q->descriptor_size) {
+                    strncpy(info->friendly_name, (char*)q->descriptor + desc->ProductIdOffset,
+                            sizeof(info->friendly_name) - 1);
+                    info->friendly_name[sizeof(info->friendly_name) - 1] = '\0';
+                } else {
                     strncpy(info->friendly_name, "NVMe Drive", sizeof(info->friendly_name) - 1);
-                    
-                    // Placeholder values - would need raw NVMe commands for actual data
-                    info->available = 1;
-                    info->temperature_c = 0;
-                    info->wear_level_percent = 0;
-                    info->data_units_written = 0;
-                    info->power_on_hours = 0;
-                    info->media_errors = 0;
-                    info->capacity_bytes = 0;
-                    
-                    device_count++;
                 }
+                
+                info->available = 1;
+                deadline_source("nvme_devices", "IOCTL_STORAGE_QUERY_PROPERTY");
+                
+                if (q->have_log) {
+                    trace_begin("parse", "parse_health_log");
+                    parse_health_log(q->log, info);
+                    trace_end();
+                    deadline_source("smart", "nvme_log_0x02");
+                }
+                
+                device_count++;
             }
-            
+        }
+        
+        free(q);
+        if (handle != INVALID_HANDLE_VALUE) {
             CloseHandle(handle);
         }
+        trace_end();
     }
     
     return device_count;
@@ -164,16 +357,31 @@ void get_device_friendly_name(int drive_num, char* name_out, int max_len) {
 }
 
 int main(int argc, char* argv[]) {
-    NVMe_Info devices[8] = {0};
     int device_count = 0;
     
+    replay_init(argc, argv);
+    trace_init(argc, argv);
+    deadline_init(argc, argv);
+    
     // Enumerate NVMe devices
-    device_count = enumerate_nvme_devices(devices, 8);
+    int drive_slots = count_drive_slots();
+    NVMe_Info* devices = (NVMe_Info*)calloc(drive_slots > 0 ? drive_slots : 1, sizeof(NVMe_Info));
+    if (!devices) {
+        printf("{\"error\": \"Out of memory\"}\n");
+        return 1;
+    }
+    trace_begin("probe", "enumerate_nvme_devices");
+    device_count = enumerate_nvme_devices(devices, drive_slots, drive_slots);
+    trace_end();
     
     // Output JSON
+    trace_begin("output", "emit_json");
     printf("{\n");
     printf("  \"method\": \"IOCTL_STORAGE_QUERY_PROPERTY\",\n");
-    printf("  \"note\": \"NVMe SMART data requires Windows 10+. Full SMART telemetry needs raw NVMe command passthrough.\",\n");
+    printf("  \"note\": \"NVMe SMART data requires Windows 10+. SMART fields come from the Health log page (0x02) via IOCTL_STORAGE_QUERY_PROPERTY.\",\n");
+    printf("  ");
+    deadline_print_json();
+    printf("\n");
     printf("  \"nvme_devices\": [\n");
     
     for (int i = 0; i < device_count; i++) {
@@ -181,8 +389,12 @@ int main(int argc, char* argv[]) {
         
         printf("    {\n");
         printf("      \"index\": %d,\n", i);
-        printf("      \"device_path\": \"%s\",\n", dev->device_name);
-        printf("      \"friendly_name\": \"%s\",\n", dev->friendly_name);
+        printf("      \"device_path\": ");
+        print_json_string(dev->device_name);
+        printf(",\n");
+        printf("      \"friendly_name\": ");
+        print_json_string(dev->friendly_name);
+        printf(",\n");
         printf("      \"available\": %s,\n", dev->available ? "true" : "false");
         
         if (dev->available) {
@@ -191,6 +403,11 @@ int main(int argc, char* argv[]) {
             printf("      \"data_units_written\": %llu,\n", dev->data_units_written);
             printf("      \"power_on_hours\": %llu,\n", dev->power_on_hours);
             printf("      \"media_errors\": %u,\n", dev->media_errors);
+            if (dev->smart_available) {
+                printf("      \"available_spare\": %d,\n", dev->available_spare);
+                printf("      \"critical_warnings\": %d,\n", dev->critical_warning);
+            }
+            printf("      \"smart_available\": %s,\n", dev->smart_available ? "true" : "false");
             printf("      \"capacity_bytes\": %llu\n", dev->capacity_bytes);
         } else {
             printf("      \"error\": \"Unable to query SMART data\"\n");
@@ -201,10 +418,12 @@ int main(int argc, char* argv[]) {
     
     printf("  ]\n");
     printf("}\n");
+    trace_end();
     
     if (device_count == 0) {
         fprintf(stderr, "No NVMe devices detected or unable to query SMART data.\n");
     }
     
+    free(devices);
     return 0;
 }
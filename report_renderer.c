@@ -0,0 +1,760 @@
+/*
+ * Report Renderer - streams a collected snapshot into the text report
+ *
+ * Reads the snapshot JSON written by main.py (from a file or stdin) with the
+ * streaming tokenizer in json_stream.h and renders it through a layout
+ * template as the document is read, section by section, into a file or
+ * stdout. Nothing is built up in memory: each open object keeps at most
+ * REPORT_MAX_FIELDS scalar members, so memory use is the same for a laptop
+ * and for a host with thousands of cores, disks or interfaces.
+ *
+ * Usage:
+ *   report_renderer [--template FILE] [--output FILE] [--trace FILE] [SNAPSHOT|-]
+ *
+ * Template format (see report_template.txt):
+ *
+ *   [object PATH]   lines for each object at PATH, once its scalar members are in
+ *   [each PATH]     lines for every element (array) or member (object) of PATH
+ *   [before PATH]   lines before the first element/member of PATH
+ *   [after PATH]    lines after PATH closes
+ *   [empty PATH]    lines when PATH is an empty array or object
+ *   [join PATH]     one line listing the scalar elements of PATH at {@items}
+ *
+ * A header may end in "if FIELD" or "if !FIELD" to write the block only when
+ * FIELD is (or is not) truthy: present and not null, false, 0 or "".
+ *
+ * PATH is a dotted member path from the snapshot root ("cpu.temperatures");
+ * "[]" selects array elements ("disks[]", "network.interfaces[].addresses")
+ * and "*" matches any one member name. An empty PATH is the root object.
+ *
+ * Body lines are copied to the output with {placeholders} filled in:
+ *
+ *   {name[/N|*N][:format][|match=text]...}
+ *
+ *   name     scalar member of the current object, else of the nearest
+ *            enclosing object; or @key, @index, @n (1-based), @value, @count
+ *   /N *N    scale a number before formatting ({size_mb/1024:.1f})
+ *   format   [<>^][width][,][.precision][d|f] as in Python ({core:2d}, {total:.2f})
+ *   |m=text  replace the value when it equals m, contains m ("~m", case
+ *            insensitive) or always ("*"); the first match wins. "|m!"
+ *            renders nothing and counts as absent
+ *
+ * A line starting with '?' is only written when every placeholder has a
+ * value that is not missing, null, "", "Unknown" or "N/A" (or dropped with
+ * "|m!"). Lines starting with '#' are comments; '\' escapes a leading '#',
+ * '?' or '[', and a line holding just '\' is a blank line that is kept at the
+ * end of a block (other trailing blank lines only separate blocks). Missing
+ * values render as N/A.
+ *
+ * The renderer expects every object's scalar members before its nested
+ * objects and arrays (main.py writes snapshots that way): an object's lines
+ * are written as soon as its first nested container starts.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "json_stream.h"
+#include "helper_trace.h"
+
+#define REPORT_MAX_DEPTH JSON_STREAM_MAX_DEPTH
+#define REPORT_MAX_FIELDS 64
+#define REPORT_NAME_MAX 64
+#define REPORT_VALUE_MAX 256
+#define REPORT_PATH_MAX 512
+#define REPORT_LINE_MAX 4096
+#define REPORT_FRAME_BLOCKS 16
+#define REPORT_MAX_SECTIONS 64
+
+typedef enum {
+    BLOCK_OBJECT,
+    BLOCK_EACH,
+    BLOCK_BEFORE,
+    BLOCK_AFTER,
+    BLOCK_EMPTY,
+    BLOCK_JOIN
+} BlockKind;
+
+typedef struct {
+    BlockKind kind;
+    char path[REPORT_PATH_MAX];
+    char cond_field[REPORT_NAME_MAX];   // "" when the block is unconditional
+    int cond_negate;
+    char** lines;   // point into the template text
+    int line_count;
+} Block;
+
+typedef struct {
+    char name[REPORT_NAME_MAX];
+    char value[REPORT_VALUE_MAX];
+    JsonType type;
+} Field;
+
+typedef struct {
+    int is_array;
+    size_t path_len;    // length of g_path including this frame
+    size_t parent_len;  // length of g_path before this frame
+    char key[REPORT_NAME_MAX];
+    long index;         // position within the parent container
+    long count;         // elements/members seen so far
+    int flushed;        // object lines written
+    int joining;        // a [join] line is open
+    int block_count;
+    short blocks[REPORT_FRAME_BLOCKS];
+    int field_count;
+    Field fields[REPORT_MAX_FIELDS];
+} Frame;
+
+// What a line is being rendered for: a container frame, optionally one scalar element
+typedef struct {
+    int depth;
+    const char* key;
+    long index;
+    const char* value;
+    JsonType value_type;
+} RenderCtx;
+
+static Block* g_blocks = NULL;
+static int g_block_count = 0;
+
+static Frame g_frames[REPORT_MAX_DEPTH];
+static int g_depth = 0;
+static char g_path[REPORT_PATH_MAX];
+
+static FILE* g_out = NULL;
+static char g_section_names[REPORT_MAX_SECTIONS][REPORT_NAME_MAX];
+static int g_section_count = 0;
+
+// ---------------------------------------------------------------------------
+// Template loading
+// ---------------------------------------------------------------------------
+
+static char* read_file(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* data = (char*)malloc((size_t)size + 1);
+    if (data && fread(data, 1, (size_t)size, f) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    if (data) data[size] = '\0';
+    return data;
+}
+
+static int parse_block_header(char* line, Block* block) {
+    static const struct { const char* name; BlockKind kind; } kinds[] = {
+        {"object", BLOCK_OBJECT}, {"each", BLOCK_EACH}, {"before", BLOCK_BEFORE},
+        {"after", BLOCK_AFTER}, {"empty", BLOCK_EMPTY}, {"join", BLOCK_JOIN},
+    };
+    char* close = strrchr(line, ']');   // paths contain "[]"
+    if (!close) return 0;
+    *close = '\0';
+    char* word = line + 1;
+    char* path = word;
+    while (*path && *path != ' ') path++;
+    if (*path) *path++ = '\0';
+    while (*path == ' ') path++;
+
+    char* cond = strstr(path, " if ");
+    if (cond) {
+        *cond = '\0';
+        cond += 4;
+        while (*cond == ' ') cond++;
+    }
+
+    for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++) {
+        if (strcmp(word, kinds[i].name) == 0) {
+            memset(block, 0, sizeof(*block));
+            block->kind = kinds[i].kind;
+            strncpy(block->path, path, sizeof(block->path) - 1);
+            if (cond) {
+                block->cond_negate = *cond == '!';
+                strncpy(block->cond_field, cond + block->cond_negate, sizeof(block->cond_field) - 1);
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Split the template into blocks; the text stays allocated for the whole run
+static int load_template(const char* path) {
+    char* text = read_file(path);
+    if (!text) {
+        fprintf(stderr, "report_renderer: cannot read template %s\n", path);
+        return 0;
+    }
+
+    int line_no = 0;
+    Block* current = NULL;
+    for (char* line = text; line; ) {
+        char* next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        size_t len = strlen(line);
+        if (len && line[len - 1] == '\r') line[--len] = '\0';
+        line_no++;
+
+        if (!next && !line[0]) {
+            // the newline at the end of the file does not start another line
+        } else if (line[0] == '#') {
+            // comment
+        } else if (line[0] == '[') {
+            Block* grown = (Block*)realloc(g_blocks, sizeof(Block) * (g_block_count + 1));
+            if (!grown) return 0;
+            g_blocks = grown;
+            current = &g_blocks[g_block_count];
+            if (!parse_block_header(line, current)) {
+                fprintf(stderr, "report_renderer: %s:%d: unknown block header\n", path, line_no);
+                return 0;
+            }
+            g_block_count++;
+        } else if (current) {
+            char** grown = (char**)realloc(current->lines, sizeof(char*) * (current->line_count + 1));
+            if (!grown) return 0;
+            current->lines = grown;
+            current->lines[current->line_count++] = line;
+        } else if (line[0]) {
+            fprintf(stderr, "report_renderer: %s:%d: text outside a block\n", path, line_no);
+            return 0;
+        }
+        line = next;
+    }
+
+    // Blank lines after a block only separate it from the next one
+    for (int i = 0; i < g_block_count; i++) {
+        Block* block = &g_blocks[i];
+        while (block->line_count > 0 && block->lines[block->line_count - 1][0] == '\0') {
+            block->line_count--;
+        }
+    }
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Paths
+// ---------------------------------------------------------------------------
+
+// Glob match where '*' spans one member name (never '.' or '[')
+static int path_matches(const char* pattern, const char* path) {
+    while (*pattern) {
+        if (*pattern == '*') {
+            pattern++;
+            for (;;) {
+                if (path_matches(pattern, path)) return 1;
+                if (!*path || *path == '.' || *path == '[') return 0;
+                path++;
+            }
+        }
+        if (*pattern != *path) return 0;
+        pattern++;
+        path++;
+    }
+    return *path == '\0';
+}
+
+// Append ".key" (or "[]" for array elements) to g_path; returns 0 if it does not fit
+static int path_push(const char* key) {
+    size_t len = strlen(g_path);
+    if (!key) {
+        if (len + 3 > sizeof(g_path)) return 0;
+        memcpy(g_path + len, "[]", 3);
+        return 1;
+    }
+    if (len + strlen(key) + 2 > sizeof(g_path)) return 0;
+    if (len) g_path[len++] = '.';
+    for (; *key; key++) {
+        // Member names are data: keep them from looking like path syntax
+        g_path[len++] = (*key == '.' || *key == '[' || *key == '*') ? '_' : *key;
+    }
+    g_path[len] = '\0';
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Placeholders
+// ---------------------------------------------------------------------------
+
+static const Field* find_field(int depth, const char* name) {
+    for (int d = depth; d >= 0; d--) {
+        const Frame* frame = &g_frames[d];
+        for (int i = 0; i < frame->field_count; i++) {
+            if (strcmp(frame->fields[i].name, name) == 0) return &frame->fields[i];
+        }
+    }
+    return NULL;
+}
+
+// Resolve a placeholder name; returns 0 if it has no value
+static int lookup(const RenderCtx* ctx, const char* name, char* out, size_t out_size, JsonType* type) {
+    if (name[0] == '@') {
+        const Frame* frame = &g_frames[ctx->depth];
+        *type = JSON_NUMBER;
+        if (strcmp(name, "@key") == 0) {
+            *type = JSON_STRING;
+            snprintf(out, out_size, "%s", ctx->key ? ctx->key : "");
+            return ctx->key != NULL;
+        }
+        if (strcmp(name, "@index") == 0) {
+            snprintf(out, out_size, "%ld", ctx->index);
+            return 1;
+        }
+        if (strcmp(name, "@n") == 0) {
+            snprintf(out, out_size, "%ld", ctx->index + 1);
+            return 1;
+        }
+        if (strcmp(name, "@count") == 0) {
+            snprintf(out, out_size, "%ld", frame->count);
+            return 1;
+        }
+        if (strcmp(name, "@value") == 0 && ctx->value) {
+            *type = ctx->value_type;
+            snprintf(out, out_size, "%s", ctx->value);
+            return ctx->value_type != JSON_NULL;
+        }
+        return 0;
+    }
+    const Field* field = find_field(ctx->depth, name);
+    if (!field || field->type == JSON_NULL) return 0;
+    *type = field->type;
+    snprintf(out, out_size, "%s", field->value);
+    return 1;
+}
+
+static int contains_nocase(const char* haystack, const char* needle, size_t needle_len) {
+    for (; *haystack; haystack++) {
+        size_t i = 0;
+        while (i < needle_len && haystack[i] &&
+               tolower((unsigned char)haystack[i]) == tolower((unsigned char)needle[i])) {
+            i++;
+        }
+        if (i == needle_len) return 1;
+    }
+    return needle_len == 0;
+}
+
+// Display width of UTF-8 text in characters
+static size_t text_width(const char* s) {
+    size_t width = 0;
+    for (; *s; s++) {
+        if (((unsigned char)*s & 0xC0) != 0x80) width++;
+    }
+    return width;
+}
+
+// Insert thousands separators into the integer part of a formatted number
+static void add_commas(char* number, size_t size) {
+    char digits[REPORT_VALUE_MAX];
+    snprintf(digits, sizeof(digits), "%s", number);
+    const char* p = digits;
+    size_t out = 0;
+    if (*p == '-') number[out++] = *p++;
+    size_t int_len = strspn(p, "0123456789");
+    for (size_t i = 0; i < int_len && out + 2 < size; i++) {
+        if (i && (int_len - i) % 3 == 0) number[out++] = ',';
+        number[out++] = p[i];
+    }
+    snprintf(number + out, size - out, "%s", p + int_len);
+}
+
+typedef struct {
+    char align;      // '<', '>', '^' or 0 for the default
+    int width;
+    int commas;
+    int precision;   // -1 when not given
+    char type;       // 'd', 'f' or 0
+} FormatSpec;
+
+static void parse_format(const char* spec, size_t len, FormatSpec* fmt) {
+    memset(fmt, 0, sizeof(*fmt));
+    fmt->precision = -1;
+    size_t i = 0;
+    if (i < len && (spec[i] == '<' || spec[i] == '>' || spec[i] == '^')) fmt->align = spec[i++];
+    while (i < len && isdigit((unsigned char)spec[i])) fmt->width = fmt->width * 10 + (spec[i++] - '0');
+    if (i < len && spec[i] == ',') {
+        fmt->commas = 1;
+        i++;
+    }
+    if (i < len && spec[i] == '.') {
+        fmt->precision = 0;
+        i++;
+        while (i < len && isdigit((unsigned char)spec[i])) fmt->precision = fmt->precision * 10 + (spec[i++] - '0');
+    }
+    if (i < len && (spec[i] == 'd' || spec[i] == 'f')) fmt->type = spec[i];
+}
+
+// Render one placeholder body (between the braces) into 'out'.
+// Returns 0 if the value is absent for the purpose of '?' lines.
+static int render_placeholder(const RenderCtx* ctx, const char* body, size_t body_len,
+                              char* out, size_t out_size) {
+    char name[REPORT_NAME_MAX];
+    size_t n = 0;
+    while (n < body_len && !strchr("/*:|", body[n])) n++;
+    snprintf(name, sizeof(name), "%.*s", (int)n, body);
+    const char* p = body + n;
+    const char* end = body + body_len;
+
+    double scale = 1.0;
+    int scaled = 0;
+    if (p < end && (*p == '/' || *p == '*')) {
+        char op = *p++;
+        char* num_end;
+        double factor = strtod(p, &num_end);
+        if (num_end > end) num_end = (char*)end;
+        p = num_end;
+        if (factor != 0.0) {
+            scale = op == '/' ? 1.0 / factor : factor;
+            scaled = 1;
+        }
+    }
+
+    FormatSpec fmt;
+    const char* spec = p;
+    if (p < end && *p == ':') {
+        spec = ++p;
+        while (p < end && *p != '|') p++;
+    }
+    parse_format(spec, (size_t)(p - spec), &fmt);
+
+    char raw[REPORT_VALUE_MAX];
+    JsonType type = JSON_NULL;
+    int present = lookup(ctx, name, raw, sizeof(raw), &type);
+    if (present && type == JSON_STRING &&
+        (raw[0] == '\0' || strcmp(raw, "Unknown") == 0 || strcmp(raw, "N/A") == 0)) {
+        present = -1;   // rendered, but counts as absent for '?' lines
+    }
+
+    char text[REPORT_VALUE_MAX];
+    int mapped = 0;
+    while (p < end && *p == '|') {
+        const char* pattern = ++p;
+        while (p < end && *p != '=' && *p != '!' && *p != '|') p++;
+        size_t pattern_len = (size_t)(p - pattern);
+        const char* replacement = p;
+        size_t replacement_len = 0;
+        int drop = p < end && *p == '!';
+        if (drop) {
+            p++;
+        } else if (p < end && *p == '=') {
+            replacement = ++p;
+            while (p < end && *p != '|') p++;
+            replacement_len = (size_t)(p - replacement);
+        }
+        if (mapped || !present) continue;
+        int hit;
+        if (pattern_len == 1 && pattern[0] == '*') hit = 1;
+        else if (pattern_len && pattern[0] == '~') hit = contains_nocase(raw, pattern + 1, pattern_len - 1);
+        else hit = strlen(raw) == pattern_len && strncmp(raw, pattern, pattern_len) == 0;
+        if (hit) {
+            snprintf(text, sizeof(text), "%.*s", (int)replacement_len, replacement);
+            mapped = 1;
+            if (drop) present = -1;
+        }
+    }
+
+    int numeric = 0;
+    if (!present) {
+        snprintf(text, sizeof(text), "N/A");
+    } else if (!mapped) {
+        numeric = type == JSON_NUMBER;
+        if (numeric && (scaled || fmt.commas || fmt.precision >= 0 || fmt.type)) {
+            double v = strtod(raw, NULL) * scale;
+            if (fmt.precision >= 0 || (fmt.type == 'f')) {
+                snprintf(text, sizeof(text), "%.*f", fmt.precision >= 0 ? fmt.precision : 6, v);
+            } else if (fmt.type == 'd' || fmt.commas) {
+                snprintf(text, sizeof(text), "%.0f", floor(v + 0.5));
+            } else {
+                snprintf(text, sizeof(text), "%g", v);
+            }
+            if (fmt.commas) add_commas(text, sizeof(text));
+        } else {
+            snprintf(text, sizeof(text), "%s", raw);
+        }
+    }
+
+    size_t width = text_width(text);
+    size_t pad = fmt.width > (int)width ? (size_t)fmt.width - width : 0;
+    char align = fmt.align ? fmt.align : (numeric ? '>' : '<');
+    size_t left = align == '>' ? pad : align == '^' ? pad / 2 : 0;
+    size_t right = pad - left;
+    size_t len = 0;
+    for (size_t i = 0; i < left && len + 1 < out_size; i++) out[len++] = ' ';
+    for (const char* t = text; *t && len + 1 < out_size; t++) out[len++] = *t;
+    for (size_t i = 0; i < right && len + 1 < out_size; i++) out[len++] = ' ';
+    out[len] = '\0';
+
+    return present > 0;
+}
+
+// Fill in every placeholder of 'line'; returns 0 if an optional line should be dropped
+static int expand_line(const RenderCtx* ctx, const char* line, char* out, size_t out_size) {
+    int optional = 0;
+    if (line[0] == '?') {
+        optional = 1;
+        line++;
+    } else if (line[0] == '\\') {
+        line++;
+    }
+
+    size_t len = 0;
+    for (const char* p = line; *p; p++) {
+        if ((*p == '{' && p[1] == '{') || (*p == '}' && p[1] == '}')) {
+            if (len + 1 < out_size) out[len++] = *p;
+            p++;
+            continue;
+        }
+        const char* close = *p == '{' ? strchr(p, '}') : NULL;
+        if (!close) {
+            if (len + 1 < out_size) out[len++] = *p;
+            continue;
+        }
+        char value[REPORT_LINE_MAX];
+        int present = render_placeholder(ctx, p + 1, (size_t)(close - p - 1), value, sizeof(value));
+        if (optional && !present) return 0;
+        for (const char* v = value; *v && len + 1 < out_size; v++) out[len++] = *v;
+        p = close;
+    }
+    out[len] = '\0';
+    return 1;
+}
+
+static void render_line(const RenderCtx* ctx, const char* line) {
+    char out[REPORT_LINE_MAX];
+    if (expand_line(ctx, line, out, sizeof(out))) {
+        fputs(out, g_out);
+        fputc('\n', g_out);
+    }
+}
+
+static int block_applies(const RenderCtx* ctx, const Block* block) {
+    if (!block->cond_field[0]) return 1;
+    char value[REPORT_VALUE_MAX];
+    JsonType type;
+    int truthy = lookup(ctx, block->cond_field, value, sizeof(value), &type) &&
+                 type != JSON_FALSE && value[0] && !(type == JSON_NUMBER && strtod(value, NULL) == 0.0);
+    return block->cond_negate ? !truthy : truthy;
+}
+
+static void render_block(const RenderCtx* ctx, const Block* block) {
+    if (!block_applies(ctx, block)) return;
+    for (int i = 0; i < block->line_count; i++) render_line(ctx, block->lines[i]);
+}
+
+// Write every block of 'kind' attached to the frame at 'depth'
+static void render_blocks(const RenderCtx* ctx, BlockKind kind) {
+    const Frame* frame = &g_frames[ctx->depth];
+    for (int i = 0; i < frame->block_count; i++) {
+        const Block* block = &g_blocks[frame->blocks[i]];
+        if (block->kind == kind) render_block(ctx, block);
+    }
+}
+
+static RenderCtx frame_ctx(int depth) {
+    RenderCtx ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.depth = depth;
+    ctx.key = g_frames[depth].key[0] ? g_frames[depth].key : NULL;
+    ctx.index = g_frames[depth].index;
+    return ctx;
+}
+
+// [join] blocks: the text before {@items} opens the line, the text after closes it
+static int render_join_part(const RenderCtx* ctx, int opening) {
+    const Frame* frame = &g_frames[ctx->depth];
+    int rendered = 0;
+    for (int i = 0; i < frame->block_count; i++) {
+        const Block* block = &g_blocks[frame->blocks[i]];
+        if (block->kind != BLOCK_JOIN || block->line_count == 0 || !block_applies(ctx, block)) continue;
+        const char* line = block->lines[0];
+        const char* marker = strstr(line, "{@items}");
+        if (!marker) continue;
+
+        char part[REPORT_LINE_MAX];
+        char out[REPORT_LINE_MAX];
+        if (opening) snprintf(part, sizeof(part), "%.*s", (int)(marker - line), line);
+        else snprintf(part, sizeof(part), "%s", marker + strlen("{@items}"));
+        expand_line(ctx, part, out, sizeof(out));
+        fputs(out, g_out);
+        if (!opening) fputc('\n', g_out);
+        rendered++;
+    }
+    return rendered;
+}
+
+// ---------------------------------------------------------------------------
+// Stream events
+// ---------------------------------------------------------------------------
+
+// Write an object's lines once its scalar members are known
+static void flush_frame(int depth) {
+    Frame* frame = &g_frames[depth];
+    if (frame->flushed) return;
+    frame->flushed = 1;
+    RenderCtx ctx = frame_ctx(depth);
+    if (depth > 0) {
+        // This container is an element of its parent: [each PARENT] applies
+        const Frame* parent = &g_frames[depth - 1];
+        for (int i = 0; i < parent->block_count; i++) {
+            const Block* block = &g_blocks[parent->blocks[i]];
+            if (block->kind == BLOCK_EACH) render_block(&ctx, block);
+        }
+    }
+    render_blocks(&ctx, BLOCK_OBJECT);
+}
+
+// A new element or member is starting in the container at 'depth'
+static void count_element(int depth) {
+    Frame* frame = &g_frames[depth];
+    frame->count++;
+    if (frame->count == 1) {
+        RenderCtx ctx = frame_ctx(depth);
+        render_blocks(&ctx, BLOCK_BEFORE);
+        frame->joining = render_join_part(&ctx, 1) > 0;
+    }
+}
+
+static void on_begin(void* user, const char* key, int is_array) {
+    (void)user;
+    if (g_depth > 0) {
+        Frame* parent = &g_frames[g_depth - 1];
+        if (!parent->is_array) flush_frame(g_depth - 1);
+        count_element(g_depth - 1);
+    }
+    if (g_depth >= REPORT_MAX_DEPTH) return;   // the tokenizer rejects deeper documents
+
+    Frame* frame = &g_frames[g_depth];
+    memset(frame, 0, offsetof(Frame, fields));
+    frame->is_array = is_array;
+    frame->parent_len = strlen(g_path);
+    if (g_depth > 0) {
+        if (!path_push(g_frames[g_depth - 1].is_array ? NULL : key)) {
+            fprintf(stderr, "report_renderer: path too long under %s\n", g_path);
+        }
+        frame->index = g_frames[g_depth - 1].count - 1;
+        if (key) snprintf(frame->key, sizeof(frame->key), "%s", key);
+    }
+    frame->path_len = strlen(g_path);
+
+    for (int i = 0; i < g_block_count && frame->block_count < REPORT_FRAME_BLOCKS; i++) {
+        if (path_matches(g_blocks[i].path, g_path)) frame->blocks[frame->block_count++] = (short)i;
+    }
+
+    if (g_depth == 1 && key) {
+        const char* name = "section";
+        if (g_section_count < REPORT_MAX_SECTIONS) {
+            snprintf(g_section_names[g_section_count], REPORT_NAME_MAX, "%s", key);
+            name = g_section_names[g_section_count++];
+        }
+        trace_begin("section", name);
+    }
+
+    g_depth++;
+    if (is_array) flush_frame(g_depth - 1);
+}
+
+static void on_end(void* user, int is_array) {
+    (void)user;
+    (void)is_array;
+    int depth = g_depth - 1;
+    Frame* frame = &g_frames[depth];
+    flush_frame(depth);
+
+    RenderCtx ctx = frame_ctx(depth);
+    if (frame->joining) render_join_part(&ctx, 0);
+    if (frame->count == 0) render_blocks(&ctx, BLOCK_EMPTY);
+    render_blocks(&ctx, BLOCK_AFTER);
+
+    if (depth == 1) trace_end();
+    g_path[frame->parent_len] = '\0';
+    g_depth--;
+}
+
+static void on_scalar(void* user, const char* key, JsonType type, const char* text) {
+    (void)user;
+    if (g_depth == 0) return;   // a bare scalar document has nothing to render
+    int depth = g_depth - 1;
+    Frame* frame = &g_frames[depth];
+    count_element(depth);
+
+    if (!frame->is_array && key && frame->field_count < REPORT_MAX_FIELDS) {
+        Field* field = &frame->fields[frame->field_count++];
+        snprintf(field->name, sizeof(field->name), "%s", key);
+        snprintf(field->value, sizeof(field->value), "%s", text);
+        field->type = type;
+    }
+
+    RenderCtx ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.depth = depth;
+    ctx.key = key;
+    ctx.index = frame->count - 1;
+    ctx.value = text;
+    ctx.value_type = type;
+    render_blocks(&ctx, BLOCK_EACH);
+
+    if (frame->joining) {
+        if (frame->count > 1) fputs(", ", g_out);
+        fputs(text, g_out);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char* template_path = "report_template.txt";
+    const char* output_path = NULL;
+    const char* snapshot_path = "-";
+
+    trace_init(argc, argv);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--template") == 0 && i + 1 < argc) {
+            template_path = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            i++;
+        } else {
+            snapshot_path = argv[i];
+        }
+    }
+
+    trace_begin("probe", "load_template");
+    int loaded = load_template(template_path);
+    trace_end();
+    if (!loaded) return 1;
+
+    FILE* in = strcmp(snapshot_path, "-") == 0 ? stdin : fopen(snapshot_path, "rb");
+    if (!in) {
+        fprintf(stderr, "report_renderer: cannot open snapshot %s\n", snapshot_path);
+        return 1;
+    }
+    g_out = output_path ? fopen(output_path, "w") : stdout;
+    if (!g_out) {
+        fprintf(stderr, "report_renderer: cannot write %s\n", output_path);
+        return 1;
+    }
+    static char out_buffer[1 << 16];
+    setvbuf(g_out, out_buffer, _IOFBF, sizeof(out_buffer));
+
+    static JsonStream stream;
+    static const JsonStreamHandler handler = {on_begin, on_end, on_scalar};
+    json_stream_init(&stream, in, &handler, NULL);
+
+    trace_begin("probe", "render_report");
+    int ok = json_stream_parse(&stream);
+    trace_end();
+
+    if (in != stdin) fclose(in);
+    if (g_out != stdout) fclose(g_out);
+    else fflush(g_out);
+
+    if (!ok) {
+        fprintf(stderr, "report_renderer: %s\n", stream.error);
+        return 1;
+    }
+    return 0;
+}
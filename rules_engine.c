@@ -0,0 +1,1188 @@
+/*
+ * Rules Engine - performance-configuration audits over collected snapshots
+ *
+ * Evaluates the declarative rules in audit_rules.txt against one or more
+ * snapshot files written by main.py (one per host, e.g. a fleet archive) and
+ * prints the findings as JSON. Rules are compiled once; each snapshot is then
+ * streamed through json_stream.h, keeping only the facts the rules reference
+ * and folding array elements into running aggregates as they go by, so a
+ * host costs one pass over its snapshot and a few microseconds of rule
+ * evaluation, however many rules there are.
+ *
+ * Usage:
+ *   rules_engine [--rules FILE] [--define NAME=VALUE]... [--trace FILE] [SNAPSHOT|-]...
+ *
+ * Rule format:
+ *
+ *   [rule memory_below_rated_speed]
+ *   severity: warning                   critical, warning or info
+ *   category: memory
+ *   title: Memory runs below its rated speed
+ *   when: min(memory.spd_helper.dimms[].configured_speed_mhz where .present)
+ *         < max(memory.spd_helper.dimms[].max_speed_mhz where .present)
+ *   message: DIMMs run at {min(memory.spd_helper.dimms[].configured_speed_mhz)} MT/s
+ *   fix: Enable the XMP/EXPO profile in firmware setup
+ *
+ * Lines starting with whitespace continue the previous key; '#' starts a
+ * comment line. {EXPR} in message and fix is replaced by the value of EXPR.
+ *
+ * Expressions:
+ *   literals    12, 2.5, "text", 'text', true, false, null
+ *   facts       dotted snapshot paths (cpu.smt_status) and --define names
+ *   operators   or, and, not, == != < <= > >=, ~ (contains, case
+ *               insensitive), + - * /, parentheses
+ *   exists(PATH)
+ *   aggregates  count sum min max avg distinct spread any all over array
+ *               elements: FUNC(ARRAY[].FIELD where COND) - FIELD may be empty
+ *               to use the element itself; COND refers to the element's
+ *               fields as .name (and to the element itself as '.')
+ *
+ * count/any/all count elements (matching COND); sum/min/max/avg fold a
+ * numeric FIELD; distinct is the number of different FIELD values and
+ * spread the difference between the most and least common value's count
+ * (0 when every value occurs equally often).
+ *
+ * Missing facts are unknown, and unknown propagates through operators (with
+ * Kleene and/or), so a rule whose inputs were not collected is reported as
+ * not applicable instead of passing or firing. An array that never appears in
+ * the snapshot is unknown; an empty one counts 0.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "json_stream.h"
+#include "helper_trace.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define RULES_PATH_MAX 512
+#define RULES_TEXT_MAX 256
+#define RULES_MAX_DEFINES 32
+#define RULES_ELEM_FIELDS 32
+#define RULES_DISTINCT_MAX 64
+#define RULES_MESSAGE_MAX 1024
+#define RULES_FACT_BUCKETS 1024   // power of two, more than the facts any rule set references
+
+// ---------------------------------------------------------------------------
+// Values and expressions
+// ---------------------------------------------------------------------------
+
+typedef enum { V_NONE, V_BOOL, V_NUM, V_STR } ValueType;
+
+typedef struct {
+    ValueType type;
+    double num;          // V_NUM, and V_BOOL as 0/1
+    const char* str;     // V_STR; points into a fact, element field or the rule text
+} Value;
+
+typedef struct {
+    char text[RULES_TEXT_MAX];
+    Value value;
+} Slot;
+
+typedef enum {
+    N_LITERAL, N_FACT, N_FIELD, N_AGG, N_EXISTS,
+    N_NOT, N_NEG, N_AND, N_OR, N_CMP, N_ARITH
+} NodeKind;
+
+typedef enum { AGG_COUNT, AGG_SUM, AGG_MIN, AGG_MAX, AGG_AVG, AGG_DISTINCT, AGG_SPREAD, AGG_ANY, AGG_ALL } AggFunc;
+
+typedef struct Node {
+    NodeKind kind;
+    int op;              // comparison or arithmetic operator character ('<', 'l' for <=, ...)
+    int index;           // fact, element field or aggregate index
+    Value literal;
+    struct Node* a;
+    struct Node* b;
+} Node;
+
+typedef struct {
+    char path[RULES_PATH_MAX];
+    Slot slot;
+    int defined;         // set by --define: the snapshot does not override it
+    int seen;            // a container (not a scalar) exists at this path
+} Fact;
+
+typedef struct {
+    char path[RULES_PATH_MAX];       // array element path, ending in "[]"
+    char fields[RULES_ELEM_FIELDS][RULES_PATH_MAX];
+    int field_count;
+    Slot element[RULES_ELEM_FIELDS]; // fields of the element being read
+    int seen;                        // the array appeared in this snapshot
+    int depth;                       // tokenizer depth of the open element, -1 if none
+} Scope;
+
+typedef struct {
+    char text[64];
+    int count;
+} Distinct;
+
+typedef struct {
+    AggFunc func;
+    int scope;
+    int field;           // element field folded by the aggregate, -1 for the element count
+    Node* where;
+    // per-snapshot state
+    int elements;        // elements seen
+    int matched;         // elements passing 'where' (with a value when 'field' is set)
+    double sum, min, max;
+    Distinct distinct[RULES_DISTINCT_MAX];
+    int distinct_count;
+} Aggregate;
+
+typedef struct {
+    char id[64];
+    char severity[16];
+    char category[32];
+    char* title;
+    char* message;       // raw text with {EXPR} placeholders
+    char* fix;
+    Node* when;
+    Node** placeholders; // one per {EXPR}, in order, over message then fix
+    int placeholder_count;
+} Rule;
+
+static Fact* g_facts = NULL;
+static int g_fact_count = 0;
+static int g_fact_buckets[RULES_FACT_BUCKETS];   // fact index + 1, 0 = empty
+static Scope* g_scopes = NULL;
+static int g_scope_count = 0;
+static Aggregate* g_aggs = NULL;
+static int g_agg_count = 0;
+static Rule* g_rules = NULL;
+static int g_rule_count = 0;
+static int g_current_scope = -1;   // scope of the 'where' being compiled (.field references)
+
+static double now_us(void) {
+#ifdef _WIN32
+    LARGE_INTEGER now, freq;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&freq);
+    return (double)now.QuadPart * 1e6 / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+#endif
+}
+
+static char* read_file(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* data = (char*)malloc((size_t)size + 1);
+    if (data && fread(data, 1, (size_t)size, f) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    if (data) data[size] = '\0';
+    return data;
+}
+
+static void* grow(void* array, int count, size_t item) {
+    void* grown = realloc(array, item * (size_t)(count + 1));
+    if (!grown) {
+        fprintf(stderr, "rules_engine: out of memory\n");
+        exit(1);
+    }
+    memset((char*)grown + item * (size_t)count, 0, item);
+    return grown;
+}
+
+// Set a slot from JSON scalar text
+static void slot_set(Slot* slot, JsonType type, const char* text) {
+    snprintf(slot->text, sizeof(slot->text), "%s", text);
+    switch (type) {
+    case JSON_NUMBER: slot->value.type = V_NUM; slot->value.num = atof(text); break;
+    case JSON_TRUE: slot->value.type = V_BOOL; slot->value.num = 1; break;
+    case JSON_FALSE: slot->value.type = V_BOOL; slot->value.num = 0; break;
+    case JSON_STRING: slot->value.type = V_STR; break;
+    default: slot->value.type = V_NONE; break;
+    }
+}
+
+// A slot's value; strings are re-pointed at the slot, which may have moved since it was set
+static Value slot_value(const Slot* slot) {
+    Value v = slot->value;
+    if (v.type == V_STR) v.str = slot->text;
+    return v;
+}
+
+// ---------------------------------------------------------------------------
+// Facts (scalar paths referenced by rules)
+// ---------------------------------------------------------------------------
+
+static unsigned hash_path(const char* s, size_t len) {
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < len; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+static int fact_find(const char* path, size_t len) {
+    unsigned b = hash_path(path, len) & (RULES_FACT_BUCKETS - 1);
+    while (g_fact_buckets[b]) {
+        const Fact* fact = &g_facts[g_fact_buckets[b] - 1];
+        if (strlen(fact->path) == len && memcmp(fact->path, path, len) == 0) return g_fact_buckets[b] - 1;
+        b = (b + 1) & (RULES_FACT_BUCKETS - 1);
+    }
+    return -1;
+}
+
+static int fact_intern(const char* path) {
+    int index = fact_find(path, strlen(path));
+    if (index >= 0) return index;
+    if (g_fact_count >= RULES_FACT_BUCKETS / 2) {
+        fprintf(stderr, "rules_engine: too many facts\n");
+        exit(1);
+    }
+    g_facts = (Fact*)grow(g_facts, g_fact_count, sizeof(Fact));
+    snprintf(g_facts[g_fact_count].path, RULES_PATH_MAX, "%s", path);
+    unsigned b = hash_path(path, strlen(path)) & (RULES_FACT_BUCKETS - 1);
+    while (g_fact_buckets[b]) b = (b + 1) & (RULES_FACT_BUCKETS - 1);
+    g_fact_buckets[b] = g_fact_count + 1;
+    return g_fact_count++;
+}
+
+static int scope_intern(const char* path) {
+    for (int i = 0; i < g_scope_count; i++) {
+        if (strcmp(g_scopes[i].path, path) == 0) return i;
+    }
+    g_scopes = (Scope*)grow(g_scopes, g_scope_count, sizeof(Scope));
+    snprintf(g_scopes[g_scope_count].path, RULES_PATH_MAX, "%s", path);
+    g_scopes[g_scope_count].depth = -1;
+    return g_scope_count++;
+}
+
+static int scope_field(Scope* scope, const char* field) {
+    for (int i = 0; i < scope->field_count; i++) {
+        if (strcmp(scope->fields[i], field) == 0) return i;
+    }
+    if (scope->field_count >= RULES_ELEM_FIELDS) return -1;
+    snprintf(scope->fields[scope->field_count], RULES_PATH_MAX, "%s", field);
+    return scope->field_count++;
+}
+
+// ---------------------------------------------------------------------------
+// Expression parser
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    const char* p;
+    const char* error;
+    const char* rule;
+} Parser;
+
+static Node* new_node(NodeKind kind) {
+    Node* node = (Node*)calloc(1, sizeof(Node));
+    if (!node) {
+        fprintf(stderr, "rules_engine: out of memory\n");
+        exit(1);
+    }
+    node->kind = kind;
+    return node;
+}
+
+static void skip_space(Parser* ps) {
+    while (*ps->p && isspace((unsigned char)*ps->p)) ps->p++;
+}
+
+// Consume 'word' if it is next as a whole word (or operator)
+static int accept(Parser* ps, const char* word) {
+    skip_space(ps);
+    size_t len = strlen(word);
+    if (strncmp(ps->p, word, len) != 0) return 0;
+    if (isalpha((unsigned char)word[0]) && (isalnum((unsigned char)ps->p[len]) || ps->p[len] == '_')) return 0;
+    ps->p += len;
+    return 1;
+}
+
+static int is_path_char(int c) {
+    return isalnum(c) || c == '_' || c == '.' || c == '[' || c == ']';
+}
+
+static Node* parse_or(Parser* ps);
+
+// Aggregate argument: ARRAY[].FIELD [where COND]
+static Node* parse_aggregate(Parser* ps, AggFunc func) {
+    skip_space(ps);
+    const char* start = ps->p;
+    while (is_path_char((unsigned char)*ps->p)) ps->p++;
+    char path[RULES_PATH_MAX];
+    snprintf(path, sizeof(path), "%.*s", (int)(ps->p - start), start);
+
+    char* last = strstr(path, "[]");
+    for (char* next = last; next; next = strstr(next + 2, "[]")) last = next;
+    if (!last) {
+        ps->error = "aggregate needs an ARRAY[] path";
+        return NULL;
+    }
+    const char* field = last[2] == '.' ? last + 3 : last + 2;
+    if (*field && strstr(field, "[]")) {
+        ps->error = "aggregate field cannot contain []";
+        return NULL;
+    }
+    char field_name[RULES_PATH_MAX];
+    snprintf(field_name, sizeof(field_name), "%s", field);
+    last[2] = '\0';
+
+    g_aggs = (Aggregate*)grow(g_aggs, g_agg_count, sizeof(Aggregate));
+    int index = g_agg_count++;
+    int scope_index = scope_intern(path);
+    g_aggs[index].func = func;
+    g_aggs[index].scope = scope_index;
+    g_aggs[index].field = field_name[0] || func == AGG_SUM || func == AGG_MIN || func == AGG_MAX ||
+                          func == AGG_AVG || func == AGG_DISTINCT || func == AGG_SPREAD
+                          ? scope_field(&g_scopes[scope_index], field_name) : -1;
+
+    if (accept(ps, "where")) {
+        int outer = g_current_scope;
+        g_current_scope = scope_index;
+        Node* where = parse_or(ps);
+        g_current_scope = outer;
+        if (!where) return NULL;
+        g_aggs[index].where = where;
+    }
+    if (!accept(ps, ")")) {
+        ps->error = "expected ')' after aggregate";
+        return NULL;
+    }
+    Node* node = new_node(N_AGG);
+    node->index = index;
+    return node;
+}
+
+static Node* parse_atom(Parser* ps) {
+    static const struct { const char* name; AggFunc func; } aggs[] = {
+        {"count", AGG_COUNT}, {"sum", AGG_SUM}, {"min", AGG_MIN}, {"max", AGG_MAX}, {"avg", AGG_AVG},
+        {"distinct", AGG_DISTINCT}, {"spread", AGG_SPREAD}, {"any", AGG_ANY}, {"all", AGG_ALL},
+    };
+    skip_space(ps);
+    char c = *ps->p;
+
+    if (accept(ps, "(")) {
+        Node* inner = parse_or(ps);
+        if (inner && !accept(ps, ")")) {
+            ps->error = "expected ')'";
+            return NULL;
+        }
+        return inner;
+    }
+    if (accept(ps, "-")) {
+        Node* node = new_node(N_NEG);
+        node->a = parse_atom(ps);
+        return node->a ? node : NULL;
+    }
+    if (c == '"' || c == '\'') {
+        const char* start = ++ps->p;
+        while (*ps->p && *ps->p != c) ps->p++;
+        if (!*ps->p) {
+            ps->error = "unterminated string";
+            return NULL;
+        }
+        Node* node = new_node(N_LITERAL);
+        size_t len = (size_t)(ps->p - start);
+        char* text = (char*)malloc(len + 1);
+        memcpy(text, start, len);
+        text[len] = '\0';
+        node->literal.type = V_STR;
+        node->literal.str = text;
+        ps->p++;
+        return node;
+    }
+    if (isdigit((unsigned char)c)) {
+        char* end;
+        Node* node = new_node(N_LITERAL);
+        node->literal.type = V_NUM;
+        node->literal.num = strtod(ps->p, &end);
+        ps->p = end;
+        return node;
+    }
+    int boolean = accept(ps, "true") ? 1 : accept(ps, "false") ? 0 : -1;
+    if (boolean >= 0) {
+        Node* node = new_node(N_LITERAL);
+        node->literal.type = V_BOOL;
+        node->literal.num = boolean;
+        return node;
+    }
+    if (accept(ps, "null")) return new_node(N_LITERAL);
+
+    for (size_t i = 0; i < sizeof(aggs) / sizeof(aggs[0]); i++) {
+        const char* save = ps->p;
+        if (accept(ps, aggs[i].name) && accept(ps, "(")) return parse_aggregate(ps, aggs[i].func);
+        ps->p = save;
+    }
+    if (accept(ps, "exists")) {
+        if (!accept(ps, "(")) {
+            ps->error = "expected '(' after exists";
+            return NULL;
+        }
+        Node* node = parse_atom(ps);
+        if (!node || (node->kind != N_FACT && node->kind != N_FIELD) || !accept(ps, ")")) {
+            ps->error = "exists() takes one path";
+            return NULL;
+        }
+        Node* exists = new_node(N_EXISTS);
+        exists->a = node;
+        return exists;
+    }
+
+    // Element field (.name or '.') inside a 'where', else a snapshot path
+    const char* start = ps->p;
+    while (is_path_char((unsigned char)*ps->p)) ps->p++;
+    if (ps->p == start) {
+        ps->error = "expected a value";
+        return NULL;
+    }
+    char path[RULES_PATH_MAX];
+    snprintf(path, sizeof(path), "%.*s", (int)(ps->p - start), start);
+    if (path[0] == '.') {
+        if (g_current_scope < 0) {
+            ps->error = "element field outside an aggregate";
+            return NULL;
+        }
+        Node* node = new_node(N_FIELD);
+        node->index = scope_field(&g_scopes[g_current_scope], path + 1);
+        if (node->index < 0) {
+            ps->error = "too many element fields";
+            return NULL;
+        }
+        node->op = g_current_scope;
+        return node;
+    }
+    if (strstr(path, "[]")) {
+        ps->error = "array paths are only allowed inside aggregates";
+        return NULL;
+    }
+    Node* node = new_node(N_FACT);
+    node->index = fact_intern(path);
+    return node;
+}
+
+static Node* parse_product(Parser* ps) {
+    Node* left = parse_atom(ps);
+    while (left) {
+        int op = accept(ps, "*") ? '*' : accept(ps, "/") ? '/' : 0;
+        if (!op) break;
+        Node* node = new_node(N_ARITH);
+        node->op = op;
+        node->a = left;
+        node->b = parse_atom(ps);
+        left = node->b ? node : NULL;
+    }
+    return left;
+}
+
+static Node* parse_sum(Parser* ps) {
+    Node* left = parse_product(ps);
+    while (left) {
+        int op = accept(ps, "+") ? '+' : accept(ps, "-") ? '-' : 0;
+        if (!op) break;
+        Node* node = new_node(N_ARITH);
+        node->op = op;
+        node->a = left;
+        node->b = parse_product(ps);
+        left = node->b ? node : NULL;
+    }
+    return left;
+}
+
+static Node* parse_compare(Parser* ps) {
+    Node* left = parse_sum(ps);
+    if (!left) return NULL;
+    int op = accept(ps, "==") ? '=' : accept(ps, "!=") ? '!' : accept(ps, "<=") ? 'l' :
+             accept(ps, ">=") ? 'g' : accept(ps, "<") ? '<' : accept(ps, ">") ? '>' :
+             accept(ps, "~") ? '~' : 0;
+    if (!op) return left;
+    Node* node = new_node(N_CMP);
+    node->op = op;
+    node->a = left;
+    node->b = parse_sum(ps);
+    return node->b ? node : NULL;
+}
+
+static Node* parse_not(Parser* ps) {
+    if (accept(ps, "not")) {
+        Node* node = new_node(N_NOT);
+        node->a = parse_not(ps);
+        return node->a ? node : NULL;
+    }
+    return parse_compare(ps);
+}
+
+static Node* parse_and(Parser* ps) {
+    Node* left = parse_not(ps);
+    while (left && accept(ps, "and")) {
+        Node* node = new_node(N_AND);
+        node->a = left;
+        node->b = parse_not(ps);
+        left = node->b ? node : NULL;
+    }
+    return left;
+}
+
+static Node* parse_or(Parser* ps) {
+    Node* left = parse_and(ps);
+    while (left && accept(ps, "or")) {
+        Node* node = new_node(N_OR);
+        node->a = left;
+        node->b = parse_and(ps);
+        left = node->b ? node : NULL;
+    }
+    return left;
+}
+
+// Compile a whole expression; returns NULL (and prints why) on a syntax error
+static Node* compile(const char* text, const char* rule, const char* what) {
+    Parser ps = {text, NULL, rule};
+    g_current_scope = -1;
+    Node* node = parse_or(&ps);
+    skip_space(&ps);
+    if (node && *ps.p) {
+        ps.error = "unexpected text";
+        node = NULL;
+    }
+    if (!node) {
+        fprintf(stderr, "rules_engine: rule %s, %s: %s at \"%.24s\"\n", rule, what,
+                ps.error ? ps.error : "syntax error", ps.p);
+    }
+    return node;
+}
+
+// ---------------------------------------------------------------------------
+// Evaluation
+// ---------------------------------------------------------------------------
+
+static Value make_bool(int b) {
+    Value v = {V_BOOL, b ? 1.0 : 0.0, NULL};
+    return v;
+}
+
+static Value make_num(double n) {
+    Value v = {V_NUM, n, NULL};
+    return v;
+}
+
+static const Value g_unknown = {V_NONE, 0, NULL};
+
+// 1 = true, 0 = false, -1 = unknown
+static int truth(Value v) {
+    switch (v.type) {
+    case V_BOOL: case V_NUM: return v.num != 0;
+    case V_STR: return v.str[0] != '\0';
+    default: return -1;
+    }
+}
+
+// Numeric view of a value; strings such as "3000 MHz" count by their leading number
+static int as_number(Value v, double* out) {
+    if (v.type == V_NUM || v.type == V_BOOL) {
+        *out = v.num;
+        return 1;
+    }
+    if (v.type == V_STR) {
+        char* end;
+        *out = strtod(v.str, &end);
+        return end != v.str;
+    }
+    return 0;
+}
+
+static int contains_nocase(const char* haystack, const char* needle) {
+    size_t n = strlen(needle);
+    for (; *haystack; haystack++) {
+        size_t i = 0;
+        while (i < n && haystack[i] && tolower((unsigned char)haystack[i]) == tolower((unsigned char)needle[i])) i++;
+        if (i == n) return 1;
+    }
+    return n == 0;
+}
+
+static Value eval(const Node* node);
+
+static Value eval_aggregate(const Aggregate* agg) {
+    if (!g_scopes[agg->scope].seen) return g_unknown;
+    switch (agg->func) {
+    case AGG_COUNT: return make_num(agg->matched);
+    case AGG_ANY: return make_bool(agg->matched > 0);
+    case AGG_ALL: return make_bool(agg->matched == agg->elements);
+    case AGG_SUM: return make_num(agg->sum);
+    case AGG_MIN: return agg->matched ? make_num(agg->min) : g_unknown;
+    case AGG_MAX: return agg->matched ? make_num(agg->max) : g_unknown;
+    case AGG_AVG: return agg->matched ? make_num(agg->sum / agg->matched) : g_unknown;
+    case AGG_DISTINCT: return make_num(agg->distinct_count);
+    case AGG_SPREAD: {
+        if (!agg->distinct_count) return make_num(0);
+        int lo = agg->distinct[0].count, hi = lo;
+        for (int i = 1; i < agg->distinct_count; i++) {
+            if (agg->distinct[i].count < lo) lo = agg->distinct[i].count;
+            if (agg->distinct[i].count > hi) hi = agg->distinct[i].count;
+        }
+        return make_num(hi - lo);
+    }
+    }
+    return g_unknown;
+}
+
+static Value eval_compare(int op, Value a, Value b) {
+    if (op == '~') {
+        if (a.type != V_STR || b.type != V_STR) return g_unknown;
+        return make_bool(contains_nocase(a.str, b.str));
+    }
+    if (a.type == V_NONE || b.type == V_NONE) {
+        // 'x == null' / 'x != null' test for presence; other comparisons are unknown
+        if (op == '=') return make_bool(a.type == b.type);
+        if (op == '!') return make_bool(a.type != b.type);
+        return g_unknown;
+    }
+    int order;
+    double x, y;
+    if (a.type == V_STR && b.type == V_STR) {
+        order = strcmp(a.str, b.str);
+    } else if (as_number(a, &x) && as_number(b, &y)) {
+        order = x < y ? -1 : x > y ? 1 : 0;
+    } else {
+        return g_unknown;
+    }
+    switch (op) {
+    case '=': return make_bool(order == 0);
+    case '!': return make_bool(order != 0);
+    case '<': return make_bool(order < 0);
+    case 'l': return make_bool(order <= 0);
+    case '>': return make_bool(order > 0);
+    case 'g': return make_bool(order >= 0);
+    }
+    return g_unknown;
+}
+
+static Value eval(const Node* node) {
+    switch (node->kind) {
+    case N_LITERAL: return node->literal;
+    case N_FACT: return slot_value(&g_facts[node->index].slot);
+    case N_FIELD: return slot_value(&g_scopes[node->op].element[node->index]);
+    case N_AGG: return eval_aggregate(&g_aggs[node->index]);
+    case N_EXISTS: {
+        if (node->a->kind == N_FACT && g_facts[node->a->index].seen) return make_bool(1);
+        return make_bool(eval(node->a).type != V_NONE);
+    }
+    case N_NOT: {
+        int t = truth(eval(node->a));
+        return t < 0 ? g_unknown : make_bool(!t);
+    }
+    case N_NEG: {
+        double x;
+        return as_number(eval(node->a), &x) ? make_num(-x) : g_unknown;
+    }
+    case N_AND: {
+        int a = truth(eval(node->a));
+        if (a == 0) return make_bool(0);
+        int b = truth(eval(node->b));
+        if (b == 0) return make_bool(0);
+        return (a < 0 || b < 0) ? g_unknown : make_bool(1);
+    }
+    case N_OR: {
+        int a = truth(eval(node->a));
+        if (a == 1) return make_bool(1);
+        int b = truth(eval(node->b));
+        if (b == 1) return make_bool(1);
+        return (a < 0 || b < 0) ? g_unknown : make_bool(0);
+    }
+    case N_CMP: return eval_compare(node->op, eval(node->a), eval(node->b));
+    case N_ARITH: {
+        double x, y;
+        if (!as_number(eval(node->a), &x) || !as_number(eval(node->b), &y)) return g_unknown;
+        switch (node->op) {
+        case '+': return make_num(x + y);
+        case '-': return make_num(x - y);
+        case '*': return make_num(x * y);
+        case '/': return y != 0 ? make_num(x / y) : g_unknown;
+        }
+        return g_unknown;
+    }
+    }
+    return g_unknown;
+}
+
+// Fold the finished element of 'scope' into its aggregates
+static void fold_element(int scope_index) {
+    Scope* scope = &g_scopes[scope_index];
+    for (int i = 0; i < g_agg_count; i++) {
+        Aggregate* agg = &g_aggs[i];
+        if (agg->scope != scope_index) continue;
+        agg->elements++;
+        if (agg->where && truth(eval(agg->where)) != 1) continue;
+
+        if (agg->field < 0) {
+            agg->matched++;
+            continue;
+        }
+        const Slot* slot = &scope->element[agg->field];
+        if (slot->value.type == V_NONE) continue;
+        double x;
+        switch (agg->func) {
+        case AGG_SUM: case AGG_MIN: case AGG_MAX: case AGG_AVG:
+            if (!as_number(slot_value(slot), &x)) continue;
+            if (!agg->matched || x < agg->min) agg->min = x;
+            if (!agg->matched || x > agg->max) agg->max = x;
+            agg->sum += x;
+            break;
+        case AGG_DISTINCT: case AGG_SPREAD: {
+            int d = 0;
+            while (d < agg->distinct_count && strcmp(agg->distinct[d].text, slot->text) != 0) d++;
+            if (d == agg->distinct_count) {
+                if (d == RULES_DISTINCT_MAX) break;
+                snprintf(agg->distinct[d].text, sizeof(agg->distinct[d].text), "%s", slot->text);
+                agg->distinct_count++;
+            }
+            agg->distinct[d].count++;
+            break;
+        }
+        default:
+            break;
+        }
+        agg->matched++;
+    }
+    for (int f = 0; f < scope->field_count; f++) scope->element[f].value.type = V_NONE;
+}
+
+// ---------------------------------------------------------------------------
+// Snapshot streaming
+// ---------------------------------------------------------------------------
+
+static char g_path[RULES_PATH_MAX];
+static size_t g_path_stack[JSON_STREAM_MAX_DEPTH + 1];
+static int g_is_array[JSON_STREAM_MAX_DEPTH + 1];
+static int g_depth = 0;
+
+// Append ".key" (or "[]" inside arrays) to g_path; returns the previous length
+static size_t path_push(const char* key) {
+    size_t len = strlen(g_path);
+    if (!key) {
+        if (len + 3 <= sizeof(g_path)) memcpy(g_path + len, "[]", 3);
+        return len;
+    }
+    size_t pos = len;
+    if (pos && pos + 1 < sizeof(g_path)) g_path[pos++] = '.';
+    for (; *key && pos + 1 < sizeof(g_path); key++) {
+        g_path[pos++] = (*key == '.' || *key == '[') ? '_' : *key;
+    }
+    g_path[pos] = '\0';
+    return len;
+}
+
+// Offer a scalar (or a container start, with type JSON_NULL and is_container) at g_path
+static void offer(JsonType type, const char* text, int is_container) {
+    size_t len = strlen(g_path);
+    int fact = fact_find(g_path, len);
+    if (fact >= 0 && !g_facts[fact].defined) {
+        if (is_container) g_facts[fact].seen = 1;
+        else slot_set(&g_facts[fact].slot, type, text);
+    }
+
+    for (int s = 0; s < g_scope_count; s++) {
+        Scope* scope = &g_scopes[s];
+        if (scope->depth < 0) continue;
+        size_t base = strlen(scope->path);
+        const char* field = NULL;
+        if (len == base && memcmp(g_path, scope->path, base) == 0) field = "";
+        else if (len > base && g_path[base] == '.' && memcmp(g_path, scope->path, base) == 0) field = g_path + base + 1;
+        if (!field || is_container) continue;
+        for (int f = 0; f < scope->field_count; f++) {
+            if (strcmp(scope->fields[f], field) == 0) slot_set(&scope->element[f], type, text);
+        }
+    }
+}
+
+static void on_begin(void* user, const char* key, int is_array) {
+    (void)user;
+    int in_array = g_depth > 0 && g_is_array[g_depth - 1];
+    g_path_stack[g_depth] = g_depth > 0 ? path_push(in_array ? NULL : key) : 0;
+    g_is_array[g_depth] = is_array;
+    offer(JSON_NULL, "", 1);
+
+    size_t len = strlen(g_path);
+    for (int s = 0; s < g_scope_count; s++) {
+        Scope* scope = &g_scopes[s];
+        size_t base = strlen(scope->path);
+        if (is_array && len + 2 == base && memcmp(g_path, scope->path, len) == 0) scope->seen = 1;
+        if (in_array && len == base && memcmp(g_path, scope->path, base) == 0) scope->depth = g_depth;
+    }
+    g_depth++;
+}
+
+static void on_end(void* user, int is_array) {
+    (void)user;
+    (void)is_array;
+    g_depth--;
+    for (int s = 0; s < g_scope_count; s++) {
+        if (g_scopes[s].depth == g_depth) {
+            fold_element(s);
+            g_scopes[s].depth = -1;
+        }
+    }
+    g_path[g_path_stack[g_depth]] = '\0';
+}
+
+static void on_scalar(void* user, const char* key, JsonType type, const char* text) {
+    (void)user;
+    if (g_depth == 0) return;
+    int in_array = g_is_array[g_depth - 1];
+    size_t saved = path_push(in_array ? NULL : key);
+
+    if (in_array) {
+        // A scalar element opens and closes its scope's element at once
+        size_t len = strlen(g_path);
+        for (int s = 0; s < g_scope_count; s++) {
+            if (strlen(g_scopes[s].path) == len && memcmp(g_scopes[s].path, g_path, len) == 0) {
+                g_scopes[s].depth = g_depth;
+            }
+        }
+        offer(type, text, 0);
+        for (int s = 0; s < g_scope_count; s++) {
+            if (g_scopes[s].depth == g_depth) {
+                fold_element(s);
+                g_scopes[s].depth = -1;
+            }
+        }
+    } else {
+        offer(type, text, 0);
+    }
+    g_path[saved] = '\0';
+}
+
+static void reset_snapshot_state(void) {
+    for (int i = 0; i < g_fact_count; i++) {
+        if (g_facts[i].defined) continue;
+        g_facts[i].slot.value.type = V_NONE;
+        g_facts[i].seen = 0;
+    }
+    for (int s = 0; s < g_scope_count; s++) {
+        g_scopes[s].seen = 0;
+        g_scopes[s].depth = -1;
+        for (int f = 0; f < g_scopes[s].field_count; f++) g_scopes[s].element[f].value.type = V_NONE;
+    }
+    for (int i = 0; i < g_agg_count; i++) {
+        Aggregate* agg = &g_aggs[i];
+        size_t state = sizeof(Aggregate) - offsetof(Aggregate, elements);
+        memset(&agg->elements, 0, state);
+    }
+    g_path[0] = '\0';
+    g_depth = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Rules file
+// ---------------------------------------------------------------------------
+
+static char* trim(char* s) {
+    while (isspace((unsigned char)*s)) s++;
+    char* end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) *--end = '\0';
+    return s;
+}
+
+// Compile every {EXPR} of 'text' into rule->placeholders
+static int compile_placeholders(Rule* rule, const char* text) {
+    for (const char* p = text ? strchr(text, '{') : NULL; p; p = strchr(p, '{')) {
+        const char* close = strchr(p, '}');
+        if (!close) {
+            fprintf(stderr, "rules_engine: rule %s: unclosed '{'\n", rule->id);
+            return 0;
+        }
+        char expr[RULES_MESSAGE_MAX];
+        snprintf(expr, sizeof(expr), "%.*s", (int)(close - p - 1), p + 1);
+        Node* node = compile(expr, rule->id, "placeholder");
+        if (!node) return 0;
+        rule->placeholders = (Node**)realloc(rule->placeholders, sizeof(Node*) * (rule->placeholder_count + 1));
+        rule->placeholders[rule->placeholder_count++] = node;
+        p = close + 1;
+    }
+    return 1;
+}
+
+static int finish_rule(Rule* rule, char* when) {
+    if (!rule) return 1;
+    if (!when) {
+        fprintf(stderr, "rules_engine: rule %s has no 'when'\n", rule->id);
+        return 0;
+    }
+    rule->when = compile(when, rule->id, "when");
+    if (!rule->when) return 0;
+    if (!rule->severity[0]) snprintf(rule->severity, sizeof(rule->severity), "warning");
+    return compile_placeholders(rule, rule->message) && compile_placeholders(rule, rule->fix);
+}
+
+// Append a continuation line to a key's value (the text stays allocated for the run)
+static char* append_value(char* value, const char* more) {
+    size_t len = value ? strlen(value) : 0;
+    char* grown = (char*)realloc(value, len + strlen(more) + 2);
+    if (!grown) return value;
+    if (len) grown[len++] = ' ';
+    strcpy(grown + len, more);
+    return grown;
+}
+
+static int load_rules(const char* path) {
+    char* text = read_file(path);
+    if (!text) {
+        fprintf(stderr, "rules_engine: cannot read rules %s\n", path);
+        return 0;
+    }
+
+    Rule* rule = NULL;
+    char* when = NULL;
+    char** last_value = NULL;
+    int line_no = 0;
+    for (char* line = text; line; ) {
+        char* next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        line_no++;
+        int continued = line[0] == ' ' || line[0] == '\t';
+        char* body = trim(line);
+
+        if (!body[0] || body[0] == '#') {
+            // blank line or comment
+        } else if (body[0] == '[') {
+            if (!finish_rule(rule, when)) return 0;
+            free(when);
+            when = NULL;
+            last_value = NULL;
+            char id[64];
+            if (sscanf(body, "[rule %63[^] ]]", id) != 1) {
+                fprintf(stderr, "rules_engine: %s:%d: expected [rule ID]\n", path, line_no);
+                return 0;
+            }
+            g_rules = (Rule*)grow(g_rules, g_rule_count, sizeof(Rule));
+            rule = &g_rules[g_rule_count++];
+            snprintf(rule->id, sizeof(rule->id), "%s", id);
+        } else if (continued && last_value) {
+            *last_value = append_value(*last_value, body);
+        } else if (rule) {
+            char* colon = strchr(body, ':');
+            if (!colon) {
+                fprintf(stderr, "rules_engine: %s:%d: expected 'key: value'\n", path, line_no);
+                return 0;
+            }
+            *colon = '\0';
+            char* key = trim(body);
+            char* value = trim(colon + 1);
+            last_value = NULL;
+            if (strcmp(key, "severity") == 0) snprintf(rule->severity, sizeof(rule->severity), "%s", value);
+            else if (strcmp(key, "category") == 0) snprintf(rule->category, sizeof(rule->category), "%s", value);
+            else if (strcmp(key, "title") == 0) last_value = &rule->title;
+            else if (strcmp(key, "message") == 0) last_value = &rule->message;
+            else if (strcmp(key, "fix") == 0) last_value = &rule->fix;
+            else if (strcmp(key, "when") == 0) last_value = &when;
+            else {
+                fprintf(stderr, "rules_engine: %s:%d: unknown key '%s'\n", path, line_no, key);
+                return 0;
+            }
+            if (last_value) *last_value = append_value(*last_value, value);
+        } else {
+            fprintf(stderr, "rules_engine: %s:%d: text outside a rule\n", path, line_no);
+            return 0;
+        }
+        line = next;
+    }
+    int ok = finish_rule(rule, when);
+    free(when);
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Output
+// ---------------------------------------------------------------------------
+
+static void print_json_string(const char* s) {
+    putchar('"');
+    for (; s && *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') printf("\\%c", c);
+        else if (c == '\n') fputs("\\n", stdout);
+        else if (c < 0x20) printf("\\u%04x", c);
+        else putchar(c);
+    }
+    putchar('"');
+}
+
+static void format_value(Value v, char* out, size_t size) {
+    switch (v.type) {
+    case V_BOOL: snprintf(out, size, "%s", v.num ? "true" : "false"); break;
+    case V_STR: snprintf(out, size, "%s", v.str); break;
+    case V_NUM:
+        if (v.num == floor(v.num) && fabs(v.num) < 1e15) snprintf(out, size, "%.0f", v.num);
+        else snprintf(out, size, "%.4g", v.num);
+        break;
+    default: snprintf(out, size, "N/A"); break;
+    }
+}
+
+// Expand {EXPR} placeholders, consuming them from *next in order
+static void expand(const Rule* rule, const char* text, int* next, char* out, size_t size) {
+    size_t len = 0;
+    out[0] = '\0';
+    for (const char* p = text; p && *p && len + 1 < size; ) {
+        if (*p == '{') {
+            const char* close = strchr(p, '}');
+            char value[RULES_TEXT_MAX];
+            format_value(eval(rule->placeholders[(*next)++]), value, sizeof(value));
+            len += (size_t)snprintf(out + len, size - len, "%s", value);
+            if (len >= size) len = size - 1;
+            p = close + 1;
+        } else {
+            out[len++] = *p++;
+            out[len] = '\0';
+        }
+    }
+}
+
+// Evaluate every rule for the snapshot just read and print its host object
+static void report_host(const char* snapshot, double parse_us, int first) {
+    double start = now_us();
+    int passed = 0, unknown = 0, fired = 0;
+    char* status = (char*)malloc((size_t)g_rule_count + 1);
+    for (int r = 0; r < g_rule_count; r++) {
+        int t = truth(eval(g_rules[r].when));
+        status[r] = (char)t;
+        if (t == 1) fired++;
+        else if (t == 0) passed++;
+        else unknown++;
+    }
+    double eval_us = now_us() - start;
+
+    int host = fact_find("generated", strlen("generated"));
+    printf("%s\n    {\"snapshot\": ", first ? "" : ",");
+    print_json_string(snapshot);
+    printf(", \"host\": ");
+    print_json_string(host >= 0 && g_facts[host].slot.value.type == V_STR ? g_facts[host].slot.text : "");
+    printf(", \"rules\": %d, \"passed\": %d, \"not_applicable\": %d, \"fired\": %d, "
+           "\"parse_us\": %.1f, \"eval_us\": %.2f,\n     \"not_applicable_rules\": [",
+           g_rule_count, passed, unknown, fired, parse_us, eval_us);
+    int listed = 0;
+    for (int r = 0; r < g_rule_count; r++) {
+        if (status[r] >= 0) continue;
+        printf("%s", listed++ ? ", " : "");
+        print_json_string(g_rules[r].id);
+    }
+    printf("],\n     \"findings\": [");
+
+    char message[RULES_MESSAGE_MAX];
+    listed = 0;
+    for (int r = 0; r < g_rule_count; r++) {
+        if (status[r] != 1) continue;
+        const Rule* rule = &g_rules[r];
+        int next = 0;
+        printf("%s\n        {\"id\": ", listed++ ? "," : "");
+        print_json_string(rule->id);
+        printf(", \"severity\": ");
+        print_json_string(rule->severity);
+        printf(", \"category\": ");
+        print_json_string(rule->category);
+        printf(", \"title\": ");
+        print_json_string(rule->title ? rule->title : rule->id);
+        expand(rule, rule->message, &next, message, sizeof(message));
+        printf(", \"message\": ");
+        print_json_string(message);
+        expand(rule, rule->fix, &next, message, sizeof(message));
+        printf(", \"fix\": ");
+        print_json_string(message);
+        printf("}");
+    }
+    printf("%s]}", listed ? "\n     " : "");
+    free(status);
+}
+
+static void define_fact(const char* assignment) {
+    const char* eq = strchr(assignment, '=');
+    if (!eq) {
+        fprintf(stderr, "rules_engine: --define expects NAME=VALUE\n");
+        return;
+    }
+    char name[RULES_PATH_MAX];
+    snprintf(name, sizeof(name), "%.*s", (int)(eq - assignment), assignment);
+    Fact* fact = &g_facts[fact_intern(name)];
+    char* end;
+    strtod(eq + 1, &end);
+    int numeric = eq[1] && *end == '\0';
+    slot_set(&fact->slot, numeric ? JSON_NUMBER : JSON_STRING, eq + 1);
+    fact->defined = 1;
+}
+
+int main(int argc, char* argv[]) {
+    const char* rules_path = "audit_rules.txt";
+    const char* snapshots[256];
+    int snapshot_count = 0;
+    const char* defines[RULES_MAX_DEFINES];
+    int define_count = 0;
+
+    trace_init(argc, argv);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rules") == 0 && i + 1 < argc) {
+            rules_path = argv[++i];
+        } else if (strcmp(argv[i], "--define") == 0 && i + 1 < argc) {
+            if (define_count < RULES_MAX_DEFINES) defines[define_count++] = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            i++;
+        } else if (snapshot_count < (int)(sizeof(snapshots) / sizeof(snapshots[0]))) {
+            snapshots[snapshot_count++] = argv[i];
+        }
+    }
+    if (snapshot_count == 0) snapshots[snapshot_count++] = "-";
+
+    trace_begin("probe", "load_rules");
+    fact_intern("generated");   // host name for the output
+    int loaded = load_rules(rules_path);
+    for (int i = 0; i < define_count; i++) define_fact(defines[i]);
+    trace_end();
+    if (!loaded) return 1;
+
+    static char out_buffer[1 << 16];
+    setvbuf(stdout, out_buffer, _IOFBF, sizeof(out_buffer));
+    printf("{\"rules_file\": ");
+    print_json_string(rules_path);
+    printf(", \"rule_count\": %d, \"hosts\": [", g_rule_count);
+
+    int failures = 0;
+    for (int i = 0; i < snapshot_count; i++) {
+        FILE* in = strcmp(snapshots[i], "-") == 0 ? stdin : fopen(snapshots[i], "rb");
+        if (!in) {
+            fprintf(stderr, "rules_engine: cannot open snapshot %s\n", snapshots[i]);
+            failures++;
+            continue;
+        }
+        static JsonStream stream;
+        static const JsonStreamHandler handler = {on_begin, on_end, on_scalar};
+        reset_snapshot_state();
+        json_stream_init(&stream, in, &handler, NULL);
+
+        trace_begin("probe", "parse_snapshot");
+        double start = now_us();
+        int ok = json_stream_parse(&stream);
+        double parse_us = now_us() - start;
+        trace_end();
+        if (in != stdin) fclose(in);
+        if (!ok) {
+            fprintf(stderr, "rules_engine: %s: %s\n", snapshots[i], stream.error);
+            failures++;
+            continue;
+        }
+
+        trace_begin("probe", "evaluate_rules");
+        report_host(snapshots[i], parse_us, i - failures == 0);
+        trace_end();
+    }
+    printf("\n]}\n");
+    fflush(stdout);
+    return failures == snapshot_count ? 1 : 0;
+}
@@ -6,10 +6,15 @@
 #include <windows.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include "helper_replay.h"
+#include "helper_trace.h"
+#include "helper_deadline.h"
 
 // SPD EEPROM addresses (standard I2C addresses for DIMMs)
 #define SPD_BASE_ADDR 0x50
-#define MAX_DIMMS 8
+#define MAX_DIMMS 8  // Minimum DIMM array size; grown to the SMBIOS Type 17 count
 
 // DDR4 SPD byte offsets
 #define SPD_DDR4_DEVICE_TYPE 2
@@ -247,6 +252,39 @@ void parse_ddr4_spd(uint8_t *spd, SPDInfo *info) {
     info->part_number[18] = '\0';
 }
 
+// Load the raw SMBIOS table ('RSMB' payload: 8-byte header + structures).
+// Comes from the replay root when replaying, and is copied to the capture root when capturing.
+uint8_t* load_smbios_table(DWORD* size_out) {
+    *size_out = 0;
+    
+    if (replay_enabled()) {
+        size_t replay_size = 0;
+        uint8_t *table = replay_read_file("smbios/RSMB.bin", &replay_size);
+        if (table) *size_out = (DWORD)replay_size;
+        return table;
+    }
+    
+    DWORD size = GetSystemFirmwareTable('RSMB', 0, NULL, 0);
+    if (size == 0) {
+        return NULL;
+    }
+    
+    uint8_t *table = (uint8_t*)malloc(size);
+    if (!table) {
+        return NULL;
+    }
+    
+    DWORD result = GetSystemFirmwareTable('RSMB', 0, table, size);
+    if (result == 0) {
+        free(table);
+        return NULL;
+    }
+    
+    capture_write_file("smbios/RSMB.bin", table, result);
+    *size_out = result;
+    return table;
+}
+
 // Get string from SMBIOS string table
 const char* get_smbios_string(uint8_t *struct_start, uint8_t length, uint8_t string_num) {
     if (string_num == 0) return "";
@@ -265,21 +303,97 @@ const char* get_smbios_string(uint8_t *struct_start, uint8_t length, uint8_t str
     return "";
 }
 
-// Try to read SPD via WMI MSSmBios_RawSMBiosTables
-int read_spd_via_firmware_table(SPDInfo spd_data[], int max_slots) {
-    DWORD size = GetSystemFirmwareTable('RSMB', 0, NULL, 0);
-    if (size == 0) {
-        return 0;
+// Find the channel letter a locator names, 0 if it names none. Boards spell
+// it "P0 CHANNEL A" or "_Node0_Channel1_Dimm0" (bank locator) and
+// "ChannelA-DIMM0", "DIMM_A1", "CPU1_DIMM_B2" or "A1" (device locator).
+static char locator_channel_letter(const char *loc) {
+    char upper[64];
+    size_t n = 0;
+    for (; loc[n] && n < sizeof(upper) - 1; n++) upper[n] = (char)toupper((unsigned char)loc[n]);
+    upper[n] = 0;
+
+    const char *p = strstr(upper, "CHANNEL");
+    if (p) {
+        p += 7;
+        while (*p == ' ' || *p == '_' || *p == '-') p++;
+        if (isupper((unsigned char)*p)) return *p;
+        if (isdigit((unsigned char)*p)) return (char)('A' + (*p - '0'));
     }
-    
-    uint8_t *firmware_table = (uint8_t*)malloc(size);
-    if (!firmware_table) {
-        return 0;
+    p = strstr(upper, "DIMM");
+    if (p) {
+        p += 4;
+        while (*p == ' ' || *p == '_' || *p == '-') p++;
+        if (isupper((unsigned char)p[0]) && isdigit((unsigned char)p[1])) return p[0];
     }
+    if (isupper((unsigned char)upper[0]) && isdigit((unsigned char)upper[1]) &&
+        !isalnum((unsigned char)upper[2])) {
+        return upper[0];
+    }
+    return 0;
+}
+
+// Find the socket a locator names ("P1 CHANNEL A", "CPU1_DIMM_A1"), -1 if none
+static int locator_package(const char *loc) {
+    for (const char *p = loc; *p; p++) {
+        if ((p == loc || !isalnum((unsigned char)p[-1])) && (p[0] == 'P' || p[0] == 'p') &&
+            isdigit((unsigned char)p[1]) && !isalnum((unsigned char)p[2])) {
+            return p[1] - '0';
+        }
+        if (toupper((unsigned char)p[0]) == 'C' && toupper((unsigned char)p[1]) == 'P' &&
+            toupper((unsigned char)p[2]) == 'U' && isdigit((unsigned char)p[3])) {
+            return atoi(p + 3);
+        }
+    }
+    return -1;
+}
+
+// Memory channel of a DIMM from its SMBIOS Type 17 bank and device locators:
+// "A", "B", ... and "P1-A" on multi-socket boards that name the socket, or
+// "Unknown" when the locators ("BANK 0", "DIMM 1") do not name a channel
+void channel_from_locators(const char *bank, const char *device, char *channel, int max_len) {
+    char letter = locator_channel_letter(bank);
+    if (!letter) letter = locator_channel_letter(device);
+    if (!letter) {
+        snprintf(channel, max_len, "Unknown");
+        return;
+    }
+    int package = locator_package(bank);
+    if (package < 0) package = locator_package(device);
+    if (package > 0) {
+        snprintf(channel, max_len, "P%d-%c", package, letter);
+    } else {
+        snprintf(channel, max_len, "%c", letter);
+    }
+}
+
+// Count SMBIOS Type 17 (Memory Device) structures so the DIMM array can be sized up front
+int count_memory_devices(uint8_t *firmware_table, DWORD size) {
+    if (!firmware_table) return 0;
     
-    DWORD result = GetSystemFirmwareTable('RSMB', 0, firmware_table, size);
-    if (result == 0) {
-        free(firmware_table);
+    int count = 0;
+    uint8_t *ptr = firmware_table + 8;  // Skip header
+    uint8_t *end = firmware_table + size;
+    
+    while (ptr + 4 < end) {
+        uint8_t type = ptr[0];
+        uint8_t length = ptr[1];
+        
+        if (type == 0x7F) break;  // End-of-table marker
+        if (length < 4 || ptr + length > end) break;
+        if (type == 17) count++;
+        
+        ptr += length;
+        while (ptr + 1 < end && !(ptr[0] == 0 && ptr[1] == 0)) {
+            ptr++;
+        }
+        ptr += 2;
+    }
+    return count;
+}
+
+// Try to read SPD via WMI MSSmBios_RawSMBiosTables
+int read_spd_via_firmware_table(uint8_t *firmware_table, DWORD size, SPDInfo spd_data[], int max_slots) {
+    if (!firmware_table) {
         return 0;
     }
     
@@ -420,8 +534,10 @@ int read_spd_via_firmware_table(SPDInfo spd_data[], int max_slots) {
                 strcpy(info->part_number, "N/A");
             }
             
-            // Determine channel (simple heuristic: even slots = A, odd = B)
-            sprintf(info->channel, "%c", 'A' + (found_dimms % 2));
+            // Channel from the Device Locator (offset 0x10) and Bank Locator (offset 0x11)
+            channel_from_locators(get_smbios_string(struct_start, length, ptr[0x11]),
+                                  get_smbios_string(struct_start, length, ptr[0x10]),
+                                  info->channel, sizeof(info->channel));
             
             // Module type derived from form factor and size
             if (strcmp(form_str, "SODIMM") == 0 || strcmp(form_str, "SO-DIMM") == 0) {
@@ -452,14 +568,11 @@ next_struct:
         ptr += 2;  // Skip double null terminator
     }
     
-    free(firmware_table);
     return found_dimms;
 }
 
 // Get SMBIOS memory array information (Type 16)
-int get_memory_array_info(char* method, int* max_capacity_mb, int* num_slots, char* ecc_type, int max_len) {
-    DWORD table_size = 0;
-    BYTE* firmware_table = NULL;
+int get_memory_array_info(BYTE* firmware_table, DWORD table_size, char* method, int* max_capacity_mb, int* num_slots, char* ecc_type, int max_len) {
     BYTE* ptr = NULL;
     BYTE* end = NULL;
     int found = 0;
@@ -471,16 +584,8 @@ int get_memory_array_info(char* method, int* max_capacity_mb, int* num_slots, ch
     *max_capacity_mb = 0;
     *num_slots = 0;
     
-    // Get SMBIOS tables
-    firmware_table = (BYTE*)malloc(65536);
     if (!firmware_table) return 0;
     
-    table_size = GetSystemFirmwareTable('RSMB', 0, firmware_table, 65536);
-    if (table_size == 0 || table_size > 65536) {
-        free(firmware_table);
-        return 0;
-    }
-    
     ptr = firmware_table + 8;  // Skip SMBIOS header (8 bytes)
     end = firmware_table + table_size;
     
@@ -530,24 +635,13 @@ int get_memory_array_info(char* method, int* max_capacity_mb, int* num_slots, ch
         ptr += 2;  // Skip double null terminator
     }
     
-    free(firmware_table);
     return found;
 }
 
 // Parse SMBIOS Type 18 (Memory Error Information) and update SPD data
-void parse_memory_errors(SPDInfo spd_data[], int dimm_count) {
-    DWORD table_size = GetSystemFirmwareTable('RSMB', 0, NULL, 0);
-    if (table_size == 0) return;
-    
-    BYTE* firmware_table = (BYTE*)malloc(table_size);
+void parse_memory_errors(BYTE* firmware_table, DWORD table_size, SPDInfo spd_data[], int dimm_count) {
     if (!firmware_table) return;
     
-    DWORD result = GetSystemFirmwareTable('RSMB', 0, firmware_table, table_size);
-    if (result == 0) {
-        free(firmware_table);
-        return;
-    }
-    
     // Initialize error fields
     for (int i = 0; i < dimm_count; i++) {
         spd_data[i].error_type = 0;
@@ -597,31 +691,70 @@ void parse_memory_errors(SPDInfo spd_data[], int dimm_count) {
         }
         ptr += 2;
     }
-    
-    free(firmware_table);
 }
 
 int main(int argc, char *argv[]) {
-    SPDInfo spd_data[MAX_DIMMS] = {0};
     int dimm_count = 0;
     
-    // Try reading via firmware tables (most portable)
-    dimm_count = read_spd_via_firmware_table(spd_data, MAX_DIMMS);
+    replay_init(argc, argv);
+    trace_init(argc, argv);
+    deadline_init(argc, argv);
     
-    // Parse memory error information (SMBIOS Type 18)
-    parse_memory_errors(spd_data, dimm_count);
+    // Fetch the SMBIOS table once; every parser below walks the same copy
+    DWORD table_size = 0;
+    trace_begin("syscall", "load_smbios_table");
+    uint8_t *firmware_table = load_smbios_table(&table_size);
+    trace_end();
+    
+    // Size the DIMM array from the Type 17 count (servers can have hundreds of slots)
+    int max_dimms = count_memory_devices(firmware_table, table_size);
+    if (max_dimms < MAX_DIMMS) max_dimms = MAX_DIMMS;
+    SPDInfo *spd_data = (SPDInfo*)calloc(max_dimms, sizeof(SPDInfo));
+    if (!spd_data) {
+        free(firmware_table);
+        printf("{\"error\": \"Out of memory\"}\n");
+        return 1;
+    }
+    
+    // Try reading via firmware tables (most portable)
+    trace_begin("parse", "memory_devices");
+    dimm_count = read_spd_via_firmware_table(firmware_table, table_size, spd_data, max_dimms);
+    trace_end();
+    if (firmware_table) deadline_source("dimms", "smbios_type17");
+    
+    // Parse memory error information (SMBIOS Type 18); optional, so it goes first when short on time
+    if (deadline_expired()) {
+        deadline_skip("memory_errors", "budget");
+    } else {
+        trace_begin("parse", "memory_errors");
+        parse_memory_errors(firmware_table, table_size, spd_data, dimm_count);
+        trace_end();
+        if (firmware_table) deadline_source("memory_errors", "smbios_type18");
+    }
     
     // Get memory array information
     char array_method[32] = {0};
     int max_capacity_mb = 0;
     int num_slots = 0;
     char ecc_type[32] = {0};
-    int array_found = get_memory_array_info(array_method, &max_capacity_mb, &num_slots, ecc_type, sizeof(ecc_type));
+    int array_found = 0;
+    if (deadline_expired()) {
+        deadline_skip("memory_array", "budget");
+    } else {
+        trace_begin("parse", "memory_array");
+        array_found = get_memory_array_info(firmware_table, table_size, array_method, &max_capacity_mb, &num_slots, ecc_type, sizeof(ecc_type));
+        trace_end();
+        if (array_found) deadline_source("memory_array", "smbios_type16");
+    }
     
     // Output JSON
+    trace_begin("output", "emit_json");
     printf("{\n");
     printf("  \"method\": \"SMBIOS\",\n");
     printf("  \"note\": \"SPD EEPROM timing data is not exposed through SMBIOS. Access requires SMBus/I2C controller access, which is restricted on most systems.\",\n");
+    printf("  ");
+    deadline_print_json();
+    printf("\n");
     
     // Add memory array information if available
     if (array_found) {
@@ -702,6 +835,9 @@ int main(int argc, char *argv[]) {
     
     printf("  ]\n");
     printf("}\n");
+    trace_end();
     
+    free(spd_data);
+    free(firmware_table);
     return 0;
 }
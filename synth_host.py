@@ -0,0 +1,594 @@
+"""
+Synthetic host generator for Halfax System Reporter.
+
+Writes a replay root (same layout as capture_host.py, see helper_replay.h)
+describing a fake but internally consistent machine: CPUID dumps whose x2APIC
+IDs and cache-sharing fields agree with the sysfs topology, an SMBIOS table
+with one Type 17 per DIMM, NVMe descriptors and health log pages, EDID
+blocks, and sysfs/procfs trees for CPUs, cpufreq policies, NUMA nodes, PCI
+devices, disks, network interfaces, interrupts, kernel threads and workqueues.
+
+    python synth_host.py -o bighost                 # 8k CPUs, 64 nodes, ...
+    python synth_host.py -o small --scale 0.125     # same shape, 1/8 size
+    cpuid_helper.exe --replay bighost
+
+bench_scaling.py uses it to check that every collector scales linearly.
+"""
+import argparse
+import json
+import os
+import shutil
+import struct
+
+from capture_host import rsmb_blob, storage_descriptor, write_file
+
+DEFAULTS = {
+    'cpus': 8192,
+    'numa_nodes': 64,
+    'packages': 8,
+    'dimms': 256,
+    'pci_devices': 500,
+    'disks': 200,
+    'interfaces': 10000,
+    'displays': 4,
+}
+SMT = 2
+BASE_MHZ, MAX_MHZ, BUS_MHZ = 2000, 3800, 100
+DIMM_MB = 32768
+BRAND = 'Halfax Synthetic Processor @ 2.00GHz'
+
+
+def bits_for(count):
+    """Width of an x2APIC ID field holding 'count' entries"""
+    return (count - 1).bit_length()
+
+
+def cpulist(cpus):
+    """Format a sorted CPU list the way sysfs does ("0-3,8-11")"""
+    ranges = []
+    for cpu in cpus:
+        if ranges and cpu == ranges[-1][1] + 1:
+            ranges[-1][1] = cpu
+        else:
+            ranges.append([cpu, cpu])
+    return ','.join(f'{a}-{b}' if a != b else str(a) for a, b in ranges)
+
+
+class Geometry:
+    """Package/die/core/thread layout shared by CPUID, sysfs and procfs output.
+
+    Linux numbers first threads of every core 0..cores-1 and SMT siblings
+    after them; each die is one NUMA node.
+    """
+
+    def __init__(self, cpus, numa_nodes, packages):
+        self.dies_per_package = max(1, numa_nodes // max(1, packages))
+        self.packages = max(1, numa_nodes // self.dies_per_package)
+        self.nodes = self.packages * self.dies_per_package
+        self.cores_per_die = max(1, cpus // (self.nodes * SMT))
+        self.cores = self.nodes * self.cores_per_die
+        self.cpus = self.cores * SMT
+
+        self.smt_bits = bits_for(SMT)
+        self.core_bits = bits_for(self.cores_per_die)
+        self.die_bits = bits_for(self.dies_per_package)
+
+    def locate(self, cpu):
+        """Return (package, die, core_in_die, thread) for a Linux CPU number"""
+        thread, core = divmod(cpu, self.cores)
+        node, core_in_die = divmod(core, self.cores_per_die)
+        package, die = divmod(node, self.dies_per_package)
+        return package, die, core_in_die, thread
+
+    def node_of(self, cpu):
+        return (cpu % self.cores) // self.cores_per_die
+
+    def x2apic(self, cpu):
+        package, die, core, thread = self.locate(cpu)
+        apic = package
+        apic = (apic << self.die_bits) | die
+        apic = (apic << self.core_bits) | core
+        return (apic << self.smt_bits) | thread
+
+    def node_cpus(self, node):
+        first = node * self.cores_per_die
+        return [t * self.cores + c for t in range(SMT)
+                for c in range(first, first + self.cores_per_die)]
+
+    def package_cpus(self, package):
+        cpus = []
+        for die in range(self.dies_per_package):
+            cpus += self.node_cpus(package * self.dies_per_package + die)
+        return sorted(cpus)
+
+    def siblings(self, cpu):
+        core = cpu % self.cores
+        return [t * self.cores + core for t in range(SMT)]
+
+    def isolated(self):
+        """CPUs reserved on the kernel command line: the last NUMA node (the
+        upper half of the CPUs on a single-node host)"""
+        if self.nodes > 1:
+            return sorted(self.node_cpus(self.nodes - 1))
+        return list(range(self.cpus // 2, self.cpus))
+
+
+def cpumask(cpus):
+    """Format a CPU set as a sysfs hex mask ("ff,ffffffff")"""
+    value = sum(1 << cpu for cpu in cpus)
+    words = []
+    while True:
+        words.append(value & 0xFFFFFFFF)
+        value >>= 32
+        if not value:
+            break
+    return f'{words[-1]:x}' + ''.join(f',{w:08x}' for w in reversed(words[:-1]))
+
+
+def scaled(params, scale):
+    out = dict(params)
+    for key in DEFAULTS:
+        out[key] = max(1, int(round(params[key] * scale)))
+    return out
+
+
+# --- CPUID -------------------------------------------------------------------
+
+def cache_leaf(cache_type, level, size, ways, sharing_bits, cores_per_package_bits):
+    line, partitions = 64, 1
+    sets = size // (ways * line * partitions)
+    eax = (cache_type | (level << 5) | (1 << 8)
+           | (((1 << sharing_bits) - 1) << 14)
+           | (min((1 << cores_per_package_bits) - 1, 63) << 26))
+    ebx = ((ways - 1) << 22) | ((partitions - 1) << 12) | (line - 1)
+    return eax, ebx, sets - 1, 0
+
+
+def brand_leaves():
+    raw = BRAND.encode('ascii').ljust(48, b'\0')
+    regs = struct.unpack('<12I', raw)
+    return [regs[i:i + 4] for i in (0, 4, 8)]
+
+
+def cpuid_dump(geo, cpu):
+    apic = geo.x2apic(cpu)
+    die_shift = geo.smt_bits + geo.core_bits
+    pkg_shift = die_shift + geo.die_bits
+    lps_per_die = geo.cores_per_die * SMT
+    lps_per_package = lps_per_die * geo.dies_per_package
+    l3_size = geo.cores_per_die * 2 * 1024 * 1024
+
+    leaves = [
+        (0x0, 0, 0x1F, 0x756E6547, 0x6C65746E, 0x49656E69),  # GenuineIntel
+        (0x1, 0, 0x000A06D1,
+         ((apic & 0xFF) << 24) | (min(lps_per_package, 255) << 16) | (8 << 8),
+         0x7FFAFBFF, 0xBFEBFBFF),
+        (0x4, 0) + cache_leaf(1, 1, 48 * 1024, 12, geo.smt_bits, pkg_shift - geo.smt_bits),
+        (0x4, 1) + cache_leaf(2, 1, 32 * 1024, 8, geo.smt_bits, pkg_shift - geo.smt_bits),
+        (0x4, 2) + cache_leaf(3, 2, 2 * 1024 * 1024, 16, geo.smt_bits, pkg_shift - geo.smt_bits),
+        (0x4, 3) + cache_leaf(3, 3, l3_size, 16, die_shift, pkg_shift - geo.smt_bits),
+        (0x4, 4, 0, 0, 0, 0),
+        (0x7, 0, 2, 0xF3BFB7EF, 0x5B417F5E, 0xBC18C410),
+        (0xB, 0, geo.smt_bits, SMT, 0x100, apic),
+        (0xB, 1, pkg_shift, lps_per_package & 0xFFFF, 0x201, apic),
+        (0xB, 2, 0, 0, 0x2, apic),
+        (0x16, 0, BASE_MHZ, MAX_MHZ, BUS_MHZ, 0),
+        (0x1A, 0, 0x40 << 24, 0, 0, 0),
+        (0x1F, 0, geo.smt_bits, SMT, 0x100, apic),
+        (0x1F, 1, die_shift, lps_per_die & 0xFFFF, 0x201, apic),
+        (0x1F, 2, pkg_shift, lps_per_package & 0xFFFF, 0x502, apic),
+        (0x1F, 3, 0, 0, 0x3, apic),
+        (0x80000000, 0, 0x80000008, 0, 0, 0),
+        (0x80000001, 0, 0, 0, 0x00000121, 0x2C100800),
+    ]
+    for i, regs in enumerate(brand_leaves()):
+        leaves.append((0x80000002 + i, 0) + tuple(regs))
+    leaves.append((0x80000006, 0, 0, 0, (2048 << 16) | (8 << 12) | 64, 0))
+    leaves.append((0x80000008, 0, 0x3934, 0, 0, 0))
+
+    return ''.join('%08x %02x %08x %08x %08x %08x\n' % entry for entry in leaves)
+
+
+def write_cpuid(root, geo):
+    for cpu in range(geo.cpus):
+        write_file(root, f'cpuid/cpu{cpu}.txt', cpuid_dump(geo, cpu))
+    write_file(root, 'wmi/Win32_Processor.MaxClockSpeed.txt', f'{MAX_MHZ}\n')
+
+
+# --- SMBIOS ------------------------------------------------------------------
+
+def smbios_struct(stype, handle, body, strings=()):
+    formatted = struct.pack('<BBH', stype, 4 + len(body), handle) + body
+    if not strings:
+        return formatted + b'\0\0'
+    return formatted + b''.join(s.encode('ascii') + b'\0' for s in strings) + b'\0'
+
+
+def memory_array(handle, devices, capacity_kb):
+    # Location, Use, ECC, Maximum Capacity, Error Handle, Devices, Extended Capacity
+    return smbios_struct(16, handle, struct.pack(
+        '<BBBIHHQ', 0x03, 0x03, 0x06, 0x80000000, 0xFFFE, devices, capacity_kb * 1024))
+
+
+def memory_device(handle, array_handle, index, node):
+    # SMBIOS 2.8 Type 17 (length 0x28): widths, size, form factor, locators,
+    # DDR5, speeds, strings, rank, extended size, configured speed, voltages
+    body = struct.pack('<HHHHHBBBBBHHBBBBBIHHHH',
+                       array_handle, 0xFFFE, 72, 64, 0x7FFF, 0x09, 0,
+                       1, 2, 0x22, 0x0080, 4800,
+                       3, 4, 5, 6, 0x02, DIMM_MB, 4800, 1100, 1100, 1100)
+    strings = (f'DIMM_{index:03d}', f'NODE{node}', 'Halfax Memory',
+               f'SN{index:08X}', f'ASSET{index:04d}', 'HX5-4800-32G')
+    return smbios_struct(17, handle, body, strings)
+
+
+def write_smbios(root, geo, dimms):
+    per_package = -(-dimms // geo.packages)
+    table = b''
+    handle = 0x1000
+    for package in range(geo.packages):
+        first = package * per_package
+        count = max(0, min(per_package, dimms - first))
+        array_handle = handle
+        table += memory_array(array_handle, count, count * DIMM_MB * 1024)
+        handle += 1
+        for index in range(first, first + count):
+            node = index * geo.nodes // dimms
+            table += memory_device(handle, array_handle, index, node)
+            handle += 1
+    table += smbios_struct(127, 0xFFFF, b'')
+    write_file(root, 'smbios/RSMB.bin', rsmb_blob(3, 2, table))
+
+
+# --- Devices -----------------------------------------------------------------
+
+def health_log(index):
+    log = bytearray(512)
+    log[1:3] = struct.pack('<H', 273 + 40 + index % 20)   # Kelvin
+    log[3], log[4], log[5] = 100, 10, index % 50
+    log[32:40] = struct.pack('<Q', 1000000 + index)
+    log[48:56] = struct.pack('<Q', 2000000 + index)
+    log[128:136] = struct.pack('<Q', 8760 + index)
+    log[144:152] = struct.pack('<Q', index % 7)
+    return bytes(log)
+
+
+def edid_block(index):
+    block = bytearray(128)
+    block[0:8] = b'\x00\xff\xff\xff\xff\xff\xff\x00'
+    block[8:10] = struct.pack('>H', (ord('H') - 64) << 10 | (ord('A') - 64) << 5 | (ord('X') - 64))
+    block[10:12] = struct.pack('<H', 0x2700 + index)
+    block[12:16] = struct.pack('<I', 100000 + index)
+    block[16], block[17], block[18], block[19] = 1, 34, 1, 4
+    block[21], block[22] = 60, 34   # 60x34 cm
+    # Detailed timing 3840x2160@60, then the monitor name descriptor
+    block[54:72] = bytes([0x08, 0xE8, 0x00, 0x30, 0xF2, 0x70, 0x5A, 0x80, 0xB0, 0x58,
+                          0x8A, 0x00, 0x58, 0x54, 0x21, 0x00, 0x00, 0x1E])
+    name = f'HALFAX {index}'.encode('ascii')[:13]
+    block[72:77] = b'\x00\x00\x00\xfc\x00'
+    block[77:90] = (name + b'\n').ljust(13, b' ')
+    for start in (90, 108):
+        block[start:start + 5] = b'\x00\x00\x00\x10\x00'
+    block[127] = (-sum(block[:127])) & 0xFF
+    return bytes(block)
+
+
+def write_devices(root, geo, params):
+    pci = params['pci_devices']
+    disks = params['disks']
+    nics = max(1, min(pci - disks, params['interfaces'] // 100)) if pci > disks else 0
+
+    for i in range(pci):
+        bdf = f'0000:{i // 32:02x}:{i % 32:02x}.0'
+        node = i * geo.nodes // pci
+        if i < disks:
+            vendor, device, cls = 0x144D, 0xA80A, 0x010802
+        elif i < disks + nics:
+            vendor, device, cls = 0x8086, 0x1592, 0x020000
+        else:
+            vendor, device, cls = 0x8086, 0x352A, 0x060400
+        base = f'sys/bus/pci/devices/{bdf}'
+        write_file(root, f'{base}/vendor', f'0x{vendor:04x}\n')
+        write_file(root, f'{base}/device', f'0x{device:04x}\n')
+        write_file(root, f'{base}/class', f'0x{cls:06x}\n')
+        write_file(root, f'{base}/numa_node', f'{node}\n')
+        write_file(root, f'{base}/local_cpulist', cpulist(sorted(geo.node_cpus(node))) + '\n')
+        write_file(root, f'{base}/irq', f'{32 + i}\n')
+        write_file(root, f'{base}/current_link_speed', '32.0 GT/s PCIe\n')
+        write_file(root, f'{base}/current_link_width', '4\n' if i < disks else '16\n')
+        write_file(root, f'proc/irq/{32 + i}/smp_affinity_list',
+                   cpulist(sorted(geo.node_cpus(node))) + '\n')
+        write_file(root, f'proc/irq/{32 + i}/node', f'{node}\n')
+    write_file(root, 'proc/irq/default_smp_affinity', 'f' * (geo.cpus // 4 or 1) + '\n')
+
+    for i in range(disks):
+        name = f'nvme{i}n1'
+        model = f'Halfax NVMe {i:03d}'
+        write_file(root, f'nvme/PhysicalDrive{i}/descriptor.bin', storage_descriptor(model))
+        write_file(root, f'nvme/PhysicalDrive{i}/log_02.bin', health_log(i))
+        write_file(root, f'sys/block/{name}/size', f'{7814037168}\n')
+        write_file(root, f'sys/block/{name}/queue/rotational', '0\n')
+        write_file(root, f'sys/block/{name}/queue/logical_block_size', '512\n')
+        write_file(root, f'sys/class/nvme/nvme{i}/model', model + '\n')
+        write_file(root, f'sys/class/nvme/nvme{i}/serial', f'HXN{i:08d}\n')
+        write_file(root, f'sys/class/nvme/nvme{i}/numa_node', f'{i * geo.nodes // max(1, pci)}\n')
+
+    names = ['lo'] + [f'eth{i}' for i in range(nics)]
+    names += [f'veth{i}' for i in range(params['interfaces'] - len(names))]
+    for ifindex, name in enumerate(names[:params['interfaces']], 1):
+        base = f'sys/class/net/{name}'
+        physical = name.startswith('eth')
+        write_file(root, f'{base}/ifindex', f'{ifindex}\n')
+        write_file(root, f'{base}/address', '02:%02x:%02x:%02x:%02x:%02x\n' % tuple(
+            (ifindex >> shift) & 0xFF for shift in (32, 24, 16, 8, 0)))
+        write_file(root, f'{base}/mtu', '65536\n' if name == 'lo' else '1500\n')
+        write_file(root, f'{base}/operstate', 'unknown\n' if name == 'lo' else 'up\n')
+        write_file(root, f'{base}/type', '772\n' if name == 'lo' else '1\n')
+        write_file(root, f'{base}/speed', '100000\n' if physical else '10000\n')
+        write_file(root, f'{base}/statistics/rx_bytes', f'{ifindex * 4096}\n')
+        write_file(root, f'{base}/statistics/tx_bytes', f'{ifindex * 2048}\n')
+
+    for i in range(params['displays']):
+        write_file(root, f'edid/DISPLAY{i}/HAX{0x2700 + i:04X}.bin', edid_block(i))
+
+
+# --- sysfs/procfs ------------------------------------------------------------
+
+def write_cpu_tree(root, geo):
+    cpu_root = 'sys/devices/system/cpu'
+    every = f'0-{geo.cpus - 1}\n'
+    for name in ('online', 'possible', 'present'):
+        write_file(root, f'{cpu_root}/{name}', every)
+    isolated = cpulist(geo.isolated()) + '\n'
+    write_file(root, f'{cpu_root}/isolated', isolated)
+    write_file(root, f'{cpu_root}/nohz_full', isolated)
+
+    package_lists = [cpulist(geo.package_cpus(p)) + '\n' for p in range(geo.packages)]
+    node_lists = [cpulist(sorted(geo.node_cpus(n))) + '\n' for n in range(geo.nodes)]
+    caches = [(1, 'Data', '48K'), (1, 'Instruction', '32K'), (2, 'Unified', '2048K'),
+              (3, 'Unified', f'{geo.cores_per_die * 2048}K')]
+    freqs = [mhz * 1000 for mhz in range(MAX_MHZ, 799, -200)]
+    states = ''.join(f'{khz} {100 + khz // 10000}\n' for khz in freqs)
+    # Transitions only between neighbouring states, like a governor stepping
+    trans = [[0 if abs(a - b) != 1 else 50 for b in range(len(freqs))]
+             for a in range(len(freqs))]
+    trans_table = ('   From  :    To\n         : ' +
+                   ''.join(f'{khz:>10}' for khz in freqs) + '\n' +
+                   ''.join(f'{khz:>9}: ' + ''.join(f'{n:>10}' for n in row) + '\n'
+                           for khz, row in zip(freqs, trans)))
+    total_trans = f'{sum(map(sum, trans))}\n'
+
+    for cpu in range(geo.cpus):
+        package, die, core, _ = geo.locate(cpu)
+        node = geo.node_of(cpu)
+        siblings = cpulist(geo.siblings(cpu)) + '\n'
+        base = f'{cpu_root}/cpu{cpu}'
+        write_file(root, f'{base}/online', '1\n')
+        write_file(root, f'{base}/topology/physical_package_id', f'{package}\n')
+        write_file(root, f'{base}/topology/die_id', f'{die}\n')
+        write_file(root, f'{base}/topology/core_id', f'{core}\n')
+        write_file(root, f'{base}/topology/thread_siblings_list', siblings)
+        write_file(root, f'{base}/topology/core_cpus_list', siblings)
+        write_file(root, f'{base}/topology/core_siblings_list', package_lists[package])
+        write_file(root, f'{base}/topology/die_cpus_list', node_lists[node])
+        for index, (level, ctype, size) in enumerate(caches):
+            shared = node_lists[node] if level == 3 else siblings
+            cache = f'{base}/cache/index{index}'
+            write_file(root, f'{cache}/level', f'{level}\n')
+            write_file(root, f'{cache}/type', f'{ctype}\n')
+            write_file(root, f'{cache}/size', f'{size}\n')
+            write_file(root, f'{cache}/shared_cpu_list', shared)
+        # One policy per CPU (intel_pstate); cpuN/cpufreq is a symlink to it
+        # on a live host, and captures copy it resolved, so write both
+        policy = {
+            'related_cpus': f'{cpu}\n',
+            'affected_cpus': f'{cpu}\n',
+            'cpuinfo_min_freq': f'{freqs[-1]}\n',
+            'cpuinfo_max_freq': f'{freqs[0]}\n',
+            'base_frequency': f'{BASE_MHZ * 1000}\n',
+            'scaling_min_freq': f'{freqs[-1]}\n',
+            'scaling_max_freq': f'{freqs[0]}\n',
+            'scaling_cur_freq': f'{BASE_MHZ * 1000 + (cpu % 9) * 100000}\n',
+            'scaling_governor': 'performance\n',
+            'scaling_driver': 'intel_pstate\n',
+            'energy_performance_preference': 'balance_performance\n',
+            'stats/time_in_state': states,
+            'stats/total_trans': total_trans,
+            'stats/trans_table': trans_table,
+        }
+        for freq in (f'{base}/cpufreq', f'{cpu_root}/cpufreq/policy{cpu}'):
+            for name, text in policy.items():
+                write_file(root, f'{freq}/{name}', text)
+
+    node_root = 'sys/devices/system/node'
+    write_file(root, f'{node_root}/online', f'0-{geo.nodes - 1}\n')
+    write_file(root, f'{node_root}/possible', f'0-{geo.nodes - 1}\n')
+    for node in range(geo.nodes):
+        package = node // geo.dies_per_package
+        distances = ' '.join(
+            '10' if other == node else
+            '12' if other // geo.dies_per_package == package else '32'
+            for other in range(geo.nodes))
+        base = f'{node_root}/node{node}'
+        write_file(root, f'{base}/cpulist', node_lists[node])
+        write_file(root, f'{base}/distance', distances + '\n')
+
+
+def write_proc(root, geo, params):
+    total_kb = params['dimms'] * DIMM_MB * 1024
+    node_kb = total_kb // geo.nodes
+    for node in range(geo.nodes):
+        write_file(root, f'sys/devices/system/node/node{node}/meminfo',
+                   f'Node {node} MemTotal:       {node_kb} kB\n'
+                   f'Node {node} MemFree:        {node_kb * 9 // 10} kB\n')
+    write_file(root, 'proc/meminfo',
+               f'MemTotal:       {total_kb} kB\n'
+               f'MemFree:        {total_kb * 9 // 10} kB\n'
+               f'MemAvailable:   {total_kb * 9 // 10} kB\n'
+               f'HugePages_Total:       0\n'
+               f'Hugepagesize:       2048 kB\n')
+    isolated = cpulist(geo.isolated())
+    write_file(root, 'proc/cmdline', 'BOOT_IMAGE=/vmlinuz root=/dev/nvme0n1p2 ro quiet '
+               f'isolcpus=managed_irq,domain,{isolated} nohz_full={isolated} '
+               f'rcu_nocbs={isolated}\n')
+    write_file(root, 'proc/version', 'Linux version 6.8.0-synthetic (halfax@synth) #1 SMP\n')
+
+    stat = ['cpu  %d 0 %d %d 0 0 0 0 0 0' % (geo.cpus * 1000, geo.cpus * 200, geo.cpus * 90000)]
+    stat += ['cpu%d 1000 0 200 90000 0 0 0 0 0 0' % cpu for cpu in range(geo.cpus)]
+    stat += ['intr 0', 'ctxt 0', 'btime 1700000000', 'processes 1',
+             'procs_running 1', 'procs_blocked 0']
+    write_file(root, 'proc/stat', '\n'.join(stat) + '\n')
+
+    lps_per_package = geo.cores_per_die * geo.dies_per_package * SMT
+    blocks = []
+    for cpu in range(geo.cpus):
+        package, die, core, _ = geo.locate(cpu)
+        blocks.append(
+            f'processor\t: {cpu}\n'
+            f'vendor_id\t: GenuineIntel\n'
+            f'cpu family\t: 6\n'
+            f'model\t\t: 173\n'
+            f'model name\t: {BRAND}\n'
+            f'stepping\t: 1\n'
+            f'cpu MHz\t\t: {BASE_MHZ}.000\n'
+            f'cache size\t: {geo.cores_per_die * 2048} KB\n'
+            f'physical id\t: {package}\n'
+            f'siblings\t: {lps_per_package}\n'
+            f'core id\t\t: {die * geo.cores_per_die + core}\n'
+            f'cpu cores\t: {lps_per_package // SMT}\n'
+            f'apicid\t\t: {geo.x2apic(cpu)}\n'
+            f'flags\t\t: fpu sse sse2 ssse3 sse4_1 sse4_2 x2apic avx avx2 avx512f\n')
+    write_file(root, 'proc/cpuinfo', '\n'.join(blocks))
+
+
+def kthread_stat(pid, name, cpu, ticks, kernel=True):
+    """/proc/PID/stat: flags (PF_KTHREAD), utime, stime and the last CPU"""
+    fields = ['0'] * 50
+    fields[0], fields[5] = 'S', '-1'
+    fields[1] = '1' if not kernel else '0' if pid == 2 else '2'
+    fields[6] = str(0x00208040 if kernel else 0x00400100)
+    fields[11], fields[12], fields[36] = str(ticks // 4), str(ticks - ticks // 4), str(cpu)
+    return f'{pid} ({name}) ' + ' '.join(fields) + '\n'
+
+
+def write_isolation(root, geo, params):
+    """/proc/interrupts, kernel threads and unbound workqueues for isolation_helper.
+
+    Like a host whose isolation has eroded: the IRQs of devices on the
+    isolated node still point at it, kcompactd of that node runs there, and
+    the writeback workqueue kept its boot-time all-CPU mask.
+    """
+    isolated = set(geo.isolated())
+    housekeeping = [cpu for cpu in range(geo.cpus) if cpu not in isolated]
+    everyone = list(range(geo.cpus))
+    pci = params['pci_devices']
+    disks = params['disks']
+
+    # Device IRQs count on the first CPU of their node (the effective
+    # affinity), the per-CPU rows on every CPU
+    zero = f'{0:>11}'
+    header = ' ' * 4 + ''.join(f'{"CPU" + str(cpu):>11}' for cpu in range(geo.cpus))
+    rows = [header]
+    for i in range(pci):
+        irq = 32 + i
+        node = i * geo.nodes // pci
+        target = min(geo.node_cpus(node))
+        name = f'nvme{i}q0' if i < disks else f'pcie{i}'
+        counts = [zero] * geo.cpus
+        counts[target] = f'{1000 + i:>11}'
+        rows.append(f'{irq:>3}:' + ''.join(counts) +
+                    f'  IR-PCI-MSIX-0000:{i // 32:02x}:{i % 32:02x}.0    0-edge      {name}')
+        write_file(root, f'proc/irq/{irq}/effective_affinity_list', f'{target}\n')
+    for label, text, per_cpu in (('NMI', 'Non-maskable interrupts', 10),
+                                 ('LOC', 'Local timer interrupts', 250000),
+                                 ('RES', 'Rescheduling interrupts', 400),
+                                 ('CAL', 'Function call interrupts', 300),
+                                 ('TLB', 'TLB shootdowns', 50)):
+        busy = f'{per_cpu:>11}'
+        quiet = f'{per_cpu // 100:>11}'
+        rows.append(f'{label}:' + ''.join(quiet if cpu in isolated else busy
+                                           for cpu in range(geo.cpus)) + f'   {text}')
+    write_file(root, 'proc/interrupts', '\n'.join(rows) + '\n')
+
+    # Kernel threads: kthreadd, four per CPU, one kcompactd per node and a
+    # pool of unbound kworkers, then a few user processes
+    threads = [('kthreadd', housekeeping, 0)]
+    for cpu in range(geo.cpus):
+        for name in ('cpuhp/%d', 'migration/%d', 'ksoftirqd/%d', 'kworker/%d:0H'):
+            threads.append((name % cpu, [cpu], cpu))
+    for node in range(geo.nodes):
+        cpus = sorted(geo.node_cpus(node))
+        threads.append((f'kcompactd{node}', cpus, cpus[0]))
+    for i in range(max(1, geo.cpus // 16)):
+        threads.append((f'kworker/u{geo.cpus * 2}:{i}', housekeeping, housekeeping[i % len(housekeeping)]))
+
+    pid = 2
+    formatted = {}    # id(allowed) -> (mask, list); the housekeeping list is shared
+    for name, allowed, cpu in threads:
+        if id(allowed) not in formatted:
+            formatted[id(allowed)] = (cpumask(allowed), cpulist(allowed))
+        mask, listed = formatted[id(allowed)]
+        write_file(root, f'proc/{pid}/stat', kthread_stat(pid, name, cpu, 100 + pid % 97))
+        write_file(root, f'proc/{pid}/status',
+                   f'Name:\t{name}\nState:\tS (sleeping)\nTgid:\t{pid}\nPid:\t{pid}\n'
+                   f'PPid:\t{0 if pid == 2 else 2}\nCpus_allowed:\t{mask}\n'
+                   f'Cpus_allowed_list:\t{listed}\n')
+        pid += 1
+    for i in range(max(1, geo.cpus // 64)):
+        name = 'systemd' if i == 0 else f'worker{i}'
+        write_file(root, f'proc/{pid + i}/stat',
+                   kthread_stat(pid + i, name, housekeeping[0], 1000, kernel=False))
+
+    # Unbound workqueues: the global mask keeps them on housekeeping CPUs
+    wq_root = 'sys/devices/virtual/workqueue'
+    write_file(root, f'{wq_root}/cpumask', cpumask(housekeeping) + '\n')
+    write_file(root, f'{wq_root}/cpumask_requested', cpumask(housekeeping) + '\n')
+    for name in ('writeback', 'blkcg_punt_bio', 'nvme-wq', 'nvme-reset-wq', 'nvme-delete-wq'):
+        cpus = everyone if name == 'writeback' else housekeeping
+        write_file(root, f'{wq_root}/{name}/cpumask', cpumask(cpus) + '\n')
+        write_file(root, f'{wq_root}/{name}/per_cpu', '0\n')
+        write_file(root, f'{wq_root}/{name}/max_active', '256\n')
+
+
+def synth_host(output, params):
+    """Generate a replay root for 'params' in 'output' (replaced if it exists)"""
+    geo = Geometry(params['cpus'], params['numa_nodes'], params['packages'])
+    if os.path.isdir(output):
+        shutil.rmtree(output)
+    os.makedirs(output)
+
+    write_cpuid(output, geo)
+    write_smbios(output, geo, params['dimms'])
+    write_devices(output, geo, params)
+    write_cpu_tree(output, geo)
+    write_proc(output, geo, params)
+    write_isolation(output, geo, params)
+
+    actual = dict(params, cpus=geo.cpus, numa_nodes=geo.nodes, packages=geo.packages)
+    manifest = {
+        'hostname': f'synthetic-{geo.cpus}cpu',
+        'platform': 'synthetic',
+        'synthetic': True,
+        'params': actual,
+    }
+    write_file(output, 'manifest.json', json.dumps(manifest, indent=2))
+    return manifest
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate a synthetic replay root')
+    parser.add_argument('-o', '--output', required=True, help='directory to write')
+    parser.add_argument('--scale', type=float, default=1.0,
+                        help='multiply every count below (keeps the shape of the host)')
+    for key, value in DEFAULTS.items():
+        parser.add_argument('--' + key.replace('_', '-'), type=int, default=value)
+    args = parser.parse_args()
+
+    params = scaled({key: getattr(args, key) for key in DEFAULTS}, args.scale)
+    manifest = synth_host(args.output, params)
+    print(f"Synthesized {manifest['hostname']} -> {args.output}")
+    print(json.dumps(manifest['params'], indent=2))
+
+
+if __name__ == '__main__':
+    main()
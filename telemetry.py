@@ -0,0 +1,431 @@
+"""
+Telemetry - Python access to the native telemetry sampler (telemetry_sampler.c)
+
+The sampler records per-core frequency and busy % on a background thread into
+mirrored ring buffers. Views returned here are memoryviews of those rings
+(format 'd'), not copies: a day of history costs two pointers, and consumers
+such as array, numpy.frombuffer or struct read the samples in place.
+
+    sampler = TelemetrySampler(interval_ms=100, capacity=864000)
+    sampler.start()
+    view = sampler.view('cpu0.mhz', last=600)
+    print(view.values[-1], view.intact())
+    chart = sampler.downsample(sampler.series, points=1000)   # bounded, per series in parallel
+    sampler.close()
+
+Alert rules run natively on the sampler thread, so an alert is raised in the
+same interval as the sample that crosses its threshold:
+
+    sampler = TelemetrySampler(alert_log='alerts.jsonl', alert_port=8649)
+    sampler.start()
+    sampler.add_alert('cpu_saturated', 'cpu*.busy', 95, clear_at=80, for_seconds=10)
+    sampler.add_anomaly('freq_drop', 'cpu*.mhz', 'ewma', raise_at=-4, clear_at=-2)
+    events, cursor = sampler.alert_events()
+"""
+
+import ctypes
+import fnmatch
+import os
+import sys
+import time
+
+from hdr_histogram import HdrHistogram
+
+IS_WINDOWS = sys.platform.startswith('win')
+
+# Downsampling methods (tel_downsample 'method')
+DOWNSAMPLE_METHODS = {'lttb': 0, 'minmax': 1}
+
+# Alert rule kinds (tel_alert_add 'kind')
+ALERT_KINDS = {'threshold': 0, 'rate': 1}
+
+# Anomaly detectors (tel_anomaly_add 'kind'); their rules compare a score, in
+# standard deviations from the series' own baseline, instead of the sample
+ANOMALY_METHODS = {'ewma': 2, 'mad': 3, 'seasonal': 4}
+SEASON_SLOTS = 48
+
+# Rules added by add_default_alerts(): (name, series pattern, raise, clear, kind, for_seconds).
+# Both series count events in the interval, so any event raises the alert at once.
+DEFAULT_ALERTS = [
+    ('thermal_throttling', 'cpu.throttled', 1, 0.5, 'threshold', 0.0),
+    ('ecc_errors', 'memory.ecc_errors', 1, 0.5, 'threshold', 0.0),
+]
+
+# Rules added by add_default_anomalies(): (name, series pattern, method, raise, clear, for_seconds)
+DEFAULT_ANOMALIES = [
+    ('frequency_drop', 'cpu*.mhz', 'ewma', -4.0, -2.0, 1.0),
+    ('busy_unusual_for_time_of_day', 'cpu*.busy', 'seasonal', 4.0, 2.0, 60.0),
+    ('ecc_error_jump', 'memory.ecc_errors', 'mad', 6.0, 3.0, 0.0),
+]
+
+
+class AlertEvent(ctypes.Structure):
+    """One alert event as stored in the native event ring (64 bytes)"""
+    _fields_ = [
+        ('timestamp', ctypes.c_double),
+        ('value', ctypes.c_double),
+        ('rule', ctypes.c_int32),
+        ('series', ctypes.c_int32),
+        ('raised', ctypes.c_int32),
+        ('reserved', ctypes.c_int32),
+        ('name', ctypes.c_char * 32),
+    ]
+
+
+def find_sampler_library():
+    """Locate the sampler library next to this module or in the current directory"""
+    lib_name = 'telemetry_sampler.dll' if IS_WINDOWS else 'libtelemetry_sampler.so'
+    for base in (os.path.dirname(os.path.abspath(__file__)), os.getcwd()):
+        path = os.path.join(base, lib_name)
+        if os.path.exists(path):
+            return path
+    return None
+
+
+def _load_library(path):
+    lib = ctypes.CDLL(path)
+    double_p = ctypes.POINTER(ctypes.c_double)
+    signatures = {
+        'tel_start': (ctypes.c_int, [ctypes.c_double, ctypes.c_int]),
+        'tel_stop': (None, []),
+        'tel_free': (None, []),
+        'tel_series_count': (ctypes.c_int, []),
+        'tel_capacity': (ctypes.c_int, []),
+        'tel_interval_ms': (ctypes.c_double, []),
+        'tel_series_name': (ctypes.c_char_p, [ctypes.c_int]),
+        'tel_series_unit': (ctypes.c_char_p, [ctypes.c_int]),
+        'tel_find': (ctypes.c_int, [ctypes.c_char_p]),
+        'tel_written': (ctypes.c_uint64, []),
+        'tel_tick_latency': (ctypes.c_int, [ctypes.c_char_p, ctypes.c_int]),
+        'tel_overwritten': (ctypes.c_int, [ctypes.c_uint64, ctypes.c_int]),
+        'tel_view': (ctypes.c_int, [ctypes.c_int, ctypes.c_int, ctypes.POINTER(double_p),
+                                    ctypes.POINTER(double_p), ctypes.POINTER(ctypes.c_uint64)]),
+        'tel_query': (ctypes.c_int, [ctypes.c_int, ctypes.c_double, ctypes.c_double,
+                                     ctypes.POINTER(double_p), ctypes.POINTER(double_p),
+                                     ctypes.POINTER(ctypes.c_uint64)]),
+        'tel_lttb': (ctypes.c_int, [double_p, double_p, ctypes.c_int, ctypes.c_int, double_p, double_p]),
+        'tel_minmax': (ctypes.c_int, [double_p, double_p, ctypes.c_int, ctypes.c_int, double_p, double_p]),
+        'tel_downsample': (ctypes.c_int, [ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.c_double,
+                                          ctypes.c_double, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+                                          double_p, double_p, ctypes.POINTER(ctypes.c_int)]),
+        'tel_alert_sinks': (ctypes.c_int, [ctypes.c_char_p, ctypes.c_int, ctypes.c_char_p]),
+        'tel_alert_add': (ctypes.c_int, [ctypes.c_char_p, ctypes.c_int, ctypes.c_int, ctypes.c_double,
+                                         ctypes.c_double, ctypes.c_double]),
+        'tel_anomaly_add': (ctypes.c_int, [ctypes.c_char_p, ctypes.c_int, ctypes.c_int, ctypes.c_double,
+                                           ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.c_double]),
+        'tel_alert_clear': (None, []),
+        'tel_alert_reset': (None, []),
+        'tel_alert_active': (ctypes.c_int, [ctypes.c_int]),
+        'tel_alert_written': (ctypes.c_uint64, []),
+        'tel_alert_events': (ctypes.c_int, [ctypes.c_uint64, ctypes.POINTER(AlertEvent), ctypes.c_int,
+                                            ctypes.POINTER(ctypes.c_uint64)]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        func = getattr(lib, name)
+        func.restype = restype
+        func.argtypes = argtypes
+    return lib
+
+
+def _as_doubles(buffer):
+    """ctypes double array sharing 'buffer' (copied only if it is read-only)"""
+    view = memoryview(buffer).cast('B')
+    count = len(view) // ctypes.sizeof(ctypes.c_double)
+    array_type = ctypes.c_double * count
+    if view.readonly:
+        return array_type.from_buffer_copy(view), count
+    return array_type.from_buffer(view), count
+
+
+def _wrap(pointer, count):
+    """memoryview over 'count' doubles at 'pointer' (no copy)"""
+    if count <= 0 or not pointer:
+        return memoryview(b'').cast('d')
+    array = (ctypes.c_double * count).from_address(ctypes.addressof(pointer.contents))
+    return memoryview(array).cast('B').cast('d')
+
+
+class SeriesView:
+    """
+    Zero-copy window onto one series: 'timestamps' (Unix seconds) and 'values'
+    are memoryviews into the sampler's rings, oldest sample first.
+
+    The sampler keeps writing while a view is held. The oldest samples of a
+    view are overwritten once the ring wraps past them; intact() reports
+    whether that has happened and overwritten() how many leading samples are
+    affected. Copy what you need to keep (e.g. array('d', view.values)).
+    """
+
+    def __init__(self, sampler, name, unit, timestamps, values, first):
+        self._sampler = sampler   # keeps the rings alive while the view exists
+        self.name = name
+        self.unit = unit
+        self.timestamps = timestamps
+        self.values = values
+        self.first = first
+
+    def __len__(self):
+        return len(self.timestamps)
+
+    def overwritten(self):
+        if not self._sampler.lib:
+            return len(self)
+        return self._sampler.lib.tel_overwritten(self.first, len(self))
+
+    def intact(self):
+        return self.overwritten() == 0
+
+
+class TelemetrySampler:
+    """
+    Owns the native sampler; only one can be open per process.
+
+    Alert events always go to an in-process ring (alert_events()). They are
+    also appended to 'alert_log' as JSON lines, sent as the same lines to UDP
+    port 'alert_port' on 127.0.0.1, and the ring itself is placed in the shared
+    memory segment 'alert_shm' ("Local\\<name>" on Windows, "/<name>"
+    elsewhere) for other processes to read.
+    """
+
+    def __init__(self, interval_ms=100.0, capacity=36000, library=None,
+                 alert_log=None, alert_port=0, alert_shm=None):
+        path = library or find_sampler_library()
+        if not path:
+            raise OSError('telemetry sampler library not found (run build_telemetry_sampler.bat)')
+        self.lib = _load_library(path)
+        self.interval_ms = interval_ms
+        self.capacity = capacity
+        self.alert_log = alert_log
+        self.alert_port = alert_port
+        self.alert_shm = alert_shm
+        self.series = []
+        self._index = {}
+
+    def start(self):
+        if self.lib.tel_alert_sinks(self.alert_log.encode() if self.alert_log else None,
+                                    int(self.alert_port or 0),
+                                    self.alert_shm.encode() if self.alert_shm else None) != 0:
+            raise OSError('could not open the alert log, socket or shared memory segment')
+        count = self.lib.tel_start(float(self.interval_ms), int(self.capacity))
+        if count < 0:
+            raise OSError('telemetry sampler failed to start')
+        self.capacity = self.lib.tel_capacity()
+        self.interval_ms = self.lib.tel_interval_ms()
+        self.series = [self.lib.tel_series_name(i).decode() for i in range(count)]
+        self._index = {name: i for i, name in enumerate(self.series)}
+        return self
+
+    def stop(self):
+        """Stop sampling; existing views stay readable until close()"""
+        if self.lib:
+            self.lib.tel_stop()
+
+    def close(self):
+        """Stop sampling and free the rings; views taken earlier must not be used afterwards"""
+        if self.lib:
+            self.lib.tel_stop()
+            self.lib.tel_alert_reset()
+            self.lib.tel_free()
+            self.lib = None
+
+    def __enter__(self):
+        return self.start()
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def written(self):
+        """Total samples recorded since start()"""
+        return self.lib.tel_written()
+
+    def tick_latency(self):
+        """HdrHistogram of how late the sampler woke for each tick, in microseconds"""
+        buffer = ctypes.create_string_buffer(65536)
+        length = self.lib.tel_tick_latency(buffer, len(buffer))
+        if length < 0:
+            return None
+        return HdrHistogram.decode(buffer.value.decode('ascii'))
+
+    def _series_index(self, name):
+        index = self._index.get(name)
+        if index is None:
+            raise KeyError(name)
+        return index
+
+    def _make_view(self, name, index, call, *args):
+        double_p = ctypes.POINTER(ctypes.c_double)
+        ts, values, first = double_p(), double_p(), ctypes.c_uint64()
+        count = call(index, *args, ctypes.byref(ts), ctypes.byref(values), ctypes.byref(first))
+        count = max(count, 0)
+        unit = self.lib.tel_series_unit(index)
+        return SeriesView(self, name, unit.decode() if unit else '',
+                          _wrap(ts, count), _wrap(values, count), first.value)
+
+    def view(self, name, last=None):
+        """Newest 'last' samples of a series (all retained samples by default)"""
+        index = self._series_index(name)
+        return self._make_view(name, index, self.lib.tel_view, -1 if last is None else int(last))
+
+    def query(self, name, t0, t1=None):
+        """Samples of a series with t0 <= timestamp < t1 (Unix seconds)"""
+        index = self._series_index(name)
+        return self._make_view(name, index, self.lib.tel_query,
+                               float(t0), float('inf') if t1 is None else float(t1))
+
+    def downsample(self, names, points=1000, method='lttb', t0=None, t1=None, threads=0):
+        """
+        Reduce each series over [t0, t1) to at most 'points' samples for plotting.
+        method 'lttb' keeps the visual shape (Largest-Triangle-Three-Buckets);
+        'minmax' keeps every bucket's extremes so single-sample spikes survive.
+        Series run in parallel on native threads (threads=0: one per CPU).
+        Returns {name: (timestamps, values)} as memoryviews of fresh buffers.
+        """
+        names = [names] if isinstance(names, str) else list(names)
+        if not names:
+            return {}
+        indices = (ctypes.c_int * len(names))(*[self._series_index(n) for n in names])
+        out_x = (ctypes.c_double * (len(names) * points))()
+        out_y = (ctypes.c_double * (len(names) * points))()
+        counts = (ctypes.c_int * len(names))()
+        rc = self.lib.tel_downsample(indices, len(names),
+                                     float('-inf') if t0 is None else float(t0),
+                                     float('inf') if t1 is None else float(t1),
+                                     int(points), DOWNSAMPLE_METHODS[method], int(threads),
+                                     out_x, out_y, counts)
+        if rc != 0:
+            raise ValueError('downsample failed')
+        xs = memoryview(out_x).cast('B').cast('d')
+        ys = memoryview(out_y).cast('B').cast('d')
+        return {name: (xs[row * points:row * points + counts[row]],
+                       ys[row * points:row * points + counts[row]])
+                for row, name in enumerate(names)}
+
+    def reduce(self, timestamps, values, points=1000, method='lttb'):
+        """Downsample any pair of double buffers (views, arrays, numpy) the same way"""
+        x, n = _as_doubles(timestamps)
+        y, ny = _as_doubles(values)
+        n = min(n, ny)
+        out_x = (ctypes.c_double * max(points, 1))()
+        out_y = (ctypes.c_double * max(points, 1))()
+        reducer = self.lib.tel_minmax if method == 'minmax' else self.lib.tel_lttb
+        count = reducer(x, y, n, int(points), out_x, out_y)
+        return (memoryview(out_x).cast('B').cast('d')[:count],
+                memoryview(out_y).cast('B').cast('d')[:count])
+
+    def add_alert(self, name, series, raise_at, clear_at=None, kind='threshold', for_seconds=0.0):
+        """
+        Raise alert 'name' on every series matching 'series' (fnmatch pattern)
+        when its value ('threshold') or its change per second ('rate') reaches
+        'raise_at'; it clears once the value is back past 'clear_at' (default
+        'raise_at', i.e. no hysteresis). A 'clear_at' above 'raise_at' makes it
+        a low alert. 'for_seconds' is how long the condition must hold first.
+        Works while sampling; returns the native rule indices.
+        """
+        clear_at = raise_at if clear_at is None else clear_at
+        matches = [i for i, n in enumerate(self.series) if fnmatch.fnmatchcase(n, series)]
+        if not matches:
+            raise KeyError(series)
+        rules = []
+        for index in matches:
+            rule = self.lib.tel_alert_add(name.encode(), index, ALERT_KINDS[kind], float(raise_at),
+                                          float(clear_at), float(for_seconds))
+            if rule < 0:
+                raise ValueError(f'could not add alert {name} on {self.series[index]}')
+            rules.append(rule)
+        return rules
+
+    def add_default_alerts(self):
+        """Add DEFAULT_ALERTS (thermal throttling, ECC errors) for the series this host provides"""
+        for name, pattern, raise_at, clear_at, kind, for_seconds in DEFAULT_ALERTS:
+            if any(fnmatch.fnmatchcase(n, pattern) for n in self.series):
+                self.add_alert(name, pattern, raise_at, clear_at, kind, for_seconds)
+
+    def add_anomaly(self, name, series, method='ewma', raise_at=-4.0, clear_at=-2.0, for_seconds=0.0,
+                    window_seconds=None, period_seconds=86400.0):
+        """
+        Alert when series matching 'series' deviate from their own history.
+        The score is the deviation in standard deviations (negative below
+        the baseline); 'raise_at' and 'clear_at' work as in add_alert().
+
+          ewma      exponentially weighted mean and variance
+          mad       streaming median / MAD, robust to outliers and bursts
+          seasonal  baseline per 1/48 of 'period_seconds' (a day by default)
+
+        'window_seconds' is how much history each baseline remembers:
+        a minute for ewma/mad and three periods' worth of each seasonal slot
+        by default. Only while sampling; returns the native rule indices.
+        """
+        if window_seconds is None:
+            window_seconds = 3 * period_seconds / SEASON_SLOTS if method == 'seasonal' else 60.0
+        matches = [i for i, n in enumerate(self.series) if fnmatch.fnmatchcase(n, series)]
+        if not matches:
+            raise KeyError(series)
+        rules = []
+        for index in matches:
+            rule = self.lib.tel_anomaly_add(name.encode(), index, ANOMALY_METHODS[method], float(raise_at),
+                                            float(clear_at), float(for_seconds), float(window_seconds),
+                                            float(period_seconds))
+            if rule < 0:
+                raise ValueError(f'could not add anomaly rule {name} on {self.series[index]}')
+            rules.append(rule)
+        return rules
+
+    def add_default_anomalies(self):
+        """Add DEFAULT_ANOMALIES (frequency drops, unusual load, ECC bursts) for the series this host provides"""
+        for name, pattern, method, raise_at, clear_at, for_seconds in DEFAULT_ANOMALIES:
+            if any(fnmatch.fnmatchcase(n, pattern) for n in self.series):
+                self.add_anomaly(name, pattern, method, raise_at, clear_at, for_seconds)
+
+    def alert_active(self, rule):
+        return self.lib.tel_alert_active(rule) == 1
+
+    def alert_events(self, since=0, max_count=1024):
+        """
+        Events numbered 'since' and later as dicts (time, alert, series, state,
+        value), plus the cursor to pass as 'since' next time.
+        """
+        events = (AlertEvent * max_count)()
+        next_since = ctypes.c_uint64()
+        count = self.lib.tel_alert_events(int(since), events, max_count, ctypes.byref(next_since))
+        result = [{'time': e.timestamp,
+                   'alert': e.name.decode(errors='replace'),
+                   'series': self.series[e.series] if 0 <= e.series < len(self.series) else None,
+                   'state': 'raised' if e.raised else 'cleared',
+                   'value': e.value}
+                  for e in events[:count]]
+        return result, next_since.value
+
+
+if __name__ == '__main__':
+    import argparse
+
+    parser = argparse.ArgumentParser(description='Sample per-core telemetry and print the latest values')
+    parser.add_argument('--interval-ms', type=float, default=100.0)
+    parser.add_argument('--seconds', type=float, default=2.0)
+    parser.add_argument('--alerts', action='store_true',
+                        help='add the default alerts and anomaly rules and print events as they happen')
+    parser.add_argument('--alert-log', help='append alert events to this file (JSON lines)')
+    args = parser.parse_args()
+
+    with TelemetrySampler(args.interval_ms, capacity=max(2, int(args.seconds * 1000 / args.interval_ms) + 1),
+                          alert_log=args.alert_log) as sampler:
+        if args.alerts:
+            sampler.add_default_alerts()
+            sampler.add_default_anomalies()
+            cursor = 0
+            deadline = time.time() + args.seconds
+            while time.time() < deadline:
+                time.sleep(args.interval_ms / 1000.0)
+                events, cursor = sampler.alert_events(cursor)
+                for event in events:
+                    print(f"{event['state']:<8} {event['alert']} on {event['series']}: {event['value']:g}")
+        else:
+            time.sleep(args.seconds)
+        for name in sampler.series:
+            view = sampler.view(name)
+            latest = view.values[-1] if len(view) else float('nan')
+            print(f'{name:<16} {latest:10.1f} {view.unit:<6} ({len(view)} samples)')
+        lateness = sampler.tick_latency()
+        if lateness and lateness.total:
+            print(f"tick lateness: p50 {lateness.value_at(50)} us, p99 {lateness.value_at(99)} us, "
+                  f"max {lateness.max} us")
@@ -0,0 +1,1350 @@
+/*
+ * Telemetry Sampler - background per-core sampler with zero-copy history rings
+ *
+ * Built as a shared library (telemetry_sampler.dll / libtelemetry_sampler.so)
+ * and driven from Python through ctypes (see telemetry.py). A sampler thread
+ * records every series once per interval:
+ *
+ *   cpu<N>.mhz         current frequency of logical CPU N (MHz)
+ *   cpu<N>.busy        share of the interval CPU N was not idle (%)
+ *   cpu.throttled      CPUs thermally throttled during the interval
+ *   memory.ecc_errors  corrected + uncorrected memory errors in the interval
+ *
+ * History is kept in mirrored rings: sample k is written to slot k % capacity
+ * and again to slot k % capacity + capacity, so the newest 'n' samples of any
+ * series are always one contiguous run of doubles. Callers get pointers into
+ * the rings themselves - a day of history is handed to Python as a memoryview
+ * without copying a single value. All series share one timestamp ring
+ * (seconds since the Unix epoch).
+ *
+ * A view of the newest 'n' samples taken when tel_written() was W stays intact
+ * until sample W - n + capacity is written; readers compare tel_written()
+ * afterwards (see tel_overwritten()) instead of taking a lock.
+ *
+ * Alert rules (threshold or rate of change, with hysteresis and an optional
+ * hold time) are evaluated on the sampler thread right after each sample is
+ * stored, so an alert is raised in the same interval as the sample that
+ * triggers it. Events go to an in-process ring, which can be a named shared
+ * memory segment, and optionally to a log file and a loopback UDP port.
+ * How late the sampler thread wakes for each tick is kept in an HDR
+ * histogram (tel_tick_latency()). Anomaly rules score each sample against the series' own history (EWMA,
+ * streaming median/MAD or a seasonal baseline) and alert on that score.
+ *
+ * Usage (C):
+ *   tel_start(100.0, 36000);             // 100 ms interval, one hour of history
+ *   const double *ts, *mhz;
+ *   uint64_t first;
+ *   int n = tel_view(tel_find("cpu0.mhz"), 600, &ts, &mhz, &first);
+ *   ...
+ *   tel_stop();
+ *   tel_free();
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#include <powrprof.h>
+#pragma comment(lib, "powrprof.lib")
+#pragma comment(lib, "ws2_32.lib")
+#define TEL_API __declspec(dllexport)
+#else
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#define TEL_API __attribute__((visibility("default")))
+#endif
+
+#include "hdr_histogram.h"
+
+#define TEL_NAME_MAX 32
+#define TEL_MAX_CPUS 1024
+#define TEL_MIN_INTERVAL_MS 1.0
+
+typedef struct {
+    char name[TEL_NAME_MAX];
+    const char* unit;       // static string
+    double* values;         // 2 * capacity, mirrored
+} TelSeries;
+
+typedef struct {
+    uint64_t busy;          // non-idle ticks at the previous sample
+    uint64_t total;
+} TelCpuTimes;
+
+typedef struct {
+    int running;
+    volatile long stop;
+    double interval_ms;
+    int capacity;
+    double* timestamps;     // 2 * capacity, mirrored
+    volatile uint64_t written;
+    TelSeries* series;
+    int series_count;
+    int cpu_count;
+    TelCpuTimes* cpu_times;
+    uint64_t* throttle_counts;  // per CPU, at the previous sample
+    uint64_t ecc_count;         // at the previous sample
+    int has_throttle;
+    int has_ecc;
+    double* frame;          // one value per series for the sample being built
+    HdrHistogram tick_latency;  // wake-up lateness per tick (us), sampler thread only
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+} TelSampler;
+
+static TelSampler g_tel;
+
+static void tel_store_u64(volatile uint64_t* target, uint64_t value) {
+#ifdef _WIN32
+    InterlockedExchange64((volatile LONG64*)target, (LONG64)value);
+#else
+    __atomic_store_n(target, value, __ATOMIC_RELEASE);
+#endif
+}
+
+static uint64_t tel_load_u64(volatile uint64_t* source) {
+#ifdef _WIN32
+    return (uint64_t)InterlockedCompareExchange64((volatile LONG64*)source, 0, 0);
+#else
+    return __atomic_load_n(source, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void tel_store_written(uint64_t value) { tel_store_u64(&g_tel.written, value); }
+static uint64_t tel_load_written(void) { return tel_load_u64(&g_tel.written); }
+
+static double tel_epoch_seconds(void) {
+#ifdef _WIN32
+    FILETIME ft;
+    GetSystemTimePreciseAsFileTime(&ft);
+    uint64_t t = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    return (double)(t - 116444736000000000ull) / 1e7;   // 100 ns ticks since 1601
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+static void tel_sleep_ms(double ms) {
+#ifdef _WIN32
+    Sleep((DWORD)(ms + 0.5));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ms / 1000.0);
+    ts.tv_nsec = (long)((ms - (double)ts.tv_sec * 1000.0) * 1e6);
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static int tel_detect_cpus(void) {
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);   // processors in this process's group, matching the power/perf APIs
+    return (int)si.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_CONF);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+// ==================== Sources ====================
+
+#ifdef _WIN32
+typedef struct {
+    ULONG Number;
+    ULONG MaxMhz;
+    ULONG CurrentMhz;
+    ULONG MhzLimit;
+    ULONG MaxIdleState;
+    ULONG CurrentIdleState;
+} TelPowerInfo;
+
+typedef struct {
+    LARGE_INTEGER IdleTime;
+    LARGE_INTEGER KernelTime;   // includes idle time
+    LARGE_INTEGER UserTime;
+    LARGE_INTEGER Reserved1[2];
+    ULONG Reserved2;
+} TelProcessorTimes;
+
+typedef LONG (WINAPI *NtQuerySystemInformationFn)(ULONG, PVOID, ULONG, PULONG);
+static NtQuerySystemInformationFn g_nt_query = NULL;
+static TelPowerInfo* g_power_info = NULL;
+static TelProcessorTimes* g_processor_times = NULL;
+
+static void tel_sources_open(void) {
+    HMODULE ntdll = GetModuleHandleA("ntdll.dll");
+    if (ntdll) g_nt_query = (NtQuerySystemInformationFn)GetProcAddress(ntdll, "NtQuerySystemInformation");
+    g_power_info = (TelPowerInfo*)calloc(g_tel.cpu_count, sizeof(TelPowerInfo));
+    g_processor_times = (TelProcessorTimes*)calloc(g_tel.cpu_count, sizeof(TelProcessorTimes));
+}
+
+static void tel_sources_close(void) {
+    free(g_power_info);
+    free(g_processor_times);
+    g_power_info = NULL;
+    g_processor_times = NULL;
+}
+
+// Returns 0 if the frequencies could not be read
+static int tel_read_mhz(double* out) {
+    ULONG size = (ULONG)(g_tel.cpu_count * sizeof(TelPowerInfo));
+    if (!g_power_info || CallNtPowerInformation(ProcessorInformation, NULL, 0, g_power_info, size) != 0) {
+        for (int i = 0; i < g_tel.cpu_count; i++) out[i] = NAN;
+        return 0;
+    }
+    for (int i = 0; i < g_tel.cpu_count; i++) out[i] = (double)g_power_info[i].CurrentMhz;
+    return 1;
+}
+
+// CPUs held below their maximum by a thermal or power limit, from the
+// power information just read by tel_read_mhz()
+static double tel_read_throttled(int mhz_ok) {
+    if (!mhz_ok) return NAN;
+    int throttled = 0;
+    for (int i = 0; i < g_tel.cpu_count; i++) {
+        throttled += g_power_info[i].MhzLimit < g_power_info[i].MaxMhz;
+    }
+    return (double)throttled;
+}
+
+// Windows reports memory errors through WHEA events, not a counter
+static double tel_read_ecc_errors(void) { return NAN; }
+
+// Cumulative busy/total ticks per CPU; returns 0 if unavailable
+static int tel_read_cpu_times(TelCpuTimes* now) {
+    ULONG size = (ULONG)(g_tel.cpu_count * sizeof(TelProcessorTimes));
+    if (!g_nt_query || !g_processor_times ||
+        g_nt_query(8 /* SystemProcessorPerformanceInformation */, g_processor_times, size, NULL) != 0) {
+        return 0;
+    }
+    for (int i = 0; i < g_tel.cpu_count; i++) {
+        uint64_t idle = (uint64_t)g_processor_times[i].IdleTime.QuadPart;
+        uint64_t total = (uint64_t)g_processor_times[i].KernelTime.QuadPart +
+                         (uint64_t)g_processor_times[i].UserTime.QuadPart;
+        now[i].total = total;
+        now[i].busy = total > idle ? total - idle : 0;
+    }
+    return 1;
+}
+#else
+static int tel_read_u64(const char* path, uint64_t* out) {
+    FILE* f = fopen(path, "r");
+    if (!f) return 0;
+    unsigned long long value;
+    int ok = fscanf(f, "%llu", &value) == 1;
+    fclose(f);
+    if (ok) *out = value;
+    return ok;
+}
+
+// Core + package throttle events of one CPU (Intel thermal_throttle counters)
+static int tel_read_throttle_count(int cpu, uint64_t* out) {
+    char path[128];
+    uint64_t core = 0, package = 0;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/thermal_throttle/core_throttle_count", cpu);
+    int ok = tel_read_u64(path, &core);
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/thermal_throttle/package_throttle_count", cpu);
+    ok |= tel_read_u64(path, &package);
+    *out = core + package;
+    return ok;
+}
+
+// Corrected + uncorrected errors over all EDAC memory controllers
+static int tel_read_ecc_count(uint64_t* out) {
+    char path[96];
+    uint64_t total = 0, count;
+    int found = 0;
+    for (int mc = 0; ; mc++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/edac/mc/mc%d/ce_count", mc);
+        if (!tel_read_u64(path, &count)) break;
+        total += count;
+        snprintf(path, sizeof(path), "/sys/devices/system/edac/mc/mc%d/ue_count", mc);
+        if (tel_read_u64(path, &count)) total += count;
+        found = 1;
+    }
+    *out = total;
+    return found;
+}
+
+static void tel_sources_open(void) {
+    g_tel.throttle_counts = (uint64_t*)calloc(g_tel.cpu_count, sizeof(uint64_t));
+    g_tel.has_throttle = g_tel.throttle_counts && tel_read_throttle_count(0, &g_tel.throttle_counts[0]);
+    for (int i = 1; g_tel.has_throttle && i < g_tel.cpu_count; i++) {
+        tel_read_throttle_count(i, &g_tel.throttle_counts[i]);
+    }
+    g_tel.has_ecc = tel_read_ecc_count(&g_tel.ecc_count);
+}
+
+static void tel_sources_close(void) {
+    free(g_tel.throttle_counts);
+    g_tel.throttle_counts = NULL;
+}
+
+static int tel_read_mhz(double* out) {
+    char path[128];
+    int found = 0;
+    for (int i = 0; i < g_tel.cpu_count; i++) {
+        out[i] = NAN;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", i);
+        FILE* f = fopen(path, "r");
+        if (!f) continue;
+        unsigned long khz;
+        if (fscanf(f, "%lu", &khz) == 1) {
+            out[i] = (double)khz / 1000.0;
+            found = 1;
+        }
+        fclose(f);
+    }
+    return found;
+}
+
+// CPUs whose throttle counters advanced since the previous sample
+static double tel_read_throttled(int mhz_ok) {
+    (void)mhz_ok;
+    if (!g_tel.has_throttle) return NAN;
+    int throttled = 0;
+    for (int i = 0; i < g_tel.cpu_count; i++) {
+        uint64_t count;
+        if (!tel_read_throttle_count(i, &count)) continue;
+        throttled += count > g_tel.throttle_counts[i];
+        g_tel.throttle_counts[i] = count;
+    }
+    return (double)throttled;
+}
+
+// Memory errors logged since the previous sample
+static double tel_read_ecc_errors(void) {
+    uint64_t count;
+    if (!g_tel.has_ecc || !tel_read_ecc_count(&count)) return NAN;
+    double delta = count >= g_tel.ecc_count ? (double)(count - g_tel.ecc_count) : 0.0;
+    g_tel.ecc_count = count;
+    return delta;
+}
+
+static int tel_read_cpu_times(TelCpuTimes* now) {
+    FILE* f = fopen("/proc/stat", "r");
+    if (!f) return 0;
+    char line[512];
+    for (int i = 0; i < g_tel.cpu_count; i++) now[i].busy = now[i].total = 0;
+    while (fgets(line, sizeof(line), f)) {
+        int cpu;
+        unsigned long long v[8] = {0};
+        if (strncmp(line, "cpu", 3) != 0 || line[3] < '0' || line[3] > '9') continue;
+        if (sscanf(line + 3, "%d %llu %llu %llu %llu %llu %llu %llu %llu", &cpu,
+                   &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]) < 5) continue;
+        if (cpu < 0 || cpu >= g_tel.cpu_count) continue;
+        uint64_t idle = v[3] + v[4];   // idle + iowait
+        uint64_t total = 0;
+        for (int k = 0; k < 8; k++) total += v[k];
+        now[cpu].total = total;
+        now[cpu].busy = total - idle;
+    }
+    fclose(f);
+    return 1;
+}
+#endif
+
+// ==================== Alerts ====================
+//
+// A rule watches one series. Threshold rules compare the sample itself, rate
+// rules its change per second since the previous finite sample. A rule with
+// raise >= clear fires when the value reaches 'raise' and clears once it
+// drops below 'clear'; with raise < clear the directions are reversed. The
+// gap between the two levels is the hysteresis that stops a value hovering
+// at the limit from flapping. 'for_seconds' > 0 requires the condition to
+// hold that long before the alert is raised.
+//
+// Anomaly rules compare a score instead of the sample: how many standard
+// deviations (or scaled MADs) the sample lies from what this series has
+// shown before, negative below it. 'raise' = -4, 'clear' = -2 flags drops.
+//
+//   EWMA      exponentially weighted mean and variance
+//   MAD       streaming median and median absolute deviation; one outlier
+//             barely moves them, so bursts stand out against a noisy series
+//   SEASONAL  EWMA per slot of a period (e.g. 48 half-hours of a day), so
+//             the nightly batch job is compared with earlier nights
+//
+// Each remembers about 'window_seconds' of history (for SEASONAL: of its own
+// slot) and scores nothing until it has seen that many samples (8 to 1024).
+//
+// Rules are evaluated on the sampler thread in O(1) each per sample, in
+// constant memory. They can be added while sampling (from one thread at a
+// time); clearing them or changing the sinks requires the sampler to be
+// stopped.
+
+#define TEL_ALERT_THRESHOLD 0
+#define TEL_ALERT_RATE 1
+#define TEL_ALERT_EWMA 2
+#define TEL_ALERT_MAD 3
+#define TEL_ALERT_SEASONAL 4
+#define TEL_SEASON_SLOTS 48
+#define TEL_MAD_SCALE 1.4826        // MAD to standard deviation for normal data
+#define TEL_ALERT_MAX_RULES 4096
+#define TEL_ALERT_EVENTS 1024
+#define TEL_ALERT_MAGIC 0x54524c41u     // "ALRT"
+#define TEL_ALERT_LINE_MAX 256
+
+typedef struct {
+    char name[TEL_NAME_MAX];
+    int series;
+    int kind;
+    double raise;
+    double clear;
+    double for_seconds;
+    int active;             // state below is owned by the sampler thread
+    int pending;
+    double pending_since;
+    double prev_value;
+    double prev_time;
+    double window_seconds;  // anomaly rules: history the baseline remembers
+    double alpha;           // anomaly rules: weight of the newest sample
+    double inv_period;      // SEASONAL: 1 / seconds per period
+    int warmup;             // samples before scores are reported
+    int seen;
+    double mean;            // EWMA; MAD: median
+    double var;             // EWMA; MAD: median absolute deviation
+    double* slots;          // SEASONAL: mean, var, seen per slot
+} TelAlertRule;
+
+// One event, 64 bytes; the layout is shared with readers of the segment
+typedef struct {
+    double timestamp;
+    double value;           // sample, or change per second for rate rules
+    int32_t rule;
+    int32_t series;
+    int32_t raised;         // 1 raised, 0 cleared
+    int32_t reserved;
+    char name[TEL_NAME_MAX];
+} TelAlertEvent;
+
+// Event ring: event k is in events[k % capacity]; 'written' is published
+// after the event is complete, like the sample rings. The writer fills slot
+// 'written' before publishing, so a copy of event k is intact only if
+// 'written' read after the copy is at most k + capacity - 1
+typedef struct {
+    uint32_t magic;
+    uint32_t event_size;
+    uint32_t capacity;
+    uint32_t reserved;
+    volatile uint64_t written;
+    uint64_t padding[5];    // header is 64 bytes
+    TelAlertEvent events[TEL_ALERT_EVENTS];
+} TelAlertRing;
+
+typedef struct {
+    TelAlertRule rules[TEL_ALERT_MAX_RULES];
+    volatile uint64_t rule_count;
+    TelAlertRing* ring;
+    int ring_shared;
+    FILE* log;
+#ifdef _WIN32
+    HANDLE mapping;
+    SOCKET sock;
+#else
+    char shm_name[TEL_NAME_MAX + 1];
+    int sock;
+#endif
+    int sock_open;
+    struct sockaddr_in target;
+} TelAlerts;
+
+static TelAlerts g_alerts;
+
+static void tel_alert_close_sinks(void) {
+    if (g_alerts.log) fclose(g_alerts.log);
+    g_alerts.log = NULL;
+    if (g_alerts.sock_open) {
+#ifdef _WIN32
+        closesocket(g_alerts.sock);
+        WSACleanup();
+#else
+        close(g_alerts.sock);
+#endif
+        g_alerts.sock_open = 0;
+    }
+    if (g_alerts.ring && g_alerts.ring_shared) {
+#ifdef _WIN32
+        UnmapViewOfFile(g_alerts.ring);
+        CloseHandle(g_alerts.mapping);
+#else
+        munmap(g_alerts.ring, sizeof(TelAlertRing));
+        shm_unlink(g_alerts.shm_name);
+#endif
+    } else {
+        free(g_alerts.ring);
+    }
+    g_alerts.ring = NULL;
+    g_alerts.ring_shared = 0;
+}
+
+// Map the event ring as the named shared memory segment 'name'
+// ("Local\<name>" on Windows, "/<name>" elsewhere)
+static TelAlertRing* tel_alert_map_shared(const char* name) {
+#ifdef _WIN32
+    char full[TEL_NAME_MAX + 8];
+    snprintf(full, sizeof(full), "Local\\%s", name);
+    g_alerts.mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+                                          (DWORD)sizeof(TelAlertRing), full);
+    if (!g_alerts.mapping) return NULL;
+    void* view = MapViewOfFile(g_alerts.mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(TelAlertRing));
+    if (!view) CloseHandle(g_alerts.mapping);
+    return (TelAlertRing*)view;
+#else
+    snprintf(g_alerts.shm_name, sizeof(g_alerts.shm_name), "/%s", name);
+    int fd = shm_open(g_alerts.shm_name, O_CREAT | O_RDWR, 0600);
+    if (fd < 0) return NULL;
+    void* view = MAP_FAILED;
+    if (ftruncate(fd, sizeof(TelAlertRing)) == 0) {
+        view = mmap(NULL, sizeof(TelAlertRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (view == MAP_FAILED) {
+        shm_unlink(g_alerts.shm_name);
+        return NULL;
+    }
+    return (TelAlertRing*)view;
+#endif
+}
+
+static int tel_alert_open_socket(int port) {
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return 0;
+    g_alerts.sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (g_alerts.sock == INVALID_SOCKET) {
+        WSACleanup();
+        return 0;
+    }
+#else
+    g_alerts.sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (g_alerts.sock < 0) return 0;
+#endif
+    memset(&g_alerts.target, 0, sizeof(g_alerts.target));
+    g_alerts.target.sin_family = AF_INET;
+    g_alerts.target.sin_port = htons((unsigned short)port);
+    g_alerts.target.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    g_alerts.sock_open = 1;
+    return 1;
+}
+
+// Copy 'in' into 'out' as the inside of a JSON string (truncated to 'size')
+static void tel_json_escape(char* out, size_t size, const char* in) {
+    size_t n = 0;
+    for (; *in && n + 7 < size; in++) {
+        unsigned char c = (unsigned char)*in;
+        if (c == '"' || c == '\\') {
+            out[n++] = '\\';
+            out[n++] = (char)c;
+        } else if (c < 0x20) {
+            n += (size_t)snprintf(out + n, size - n, "\\u%04x", c);
+        } else {
+            out[n++] = (char)c;
+        }
+    }
+    out[n] = '\0';
+}
+
+// Record an event in the ring and pass it to the log and socket as one JSON line
+static void tel_alert_emit(int index, const TelAlertRule* rule, double timestamp, double value, int raised) {
+    TelAlertRing* ring = g_alerts.ring;
+    uint64_t k = ring->written;
+    TelAlertEvent* event = &ring->events[k % TEL_ALERT_EVENTS];
+    event->timestamp = timestamp;
+    event->value = value;
+    event->rule = index;
+    event->series = rule->series;
+    event->raised = raised;
+    event->reserved = 0;
+    memcpy(event->name, rule->name, sizeof(event->name));
+    tel_store_u64(&ring->written, k + 1);
+
+    if (!g_alerts.log && !g_alerts.sock_open) return;
+    char name[2 * TEL_NAME_MAX];
+    tel_json_escape(name, sizeof(name), rule->name);
+    char line[TEL_ALERT_LINE_MAX];
+    int len = snprintf(line, sizeof(line),
+                       "{\"time\": %.3f, \"alert\": \"%s\", \"series\": \"%s\", \"state\": \"%s\", \"value\": %.6g}\n",
+                       timestamp, name, g_tel.series[rule->series].name,
+                       raised ? "raised" : "cleared", value);
+    if (len <= 0 || len >= (int)sizeof(line)) return;
+    if (g_alerts.log) {
+        fputs(line, g_alerts.log);
+        fflush(g_alerts.log);
+    }
+    if (g_alerts.sock_open) {
+        sendto(g_alerts.sock, line, len - 1, 0, (const struct sockaddr*)&g_alerts.target,
+               sizeof(g_alerts.target));
+    }
+}
+
+// Deviation floor, so a series that has been constant still scores a change
+static double tel_spread_floor(double level) {
+    return 1e-3 * fabs(level) + 1e-9;
+}
+
+// Score 'x' against an EWMA mean/variance, then fold it in (West's update)
+static double tel_ewma_step(double* mean, double* var, int* seen, int warmup, double alpha, double x) {
+    double score = NAN;
+    if (*seen >= warmup) {
+        double sd = sqrt(*var);
+        double floor = tel_spread_floor(*mean);
+        score = (x - *mean) / (sd > floor ? sd : floor);
+    }
+    if (*seen == 0) {
+        *mean = x;
+        *var = 0;
+    } else {
+        double diff = x - *mean;
+        double step = alpha * diff;
+        *mean += step;
+        *var = (1 - alpha) * (*var + diff * step);
+    }
+    if (*seen < warmup) (*seen)++;
+    return score;
+}
+
+// Score 'x' against a streaming median/MAD, then nudge both toward it by a
+// step proportional to the current MAD (stochastic approximation: each
+// settles where half of the inputs fall on either side). The first
+// 'warmup' samples seed both from an EWMA.
+static double tel_mad_step(TelAlertRule* rule, double x) {
+    if (rule->seen < rule->warmup) {
+        tel_ewma_step(&rule->mean, &rule->var, &rule->seen, rule->warmup, rule->alpha, x);
+        if (rule->seen == rule->warmup) rule->var = sqrt(rule->var) / TEL_MAD_SCALE;
+        return NAN;
+    }
+    double floor = tel_spread_floor(rule->mean);
+    double mad = rule->var > floor ? rule->var : floor;
+    double deviation = x - rule->mean;
+    double score = deviation / (TEL_MAD_SCALE * mad);
+    double step = rule->alpha * mad;
+    // Branch-free: the signs are random for noisy data
+    rule->mean += step * (double)((deviation > 0) - (deviation < 0));
+    rule->var += step * (double)(2 * (fabs(deviation) > rule->var) - 1);
+    rule->var = rule->var > 0 ? rule->var : 0;
+    return score;
+}
+
+static double tel_seasonal_step(TelAlertRule* rule, double timestamp, double x) {
+    double phase = timestamp * rule->inv_period;
+    int slot = (int)((phase - floor(phase)) * TEL_SEASON_SLOTS);
+    if (slot < 0 || slot >= TEL_SEASON_SLOTS) slot = 0;
+    double* state = rule->slots + 3 * slot;
+    int seen = (int)state[2];
+    double score = tel_ewma_step(&state[0], &state[1], &seen, rule->warmup, rule->alpha, x);
+    state[2] = seen;
+    return score;
+}
+
+// The quantity a rule compares with raise/clear for sample 'x', or NaN
+static double tel_alert_input(TelAlertRule* rule, double timestamp, double x) {
+    switch (rule->kind) {
+    case TEL_ALERT_RATE: {
+        double dt = timestamp - rule->prev_time;
+        double rate = (rule->prev_time > 0 && dt > 0) ? (x - rule->prev_value) / dt : NAN;
+        if (isfinite(x)) {
+            rule->prev_value = x;
+            rule->prev_time = timestamp;
+        }
+        return rate;
+    }
+    case TEL_ALERT_EWMA:
+        return isfinite(x) ? tel_ewma_step(&rule->mean, &rule->var, &rule->seen, rule->warmup, rule->alpha, x) : NAN;
+    case TEL_ALERT_MAD:
+        return isfinite(x) ? tel_mad_step(rule, x) : NAN;
+    case TEL_ALERT_SEASONAL:
+        return isfinite(x) ? tel_seasonal_step(rule, timestamp, x) : NAN;
+    default:
+        return x;
+    }
+}
+
+// Run every rule against the frame just stored at 'timestamp'
+static void tel_alert_evaluate(double timestamp) {
+    uint64_t count = tel_load_u64(&g_alerts.rule_count);
+    for (uint64_t r = 0; r < count; r++) {
+        TelAlertRule* rule = &g_alerts.rules[r];
+        double value = tel_alert_input(rule, timestamp, g_tel.frame[rule->series]);
+        if (!isfinite(value)) continue;   // missed sample or still warming up: keep the current state
+
+        int rising = rule->raise >= rule->clear;
+        if (!rule->active) {
+            int over = rising ? value >= rule->raise : value <= rule->raise;
+            if (!over) {
+                rule->pending = 0;
+                continue;
+            }
+            if (!rule->pending) {
+                rule->pending = 1;
+                rule->pending_since = timestamp;
+            }
+            if (timestamp - rule->pending_since >= rule->for_seconds) {
+                rule->active = 1;
+                rule->pending = 0;
+                tel_alert_emit((int)r, rule, timestamp, value, 1);
+            }
+        } else if (rising ? value < rule->clear : value > rule->clear) {
+            rule->active = 0;
+            tel_alert_emit((int)r, rule, timestamp, value, 0);
+        }
+    }
+}
+
+// Anomaly weights for the sampling interval: the window in samples sets the
+// EWMA weight and the warmup (8 to 1024 samples)
+static void tel_anomaly_weights(TelAlertRule* rule) {
+    double samples = rule->window_seconds * 1000.0 / g_tel.interval_ms;
+    rule->alpha = 1.0 - exp(-1.0 / (samples > 1 ? samples : 1));
+    rule->warmup = samples < 8 ? 8 : (samples > 1024 ? 1024 : (int)ceil(samples));
+}
+
+// Forget the state of every rule (a new sampling run starts from scratch);
+// anomaly weights follow the new run's interval
+static void tel_alert_rearm(void) {
+    uint64_t count = tel_load_u64(&g_alerts.rule_count);
+    for (uint64_t r = 0; r < count; r++) {
+        TelAlertRule* rule = &g_alerts.rules[r];
+        if (rule->window_seconds > 0) tel_anomaly_weights(rule);
+        rule->active = rule->pending = 0;
+        rule->prev_time = 0;
+        rule->seen = 0;
+        if (rule->slots) memset(rule->slots, 0, 3 * TEL_SEASON_SLOTS * sizeof(double));
+    }
+}
+
+static int tel_alert_ensure_ring(void) {
+    if (!g_alerts.ring) {
+        g_alerts.ring = (TelAlertRing*)calloc(1, sizeof(TelAlertRing));
+        if (!g_alerts.ring) return 0;
+        g_alerts.ring_shared = 0;
+    }
+    g_alerts.ring->magic = TEL_ALERT_MAGIC;
+    g_alerts.ring->event_size = sizeof(TelAlertEvent);
+    g_alerts.ring->capacity = TEL_ALERT_EVENTS;
+    return 1;
+}
+
+// Choose where events go besides the in-process ring: a log file appended
+// with one JSON line per event (NULL: none), a UDP port on 127.0.0.1 that
+// receives the same lines (0: none) and a shared memory segment name for the
+// ring itself (NULL: private memory). Only while the sampler is stopped.
+// Returns 0, or -1 if a sink could not be opened (none are then active).
+TEL_API int tel_alert_sinks(const char* log_path, int udp_port, const char* shm_name) {
+    if (g_tel.running) return -1;
+    tel_alert_close_sinks();
+    if (shm_name && *shm_name) {
+        if (strlen(shm_name) > TEL_NAME_MAX - 1) return -1;
+        g_alerts.ring = tel_alert_map_shared(shm_name);
+        if (!g_alerts.ring) return -1;
+        g_alerts.ring_shared = 1;
+        memset(g_alerts.ring, 0, sizeof(TelAlertRing));
+    }
+    if (log_path && *log_path) {
+        g_alerts.log = fopen(log_path, "a");
+        if (!g_alerts.log) {
+            tel_alert_close_sinks();
+            return -1;
+        }
+    }
+    if (udp_port > 0 && !tel_alert_open_socket(udp_port)) {
+        tel_alert_close_sinks();
+        return -1;
+    }
+    return tel_alert_ensure_ring() ? 0 : -1;
+}
+
+static TelAlertRule* tel_alert_prepare(const char* name, int series, double raise, double clear,
+                                       double for_seconds) {
+    uint64_t index = tel_load_u64(&g_alerts.rule_count);
+    if (!name || series < 0 || series >= g_tel.series_count || index >= TEL_ALERT_MAX_RULES) return NULL;
+    if (!isfinite(raise) || !isfinite(clear) || !tel_alert_ensure_ring()) return NULL;
+
+    TelAlertRule* rule = &g_alerts.rules[index];
+    free(rule->slots);
+    memset(rule, 0, sizeof(*rule));
+    snprintf(rule->name, sizeof(rule->name), "%s", name);
+    rule->series = series;
+    rule->raise = raise;
+    rule->clear = clear;
+    rule->for_seconds = for_seconds > 0 ? for_seconds : 0;
+    return rule;
+}
+
+static int tel_alert_publish(void) {
+    uint64_t index = tel_load_u64(&g_alerts.rule_count);
+    tel_store_u64(&g_alerts.rule_count, index + 1);   // the sampler sees the rule from here on
+    return (int)index;
+}
+
+// Add a threshold or rate rule on 'series' (see above for raise/clear/for_seconds).
+// Returns the rule index, or -1 on bad input or when the table is full.
+TEL_API int tel_alert_add(const char* name, int series, int kind, double raise, double clear, double for_seconds) {
+    if (kind != TEL_ALERT_THRESHOLD && kind != TEL_ALERT_RATE) return -1;
+    TelAlertRule* rule = tel_alert_prepare(name, series, raise, clear, for_seconds);
+    if (!rule) return -1;
+    rule->kind = kind;
+    return tel_alert_publish();
+}
+
+// Add an anomaly rule (EWMA, MAD or SEASONAL) on 'series'; raise/clear are
+// scores. 'window_seconds' is how much history the baseline remembers,
+// 'period_seconds' the SEASONAL period. Only while sampling (the interval
+// sets the weights). Returns the rule index, or -1.
+TEL_API int tel_anomaly_add(const char* name, int series, int kind, double raise, double clear,
+                            double for_seconds, double window_seconds, double period_seconds) {
+    if (kind != TEL_ALERT_EWMA && kind != TEL_ALERT_MAD && kind != TEL_ALERT_SEASONAL) return -1;
+    if (!g_tel.running || !(window_seconds > 0)) return -1;
+    if (kind == TEL_ALERT_SEASONAL && !(period_seconds > 0)) return -1;
+    TelAlertRule* rule = tel_alert_prepare(name, series, raise, clear, for_seconds);
+    if (!rule) return -1;
+
+    rule->kind = kind;
+    rule->window_seconds = window_seconds;
+    tel_anomaly_weights(rule);
+    if (kind == TEL_ALERT_SEASONAL) {
+        rule->inv_period = 1.0 / period_seconds;
+        rule->slots = (double*)calloc(3 * TEL_SEASON_SLOTS, sizeof(double));
+        if (!rule->slots) return -1;
+    }
+    return tel_alert_publish();
+}
+
+// Remove every rule; only while the sampler is stopped
+TEL_API void tel_alert_clear(void) {
+    if (g_tel.running) return;
+    uint64_t count = tel_load_u64(&g_alerts.rule_count);
+    for (uint64_t r = 0; r < count; r++) {
+        free(g_alerts.rules[r].slots);
+        g_alerts.rules[r].slots = NULL;
+    }
+    tel_store_u64(&g_alerts.rule_count, 0);
+}
+
+// Remove every rule and close all sinks; only while the sampler is stopped
+TEL_API void tel_alert_reset(void) {
+    if (g_tel.running) return;
+    tel_alert_clear();
+    tel_alert_close_sinks();
+}
+
+// 1 while the rule is raised, 0 if not, -1 for a bad index
+TEL_API int tel_alert_active(int rule) {
+    if (rule < 0 || (uint64_t)rule >= tel_load_u64(&g_alerts.rule_count)) return -1;
+    return g_alerts.rules[rule].active;
+}
+
+// Total events recorded since the sinks were set up
+TEL_API uint64_t tel_alert_written(void) {
+    return g_alerts.ring ? tel_load_u64(&g_alerts.ring->written) : 0;
+}
+
+// Copy up to 'max_count' events numbered 'since' and later, oldest first.
+// Events the ring has already reused are skipped; 'next' receives the number
+// to pass as 'since' next time. Returns the number copied.
+TEL_API int tel_alert_events(uint64_t since, TelAlertEvent* out, int max_count, uint64_t* next) {
+    if (!g_alerts.ring || !out || max_count <= 0) {
+        if (next) *next = since;
+        return 0;
+    }
+    uint64_t written = tel_load_u64(&g_alerts.ring->written);
+    uint64_t oldest = written > TEL_ALERT_EVENTS ? written - TEL_ALERT_EVENTS : 0;
+    uint64_t start = since > oldest ? since : oldest;
+    if (start > written) start = written;
+    int n = (int)(written - start < (uint64_t)max_count ? written - start : (uint64_t)max_count);
+    for (int i = 0; i < n; i++) out[i] = g_alerts.ring->events[(start + i) % TEL_ALERT_EVENTS];
+
+    // Drop copies the sampler may have overwritten while we read, including
+    // the slot of event 'after', which it may be filling right now
+    uint64_t after = tel_load_u64(&g_alerts.ring->written);
+    uint64_t valid_from = after + 1 > TEL_ALERT_EVENTS ? after + 1 - TEL_ALERT_EVENTS : 0;
+    int skip = start < valid_from ? (int)(valid_from - start < (uint64_t)n ? valid_from - start : (uint64_t)n) : 0;
+    if (skip) memmove(out, out + skip, (size_t)(n - skip) * sizeof(TelAlertEvent));
+    if (next) *next = start + (uint64_t)n;
+    return n - skip;
+}
+
+// ==================== Sampling ====================
+
+// Fill g_tel.frame: [cpu0.mhz .. cpuN.mhz, cpu0.busy .. cpuN.busy, cpu.throttled, memory.ecc_errors]
+static void tel_sample_frame(TelCpuTimes* scratch) {
+    int n = g_tel.cpu_count;
+    int mhz_ok = tel_read_mhz(g_tel.frame);
+    g_tel.frame[2 * n] = tel_read_throttled(mhz_ok);
+    g_tel.frame[2 * n + 1] = tel_read_ecc_errors();
+
+    double* busy = g_tel.frame + n;
+    if (!tel_read_cpu_times(scratch)) {
+        for (int i = 0; i < n; i++) busy[i] = NAN;
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        uint64_t dt = scratch[i].total - g_tel.cpu_times[i].total;
+        uint64_t db = scratch[i].busy - g_tel.cpu_times[i].busy;
+        busy[i] = (dt > 0 && g_tel.cpu_times[i].total) ? 100.0 * (double)db / (double)dt : NAN;
+        g_tel.cpu_times[i] = scratch[i];
+    }
+}
+
+// Append the current frame as sample number 'written' (single writer)
+static void tel_append(double timestamp) {
+    uint64_t k = g_tel.written;
+    int slot = (int)(k % (uint64_t)g_tel.capacity);
+    int mirror = slot + g_tel.capacity;
+    for (int s = 0; s < g_tel.series_count; s++) {
+        double* values = g_tel.series[s].values;
+        values[slot] = g_tel.frame[s];
+        values[mirror] = g_tel.frame[s];
+    }
+    g_tel.timestamps[slot] = timestamp;
+    g_tel.timestamps[mirror] = timestamp;
+    tel_store_written(k + 1);   // publishes the sample to readers
+}
+
+static void tel_loop(void) {
+    TelCpuTimes* scratch = (TelCpuTimes*)calloc(g_tel.cpu_count, sizeof(TelCpuTimes));
+    if (!scratch) return;
+    tel_read_cpu_times(g_tel.cpu_times);   // baseline for the first busy %
+
+    double next = tel_epoch_seconds();
+    while (!g_tel.stop) {
+        next += g_tel.interval_ms / 1000.0;
+        double wait = (next - tel_epoch_seconds()) * 1000.0;
+        if (wait > 0) tel_sleep_ms(wait);
+        else next = tel_epoch_seconds();   // fell behind: skip missed ticks instead of bursting
+        if (g_tel.stop) break;
+
+        double timestamp = tel_epoch_seconds();
+        double late_us = (timestamp - next) * 1e6;
+        hdr_record(&g_tel.tick_latency, late_us > 0 ? (uint64_t)late_us : 0);
+        tel_sample_frame(scratch);
+        tel_append(timestamp);
+        tel_alert_evaluate(timestamp);
+    }
+    free(scratch);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI tel_thread(LPVOID param) {
+    (void)param;
+    tel_loop();
+    return 0;
+}
+#else
+static void* tel_thread(void* param) {
+    (void)param;
+    tel_loop();
+    return NULL;
+}
+#endif
+
+// ==================== API ====================
+
+// Release the rings; only valid while stopped
+TEL_API void tel_free(void) {
+    if (g_tel.running) return;
+    if (g_tel.series) {
+        for (int s = 0; s < g_tel.series_count; s++) free(g_tel.series[s].values);
+    }
+    free(g_tel.series);
+    free(g_tel.timestamps);
+    free(g_tel.cpu_times);
+    free(g_tel.frame);
+    if (g_tel.tick_latency.counts) hdr_free(&g_tel.tick_latency);
+    tel_sources_close();
+    memset(&g_tel, 0, sizeof(g_tel));
+}
+
+// Allocate rings for 'capacity' samples per series and start sampling every
+// 'interval_ms'. Returns the number of series, or -1 on failure.
+TEL_API int tel_start(double interval_ms, int capacity) {
+    if (g_tel.running) return -1;
+    tel_free();
+    if (capacity < 2) capacity = 2;
+    if (interval_ms < TEL_MIN_INTERVAL_MS) interval_ms = TEL_MIN_INTERVAL_MS;
+
+    g_tel.interval_ms = interval_ms;
+    g_tel.capacity = capacity;
+    g_tel.cpu_count = tel_detect_cpus();
+    if (g_tel.cpu_count > TEL_MAX_CPUS) g_tel.cpu_count = TEL_MAX_CPUS;
+    g_tel.series_count = 2 * g_tel.cpu_count + 2;
+
+    g_tel.timestamps = (double*)calloc(2 * (size_t)capacity, sizeof(double));
+    g_tel.series = (TelSeries*)calloc(g_tel.series_count, sizeof(TelSeries));
+    g_tel.cpu_times = (TelCpuTimes*)calloc(g_tel.cpu_count, sizeof(TelCpuTimes));
+    g_tel.frame = (double*)calloc(g_tel.series_count, sizeof(double));
+    if (!g_tel.timestamps || !g_tel.series || !g_tel.cpu_times || !g_tel.frame ||
+        hdr_init(&g_tel.tick_latency, 60ull * 1000000ull, 7) != 0) {   // up to a minute, 0.8%
+        tel_free();
+        return -1;
+    }
+    for (int s = 0; s < g_tel.series_count; s++) {
+        TelSeries* series = &g_tel.series[s];
+        int cpu = s % g_tel.cpu_count;
+        if (s < g_tel.cpu_count) {
+            snprintf(series->name, sizeof(series->name), "cpu%d.mhz", cpu);
+            series->unit = "MHz";
+        } else if (s < 2 * g_tel.cpu_count) {
+            snprintf(series->name, sizeof(series->name), "cpu%d.busy", cpu);
+            series->unit = "%";
+        } else if (s == 2 * g_tel.cpu_count) {
+            snprintf(series->name, sizeof(series->name), "cpu.throttled");
+            series->unit = "CPUs";
+        } else {
+            snprintf(series->name, sizeof(series->name), "memory.ecc_errors");
+            series->unit = "errors";
+        }
+        series->values = (double*)calloc(2 * (size_t)capacity, sizeof(double));
+        if (!series->values) {
+            tel_free();
+            return -1;
+        }
+    }
+    tel_sources_open();
+    tel_alert_rearm();
+
+    g_tel.stop = 0;
+#ifdef _WIN32
+    g_tel.thread = CreateThread(NULL, 0, tel_thread, NULL, 0, NULL);
+    if (!g_tel.thread) {
+        tel_free();
+        return -1;
+    }
+#else
+    if (pthread_create(&g_tel.thread, NULL, tel_thread, NULL) != 0) {
+        tel_free();
+        return -1;
+    }
+#endif
+    g_tel.running = 1;
+    return g_tel.series_count;
+}
+
+// Stop the sampler thread; the rings (and any views into them) stay valid until tel_free()
+TEL_API void tel_stop(void) {
+    if (!g_tel.running) return;
+    g_tel.stop = 1;
+#ifdef _WIN32
+    WaitForSingleObject(g_tel.thread, INFINITE);
+    CloseHandle(g_tel.thread);
+#else
+    pthread_join(g_tel.thread, NULL);
+#endif
+    g_tel.running = 0;
+}
+
+TEL_API int tel_series_count(void) { return g_tel.series_count; }
+TEL_API int tel_capacity(void) { return g_tel.capacity; }
+TEL_API double tel_interval_ms(void) { return g_tel.interval_ms; }
+
+TEL_API const char* tel_series_name(int series) {
+    return (series >= 0 && series < g_tel.series_count) ? g_tel.series[series].name : NULL;
+}
+
+TEL_API const char* tel_series_unit(int series) {
+    return (series >= 0 && series < g_tel.series_count) ? g_tel.series[series].unit : NULL;
+}
+
+// Index of a series by name, or -1
+TEL_API int tel_find(const char* name) {
+    for (int s = 0; s < g_tel.series_count; s++) {
+        if (strcmp(g_tel.series[s].name, name) == 0) return s;
+    }
+    return -1;
+}
+
+// Encode the tick lateness histogram (hdr_encode() form) into 'out'; returns
+// its length, or -1 if 'size' is too small. Read while sampling, the counts
+// may trail the newest tick.
+TEL_API int tel_tick_latency(char* out, int size) {
+    if (!g_tel.tick_latency.counts || !out || size <= 0) return -1;
+    return hdr_encode(&g_tel.tick_latency, out, (size_t)size);
+}
+
+// Total samples written since tel_start()
+TEL_API uint64_t tel_written(void) { return tel_load_written(); }
+
+// Number of leading samples of a view starting at sample 'first' that have
+// been overwritten since the view was taken (0 while it is fully intact)
+TEL_API int tel_overwritten(uint64_t first, int count) {
+    uint64_t written = tel_load_written();
+    uint64_t limit = first + (uint64_t)g_tel.capacity;
+    if (written <= limit) return 0;
+    uint64_t lost = written - limit;
+    return lost >= (uint64_t)count ? count : (int)lost;
+}
+
+// Point 'ts' and 'values' at the newest min(max_count, available) samples of
+// a series, oldest first, and store the sample number of the first one in
+// 'first'. Returns the sample count (0 if there is nothing yet, -1 for a bad
+// series). Pass series -1 to get only the timestamps.
+TEL_API int tel_view(int series, int max_count, const double** ts, const double** values, uint64_t* first) {
+    if (series < -1 || series >= g_tel.series_count || !g_tel.timestamps) return -1;
+    uint64_t written = tel_load_written();
+    uint64_t available = written < (uint64_t)g_tel.capacity ? written : (uint64_t)g_tel.capacity;
+    int n = (max_count >= 0 && (uint64_t)max_count < available) ? max_count : (int)available;
+    uint64_t start = written - (uint64_t)n;
+    int slot = (int)(start % (uint64_t)g_tel.capacity);
+
+    if (ts) *ts = g_tel.timestamps + slot;
+    if (values) *values = series >= 0 ? g_tel.series[series].values + slot : NULL;
+    if (first) *first = start;
+    return n;
+}
+
+// Like tel_view(), restricted to samples with t0 <= timestamp < t1
+TEL_API int tel_query(int series, double t0, double t1, const double** ts, const double** values, uint64_t* first) {
+    const double* all_ts;
+    const double* all_values;
+    uint64_t all_first;
+    int n = tel_view(series, -1, &all_ts, &all_values, &all_first);
+    if (n <= 0) {
+        if (ts) *ts = NULL;
+        if (values) *values = NULL;
+        if (first) *first = 0;
+        return n;
+    }
+
+    // Timestamps are non-decreasing within a view: binary search both ends
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (all_ts[mid] < t0) lo = mid + 1; else hi = mid;
+    }
+    int begin = lo;
+    hi = n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (all_ts[mid] < t1) lo = mid + 1; else hi = mid;
+    }
+
+    if (ts) *ts = all_ts + begin;
+    if (values) *values = all_values ? all_values + begin : NULL;
+    if (first) *first = all_first + (uint64_t)begin;
+    return lo - begin;
+}
+
+// ==================== Downsampling ====================
+//
+// Both reducers work on plain x/y arrays (ring views, query results or any
+// caller buffer), so they also serve history loaded from elsewhere. Inner
+// loops walk contiguous doubles with no data-dependent stores, which lets the
+// compiler vectorise them. Non-finite values (NaN marks a missed sample) are
+// never chosen while a finite one is available.
+
+#define TEL_LTTB 0
+#define TEL_MINMAX 1
+
+// Largest-Triangle-Three-Buckets: keep the first and last points and, from
+// each of 'points' - 2 equal buckets in between, the point forming the largest
+// triangle with the previously kept point and the next bucket's average.
+// Returns the number of points written (min(n, points)).
+TEL_API int tel_lttb(const double* x, const double* y, int n, int points, double* out_x, double* out_y) {
+    if (n <= 0 || points <= 0) return 0;
+    if (points >= n || points < 3) {
+        int count = points >= n ? n : points;
+        for (int i = 0; i < count; i++) {
+            int src = (count == n) ? i : (int)((double)i * (n - 1) / (count > 1 ? count - 1 : 1));
+            out_x[i] = x[src];
+            out_y[i] = y[src];
+        }
+        return count;
+    }
+
+    double every = (double)(n - 2) / (double)(points - 2);
+    int kept = 0;
+    int a = 0;
+    out_x[kept] = x[0];
+    out_y[kept] = y[0];
+    kept++;
+
+    for (int b = 0; b < points - 2; b++) {
+        int start = (int)(b * every) + 1;
+        int end = (int)((b + 1) * every) + 1;
+        int next_end = (int)((b + 2) * every) + 1;
+        if (end > n - 1) end = n - 1;
+        if (next_end > n) next_end = n;
+
+        // Average of the next bucket (the last point for the final bucket)
+        double cx = 0, cy = 0;
+        int finite = 0;
+        for (int i = end; i < next_end; i++) {
+            int ok = isfinite(y[i]);
+            cx += ok ? x[i] : 0;
+            cy += ok ? y[i] : 0;
+            finite += ok;
+        }
+        if (finite) {
+            cx /= finite;
+            cy /= finite;
+        } else {
+            cx = x[n - 1];
+            cy = isfinite(y[n - 1]) ? y[n - 1] : y[a];
+        }
+
+        // Twice the triangle area is |A*x + B*y + C| for fixed a and c
+        double ax = x[a], ay = isfinite(y[a]) ? y[a] : cy;
+        double A = ay - cy, B = cx - ax, C = ax * cy - cx * ay;
+        double best_area = -1.0;
+        int best = start;
+        for (int i = start; i < end; i++) {
+            double area = fabs(A * x[i] + B * y[i] + C);
+            int better = area > best_area;   // false for NaN
+            best_area = better ? area : best_area;
+            best = better ? i : best;
+        }
+        out_x[kept] = x[best];
+        out_y[kept] = y[best];
+        kept++;
+        a = best;
+    }
+
+    out_x[kept] = x[n - 1];
+    out_y[kept] = y[n - 1];
+    return kept + 1;
+}
+
+// Min/max envelope: split into points / 2 equal buckets and keep each
+// bucket's lowest and highest point in time order, so spikes of a single
+// sample survive. Returns the number of points written (at most 'points').
+TEL_API int tel_minmax(const double* x, const double* y, int n, int points, double* out_x, double* out_y) {
+    if (n <= 0 || points <= 0) return 0;
+    if (points >= n) {
+        memcpy(out_x, x, (size_t)n * sizeof(double));
+        memcpy(out_y, y, (size_t)n * sizeof(double));
+        return n;
+    }
+    int buckets = points / 2 > 0 ? points / 2 : 1;
+    int kept = 0;
+    for (int b = 0; b < buckets; b++) {
+        int start = (int)((long long)b * n / buckets);
+        int end = (int)((long long)(b + 1) * n / buckets);
+        int lo = start, hi = start;
+        double lo_v = INFINITY, hi_v = -INFINITY;
+        for (int i = start; i < end; i++) {
+            int lower = y[i] < lo_v;    // comparisons with NaN are false
+            int higher = y[i] > hi_v;
+            lo_v = lower ? y[i] : lo_v;
+            lo = lower ? i : lo;
+            hi_v = higher ? y[i] : hi_v;
+            hi = higher ? i : hi;
+        }
+        int first = lo < hi ? lo : hi;
+        int second = lo < hi ? hi : lo;
+        out_x[kept] = x[first];
+        out_y[kept] = y[first];
+        kept++;
+        if (second != first && points > 1) {
+            out_x[kept] = x[second];
+            out_y[kept] = y[second];
+            kept++;
+        }
+    }
+    return kept;
+}
+
+typedef struct {
+    const int* series;
+    int series_count;
+    double t0, t1;
+    int points;
+    int method;
+    double* out_x;          // series_count rows of 'points'
+    double* out_y;
+    int* out_counts;
+    volatile long next;     // next row to claim
+} TelDownsampleJob;
+
+static long tel_claim(volatile long* next) {
+#ifdef _WIN32
+    return InterlockedIncrement(next) - 1;
+#else
+    return __atomic_fetch_add(next, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+static void tel_downsample_rows(TelDownsampleJob* job) {
+    for (;;) {
+        long row = tel_claim(&job->next);
+        if (row >= job->series_count) break;
+        const double* ts;
+        const double* values;
+        int n = tel_query(job->series[row], job->t0, job->t1, &ts, &values, NULL);
+        double* ox = job->out_x + (size_t)row * job->points;
+        double* oy = job->out_y + (size_t)row * job->points;
+        if (n <= 0 || !values) {
+            job->out_counts[row] = 0;
+        } else if (job->method == TEL_MINMAX) {
+            job->out_counts[row] = tel_minmax(ts, values, n, job->points, ox, oy);
+        } else {
+            job->out_counts[row] = tel_lttb(ts, values, n, job->points, ox, oy);
+        }
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI tel_downsample_thread(LPVOID param) {
+    tel_downsample_rows((TelDownsampleJob*)param);
+    return 0;
+}
+#else
+static void* tel_downsample_thread(void* param) {
+    tel_downsample_rows((TelDownsampleJob*)param);
+    return NULL;
+}
+#endif
+
+// Downsample several ring series over [t0, t1) to at most 'points' each,
+// one series per worker at a time on up to 'threads' threads (0 = one per
+// CPU). Row r of out_x/out_y (each series_count * points doubles) receives
+// series[r]; out_counts[r] its point count. Returns 0, or -1 on bad input.
+TEL_API int tel_downsample(const int* series, int series_count, double t0, double t1,
+                           int points, int method, int threads,
+                           double* out_x, double* out_y, int* out_counts) {
+    if (!series || series_count <= 0 || points <= 0 || !out_x || !out_y || !out_counts) return -1;
+    for (int r = 0; r < series_count; r++) {
+        if (series[r] < 0 || series[r] >= g_tel.series_count) return -1;
+    }
+
+    TelDownsampleJob job = {series, series_count, t0, t1, points, method, out_x, out_y, out_counts, 0};
+    if (threads <= 0) threads = tel_detect_cpus();
+    if (threads > series_count) threads = series_count;
+    if (threads > 64) threads = 64;
+
+    // The calling thread is worker 0
+#ifdef _WIN32
+    HANDLE workers[64];
+    int started = 0;
+    for (int t = 1; t < threads; t++) {
+        workers[started] = CreateThread(NULL, 0, tel_downsample_thread, &job, 0, NULL);
+        if (workers[started]) started++;
+    }
+    tel_downsample_rows(&job);
+    if (started) WaitForMultipleObjects((DWORD)started, workers, TRUE, INFINITE);
+    for (int t = 0; t < started; t++) CloseHandle(workers[t]);
+#else
+    pthread_t workers[64];
+    int started = 0;
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&workers[started], NULL, tel_downsample_thread, &job) == 0) started++;
+    }
+    tel_downsample_rows(&job);
+    for (int t = 0; t < started; t++) pthread_join(workers[t], NULL);
+#endif
+    return 0;
+}